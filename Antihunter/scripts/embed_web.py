@@ -0,0 +1,89 @@
+"""Gzips the web UI in Antihunter/web and embeds it as Antihunter/src/web_assets.h.
+
+Runs as a PlatformIO pre-build script (extra_scripts) and can also be run by
+hand. index.html references the other assets as "name?v={{name}}"; those
+placeholders are replaced with each asset's hash so the JS/CSS URLs change
+whenever their content does and can be cached indefinitely.
+"""
+import gzip
+import hashlib
+import os
+
+try:
+    Import("env")  # noqa: F821 (provided by PlatformIO)
+    ROOT = env.subst("$PROJECT_DIR")  # noqa: F821
+except NameError:
+    ROOT = os.path.abspath(os.path.join(os.path.dirname(__file__), "..", ".."))
+
+WEB_DIR = os.path.join(ROOT, "Antihunter", "web")
+OUT = os.path.join(ROOT, "Antihunter", "src", "web_assets.h")
+
+# (file, url, mime, cache-control); the page itself is revalidated every
+# load, the fingerprinted assets never are
+ASSETS = [
+    ("app.css", "/app.css", "text/css", "public, max-age=31536000, immutable"),
+    ("app.js", "/app.js", "application/javascript", "public, max-age=31536000, immutable"),
+    ("index.html", "/", "text/html", "no-cache"),
+]
+
+
+def digest(data):
+    return hashlib.sha256(data).hexdigest()[:16]
+
+
+def build():
+    hashes = {}
+    entries = []
+    for name, url, mime, cache in ASSETS:
+        with open(os.path.join(WEB_DIR, name), "rb") as f:
+            raw = f.read()
+        for ref, h in hashes.items():
+            raw = raw.replace(("{{%s}}" % ref).encode(), h.encode())
+        # mtime=0 keeps the output (and the ETag) reproducible
+        gz = gzip.compress(raw, compresslevel=9, mtime=0)
+        hashes[name] = digest(raw)
+        entries.append((name, url, mime, cache, raw, gz))
+
+    lines = [
+        "// Generated by Antihunter/scripts/embed_web.py from Antihunter/web; do not edit.",
+        "#pragma once",
+        "#include <Arduino.h>",
+        "",
+        "struct WebAsset {",
+        "    const char *url;",
+        "    const char *mime;",
+        "    const char *cacheControl;",
+        "    const char *etag;",
+        "    const uint8_t *data;",
+        "    size_t len;",
+        "};",
+        "",
+    ]
+    for i, (name, url, mime, cache, raw, gz) in enumerate(entries):
+        lines.append("// %s: %d bytes, %d gzipped" % (name, len(raw), len(gz)))
+        lines.append("static const uint8_t WEB_ASSET_%d[] PROGMEM = {" % i)
+        for off in range(0, len(gz), 20):
+            lines.append("    " + ",".join("0x%02x" % b for b in gz[off:off + 20]) + ",")
+        lines.append("};")
+        lines.append("")
+
+    lines.append("static const WebAsset WEB_ASSETS[] = {")
+    for i, (name, url, mime, cache, raw, gz) in enumerate(entries):
+        etag = '\\"%s\\"' % digest(gz)
+        lines.append('    {"%s", "%s", "%s", "%s", WEB_ASSET_%d, sizeof(WEB_ASSET_%d)},'
+                     % (url, mime, cache, etag, i, i))
+    lines.append("};")
+    lines.append("")
+
+    text = "\n".join(lines)
+    if os.path.exists(OUT):
+        with open(OUT) as f:
+            if f.read() == text:
+                return
+    with open(OUT, "w") as f:
+        f.write(text)
+    for name, url, mime, cache, raw, gz in entries:
+        print("[embed_web] %-10s %6d -> %5d bytes" % (name, len(raw), len(gz)))
+
+
+build()
@@ -0,0 +1,69 @@
+#include "advparse.h"
+#include <string.h>
+
+bool advParse(const uint8_t *payload, size_t len, AdvFields &out)
+{
+    memset(&out, 0, sizeof(out));
+    AdvSpan shortName = {nullptr, 0};
+    bool any = false;
+    size_t i = 0;
+    while (i < len) {
+        uint8_t fieldLen = payload[i];
+        if (fieldLen == 0) break;           // zero padding ends the data
+        if (i + 1 + fieldLen > len) {
+            out.malformed = true;
+            break;
+        }
+        uint8_t type = payload[i + 1];
+        AdvSpan v = {payload + i + 2, (uint8_t)(fieldLen - 1)};
+        any = true;
+        switch (type) {
+        case AD_FLAGS:
+            if (v.len) out.flags = v.data[0];
+            break;
+        case AD_NAME_COMPLETE:
+            out.name = v;
+            break;
+        case AD_NAME_SHORT:
+            shortName = v;
+            break;
+        case AD_MANUFACTURER:
+            if (!out.manufacturer.data) {
+                out.manufacturer = v;
+                if (v.len >= 2) out.companyId = (uint16_t)(v.data[0] | v.data[1] << 8);
+            }
+            break;
+        case AD_SERVICE_DATA16:
+            if (!out.serviceUuid && v.len >= 2) out.serviceUuid = (uint16_t)(v.data[0] | v.data[1] << 8);
+            break;
+        }
+        i += 1 + fieldLen;
+    }
+    if (!out.name.len) out.name = shortName;
+    return any;
+}
+
+void advMacFromNative(const uint8_t *native, uint8_t mac[6])
+{
+    for (int i = 0; i < 6; i++) mac[i] = native[5 - i];
+}
+
+size_t advCopyName(const AdvSpan &name, char *out, size_t cap)
+{
+    if (!cap) return 0;
+    size_t n = 0;
+    for (uint8_t i = 0; i < name.len && n < cap - 1; i++) {
+        uint8_t c = name.data[i];
+        if (c >= 32 && c <= 126) out[n++] = (char)c;
+    }
+    out[n] = 0;
+    return n;
+}
+
+uint32_t advSpanHash(const AdvSpan &s)
+{
+    if (!s.len) return 0;
+    uint32_t h = 2166136261u;
+    for (uint8_t i = 0; i < s.len; i++) h = (h ^ s.data[i]) * 16777619u;
+    return h ? h : 1;
+}
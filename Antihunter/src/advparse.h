@@ -0,0 +1,42 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// BLE advertising data read in place, shared with host tools (no Arduino
+// dependencies). A payload is a run of AD structures, [len][type][len - 1
+// bytes]; AdvFields points into it, so nothing is copied or allocated per
+// advertisement. A name is only copied out once the device is worth
+// keeping (a target match or an alert).
+
+const uint8_t AD_FLAGS = 0x01;
+const uint8_t AD_NAME_SHORT = 0x08;
+const uint8_t AD_NAME_COMPLETE = 0x09;
+const uint8_t AD_SERVICE_DATA16 = 0x16;
+const uint8_t AD_MANUFACTURER = 0xFF;
+
+struct AdvSpan {
+    const uint8_t *data;
+    uint8_t len;
+};
+
+struct AdvFields {
+    AdvSpan name;           // complete name, else the shortened one
+    AdvSpan manufacturer;   // little-endian company id, then its data
+    uint16_t companyId;     // 0 unless manufacturer.len >= 2
+    uint16_t serviceUuid;   // first 16-bit service data UUID, 0 if none
+    uint8_t flags;
+    bool malformed;         // a structure ran past the end; the ones before it are kept
+};
+
+// False only if payload holds no structures at all
+bool advParse(const uint8_t *payload, size_t len, AdvFields &out);
+
+// NimBLE stores addresses least significant byte first
+void advMacFromNative(const uint8_t *native, uint8_t mac[6]);
+
+// Printable ASCII of name into out, NUL-terminated and at most cap - 1
+// characters. Returns the length; 0 if nothing printable.
+size_t advCopyName(const AdvSpan &name, char *out, size_t cap);
+
+// FNV-1a of the span; 0 for an empty one
+uint32_t advSpanHash(const AdvSpan &s);
@@ -0,0 +1,452 @@
+#include "api.h"
+#include "hardware.h"
+#include "network.h"
+#include "scanner.h"
+#include "hitstore.h"
+#include "main.h"
+#include <ESPAsyncWebServer.h>
+#include <memory>
+
+extern volatile bool scanning;
+extern volatile int totalHits;
+extern volatile uint32_t framesSeen;
+extern volatile uint32_t bleFramesSeen;
+extern std::set<String> uniqueMacs;
+extern ScanMode currentScanMode;
+extern bool parseMac6(const String &in, uint8_t out[6]);
+
+static const uint32_t API_VERSION = 1;
+static const uint32_t API_HITS_DEFAULT_LIMIT = 500;
+static const uint32_t API_HITS_MAX_LIMIT = 2000;
+static const uint32_t API_ALERTS_MAX_LIMIT = 64;
+
+
+// Streaming
+//
+// A response is a prologue, zero or more records and an epilogue, emitted one
+// unit at a time straight into the chunk buffer. A unit that doesn't fit ends
+// the chunk and is re-encoded into the next one; only a chunk too small for a
+// single record goes through the spill buffer.
+
+enum ApiStream : uint8_t { API_STREAM_HITS, API_STREAM_ALERTS, API_STREAM_TRACK };
+enum ApiPhase : uint8_t { API_PHASE_HEAD, API_PHASE_RECORDS, API_PHASE_TAIL, API_PHASE_DONE };
+
+struct ApiCursor {
+    ApiStream stream;
+    ApiFormat fmt;
+    ApiPhase phase = API_PHASE_HEAD;
+    bool needComma = false;
+    uint32_t index = 0;     // alerts, track: last seq sent
+    uint32_t sent = 0;
+    uint32_t limit = 0;
+    uint64_t pos = HIT_CURSOR_START;
+    HitQuery query;
+    uint8_t spill[256];
+    uint16_t spillLen = 0;
+    uint16_t spillPos = 0;
+};
+
+static void emitHitsHead(ApiCursor &c, ApiWriter &w)
+{
+    uint32_t head;
+    {
+        std::lock_guard<std::mutex> lock(antihunter::lastResultsMutex);
+        head = hitStore.headSeq();
+    }
+    w.beginMap(4);
+    w.key("v");
+    w.u32(API_VERSION);
+    w.key("head");
+    w.u32(head);
+    w.key("hits");
+    w.beginArray();
+}
+
+// Returns false when there are no more records
+static bool emitHitRecord(ApiCursor &c, ApiWriter &w)
+{
+    if (c.sent >= c.limit) return false;
+    StoredHit s;
+    {
+        std::lock_guard<std::mutex> lock(antihunter::lastResultsMutex);
+        if (!hitStore.next(c.query, c.pos, s)) return false;
+    }
+    const Hit &h = s.hit;
+    w.beginMap(7);
+    w.key("seq");
+    w.u32(s.seq);
+    w.key("ms");
+    w.u32(s.ms);
+    w.key("mac");
+    w.mac(h.mac);
+    w.key("rssi");
+    w.i32(h.rssi);
+    w.key("ch");
+    w.u32(h.ch);
+    w.key("ble");
+    w.boolean(h.isBLE);
+    w.key("name");
+    w.text(h.name, strnlen(h.name, sizeof(h.name)));
+    w.endMap();
+    return true;
+}
+
+// cursor is null once the query is exhausted, otherwise pass it back as-is
+static void emitHitsTail(ApiCursor &c, ApiWriter &w)
+{
+    w.endArray();
+    w.key("cursor");
+    if (c.pos == HIT_CURSOR_DONE) w.null();
+    else w.u64(c.pos);
+    w.endMap();
+}
+
+static void emitAlertsHead(ApiCursor &c, ApiWriter &w)
+{
+    w.beginMap(3);
+    w.key("v");
+    w.u32(API_VERSION);
+    w.key("alerts");
+    w.beginArray();
+}
+
+static bool emitAlertRecord(ApiCursor &c, ApiWriter &w)
+{
+    AlertRecord a;
+    if (c.sent >= c.limit || !nextAlertSince(c.index, a)) return false;
+    w.beginMap(5);
+    w.key("seq");
+    w.u32(a.seq);
+    w.key("ms");
+    w.u32(a.ms);
+    w.key("ts");
+    if (a.epoch) w.u32(a.epoch);
+    else w.null();
+    w.key("kind");
+    w.text(a.tag, strnlen(a.tag, sizeof(a.tag)));
+    w.key("text");
+    w.text(a.text, strnlen(a.text, sizeof(a.text)));
+    w.endMap();
+    c.index = a.seq;
+    return true;
+}
+
+static void emitAlertsTail(ApiCursor &c, ApiWriter &w)
+{
+    w.endArray();
+    w.key("last");
+    w.u32(c.index);
+    w.endMap();
+}
+
+static void emitTrackHead(ApiCursor &c, ApiWriter &w)
+{
+    w.beginMap(3);
+    w.key("v");
+    w.u32(API_VERSION);
+    w.key("track");
+    w.beginArray();
+}
+
+static bool emitTrackRecord(ApiCursor &c, ApiWriter &w)
+{
+    TrackPoint p;
+    if (c.sent >= c.limit || !nextTrackPointSince(c.index, p)) return false;
+    w.beginMap(11);
+    w.key("seq");
+    w.u32(p.seq);
+    w.key("ms");
+    w.u32(p.ms);
+    w.key("ts");
+    if (p.epoch) w.u32(p.epoch);
+    else w.null();
+    w.key("lat");
+    w.f64(p.lat, 7);
+    w.key("lon");
+    w.f64(p.lon, 7);
+    w.key("major");
+    w.f32(p.major, 1);
+    w.key("minor");
+    w.f32(p.minor, 1);
+    w.key("heading");
+    w.f32(p.headingDeg, 0);
+    w.key("rms");
+    w.f32(p.rmsResidual, 1);
+    w.key("nodes");
+    w.u32(p.nodes);
+    w.key("method");
+    w.text(trackMethodName(p.method));
+    w.endMap();
+    c.index = p.seq;
+    return true;
+}
+
+// Encodes the next unit into w. The cursor only advances if it fit.
+static void emitNext(ApiCursor &c, ApiWriter &w)
+{
+    ApiPhase phase = c.phase;
+    bool needComma = c.needComma;
+    uint32_t index = c.index, sent = c.sent;
+    uint64_t pos = c.pos;
+    bool hits = c.stream == API_STREAM_HITS;
+    bool more;
+    switch (c.phase) {
+        case API_PHASE_HEAD:
+            if (hits) emitHitsHead(c, w);
+            else if (c.stream == API_STREAM_TRACK) emitTrackHead(c, w);
+            else emitAlertsHead(c, w);
+            c.phase = API_PHASE_RECORDS;
+            break;
+        case API_PHASE_RECORDS:
+            more = hits ? emitHitRecord(c, w)
+                 : c.stream == API_STREAM_TRACK ? emitTrackRecord(c, w)
+                 : emitAlertRecord(c, w);
+            if (more) {
+                c.sent++;
+            } else {
+                c.phase = API_PHASE_TAIL;
+            }
+            break;
+        case API_PHASE_TAIL:
+            // Track ends like alerts: the last seq, to pass back as since
+            if (hits) emitHitsTail(c, w);
+            else emitAlertsTail(c, w);
+            c.phase = API_PHASE_DONE;
+            break;
+        case API_PHASE_DONE:
+            break;
+    }
+    if (w.overflow) {
+        c.phase = phase;
+        c.needComma = needComma;
+        c.index = index;
+        c.sent = sent;
+        c.pos = pos;
+    } else {
+        c.needComma = w.needComma;
+    }
+}
+
+static size_t apiFill(ApiCursor &c, uint8_t *buf, size_t maxLen)
+{
+    size_t out = 0;
+    while (out < maxLen) {
+        if (c.spillPos < c.spillLen) {
+            size_t n = c.spillLen - c.spillPos;
+            if (n > maxLen - out) n = maxLen - out;
+            memcpy(buf + out, c.spill + c.spillPos, n);
+            c.spillPos += n;
+            out += n;
+            continue;
+        }
+        if (c.phase == API_PHASE_DONE) break;
+
+        ApiWriter w(buf + out, maxLen - out, c.fmt, c.needComma);
+        emitNext(c, w);
+        if (!w.overflow) {
+            out += w.len;
+            continue;
+        }
+        if (out > 0) break;
+
+        ApiWriter s(c.spill, sizeof(c.spill), c.fmt, c.needComma);
+        emitNext(c, s);
+        if (s.overflow) {
+            // Unit larger than the spill buffer; cannot happen with the
+            // fixed-size records above, but never loop forever on it
+            c.phase = API_PHASE_DONE;
+            break;
+        }
+        c.spillLen = s.len;
+        c.spillPos = 0;
+    }
+    return out;
+}
+
+static ApiFormat requestFormat(AsyncWebServerRequest *r)
+{
+    if (r->hasParam("fmt")) {
+        return r->getParam("fmt")->value() == "cbor" ? API_CBOR : API_JSON;
+    }
+    if (r->hasHeader("Accept") && r->getHeader("Accept")->value().indexOf("application/cbor") >= 0) {
+        return API_CBOR;
+    }
+    return API_JSON;
+}
+
+static const char *formatMime(ApiFormat fmt)
+{
+    return fmt == API_CBOR ? "application/cbor" : "application/json";
+}
+
+static uint32_t uintParam(AsyncWebServerRequest *r, const char *name, uint32_t def, uint32_t max)
+{
+    if (!r->hasParam(name)) return def;
+    long v = r->getParam(name)->value().toInt();
+    if (v < 0) return 0;
+    return (uint32_t)v > max ? max : (uint32_t)v;
+}
+
+static void sendApiStream(AsyncWebServerRequest *r, std::shared_ptr<ApiCursor> cursor)
+{
+    cursor->fmt = requestFormat(r);
+    AsyncWebServerResponse *res = r->beginChunkedResponse(formatMime(cursor->fmt),
+        [cursor](uint8_t *buf, size_t maxLen, size_t) -> size_t
+        { return apiFill(*cursor, buf, maxLen); });
+    res->addHeader("Cache-Control", "no-store");
+    r->send(res);
+}
+
+static bool parseOui3(const String &in, uint8_t out[3])
+{
+    String t;
+    for (size_t i = 0; i < in.length(); ++i) {
+        char c = in[i];
+        if (isxdigit((int)c)) t += c;
+    }
+    if (t.length() != 6) return false;
+    for (int i = 0; i < 3; i++) {
+        out[i] = (uint8_t)strtoul(t.substring(i * 2, i * 2 + 2).c_str(), nullptr, 16);
+    }
+    return true;
+}
+
+// mac, oui, ch, minRssi, since (seq), sinceMs, order=rssi|newest, cursor
+static bool parseHitQuery(AsyncWebServerRequest *r, ApiCursor &c, const char *&err)
+{
+    HitQuery &q = c.query;
+    if (r->hasParam("mac")) {
+        if (!parseMac6(r->getParam("mac")->value(), q.mac)) {
+            err = "bad mac";
+            return false;
+        }
+        q.hasMac = true;
+    }
+    if (r->hasParam("oui")) {
+        if (!parseOui3(r->getParam("oui")->value(), q.oui)) {
+            err = "bad oui";
+            return false;
+        }
+        q.hasOui = true;
+    }
+    if (r->hasParam("ch")) q.ch = (int16_t)uintParam(r, "ch", 0, 255);
+    if (r->hasParam("minRssi")) {
+        long v = r->getParam("minRssi")->value().toInt();
+        q.minRssi = (int8_t)(v < -128 ? -128 : v > 127 ? 127 : v);
+    }
+    q.afterSeq = uintParam(r, "since", 0, UINT32_MAX);
+    q.sinceMs = uintParam(r, "sinceMs", 0, UINT32_MAX);
+    q.byRssi = r->hasParam("order") && r->getParam("order")->value() == "rssi";
+    if (r->hasParam("cursor")) {
+        c.pos = strtoull(r->getParam("cursor")->value().c_str(), nullptr, 10);
+    }
+    return true;
+}
+
+static size_t encodeStatus(ApiWriter &w)
+{
+    const char *mode = (currentScanMode == SCAN_WIFI) ? "wifi" :
+                       (currentScanMode == SCAN_BLE) ? "ble" : "both";
+    int64_t epochUs = getEpochMicros();
+    String node = getNodeId();
+
+    w.beginMap(16);
+    w.key("v");
+    w.u32(API_VERSION);
+    w.key("node");
+    w.text(node.c_str(), node.length());
+    w.key("uptime");
+    w.u32(millis() / 1000);
+    w.key("epochMs");
+    if (epochUs > 0) w.u64((uint64_t)(epochUs / 1000));
+    else w.null();
+    w.key("scanning");
+    w.boolean(scanning);
+    w.key("mode");
+    w.text(mode);
+    w.key("wifiFrames");
+    w.u32(framesSeen);
+    w.key("bleFrames");
+    w.u32(bleFramesSeen);
+    w.key("hits");
+    w.u32(totalHits);
+    w.key("unique");
+    w.u32(uniqueMacs.size());
+    w.key("targets");
+    w.u32(getTargetCount());
+    w.key("tempC");
+    w.f32(temperatureRead(), 1);
+    w.key("gps");
+    if (gpsValid) {
+        w.beginMap(2);
+        w.key("lat");
+        w.f32(gpsLat, 6);
+        w.key("lon");
+        w.f32(gpsLon, 6);
+        w.endMap();
+    } else {
+        w.null();
+    }
+    w.key("rtc");
+    w.text(!rtcAvailable ? "none" : rtcSynced ? "synced" : "unsynced");
+    w.key("sd");
+    w.boolean(sdAvailable);
+    w.key("heap");
+    w.u32(ESP.getFreeHeap());
+    w.endMap();
+    return w.overflow ? 0 : w.len;
+}
+
+void registerApiRoutes(AsyncWebServer *server)
+{
+    server->on("/api/v1/hits", HTTP_GET, [](AsyncWebServerRequest *r)
+               {
+        auto cursor = std::make_shared<ApiCursor>();
+        cursor->stream = API_STREAM_HITS;
+        cursor->limit = uintParam(r, "limit", API_HITS_DEFAULT_LIMIT, API_HITS_MAX_LIMIT);
+        const char *err = nullptr;
+        if (!parseHitQuery(r, *cursor, err)) {
+            r->send(400, "text/plain", err);
+            return;
+        }
+        sendApiStream(r, cursor); });
+
+    server->on("/api/v1/alerts", HTTP_GET, [](AsyncWebServerRequest *r)
+               {
+        auto cursor = std::make_shared<ApiCursor>();
+        cursor->stream = API_STREAM_ALERTS;
+        cursor->index = uintParam(r, "since", 0, UINT32_MAX);
+        cursor->limit = uintParam(r, "limit", API_ALERTS_MAX_LIMIT, API_ALERTS_MAX_LIMIT);
+        sendApiStream(r, cursor); });
+
+    server->on("/api/v1/track", HTTP_GET, [](AsyncWebServerRequest *r)
+               {
+        auto cursor = std::make_shared<ApiCursor>();
+        cursor->stream = API_STREAM_TRACK;
+        cursor->index = uintParam(r, "since", 0, UINT32_MAX);
+        cursor->limit = uintParam(r, "limit", API_ALERTS_MAX_LIMIT, API_ALERTS_MAX_LIMIT);
+        sendApiStream(r, cursor); });
+
+    server->on("/api/v1/status", HTTP_GET, [](AsyncWebServerRequest *r)
+               {
+        uint8_t buf[384];
+        ApiFormat fmt = requestFormat(r);
+        ApiWriter w(buf, sizeof(buf), fmt);
+        size_t n = encodeStatus(w);
+        if (n == 0) {
+            r->send(500, "text/plain", "status encode failed");
+            return;
+        }
+        // Binary body, so no String; the response reads it after we return
+        auto body = std::make_shared<std::vector<uint8_t>>(buf, buf + n);
+        AsyncWebServerResponse *res = r->beginResponse(formatMime(fmt), n,
+            [body](uint8_t *out, size_t maxLen, size_t index) -> size_t
+            {
+                size_t len = body->size() - index;
+                if (len > maxLen) len = maxLen;
+                memcpy(out, body->data() + index, len);
+                return len;
+            });
+        res->addHeader("Cache-Control", "no-store");
+        r->send(res); });
+}
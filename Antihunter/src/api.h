@@ -0,0 +1,48 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+class AsyncWebServer;
+
+enum ApiFormat : uint8_t { API_JSON, API_CBOR };
+
+// Encodes records straight into a caller-owned buffer, as CBOR or compact
+// JSON. On overflow the writer stops and flags it; callers roll back to the
+// last record boundary and retry with a fresh buffer.
+struct ApiWriter {
+    uint8_t *buf;
+    size_t cap;
+    size_t len;
+    bool overflow;
+    bool needComma;
+    ApiFormat fmt;
+
+    ApiWriter(uint8_t *b, size_t c, ApiFormat f, bool comma = false)
+        : buf(b), cap(c), len(0), overflow(false), needComma(comma), fmt(f) {}
+
+    void beginMap(uint8_t pairs);
+    void endMap();
+    void beginArray();   // indefinite length in CBOR
+    void endArray();
+    void key(const char *k);
+
+    void u32(uint32_t v);
+    void i32(int32_t v);
+    void u64(uint64_t v);
+    void f32(float v, uint8_t decimals);
+    void f64(double v, uint8_t decimals);   // coordinates a float can't hold to the metre
+    void boolean(bool v);
+    void text(const char *s);
+    void text(const char *s, size_t n);
+    void mac(const uint8_t m[6]);   // CBOR bytes(6), JSON "AA:BB:.."
+    void null();
+
+  private:
+    void put(const void *p, size_t n);
+    void putByte(uint8_t b);
+    void cborHead(uint8_t major, uint64_t v);
+    void separate();
+    void jsonNumber(const char *fmt, ...);
+};
+
+void registerApiRoutes(AsyncWebServer *server);
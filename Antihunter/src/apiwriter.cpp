@@ -0,0 +1,270 @@
+#include "api.h"
+#include <cmath>
+#include <cstdarg>
+#include <stdio.h>
+#include <string.h>
+
+void ApiWriter::put(const void *p, size_t n)
+{
+    if (overflow || len + n > cap) {
+        overflow = true;
+        return;
+    }
+    memcpy(buf + len, p, n);
+    len += n;
+}
+
+void ApiWriter::putByte(uint8_t b)
+{
+    if (overflow || len >= cap) {
+        overflow = true;
+        return;
+    }
+    buf[len++] = b;
+}
+
+void ApiWriter::cborHead(uint8_t major, uint64_t v)
+{
+    uint8_t h[9];
+    size_t n;
+    major <<= 5;
+    if (v < 24) {
+        h[0] = major | (uint8_t)v;
+        n = 1;
+    } else if (v <= 0xFF) {
+        h[0] = major | 24;
+        h[1] = (uint8_t)v;
+        n = 2;
+    } else if (v <= 0xFFFF) {
+        h[0] = major | 25;
+        h[1] = (uint8_t)(v >> 8);
+        h[2] = (uint8_t)v;
+        n = 3;
+    } else if (v <= 0xFFFFFFFFULL) {
+        h[0] = major | 26;
+        for (int i = 0; i < 4; i++) h[1 + i] = (uint8_t)(v >> (24 - 8 * i));
+        n = 5;
+    } else {
+        h[0] = major | 27;
+        for (int i = 0; i < 8; i++) h[1 + i] = (uint8_t)(v >> (56 - 8 * i));
+        n = 9;
+    }
+    put(h, n);
+}
+
+// JSON: comma before any element or key that follows another one
+void ApiWriter::separate()
+{
+    if (fmt == API_JSON && needComma) putByte(',');
+}
+
+void ApiWriter::jsonNumber(const char *f, ...)
+{
+    char tmp[32];
+    va_list args;
+    va_start(args, f);
+    int n = vsnprintf(tmp, sizeof(tmp), f, args);
+    va_end(args);
+    if (n < 0 || n >= (int)sizeof(tmp)) {
+        overflow = true;
+        return;
+    }
+    put(tmp, n);
+}
+
+void ApiWriter::beginMap(uint8_t pairs)
+{
+    separate();
+    if (fmt == API_CBOR) cborHead(5, pairs);
+    else putByte('{');
+    needComma = false;
+}
+
+void ApiWriter::endMap()
+{
+    if (fmt == API_JSON) putByte('}');
+    needComma = true;
+}
+
+void ApiWriter::beginArray()
+{
+    separate();
+    if (fmt == API_CBOR) putByte(0x9F);
+    else putByte('[');
+    needComma = false;
+}
+
+void ApiWriter::endArray()
+{
+    putByte(fmt == API_CBOR ? 0xFF : ']');
+    needComma = true;
+}
+
+void ApiWriter::key(const char *k)
+{
+    separate();
+    size_t n = strlen(k);
+    if (fmt == API_CBOR) {
+        cborHead(3, n);
+        put(k, n);
+    } else {
+        putByte('"');
+        put(k, n);
+        put("\":", 2);
+    }
+    needComma = false;
+}
+
+void ApiWriter::u32(uint32_t v)
+{
+    separate();
+    if (fmt == API_CBOR) cborHead(0, v);
+    else jsonNumber("%lu", (unsigned long)v);
+    needComma = true;
+}
+
+void ApiWriter::i32(int32_t v)
+{
+    separate();
+    if (fmt == API_CBOR) {
+        if (v >= 0) cborHead(0, (uint64_t)v);
+        else cborHead(1, (uint64_t)(-1 - (int64_t)v));
+    } else {
+        jsonNumber("%ld", (long)v);
+    }
+    needComma = true;
+}
+
+void ApiWriter::u64(uint64_t v)
+{
+    separate();
+    if (fmt == API_CBOR) cborHead(0, v);
+    else jsonNumber("%llu", (unsigned long long)v);
+    needComma = true;
+}
+
+void ApiWriter::f32(float v, uint8_t decimals)
+{
+    separate();
+    if (fmt == API_CBOR) {
+        uint32_t bits;
+        memcpy(&bits, &v, 4);
+        uint8_t h[5] = {0xFA, (uint8_t)(bits >> 24), (uint8_t)(bits >> 16), (uint8_t)(bits >> 8), (uint8_t)bits};
+        put(h, 5);
+    } else if (std::isnan(v) || std::isinf(v)) {
+        put("null", 4);
+    } else {
+        jsonNumber("%.*f", decimals, v);
+    }
+    needComma = true;
+}
+
+void ApiWriter::f64(double v, uint8_t decimals)
+{
+    separate();
+    if (fmt == API_CBOR) {
+        uint64_t bits;
+        memcpy(&bits, &v, 8);
+        uint8_t h[9] = {0xFB};
+        for (int i = 0; i < 8; i++) h[1 + i] = (uint8_t)(bits >> (56 - 8 * i));
+        put(h, 9);
+    } else if (std::isnan(v) || std::isinf(v)) {
+        put("null", 4);
+    } else {
+        jsonNumber("%.*f", decimals, v);
+    }
+    needComma = true;
+}
+
+void ApiWriter::boolean(bool v)
+{
+    separate();
+    if (fmt == API_CBOR) putByte(v ? 0xF5 : 0xF4);
+    else if (v) put("true", 4);
+    else put("false", 5);
+    needComma = true;
+}
+
+void ApiWriter::null()
+{
+    separate();
+    if (fmt == API_CBOR) putByte(0xF6);
+    else put("null", 4);
+    needComma = true;
+}
+
+// Length of the valid UTF-8 sequence at p, 0 if invalid
+static size_t utf8SeqLen(const uint8_t *p, size_t avail)
+{
+    uint8_t c = p[0];
+    size_t n;
+    if (c < 0x80) return 1;
+    else if ((c & 0xE0) == 0xC0 && c >= 0xC2) n = 2;
+    else if ((c & 0xF0) == 0xE0) n = 3;
+    else if ((c & 0xF8) == 0xF0 && c <= 0xF4) n = 4;
+    else return 0;
+    if (n > avail) return 0;
+    for (size_t i = 1; i < n; i++) {
+        if ((p[i] & 0xC0) != 0x80) return 0;
+    }
+    if (n == 3 && ((c == 0xE0 && p[1] < 0xA0) || (c == 0xED && p[1] >= 0xA0))) return 0;
+    if (n == 4 && ((c == 0xF0 && p[1] < 0x90) || (c == 0xF4 && p[1] >= 0x90))) return 0;
+    return n;
+}
+
+// SSIDs and BLE names are arbitrary bytes; invalid UTF-8 goes out as '?',
+// byte for byte, so the CBOR length header stays exact
+void ApiWriter::text(const char *s, size_t n)
+{
+    separate();
+    const uint8_t *p = (const uint8_t *)s;
+    if (fmt == API_CBOR) cborHead(3, n);
+    else putByte('"');
+
+    size_t i = 0;
+    while (i < n && !overflow) {
+        size_t seq = utf8SeqLen(p + i, n - i);
+        if (seq == 0) {
+            putByte('?');
+            i++;
+        } else if (seq > 1) {
+            put(p + i, seq);
+            i += seq;
+        } else if (fmt == API_JSON && (p[i] == '"' || p[i] == '\\')) {
+            uint8_t esc[2] = {'\\', p[i++]};
+            put(esc, 2);
+        } else if (fmt == API_JSON && p[i] < 0x20) {
+            jsonNumber("\\u%04x", p[i++]);
+        } else {
+            putByte(p[i++]);
+        }
+    }
+
+    if (fmt == API_JSON) putByte('"');
+    needComma = true;
+}
+
+void ApiWriter::text(const char *s)
+{
+    text(s, strlen(s));
+}
+
+void ApiWriter::mac(const uint8_t m[6])
+{
+    separate();
+    if (fmt == API_CBOR) {
+        cborHead(2, 6);
+        put(m, 6);
+    } else {
+        static const char hex[] = "0123456789ABCDEF";
+        char tmp[19];
+        tmp[0] = '"';
+        for (int i = 0; i < 6; i++) {
+            tmp[1 + i * 3] = hex[m[i] >> 4];
+            tmp[2 + i * 3] = hex[m[i] & 0x0F];
+            tmp[3 + i * 3] = i < 5 ? ':' : '"';
+        }
+        put(tmp, 19);
+    }
+    needComma = true;
+}
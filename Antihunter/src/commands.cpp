@@ -0,0 +1,264 @@
+#include "commands.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+static const size_t COMMAND_MAX = 32;
+
+// Kept sorted by verb as commands register. Registration only happens
+// during static initialization, so dispatch reads it without locking.
+static Command *commandTable[COMMAND_MAX];
+static size_t commandCount = 0;
+
+static int compareVerb(const char *verb, const char *p, size_t n)
+{
+    int c = strncmp(verb, p, n);
+    if (c != 0) return c;
+    return verb[n] ? 1 : 0;
+}
+
+Command::Command(const char *v, CommandHandler f, bool args) : verb(v), fn(f), takesArgs(args)
+{
+    if (commandCount >= COMMAND_MAX) return;
+    size_t i = commandCount++;
+    while (i > 0 && strcmp(commandTable[i - 1]->verb, verb) > 0) {
+        commandTable[i] = commandTable[i - 1];
+        i--;
+    }
+    commandTable[i] = this;
+}
+
+static Command *findCommand(const char *verb, size_t n)
+{
+    size_t lo = 0, hi = commandCount;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        int c = compareVerb(commandTable[mid]->verb, verb, n);
+        if (c == 0) return commandTable[mid];
+        if (c < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return nullptr;
+}
+
+bool dispatchCommand(const char *line, size_t len)
+{
+    while (len && (line[len - 1] == ' ' || line[len - 1] == '\r' || line[len - 1] == '\n')) len--;
+    size_t verbLen = 0;
+    while (verbLen < len && line[verbLen] != ':' && line[verbLen] != ' ') verbLen++;
+
+    Command *cmd = findCommand(line, verbLen);
+    if (!cmd) return false;
+
+    const char *args = line + verbLen;
+    size_t argLen = len - verbLen;
+    if (argLen) {
+        args++;
+        argLen--;
+    }
+    if (argLen && !cmd->takesArgs) return false;
+
+    ArgReader reader(args, argLen);
+    cmd->fn(reader);
+    return true;
+}
+
+// ArgReader
+
+const char *ArgReader::fieldEnd() const
+{
+    const char *p = (const char *)memchr(cur, ':', end - cur);
+    return p ? p : end;
+}
+
+void ArgReader::consume(const char *to)
+{
+    cur = to < end ? to + 1 : end;
+}
+
+bool ArgReader::readField(const char *&p, size_t &n)
+{
+    if (empty()) return false;
+    const char *fe = fieldEnd();
+    p = cur;
+    n = fe - cur;
+    consume(fe);
+    return true;
+}
+
+bool ArgReader::readUInt(uint32_t &out)
+{
+    const char *fe = fieldEnd();
+    if (fe == cur) return false;
+    uint32_t v = 0;
+    for (const char *p = cur; p < fe; p++) {
+        if (*p < '0' || *p > '9') return false;
+        uint32_t d = *p - '0';
+        if (v > (UINT32_MAX - d) / 10) return false;
+        v = v * 10 + d;
+    }
+    out = v;
+    consume(fe);
+    return true;
+}
+
+bool ArgReader::readInt(int32_t &out)
+{
+    bool neg = !empty() && *cur == '-';
+    if (neg) cur++;
+    uint32_t v;
+    const char *start = cur;
+    if (!readUInt(v) || v > (uint32_t)INT32_MAX + neg) {
+        cur = neg ? start - 1 : start;
+        return false;
+    }
+    out = neg ? (int32_t)(0u - v) : (int32_t)v;
+    return true;
+}
+
+bool ArgReader::readDouble(double &out)
+{
+    const char *fe = fieldEnd();
+    char buf[24];
+    size_t n = fe - cur;
+    if (n == 0 || n >= sizeof(buf)) return false;
+    memcpy(buf, cur, n);
+    buf[n] = '\0';
+    for (size_t i = 0; i < n; i++) {
+        if (!(buf[i] >= '0' && buf[i] <= '9') && buf[i] != '.' && !(i == 0 && buf[i] == '-')) return false;
+    }
+    char *e;
+    double v = strtod(buf, &e);
+    if (e != buf + n) return false;
+    out = v;
+    consume(fe);
+    return true;
+}
+
+// Channel numbers past 255 are refused rather than wrapped
+static bool readChannelNumber(const char *&p, const char *fe, uint32_t &out)
+{
+    const char *s = p;
+    uint32_t v = 0;
+    while (p < fe && *p >= '0' && *p <= '9') {
+        v = v * 10 + (*p++ - '0');
+        if (v > 255) return false;
+    }
+    out = v;
+    return p > s;
+}
+
+static int hexVal(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool ArgReader::readMac(uint8_t out[6])
+{
+    const char *p = cur;
+    uint8_t mac[6];
+    for (int i = 0; i < 6; i++) {
+        if (i > 0 && p < end && (*p == ':' || *p == '-')) p++;
+        if (end - p < 2) return false;
+        int hi = hexVal(p[0]), lo = hexVal(p[1]);
+        if (hi < 0 || lo < 0) return false;
+        mac[i] = (uint8_t)(hi << 4 | lo);
+        p += 2;
+    }
+    if (p < end && *p != ':') return false;
+    memcpy(out, mac, 6);
+    consume(p);
+    return true;
+}
+
+bool ArgReader::readChannels(ChannelList &out)
+{
+    const char *fe = fieldEnd();
+    if (fe == cur) return false;
+    out.count = 0;
+
+    const char *p = cur;
+    while (p < fe) {
+        uint32_t a, b;
+        while (p < fe && *p == ' ') p++;
+        if (!readChannelNumber(p, fe, a)) return false;
+        b = a;
+        if (fe - p >= 2 && p[0] == '.' && p[1] == '.') {
+            p += 2;
+            if (!readChannelNumber(p, fe, b)) return false;
+        }
+        for (uint32_t ch = a; ch <= b && ch <= 14; ch++) {
+            if (ch >= 1 && out.count < sizeof(out.ch)) out.ch[out.count++] = (uint8_t)ch;
+        }
+        while (p < fe && *p == ' ') p++;
+        if (p < fe && *p != ',') return false;
+        if (p < fe) p++;
+    }
+    consume(fe);
+    return true;
+}
+
+bool ArgReader::readFlag(const char *word)
+{
+    const char *fe = fieldEnd();
+    size_t n = strlen(word);
+    if ((size_t)(fe - cur) != n || memcmp(cur, word, n) != 0) return false;
+    consume(fe);
+    return true;
+}
+
+const char *ArgReader::rest(size_t &n) const
+{
+    n = end - cur;
+    return cur;
+}
+
+// Command arguments
+
+bool parseScanStart(ArgReader &args, ScanStartArgs &out)
+{
+    uint32_t mode;
+    if (!args.readUInt(mode) || !args.readUInt(out.secs) || mode > 2) return false;
+    out.mode = (uint8_t)mode;
+    out.channels = {};
+    out.haveChannels = args.readChannels(out.channels);
+    out.forever = args.readFlag("FOREVER");
+    return true;
+}
+
+bool parseTrackStart(ArgReader &args, TrackStartArgs &out)
+{
+    return args.readMac(out.mac) && parseScanStart(args, out.scan);
+}
+
+bool parseTriangulateStart(ArgReader &args, uint8_t mac[6], uint32_t &secs)
+{
+    return args.readMac(mac) && args.readUInt(secs);
+}
+
+bool parseCalibrateStart(ArgReader &args, CalibrateStartArgs &out)
+{
+    out.secs = CALIBRATE_DEFAULT_SECS;
+    if (!args.readMac(out.mac) || !args.readDouble(out.lat) || !args.readDouble(out.lon)) return false;
+    if (out.lat < -90 || out.lat > 90 || out.lon < -180 || out.lon > 180) return false;
+    return args.empty() || args.readUInt(out.secs);
+}
+
+bool parseCacheSync(ArgReader &args, uint32_t &since)
+{
+    since = 0;
+    return args.empty() || args.readUInt(since);
+}
+
+bool parseConfigTargets(ArgReader &args, char *out, size_t cap)
+{
+    size_t n;
+    const char *p = args.rest(n);
+    if (n >= cap) return false;
+    for (size_t i = 0; i < n; i++) out[i] = p[i] == '|' ? '\n' : p[i];
+    out[n] = '\0';
+    return true;
+}
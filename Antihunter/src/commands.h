@@ -0,0 +1,102 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Mesh/console command registry. Each subsystem declares its commands as
+// file-scope statics next to the state they touch:
+//
+//   static void handleStop(ArgReader &args) { ... }
+//   static Command cmdStop("STOP", handleStop);
+//
+// A command line is VERB[:arg[:arg...]]. The verb must match exactly, so
+// STOP no longer fires on another node's STOP_ACK, and a command declared
+// without arguments ignores lines that carry some.
+
+struct ChannelList {
+    uint8_t ch[14];
+    uint8_t count;
+};
+
+// Reads ':'-separated fields from a command's argument text in place.
+// Each read consumes one field (and its trailing ':') only on success.
+class ArgReader {
+  public:
+    ArgReader(const char *p, size_t n) : cur(p), end(p + n) {}
+
+    bool empty() const { return cur >= end; }
+    bool readInt(int32_t &out);
+    bool readUInt(uint32_t &out);
+    // Decimal with optional sign and fraction, e.g. a latitude
+    bool readDouble(double &out);
+    // 12 hex digits; ':' or '-' between bytes are allowed and consumed
+    bool readMac(uint8_t out[6]);
+    // "1,6,11", "1..13" or a mix like "1..3,11"; spaces around numbers are
+    // allowed and channels outside 1-14 are skipped
+    bool readChannels(ChannelList &out);
+    // Consumes the next field if it equals word
+    bool readFlag(const char *word);
+    bool readField(const char *&p, size_t &n);
+    // Everything not yet read, unsplit
+    const char *rest(size_t &n) const;
+
+  private:
+    const char *cur;
+    const char *end;
+    const char *fieldEnd() const;
+    void consume(const char *to);
+};
+
+typedef void (*CommandHandler)(ArgReader &args);
+
+class Command {
+  public:
+    Command(const char *verb, CommandHandler fn, bool takesArgs = false);
+
+    const char *const verb;
+    const CommandHandler fn;
+    const bool takesArgs;
+};
+
+// Runs the handler for line; false if no command matched
+bool dispatchCommand(const char *line, size_t len);
+
+// Argument grammars of the scan, tracking and calibration commands. The
+// handlers live with their subsystems; parsing is here so the host tests
+// can reach it. Each returns false, and the command is ignored, on a
+// missing, malformed or out-of-range argument.
+
+// SCAN_START:mode:secs[:channels][:FOREVER]
+struct ScanStartArgs {
+    uint8_t mode;           // ScanMode: 0 Wi-Fi, 1 BLE, 2 both
+    uint32_t secs;
+    bool haveChannels;
+    ChannelList channels;
+    bool forever;
+};
+bool parseScanStart(ArgReader &args, ScanStartArgs &out);
+
+// TRACK_START:mac:mode:secs[:channels][:FOREVER]
+struct TrackStartArgs {
+    uint8_t mac[6];
+    ScanStartArgs scan;
+};
+bool parseTrackStart(ArgReader &args, TrackStartArgs &out);
+
+// TRIANGULATE_START:mac:secs
+bool parseTriangulateStart(ArgReader &args, uint8_t mac[6], uint32_t &secs);
+
+// CALIBRATE_START:mac:lat:lon[:secs]
+const uint32_t CALIBRATE_DEFAULT_SECS = 300;
+struct CalibrateStartArgs {
+    uint8_t mac[6];
+    double lat, lon;
+    uint32_t secs;
+};
+bool parseCalibrateStart(ArgReader &args, CalibrateStartArgs &out);
+
+// CACHE_SYNC[:since]
+bool parseCacheSync(ArgReader &args, uint32_t &since);
+
+// CONFIG_TARGETS:mac|mac|...; out gets the entries one per line, the way
+// the target list is stored
+bool parseConfigTargets(ArgReader &args, char *out, size_t cap);
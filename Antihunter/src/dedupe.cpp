@@ -0,0 +1,123 @@
+#include "dedupe.h"
+#include <string.h>
+
+static uint32_t fnv(uint32_t h, const void *p, size_t n)
+{
+    const uint8_t *b = (const uint8_t *)p;
+    for (size_t i = 0; i < n; i++) h = (h ^ b[i]) * 16777619u;
+    return h;
+}
+
+uint32_t dedupeKey(const char *origin, size_t originLen, uint32_t seq)
+{
+    uint32_t h = fnv(2166136261u, origin, originLen);
+    h = fnv(h, &seq, sizeof(seq));
+    return h ? h : 1;
+}
+
+uint32_t dedupeContentKey(const char *text, size_t len)
+{
+    // Separate basis from dedupeKey so a line can't alias its own id
+    uint32_t h = fnv(0x811C9DC5u ^ 0x5A5A5A5Au, text, len);
+    return h ? h : 1;
+}
+
+void DedupeCache::clear()
+{
+    memset(index, -1, sizeof(index));
+    count = next = 0;
+    ready = true;
+}
+
+int DedupeCache::find(uint32_t key) const
+{
+    for (size_t i = key & (INDEX_SIZE - 1), n = 0; n < INDEX_SIZE; i = (i + 1) & (INDEX_SIZE - 1), n++) {
+        if (index[i] < 0) return -1;
+        if (keys[index[i]] == key) return index[i];
+    }
+    return -1;
+}
+
+void DedupeCache::indexInsert(uint32_t key, int8_t slot)
+{
+    size_t i = key & (INDEX_SIZE - 1);
+    while (index[i] >= 0) i = (i + 1) & (INDEX_SIZE - 1);
+    index[i] = slot;
+}
+
+// Backward-shift deletion keeps probe chains intact without tombstones
+void DedupeCache::indexRemove(uint32_t key)
+{
+    size_t i = key & (INDEX_SIZE - 1);
+    while (index[i] >= 0 && keys[index[i]] != key) i = (i + 1) & (INDEX_SIZE - 1);
+    if (index[i] < 0) return;
+    size_t j = i;
+    for (;;) {
+        j = (j + 1) & (INDEX_SIZE - 1);
+        if (index[j] < 0) break;
+        size_t home = keys[index[j]] & (INDEX_SIZE - 1);
+        // Move j back into the hole unless its home lies cyclically in (i, j]
+        bool stays = i <= j ? (home > i && home <= j) : (home > i || home <= j);
+        if (!stays) {
+            index[i] = index[j];
+            i = j;
+        }
+    }
+    index[i] = -1;
+}
+
+bool DedupeCache::seen(uint32_t key, uint32_t nowMs, uint32_t ttlMs)
+{
+    if (!ready) clear();
+    int slot = find(key);
+    if (slot >= 0) {
+        if (nowMs - times[slot] < ttlMs) return true;
+        times[slot] = nowMs;   // expired: count this as a fresh sighting
+        return false;
+    }
+    if (count == DEDUPE_SLOTS) indexRemove(keys[next]);
+    else count++;
+    keys[next] = key;
+    times[next] = nowMs;
+    indexInsert(key, (int8_t)next);
+    next = (next + 1) % DEDUPE_SLOTS;
+    return false;
+}
+
+bool DedupeCache::contains(uint32_t key, uint32_t nowMs, uint32_t ttlMs) const
+{
+    if (!ready) return false;
+    int slot = find(key);
+    return slot >= 0 && nowMs - times[slot] < ttlMs;
+}
+
+bool splitMessageId(const char *line, size_t &len, const char *&origin, size_t &originLen, uint32_t &seq)
+{
+    // Last " ~" token, which must run to the end of the line
+    size_t i = len;
+    while (i > 0 && line[i - 1] != '~') {
+        if (line[i - 1] == ' ') return false;
+        i--;
+    }
+    if (i < 2 || line[i - 2] != ' ') return false;
+
+    const char *tok = line + i;
+    size_t tokLen = len - i;
+    const char *dot = (const char *)memchr(tok, '.', tokLen);
+    const char *num = dot ? dot + 1 : tok;
+    size_t numLen = tok + tokLen - num;
+    if (numLen == 0 || numLen > 10 || (dot && dot == tok)) return false;
+
+    uint64_t v = 0;
+    for (size_t k = 0; k < numLen; k++) {
+        if (num[k] < '0' || num[k] > '9') return false;
+        v = v * 10 + (num[k] - '0');
+    }
+    if (v > UINT32_MAX) return false;
+
+    seq = (uint32_t)v;
+    origin = dot ? tok : nullptr;
+    originLen = dot ? (size_t)(dot - tok) : 0;
+    len = i - 2;
+    return true;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Recently seen mesh message ids. A fixed ring holds the last DEDUPE_SLOTS
+// keys in arrival order; an open-addressed index over it makes lookups
+// O(1). Inserting into a full ring evicts the oldest key.
+//
+// Message ids are (origin node, sequence) pairs. On the wire a text line
+// ends in " ~seq" when it starts with its origin ("NODE_1: ... ~42") and in
+// " ~origin.seq" otherwise ("@ALL STOP ~CC.17"). Binary frames carry the
+// sequence in their header.
+
+const size_t DEDUPE_SLOTS = 64;
+
+class DedupeCache {
+  public:
+    // True if key was seen within ttlMs; otherwise records it and returns false
+    bool seen(uint32_t key, uint32_t nowMs, uint32_t ttlMs);
+    // Same test without recording key
+    bool contains(uint32_t key, uint32_t nowMs, uint32_t ttlMs) const;
+    void clear();
+
+  private:
+    static const size_t INDEX_SIZE = DEDUPE_SLOTS * 2;
+    uint32_t keys[DEDUPE_SLOTS] = {};
+    uint32_t times[DEDUPE_SLOTS] = {};
+    int8_t index[INDEX_SIZE];
+    size_t count = 0;
+    size_t next = 0;
+    bool ready = false;
+
+    int find(uint32_t key) const;
+    void indexInsert(uint32_t key, int8_t slot);
+    void indexRemove(uint32_t key);
+};
+
+uint32_t dedupeKey(const char *origin, size_t originLen, uint32_t seq);
+uint32_t dedupeContentKey(const char *text, size_t len);
+
+// Finds a trailing id on line. On success len is shortened to exclude it;
+// origin/originLen are set only if the id names its origin (else nullptr).
+bool splitMessageId(const char *line, size_t &len, const char *&origin, size_t &originLen, uint32_t &seq);
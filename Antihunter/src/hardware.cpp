@@ -1,4 +1,9 @@
 #include "hardware.h"
+#include "radio_esp.h"
+#include "metrics.h"
+#include "meshtx.h"
+#include "commands.h"
+#include "timesync.h"
 #include <Arduino.h>
 #include <Preferences.h>
 #include <WiFi.h>
@@ -9,6 +14,7 @@
 #include <Wire.h>
 #include <RTClib.h>
 #include "esp_wifi.h"
+#include "esp_timer.h"
 
 
 extern Preferences prefs;
@@ -30,6 +36,66 @@ bool rtcSynced = false;
 time_t lastRTCSync = 0;
 String rtcTimeString = "RTC not initialized";
 
+// Time service: epoch is carried on esp_timer between RTC/GPS resyncs
+static portMUX_TYPE timeMux = portMUX_INITIALIZER_UNLOCKED;
+static int64_t timeBaseMonoUs = 0;
+static int64_t timeBaseEpochUs = 0;
+static int32_t timeDriftPpb = 0;
+static int64_t driftRefMonoUs = 0;
+static int64_t driftCorrectionUs = 0;
+static bool timeValid = false;
+static const char *timeSource = "none";
+static int64_t timeErrUs = -1;          // bound on |clock - UTC| at timeErrMonoUs, -1 unknown
+static int64_t timeErrMonoUs = 0;
+static unsigned long lastRTCResync = 0;
+static unsigned long lastRTCCheck = 0;
+const unsigned long RTC_RESYNC_INTERVAL = 600000;
+const unsigned long RTC_CHECK_INTERVAL = 3600000;
+const int64_t DRIFT_MIN_WINDOW_US = 3600000000LL;
+const int32_t DRIFT_MAX_PPB = 500000;
+const int64_t TIME_STEP_US = 1000000;   // errors beyond this step the clock instead of training drift
+
+// Calendar fields cached for the current second
+static int64_t cachedTsSec = -1;
+static char cachedTs[20] = "";
+
+static DateTime readRTCSecondEdge();
+static void setTimeBase(int64_t epochUs, int64_t monoUs, const char *source, int64_t errUs);
+
+// Mesh time sync (see timesync.h)
+static const uint32_t TSYNC_FAST_MS = 60000;     // until the filter has a few samples
+static const uint32_t TSYNC_SLOW_MS = 600000;
+static TimeSyncFilter meshTimeFilter;
+static size_t meshTimeSamples = 0;
+static uint32_t meshTimeRefMs = 0;
+static uint32_t lastTimeSyncReq = 0;
+// Reference node and path delay, under tsyncMux: set on the mesh UART task
+// and read by /diag
+static char meshTimeRef[24] = "";
+static int64_t meshTimeDelayUs = -1;
+// Set when the reference answers; the next request names it only then, so
+// one that stops answering is replaced by an open request
+static bool meshTimeAnswered = false;
+
+// A GPS node's answer to an open request waits a random delay and is
+// dropped if another node answers the same requester first
+static const uint32_t TSYNC_REPLY_JITTER_MS = 8000;
+static portMUX_TYPE tsyncMux = portMUX_INITIALIZER_UNLOCKED;
+static struct {
+    bool pending;
+    char requester[24];
+    int64_t t1, t2;
+    uint32_t dueMs;
+} tsyncReply;
+static Counter mTimeSyncSamples("antihunter_time_sync_samples_total", "Mesh time sync replies accepted");
+
+static double sampleTimeError() {
+    int64_t e = getTimeErrorUs();
+    return e < 0 ? -1 : e / 1000.0;
+}
+static Gauge mTimeError("antihunter_time_error_ms", "Bound on clock error vs UTC, -1 if unknown", "Clock error ms",
+                        sampleTimeError);
+
 // Viration Sensor
 volatile bool vibrationDetected = false;
 unsigned long lastVibrationTime = 0;
@@ -38,15 +104,10 @@ const unsigned long VIBRATION_ALERT_INTERVAL = 5000;
 
 // Diagnostics
 extern volatile bool scanning;
-extern volatile int totalHits;
-extern volatile uint32_t framesSeen;
-extern volatile uint32_t bleFramesSeen;
 extern volatile bool trackerMode;
-extern std::set<String> uniqueMacs;
 extern uint32_t lastScanSecs;
 extern bool lastScanForever;
 extern String macFmt6(const uint8_t *m);
-extern size_t getTargetCount();
 extern void getTrackerStatus(uint8_t mac[6], int8_t &rssi, uint32_t &lastSeen, uint32_t &packets);
 
 
@@ -72,17 +133,21 @@ void saveConfiguration()
   // TODO save wifi channels and other granular stuff
 }
 
-String getDiagnostics() {
-    static unsigned long lastDiagTime = 0;
+// Cached because SD.totalBytes()/usedBytes() walk the FAT
+static double sampleSDFree() {
     static unsigned long lastSDTime = 0;
-    static String cachedDiag = "";
-    static String cachedSDInfo = "";
-    
-    if (millis() - lastDiagTime < 5000 && cachedDiag.length() > 0) {
-        return cachedDiag;
+    static double cachedFree = 0;
+    if (!sdAvailable) return 0;
+    if (lastSDTime == 0 || millis() - lastSDTime > 30000) {
+        lastSDTime = millis();
+        cachedFree = (double)(SD.totalBytes() - SD.usedBytes());
     }
-    lastDiagTime = millis();
-    
+    return cachedFree;
+}
+
+static Gauge mSDFree("antihunter_sd_free_bytes", "Free space on the SD card", "SD Card free bytes", sampleSDFree);
+
+String getDiagnostics() {
     String s;
     String modeStr = (currentScanMode == SCAN_WIFI) ? "WiFi" : 
                      (currentScanMode == SCAN_BLE) ? "BLE" : "WiFi+BLE";
@@ -98,13 +163,10 @@ String getDiagnostics() {
 
     s += "Scan Mode: " + modeStr + "\n";
     s += String("Scanning: ") + (scanning ? "yes" : "no") + "\n";
-    s += "WiFi Frames seen: " + String((unsigned)framesSeen) + "\n";
-    s += "BLE Frames seen: " + String((unsigned)bleFramesSeen) + "\n";
-    s += "Total hits: " + String(totalHits) + "\n";
     s += "Current channel: " + String(WiFi.channel()) + "\n";
     s += "AP IP: " + WiFi.softAPIP().toString() + "\n";
-    s += "Unique devices: " + String((int)uniqueMacs.size()) + "\n";
-    s += "Targets: " + String(getTargetCount()) + "\n";
+    s += "Radio: " + getRadioInfo() + "\n";
+    s += "BLE scan: " + getBleScanInfo() + "\n";
     s += "Mesh Node ID: " + getNodeId() + "\n";
     s += "Vibration sensor: " + String(lastVibrationTime > 0 ? "Active" : "Standby") + "\n";
     if (lastVibrationTime > 0) {
@@ -127,23 +189,11 @@ String getDiagnostics() {
 
     s += "SD Card: " + String(sdAvailable ? "Available" : "Not available") + "\n";
     if (sdAvailable) {
-        if (millis() - lastSDTime > 30000 || cachedSDInfo.length() == 0) {
-            lastSDTime = millis();
-            cachedSDInfo = "";
-            
-            uint64_t cardSize = SD.cardSize() / (1024 * 1024);
-            uint64_t totalBytes = SD.totalBytes();
-            uint64_t usedBytes = SD.usedBytes();
-            uint64_t freeBytes = totalBytes - usedBytes;
-
-            uint8_t cardType = SD.cardType();
-            String cardTypeStr = (cardType == CARD_MMC) ? "MMC" :
-                                (cardType == CARD_SD) ? "SDSC" :
-                                (cardType == CARD_SDHC) ? "SDHC" : "UNKNOWN";
-            cachedSDInfo += "SD Card Type: " + cardTypeStr + "\n";
-            cachedSDInfo += "SD Free Space: " + String(freeBytes / (1024 * 1024)) + "MB\n";
-        }
-        s += cachedSDInfo;
+        uint8_t cardType = SD.cardType();
+        String cardTypeStr = (cardType == CARD_MMC) ? "MMC" :
+                            (cardType == CARD_SD) ? "SDSC" :
+                            (cardType == CARD_SDHC) ? "SDHC" : "UNKNOWN";
+        s += "SD Card Type: " + cardTypeStr + "\n";
     }
 
     s += "GPS: ";
@@ -162,6 +212,7 @@ String getDiagnostics() {
     } else {
         s += "Not available\n";
     }
+    s += "Clock: " + getTimeSourceInfo() + "\n";
 
     if (trackerMode) {
         uint8_t trackerMac[6];
@@ -186,7 +237,8 @@ String getDiagnostics() {
     }
     s += "\n";
 
-    cachedDiag = s;
+    // Counters and gauges, from the metrics registry
+    appendMetricsDiag(s);
     return s;
 }
 
@@ -284,10 +336,7 @@ void sendStartupStatus() {
     
     Serial.printf("[STARTUP] %s\n", startupMsg.c_str());
     
-    if (Serial1.availableForWrite() >= startupMsg.length()) {
-        Serial1.println(startupMsg);
-        Serial1.flush();
-    }
+    meshSend(MESH_STATUS, startupMsg);
     
     logToSD(startupMsg);
 }
@@ -303,10 +352,7 @@ void sendGPSLockStatus(bool locked) {
     
     Serial.printf("[GPS] %s\n", gpsMsg.c_str());
     
-    if (Serial1.availableForWrite() >= gpsMsg.length()) {
-        Serial1.println(gpsMsg);
-        Serial1.flush();
-    }
+    meshSend(MESH_STATUS, gpsMsg, "gps");
     
     logToSD("GPS Status: " + gpsMsg);
 }
@@ -385,10 +431,11 @@ void logToSD(const String &data) {
         }
     }
     
-    // Use RTC time if available, otherwise fall back to millis
-    String timestamp = getFormattedTimestamp();
+    // Cached epoch from the time service, millis fallback before first sync
+    char timestamp[24];
+    formatTimestamp(timestamp, sizeof(timestamp));
     
-    logFile.printf("[%s] %s\n", timestamp.c_str(), data.c_str());
+    logFile.printf("[%s] %s\n", timestamp, data.c_str());
     
     // Batch flush every 10 writes 
     if (++totalWrites % 10 == 0) {
@@ -461,11 +508,9 @@ void checkAndSendVibrationAlert() {
             }
             
             Serial.printf("[VIBRATION] Sending mesh alert: %s\n", vibrationMsg.c_str());
+            pushAlertEvent("vibration", vibrationMsg);
             
-            if (Serial1.availableForWrite() >= vibrationMsg.length()) {
-                Serial1.println(vibrationMsg);
-                Serial1.flush();
-            }
+            meshSend(MESH_ALERT, vibrationMsg, "vibration");
             
             logVibrationEvent(sensorValue);
             
@@ -524,26 +569,214 @@ void initializeRTC() {
         rtc.adjust(DateTime(F(__DATE__), F(__TIME__)));
         rtcSynced = false;
     } else {
-        DateTime now = rtc.now();
         rtcSynced = true;
-        Serial.printf("[RTC] Current time: %04d-%02d-%02d %02d:%02d:%02d\n", 
-                      now.year(), now.month(), now.day(),
-                      now.hour(), now.minute(), now.second());
     }
+
+    // Single read aligned to the seconds edge, esp_timer carries it from here
+    DateTime now = readRTCSecondEdge();
+    setTimeBase((int64_t)now.unixtime() * 1000000LL, esp_timer_get_time(), "RTC", rtcSynced ? 1000000 : -1);
+    lastRTCResync = millis();
+    Serial.printf("[RTC] Current time: %04d-%02d-%02d %02d:%02d:%02d\n", 
+                  now.year(), now.month(), now.day(),
+                  now.hour(), now.minute(), now.second());
     
     rtc.disable32K();
     Serial.printf("[RTC] Successfully initialized on SDA:%d SCL:%d\n", 
                   RTC_SDA_PIN, RTC_SCL_PIN);
 }
 
+// Time service
+
+// Polls the DS3231 until the seconds register ticks so the base is accurate
+// to the poll interval rather than to a whole second. Boot only.
+static DateTime readRTCSecondEdge() {
+    DateTime first = rtc.now();
+    unsigned long start = millis();
+    while (millis() - start < 1100) {
+        delay(5);
+        DateTime now = rtc.now();
+        if (now.unixtime() != first.unixtime()) return now;
+    }
+    return first;
+}
+
+static inline int64_t epochMicrosLocked(int64_t monoUs) {
+    int64_t elapsed = monoUs - timeBaseMonoUs;
+    return timeBaseEpochUs + elapsed + (elapsed * timeDriftPpb) / 1000000000LL;
+}
+
+static inline int64_t timeErrorLocked(int64_t monoUs) {
+    if (timeErrUs < 0) return -1;
+    return timeErrUs + (monoUs - timeErrMonoUs) * TIME_SYNC_DRIFT_PPM / 1000000;
+}
+
+static void setTimeBase(int64_t epochUs, int64_t monoUs, const char *source, int64_t errUs) {
+    portENTER_CRITICAL(&timeMux);
+    timeBaseEpochUs = epochUs;
+    timeBaseMonoUs = monoUs;
+    driftRefMonoUs = monoUs;
+    driftCorrectionUs = 0;
+    timeSource = source;
+    timeValid = true;
+    timeErrUs = errUs;
+    timeErrMonoUs = monoUs;
+    cachedTsSec = -1;
+    portEXIT_CRITICAL(&timeMux);
+}
+
+// Disciplines the carried epoch against a reference known to lie within
+// [refEpochUs, refEpochUs + windowUs). Inside the window nothing moves; outside
+// it the clock steps to the nearest edge and the step feeds the drift estimate.
+// Errors over TIME_STEP_US (an RTC that lost power, a first GPS fix) are not
+// drift: the clock is reset to the reference and the estimate restarts.
+static void disciplineTime(int64_t refEpochUs, int64_t windowUs, int64_t monoUs, const char *source) {
+    if (!timeValid) {
+        setTimeBase(refEpochUs + windowUs / 2, monoUs, source, windowUs / 2);
+        return;
+    }
+
+    portENTER_CRITICAL(&timeMux);
+    int64_t predicted = epochMicrosLocked(monoUs);
+    int64_t err = 0;
+    if (predicted < refEpochUs) err = refEpochUs - predicted;
+    else if (predicted >= refEpochUs + windowUs) err = refEpochUs + windowUs - 1 - predicted;
+
+    if (err > TIME_STEP_US || err < -TIME_STEP_US) {
+        portEXIT_CRITICAL(&timeMux);
+        setTimeBase(refEpochUs + windowUs / 2, monoUs, source, windowUs / 2);
+        Serial.printf("[TIME] Stepped %lldms from %s\n", err / 1000, source);
+        return;
+    }
+
+    timeBaseEpochUs = predicted + err;
+    timeBaseMonoUs = monoUs;
+    driftCorrectionUs += err;
+    // A reference that agrees with the clock only replaces a tighter bound
+    // (and its source) if the clock had to move
+    int64_t bound = timeErrorLocked(monoUs);
+    if (err != 0 || bound < 0 || bound > windowUs) {
+        timeErrUs = windowUs;
+        timeErrMonoUs = monoUs;
+        timeSource = source;
+    }
+
+    int64_t window = monoUs - driftRefMonoUs;
+    if (window >= DRIFT_MIN_WINDOW_US) {
+        int64_t ppb = (int64_t)timeDriftPpb + (driftCorrectionUs * 1000000000LL) / window;
+        if (ppb > DRIFT_MAX_PPB) ppb = DRIFT_MAX_PPB;
+        if (ppb < -DRIFT_MAX_PPB) ppb = -DRIFT_MAX_PPB;
+        timeDriftPpb = (int32_t)ppb;
+        driftRefMonoUs = monoUs;
+        driftCorrectionUs = 0;
+    }
+    if (err != 0) cachedTsSec = -1;
+    portEXIT_CRITICAL(&timeMux);
+}
+
+int64_t getTimeErrorUs() {
+    if (!timeValid) return -1;
+    int64_t mono = esp_timer_get_time();
+    portENTER_CRITICAL(&timeMux);
+    int64_t e = timeErrorLocked(mono);
+    portEXIT_CRITICAL(&timeMux);
+    return e;
+}
+
+int64_t getEpochMicros() {
+    if (!timeValid) return 0;
+    int64_t mono = esp_timer_get_time();
+    portENTER_CRITICAL(&timeMux);
+    int64_t us = epochMicrosLocked(mono);
+    portEXIT_CRITICAL(&timeMux);
+    return us;
+}
+
+// Days since 1970-01-01 to civil date (Howard Hinnant's algorithm)
+static void civilFromDays(int64_t z, int &y, unsigned &m, unsigned &d) {
+    z += 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = (unsigned)(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = (int)(yoe + era * 400) + (m <= 2);
+}
+
+static inline void put2(char *p, unsigned v) {
+    p[0] = '0' + v / 10;
+    p[1] = '0' + v % 10;
+}
+
+// "YYYY-MM-DD HH:MM:SS" from cached calendar fields; the date part is only
+// recomputed when the day changes.
+static void refreshTimestampCache(int64_t sec) {
+    if (cachedTsSec < 0 || sec / 86400 != cachedTsSec / 86400) {
+        int y;
+        unsigned m, d;
+        civilFromDays(sec / 86400, y, m, d);
+        put2(cachedTs, (unsigned)(y / 100) % 100);
+        put2(cachedTs + 2, (unsigned)y % 100);
+        cachedTs[4] = '-';
+        put2(cachedTs + 5, m);
+        cachedTs[7] = '-';
+        put2(cachedTs + 8, d);
+        cachedTs[10] = ' ';
+        cachedTs[13] = ':';
+        cachedTs[16] = ':';
+        cachedTs[19] = '\0';
+    }
+    unsigned sod = (unsigned)(sec % 86400);
+    put2(cachedTs + 11, sod / 3600);
+    put2(cachedTs + 14, (sod / 60) % 60);
+    put2(cachedTs + 17, sod % 60);
+    cachedTsSec = sec;
+}
+
+size_t formatTimestamp(char *buf, size_t len) {
+    if (len == 0) return 0;
+    if (!timeValid) {
+        // Fallback to millis-based timestamp
+        uint32_t ts = millis();
+        return snprintf(buf, len, "%02u:%02u:%02u",
+                        (unsigned)((ts / 3600000) % 24), (unsigned)((ts / 60000) % 60), (unsigned)((ts / 1000) % 60));
+    }
+
+    int64_t mono = esp_timer_get_time();
+    size_t n = len - 1 < 19 ? len - 1 : 19;
+    portENTER_CRITICAL(&timeMux);
+    int64_t sec = epochMicrosLocked(mono) / 1000000LL;
+    if (sec != cachedTsSec) refreshTimestampCache(sec);
+    memcpy(buf, cachedTs, n);
+    portEXIT_CRITICAL(&timeMux);
+    buf[n] = '\0';
+    return n;
+}
+
+String getTimeSourceInfo() {
+    if (!timeValid) return "uptime only";
+    char b[112];
+    int n = snprintf(b, sizeof(b), "%s drift=%+.1fppm", timeSource, timeDriftPpb / 1000.0f);
+    int64_t err = getTimeErrorUs();
+    if (err >= 0) n += snprintf(b + n, sizeof(b) - n, " err=+/-%.1fms", err / 1000.0);
+    char ref[sizeof(meshTimeRef)];
+    portENTER_CRITICAL(&tsyncMux);
+    memcpy(ref, meshTimeRef, sizeof(ref));
+    int64_t delay = meshTimeDelayUs;
+    portEXIT_CRITICAL(&tsyncMux);
+    if (delay >= 0 && strcmp(timeSource, "MESH") == 0) {
+        snprintf(b + n, sizeof(b) - n, " ref=%s delay=%.1fms", ref, delay / 1000.0);
+    }
+    return String(b);
+}
+
 void syncRTCFromGPS() {
-    if (!rtcAvailable || !gpsValid) return;
+    if (!gpsValid) return;
     
     // Only sync if we have a good GPS fix with valid date/time
     if (!gps.date.isValid() || !gps.time.isValid()) return;
-    
-    // Sync once per hour max
-    if (lastRTCSync > 0 && (millis() - lastRTCSync) < 3600000) return;
+    if (gps.time.age() > 1500) return;
     
     int year = gps.date.year();
     int month = gps.date.month();
@@ -559,11 +792,22 @@ void syncRTCFromGPS() {
     if (hour > 23 || minute > 59 || second > 59) return;
     
     DateTime gpsTime(year, month, day, hour, minute, second);
-    DateTime rtcTime = rtc.now();
-    
-    // Only sync if difference is more than 2 seconds
-    int timeDiff = abs((int)(gpsTime.unixtime() - rtcTime.unixtime()));
-    if (timeDiff > 2) {
+
+    // NMEA trails the second it describes by up to ~0.5s
+    int64_t mono = esp_timer_get_time() - (int64_t)gps.time.age() * 1000;
+    int64_t ref = (int64_t)gpsTime.unixtime() * 1000000LL + gps.time.centisecond() * 10000LL;
+    disciplineTime(ref, 500000, mono, "GPS");
+
+    if (!rtcAvailable) return;
+
+    // Check the RTC once per hour max
+    if (rtcSynced && lastRTCCheck > 0 && (millis() - lastRTCCheck) < RTC_CHECK_INTERVAL) return;
+    lastRTCCheck = millis();
+
+    // Only sync if difference is more than 2 seconds. Read the DS3231 itself:
+    // getRTCEpoch() is the clock GPS just disciplined and would always agree.
+    int timeDiff = abs((int)((int64_t)gpsTime.unixtime() - (int64_t)rtc.now().unixtime()));
+    if (timeDiff > 2 || !rtcSynced) {
         rtc.adjust(gpsTime);
         rtcSynced = true;
         lastRTCSync = millis();
@@ -578,71 +822,190 @@ void syncRTCFromGPS() {
         logToSD(syncMsg);
         
         // Send sync status over mesh
-        if (Serial1.availableForWrite() >= 100) {
-            String meshMsg = getNodeId() + ": RTC_SYNC: " + syncMsg;
-            Serial1.println(meshMsg);
-        }
+        meshSend(MESH_STATUS, getNodeId() + ": RTC_SYNC: " + syncMsg, "rtc");
     }
 }
 
 void updateRTCTime() {
+    // Fresh GPS time disciplines the clock directly
+    if (gpsValid && gps.time.isUpdated()) {
+        syncRTCFromGPS();
+    }
+
     if (!rtcAvailable) {
-        rtcTimeString = "RTC not available";
+        rtcTimeString = timeValid ? getFormattedTimestamp() : "RTC not available";
         return;
     }
-    
-    DateTime now = rtc.now();
-    
-    char buffer[30];
-    snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d %02d:%02d:%02d",
-             now.year(), now.month(), now.day(),
-             now.hour(), now.minute(), now.second());
-    
-    rtcTimeString = String(buffer);
-    
-    // Auto-sync from GPS if available
-    if (gpsValid && !rtcSynced) {
-        syncRTCFromGPS();
+
+    // Periodic RTC read to bound esp_timer drift
+    if (millis() - lastRTCResync > RTC_RESYNC_INTERVAL) {
+        lastRTCResync = millis();
+        // Skipped while GPS or mesh time holds the clock tighter than the RTC's second
+        int64_t err = getTimeErrorUs();
+        if (err < 0 || err >= 1000000) {
+            DateTime now = rtc.now();
+            disciplineTime((int64_t)now.unixtime() * 1000000LL, 1000000, esp_timer_get_time(), "RTC");
+            if (!rtcSynced) {
+                portENTER_CRITICAL(&timeMux);
+                timeErrUs = -1;     // never set since it lost power
+                portEXIT_CRITICAL(&timeMux);
+            }
+        }
     }
-    
-    // Periodic re-sync (every hour if GPS available)
-    if (gpsValid && rtcSynced && (millis() - lastRTCSync) > 3600000) {
-        syncRTCFromGPS();
+
+    rtcTimeString = getFormattedTimestamp();
+}
+
+// Nodes without GPS ask the GPS-locked ones for the time, quickly until a
+// few exchanges are in and then every 10 minutes
+static void requestMeshTime() {
+    if (gpsValid || !meshEnabled) return;
+    uint32_t interval = meshTimeSamples < TIME_SYNC_SAMPLES / 2 ? TSYNC_FAST_MS : TSYNC_SLOW_MS;
+    if (lastTimeSyncReq && millis() - lastTimeSyncReq < interval) return;
+    lastTimeSyncReq = millis();
+
+    // TSYNC_REQ:t1[:ref], t1 stamped as the line goes out
+    char ref[sizeof(meshTimeRef)] = "";
+    portENTER_CRITICAL(&tsyncMux);
+    if (meshTimeAnswered) memcpy(ref, meshTimeRef, sizeof(ref));
+    meshTimeAnswered = false;
+    portEXIT_CRITICAL(&tsyncMux);
+
+    char msg[80];
+    int at = snprintf(msg, sizeof(msg), "%s: TSYNC_REQ:", getNodeId().c_str());
+    snprintf(msg + at, sizeof(msg) - at, "%0*d%s%s", (int)MESH_STAMP_WIDTH, 0, ref[0] ? ":" : "", ref);
+    meshSendStamped(MESH_CONTROL, msg, at, esp_timer_get_time, "tsync");
+}
+
+// Sends the reply scheduled by handleTimeSyncLine once its delay is up; t3
+// is stamped when the line reaches the radio UART, so time spent behind the
+// MESH_CONTROL token bucket counts as hold time (t3 - t2), not transit
+static void sendTimeSyncReply() {
+    char requester[sizeof(tsyncReply.requester)];
+    int64_t t1, t2;
+    portENTER_CRITICAL(&tsyncMux);
+    bool due = tsyncReply.pending && (int32_t)(millis() - tsyncReply.dueMs) >= 0;
+    if (due) {
+        tsyncReply.pending = false;
+        memcpy(requester, tsyncReply.requester, sizeof(requester));
+        t1 = tsyncReply.t1;
+        t2 = tsyncReply.t2;
     }
+    portEXIT_CRITICAL(&tsyncMux);
+    if (!due || !gpsValid || !timeValid) return;
+
+    char msg[128];
+    int at = snprintf(msg, sizeof(msg), "%s: TSYNC:%s:%lld:%lld:", getNodeId().c_str(), requester,
+                      (long long)t1, (long long)t2);
+    snprintf(msg + at, sizeof(msg) - at, "%0*d:%lld", (int)MESH_STAMP_WIDTH, 0, (long long)getTimeErrorUs());
+    meshSendStamped(MESH_CONTROL, msg, at, getEpochMicros);
+}
+
+static bool readTimes(const char *p, int64_t *out, int n) {
+    for (int i = 0; i < n; i++) {
+        char *end;
+        out[i] = strtoll(p, &end, 10);
+        if (end == p || (i < n - 1 && *end != ':')) return false;
+        p = end + 1;
+    }
+    return true;
+}
+
+// Taken over from GPS/RTC only when tighter, and from one reference at a
+// time so estimates from differently-offset GPS units don't mix
+static void acceptMeshTime(const String &ref, const int64_t t[5], int64_t t4) {
+    if (ref.length() >= sizeof(meshTimeRef)) return;
+    // Only this task writes meshTimeRef, so reading it here needs no lock
+    bool same = ref == meshTimeRef;
+    if (meshTimeRef[0] && !same && millis() - meshTimeRefMs < 3 * TSYNC_SLOW_MS) return;
+    if (!same) {
+        meshTimeFilter.clear();
+        meshTimeSamples = 0;
+    }
+    meshTimeRefMs = millis();
+    portENTER_CRITICAL(&tsyncMux);
+    memcpy(meshTimeRef, ref.c_str(), ref.length() + 1);
+    meshTimeAnswered = true;
+    portEXIT_CRITICAL(&tsyncMux);
+    if (!meshTimeFilter.add(t[0], t[1], t[2], t4, t[3])) return;
+    meshTimeSamples++;
+    mTimeSyncSamples.inc();
+
+    TimeSyncSample best;
+    int64_t mono = esp_timer_get_time();
+    if (!meshTimeFilter.best(mono, best)) return;
+    int64_t bound = timeSyncError(best, mono);
+    // Once on mesh time, follow the filter: an old sample's bound stays honest
+    // but the crystal has wandered since
+    int64_t cur = getTimeErrorUs();
+    if (strcmp(timeSource, "MESH") != 0 && cur >= 0 && cur <= bound) return;
+
+    // Steps rather than disciplines: per-sample jitter would swamp the drift estimate
+    setTimeBase(mono + best.offsetUs, mono, "MESH", bound);
+    portENTER_CRITICAL(&tsyncMux);
+    meshTimeDelayUs = best.delayUs;
+    portEXIT_CRITICAL(&tsyncMux);
+    Serial.printf("[TIME] Mesh sync from %s: +/-%.1fms (delay %.1fms)\n", ref.c_str(), bound / 1000.0,
+                  best.delayUs / 1000.0);
+}
+
+bool handleTimeSyncLine(const String &node, const String &content) {
+    int64_t now = esp_timer_get_time();
+    if (content.startsWith("TSYNC_REQ:")) {
+        if (!gpsValid || !timeValid || node.length() >= sizeof(tsyncReply.requester)) return true;
+        int64_t t2 = getEpochMicros();
+        char *end;
+        int64_t t1 = strtoll(content.c_str() + 10, &end, 10);
+        // A request naming its reference is only for that node; an open one
+        // gets a jittered answer that the first other answer cancels
+        uint32_t delayMs = 0;
+        if (*end == ':') {
+            if (getNodeId() != end + 1) return true;
+        } else {
+            delayMs = esp_random() % TSYNC_REPLY_JITTER_MS;
+        }
+        portENTER_CRITICAL(&tsyncMux);
+        tsyncReply.pending = true;
+        memcpy(tsyncReply.requester, node.c_str(), node.length() + 1);
+        tsyncReply.t1 = t1;
+        tsyncReply.t2 = t2;
+        tsyncReply.dueMs = millis() + delayMs;
+        portEXIT_CRITICAL(&tsyncMux);
+        return true;
+    }
+    if (!content.startsWith("TSYNC:")) return false;
+
+    // TSYNC:requester:t1:t2:t3:err
+    int sep = content.indexOf(':', 6);
+    if (sep < 0) return true;
+    String requester = content.substring(6, sep);
+    portENTER_CRITICAL(&tsyncMux);
+    if (tsyncReply.pending && requester == tsyncReply.requester) tsyncReply.pending = false;
+    portEXIT_CRITICAL(&tsyncMux);
+    if (requester != getNodeId() || gpsValid) return true;
+    int64_t t[4];
+    if (!readTimes(content.c_str() + sep + 1, t, 4) || t[3] < 0) return true;
+    acceptMeshTime(node, t, now);
+    return true;
+}
+
+void pollTimeSync() {
+    requestMeshTime();
+    sendTimeSyncReply();
 }
 
 String getRTCTimeString() {
-    updateRTCTime();
     return rtcTimeString;
 }
 
 String getFormattedTimestamp() {
-    if (!rtcAvailable) {
-        // Fallback to millis-based timestamp
-        uint32_t ts = millis();
-        uint8_t hours = (ts / 3600000) % 24;
-        uint8_t mins = (ts / 60000) % 60;
-        uint8_t secs = (ts / 1000) % 60;
-        
-        char buffer[12];
-        snprintf(buffer, sizeof(buffer), "%02d:%02d:%02d", hours, mins, secs);
-        return String(buffer);
-    }
-    
-    DateTime now = rtc.now();
-    char buffer[30];
-    snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d %02d:%02d:%02d",
-             now.year(), now.month(), now.day(),
-             now.hour(), now.minute(), now.second());
-    
+    char buffer[24];
+    formatTimestamp(buffer, sizeof(buffer));
     return String(buffer);
 }
 
 time_t getRTCEpoch() {
-    if (!rtcAvailable) return 0;
-    
-    DateTime now = rtc.now();
-    return now.unixtime();
+    return (time_t)(getEpochMicros() / 1000000LL);
 }
 
 bool setRTCTime(int year, int month, int day, int hour, int minute, int second) {
@@ -651,9 +1014,18 @@ bool setRTCTime(int year, int month, int day, int hour, int minute, int second)
     DateTime newTime(year, month, day, hour, minute, second);
     rtc.adjust(newTime);
     rtcSynced = true;
+    setTimeBase((int64_t)newTime.unixtime() * 1000000LL, esp_timer_get_time(), "RTC", 1000000);
     
     Serial.printf("[RTC] Manually set to: %04d-%02d-%02d %02d:%02d:%02d\n",
                   year, month, day, hour, minute, second);
     
     return true;
-}
\ No newline at end of file
+}
+
+static void handleVibrationStatus(ArgReader &)
+{
+    String status = lastVibrationTime > 0 ? ("Last vibration: " + String(lastVibrationTime) + "ms (" + String((millis() - lastVibrationTime) / 1000) + "s ago)") : "No vibrations detected";
+    meshSend(MESH_STATUS, getNodeId() + ": VIBRATION_STATUS: " + status);
+}
+
+static Command cmdVibrationStatus("VIBRATION_STATUS", handleVibrationStatus);
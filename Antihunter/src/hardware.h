@@ -64,5 +64,15 @@ void syncRTCFromGPS();
 void updateRTCTime();
 String getRTCTimeString();
 String getFormattedTimestamp();
+size_t formatTimestamp(char *buf, size_t len);
+int64_t getEpochMicros();
+// Bound on the clock's error vs UTC in us, -1 if unknown
+int64_t getTimeErrorUs();
+// TSYNC_REQ / TSYNC lines from node (content is after "NODE: "); false if not one
+bool handleTimeSyncLine(const String &node, const String &content);
+void pollTimeSync();
+String getTimeSourceInfo();
+// Epoch seconds from the disciplined clock (esp_timer carried, corrected by
+// GPS, mesh or RTC), not a DS3231 read
 time_t getRTCEpoch();
 bool setRTCTime(int year, int month, int day, int hour, int minute, int second);
\ No newline at end of file
@@ -0,0 +1,11 @@
+#pragma once
+#include <stdint.h>
+
+// One detection, shared by the scanners and the hit store
+struct Hit {
+   uint8_t mac[6];
+   int8_t rssi;
+   uint8_t ch;
+   char name[32];
+   bool isBLE;
+};
@@ -0,0 +1,182 @@
+#include "hitstore.h"
+#include <string.h>
+#include <new>
+
+HitStore hitStore;
+
+HitStore::~HitStore()
+{
+    delete[] slots;
+    delete[] macHeads;
+    delete[] ouiHeads;
+}
+
+bool HitStore::init(size_t capacity)
+{
+    delete[] slots;
+    delete[] macHeads;
+    delete[] ouiHeads;
+    cap = 0;
+
+    // About four records per hash chain when full
+    uint32_t buckets = 64;
+    while (buckets < capacity / 4) buckets <<= 1;
+
+    slots = new (std::nothrow) StoredHit[capacity];
+    macHeads = new (std::nothrow) uint32_t[buckets];
+    ouiHeads = new (std::nothrow) uint32_t[buckets];
+    if (!slots || !macHeads || !ouiHeads) {
+        delete[] slots;
+        delete[] macHeads;
+        delete[] ouiHeads;
+        slots = nullptr;
+        macHeads = ouiHeads = nullptr;
+        return false;
+    }
+    memset(slots, 0, capacity * sizeof(StoredHit));
+    memset(macHeads, 0, buckets * sizeof(uint32_t));
+    memset(ouiHeads, 0, buckets * sizeof(uint32_t));
+    cap = capacity;
+    hashMask = buckets - 1;
+    clear();
+    return true;
+}
+
+// Everything older than the next seq becomes unreachable; chains are left
+// pointing at dead seqs and get overwritten as new records arrive.
+void HitStore::clear()
+{
+    oldest = head + 1;
+}
+
+uint32_t HitStore::macBucket(const uint8_t *mac) const
+{
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < 6; i++) h = (h ^ mac[i]) * 16777619u;
+    return h & hashMask;
+}
+
+uint32_t HitStore::ouiBucket(const uint8_t *mac) const
+{
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < 3; i++) h = (h ^ mac[i]) * 16777619u;
+    return h & hashMask;
+}
+
+uint32_t HitStore::add(const Hit &h, uint32_t ms)
+{
+    if (!cap) return 0;
+    uint32_t seq = ++head;
+    if (seq - oldest >= cap) oldest = seq - cap + 1;
+
+    StoredHit &s = slots[seq % cap];
+    s.hit = h;
+    s.seq = seq;
+    s.ms = ms;
+
+    uint32_t mb = macBucket(h.mac);
+    uint32_t ob = ouiBucket(h.mac);
+    s.nextMac = macHeads[mb];
+    macHeads[mb] = seq;
+    s.nextOui = ouiHeads[ob];
+    ouiHeads[ob] = seq;
+    s.nextCh = chHeads[h.ch & 15];
+    chHeads[h.ch & 15] = seq;
+    s.nextRssi = rssiHeads[h.rssi + 128];
+    rssiHeads[h.rssi + 128] = seq;
+    return seq;
+}
+
+const StoredHit *HitStore::at(uint32_t seq) const
+{
+    if (seq < oldest || seq > head) return nullptr;
+    const StoredHit &s = slots[seq % cap];
+    return s.seq == seq ? &s : nullptr;
+}
+
+// Records arrive in millis() order, so seq is monotonic in time
+uint32_t HitStore::firstSeqAtOrAfter(uint32_t ms) const
+{
+    uint32_t lo = oldest, hi = head + 1;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (slots[mid % cap].ms < ms) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+uint32_t HitStore::lowerBound(const HitQuery &q) const
+{
+    uint32_t low = oldest;
+    if (q.afterSeq >= low) low = q.afterSeq == UINT32_MAX ? UINT32_MAX : q.afterSeq + 1;
+    if (q.sinceMs) {
+        uint32_t t = firstSeqAtOrAfter(q.sinceMs);
+        if (t > low) low = t;
+    }
+    return low;
+}
+
+bool HitStore::matches(const HitQuery &q, const StoredHit &s) const
+{
+    if (s.hit.rssi < q.minRssi) return false;
+    if (q.ch >= 0 && s.hit.ch != q.ch) return false;
+    if (q.hasMac && memcmp(s.hit.mac, q.mac, 6) != 0) return false;
+    if (q.hasOui && memcmp(s.hit.mac, q.oui, 3) != 0) return false;
+    return true;
+}
+
+bool HitStore::next(const HitQuery &q, uint64_t &pos, StoredHit &out) const
+{
+    if (pos == HIT_CURSOR_DONE || !cap) return false;
+    uint32_t low = lowerBound(q);
+    const StoredHit *s;
+
+    if (q.byRssi) {
+        // pos = (256 - bucket) << 32 | seq, seq 0 = start of that bucket
+        int b = pos == HIT_CURSOR_START ? 255 : 256 - (int)(pos >> 32);
+        uint32_t seq = (uint32_t)pos;
+        if (seq != 0 && seq < oldest) {
+            // The rest of this bucket went with it (a chain only gets older),
+            // but weaker buckets can still hold live hits
+            b--;
+            seq = 0;
+        }
+        int minB = q.minRssi + 128;
+        for (; b >= minB; b--, seq = 0) {
+            if (seq == 0) seq = rssiHeads[b];
+            while (seq >= low && (s = at(seq)) != nullptr) {
+                seq = s->nextRssi;
+                if (!matches(q, *s)) continue;
+                out = *s;
+                if (seq >= low && at(seq)) pos = ((uint64_t)(256 - b) << 32) | seq;
+                else if (b > minB) pos = (uint64_t)(256 - (b - 1)) << 32;
+                else pos = HIT_CURSOR_DONE;
+                return true;
+            }
+        }
+        pos = HIT_CURSOR_DONE;
+        return false;
+    }
+
+    // Newest first along the most selective chain; pos = next seq to look at
+    uint32_t seq;
+    if (pos != HIT_CURSOR_START) seq = (uint32_t)pos;
+    else if (q.hasMac) seq = macHeads[macBucket(q.mac)];
+    else if (q.hasOui) seq = ouiHeads[ouiBucket(q.oui)];
+    else if (q.ch >= 0) seq = chHeads[q.ch & 15];
+    else seq = head;
+
+    while (seq >= low && (s = at(seq)) != nullptr) {
+        if (q.hasMac) seq = s->nextMac;
+        else if (q.hasOui) seq = s->nextOui;
+        else if (q.ch >= 0) seq = s->nextCh;
+        else seq = s->seq - 1;
+        if (!matches(q, *s)) continue;
+        out = *s;
+        pos = seq >= low && at(seq) ? seq : HIT_CURSOR_DONE;
+        return true;
+    }
+    pos = HIT_CURSOR_DONE;
+    return false;
+}
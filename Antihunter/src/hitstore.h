@@ -0,0 +1,79 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "hit.h"
+
+#ifndef HIT_STORE_CAPACITY
+#define HIT_STORE_CAPACITY 1024
+#endif
+
+// One stored hit. Chain links hold the seq of the next older record in the
+// same index bucket; a link is dead once that slot has been reused, which is
+// detected by the seq no longer matching, so eviction never has to unlink.
+struct StoredHit {
+    Hit hit;
+    uint32_t seq;      // 0 = empty slot
+    uint32_t ms;
+    uint32_t nextMac;
+    uint32_t nextOui;
+    uint32_t nextCh;
+    uint32_t nextRssi;
+};
+
+struct HitQuery {
+    bool hasMac = false;
+    uint8_t mac[6] = {0};
+    bool hasOui = false;
+    uint8_t oui[3] = {0};
+    int16_t ch = -1;            // -1 = any
+    int8_t minRssi = -128;
+    uint32_t afterSeq = 0;      // only seq > afterSeq
+    uint32_t sinceMs = 0;       // only ms >= sinceMs, 0 = any
+    bool byRssi = false;        // strongest first, otherwise newest first
+};
+
+const uint64_t HIT_CURSOR_START = 0;
+const uint64_t HIT_CURSOR_DONE = UINT64_MAX;
+
+// Fixed-capacity ring of hits with per-MAC, per-OUI, per-channel and
+// per-RSSI chains. Queries walk the most selective chain newest-first and
+// stop at the seq lower bound, so paging never copies or sorts. Time ranges
+// map to seq by binary search since records arrive in millis() order.
+// Not thread-safe; callers hold lastResultsMutex.
+class HitStore {
+  public:
+    ~HitStore();
+
+    bool init(size_t capacity);
+    void clear();
+    uint32_t add(const Hit &h, uint32_t ms);
+
+    size_t size() const { return head - oldest + 1; }
+    size_t capacity() const { return cap; }
+    uint32_t headSeq() const { return head; }
+    uint32_t oldestSeq() const { return oldest; }
+
+    // Next match at or after pos; pos is opaque, starts at HIT_CURSOR_START
+    // and reads HIT_CURSOR_DONE when nothing is left.
+    bool next(const HitQuery &q, uint64_t &pos, StoredHit &out) const;
+
+  private:
+    const StoredHit *at(uint32_t seq) const;
+    uint32_t lowerBound(const HitQuery &q) const;
+    uint32_t firstSeqAtOrAfter(uint32_t ms) const;
+    bool matches(const HitQuery &q, const StoredHit &s) const;
+    uint32_t macBucket(const uint8_t *mac) const;
+    uint32_t ouiBucket(const uint8_t *mac) const;
+
+    StoredHit *slots = nullptr;
+    size_t cap = 0;
+    uint32_t hashMask = 0;
+    uint32_t *macHeads = nullptr;
+    uint32_t *ouiHeads = nullptr;
+    uint32_t chHeads[16] = {0};
+    uint32_t rssiHeads[256] = {0};
+    uint32_t head = 0;        // newest seq, 0 before the first add
+    uint32_t oldest = 1;      // oldest live seq
+};
+
+extern HitStore hitStore;
@@ -0,0 +1,77 @@
+#include "lineframer.h"
+#include <string.h>
+
+LineFramer::LineFramer(uint8_t *b, size_t c, bool bin) : buf(b), cap(c), binary(bin) {}
+
+// Whatever arrives next may be the middle of a line or frame, so it is
+// dropped up to the next delimiter
+void LineFramer::reset()
+{
+    start = scan = end = 0;
+    inFrame = false;
+    dropping = true;
+}
+
+uint8_t *LineFramer::writeSpace(size_t &avail)
+{
+    if (end == cap && start > 0) {
+        memmove(buf, buf + start, end - start);
+        scan -= start;
+        end -= start;
+        start = 0;
+    }
+    avail = cap - end;
+    return buf + end;
+}
+
+void LineFramer::commit(size_t n)
+{
+    end += n;
+}
+
+FrameKind LineFramer::next(const uint8_t *&data, size_t &len)
+{
+    for (;;) {
+        const uint8_t *from = buf + scan;
+        size_t n = end - scan;
+        const uint8_t *nl = inFrame ? nullptr : (const uint8_t *)memchr(from, '\n', n);
+        const uint8_t *zero = binary ? (const uint8_t *)memchr(from, 0, nl ? nl - from : n) : nullptr;
+        const uint8_t *delim = zero ? zero : nl;
+
+        if (!delim) {
+            scan = end;
+            if (start == 0 && end == cap) {
+                // Nothing ends inside a full buffer: drop it and resync
+                bool wasDropping = dropping;
+                start = scan = end = 0;
+                dropping = true;
+                if (!wasDropping) return FRAME_OVERFLOW;
+            }
+            return FRAME_NONE;
+        }
+
+        size_t at = delim - buf;
+        data = buf + start;
+        len = at - start;
+        scan = start = at + 1;
+
+        // Every 0x00 ends a frame. One that ends an empty frame is (or may
+        // be) an opening delimiter, so '\n' is not a delimiter until the
+        // next 0x00; one that ends a non-empty frame was a closing one. A
+        // framer that lost track this way is back in step one frame later.
+        bool wasDropping = dropping;
+        dropping = false;
+        if (*delim == 0) {
+            inFrame = len == 0 && !wasDropping;
+            if (wasDropping || len == 0) continue;
+            return FRAME_BINARY;
+        }
+        if (wasDropping) continue;
+        while (len && data[len - 1] == '\r') len--;
+        while (len && data[0] == '\r') {
+            data++;
+            len--;
+        }
+        if (len) return FRAME_LINE;
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Splits a byte stream into '\n'-terminated text lines and, when enabled,
+// 0x00-delimited binary mesh frames (see meshproto.h), without copying.
+//
+// Reads go straight into the framer's buffer (writeSpace/commit); next()
+// then returns spans into that buffer. Delimiters are found with memchr and
+// scanning resumes where it stopped, so each byte is looked at once. A
+// partial frame is moved to the front of the buffer only when more room is
+// needed. Spans stay valid until the next writeSpace() call.
+//
+// Each 0x00 ends a binary frame and empty frames are skipped, so a lost
+// delimiter costs at most the frame around it. After reset() or an
+// overflow everything up to the next delimiter is discarded.
+enum FrameKind : uint8_t {
+    FRAME_NONE,         // need more data
+    FRAME_LINE,         // text line, without CR/LF
+    FRAME_BINARY,       // frame body, without its delimiters
+    FRAME_OVERFLOW,     // a line or frame longer than the buffer was dropped
+};
+
+class LineFramer {
+  public:
+    LineFramer(uint8_t *buf, size_t cap, bool binary);
+
+    // Room for the next read; compacts first if needed
+    uint8_t *writeSpace(size_t &avail);
+    void commit(size_t n);
+    FrameKind next(const uint8_t *&data, size_t &len);
+    void reset();
+
+  private:
+    uint8_t *buf;
+    size_t cap;
+    bool binary;
+    size_t start = 0;   // first byte of the frame being assembled
+    size_t scan = 0;    // bytes before this are known not to hold a delimiter
+    size_t end = 0;     // bytes filled
+    bool inFrame = false;
+    bool dropping = false;
+};
@@ -0,0 +1,113 @@
+#include "liveevents.h"
+#include <cstdarg>
+#include <stdio.h>
+
+bool jsonAppend(char *buf, size_t &len, size_t cap, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf + len, cap - len, fmt, args);
+    va_end(args);
+    if (n < 0 || len + n >= cap) {
+        buf[len] = '\0';
+        return false;
+    }
+    len += n;
+    return true;
+}
+
+bool jsonAppendString(char *buf, size_t &len, size_t cap, const char *str)
+{
+    size_t start = len;
+    if (len + 1 >= cap) return false;
+    buf[len++] = '"';
+    for (const char *p = str; *p; p++) {
+        unsigned char ch = (unsigned char)*p;
+        bool ok;
+        if (ch == '"' || ch == '\\') ok = jsonAppend(buf, len, cap, "\\%c", ch);
+        else if (ch < 0x20) ok = jsonAppend(buf, len, cap, "\\u%04x", ch);
+        else if (len + 1 < cap) { buf[len++] = ch; ok = true; }
+        else ok = false;
+        if (!ok) {
+            len = start;
+            buf[len] = '\0';
+            return false;
+        }
+    }
+    if (len + 1 >= cap) {
+        len = start;
+        buf[len] = '\0';
+        return false;
+    }
+    buf[len++] = '"';
+    buf[len] = '\0';
+    return true;
+}
+
+bool liveEventToJson(const LiveEvent &ev, char *buf, size_t &len, size_t cap)
+{
+    size_t start = len;
+    bool ok;
+    if (ev.kind == LIVE_HIT) {
+        ok = jsonAppend(buf, len, cap, "%s{\"m\":\"%02X:%02X:%02X:%02X:%02X:%02X\",\"r\":%d,\"c\":%u,\"b\":%d,\"n\":",
+                        len > 1 ? "," : "", ev.mac[0], ev.mac[1], ev.mac[2], ev.mac[3], ev.mac[4], ev.mac[5],
+                        ev.rssi, ev.ch, ev.isBLE ? 1 : 0) &&
+             jsonAppendString(buf, len, cap, ev.text) &&
+             jsonAppend(buf, len, cap, "}");
+    } else {
+        ok = jsonAppend(buf, len, cap, "%s{\"k\":", len > 1 ? "," : "") &&
+             jsonAppendString(buf, len, cap, ev.tag) &&
+             jsonAppend(buf, len, cap, ",\"t\":") &&
+             jsonAppendString(buf, len, cap, ev.text) &&
+             jsonAppend(buf, len, cap, "}");
+    }
+    if (!ok) {
+        len = start;
+        buf[len] = '\0';
+    }
+    return ok;
+}
+
+void LiveBatch::begin()
+{
+    hits[0] = alerts[0] = '[';
+    hitLen = alertLen = 1;
+}
+
+// One byte is reserved for the closing bracket
+bool LiveBatch::add(const LiveEvent &ev)
+{
+    return ev.kind == LIVE_HIT ? liveEventToJson(ev, hits, hitLen, LIVE_MSG_MAX - 1)
+                               : liveEventToJson(ev, alerts, alertLen, LIVE_MSG_MAX - 1);
+}
+
+static const char *closeArray(char *buf, size_t &len)
+{
+    if (len <= 1) return nullptr;
+    buf[len++] = ']';
+    buf[len] = '\0';
+    return buf;
+}
+
+const char *LiveBatch::hitsJson()
+{
+    return closeArray(hits, hitLen);
+}
+
+const char *LiveBatch::alertsJson()
+{
+    return closeArray(alerts, alertLen);
+}
+
+LiveSendAction liveSendAction(bool &lagging, size_t packetsWaiting)
+{
+    if (packetsWaiting >= LIVE_CLIENT_MAX_QUEUED) {
+        lagging = true;
+        return LIVE_SKIP;
+    }
+    if (lagging) {
+        lagging = false;
+        return LIVE_RESYNC_SEND;
+    }
+    return LIVE_SEND;
+}
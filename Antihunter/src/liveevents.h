@@ -0,0 +1,49 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Live event (SSE) serialization, shared with host tests (no Arduino
+// dependencies). Scan tasks queue LiveEvents; each flush packs them into one
+// JSON array per kind, and each client is sent the arrays unless its queue
+// is backed up, in which case it is skipped and later told to resync.
+
+enum LiveKind : uint8_t { LIVE_HIT, LIVE_ALERT };
+
+struct LiveEvent {
+    uint8_t kind;
+    uint8_t mac[6];
+    int8_t rssi;
+    uint8_t ch;
+    bool isBLE;
+    char tag[12];
+    char text[96];
+};
+
+const size_t LIVE_MSG_MAX = 1024;
+const size_t LIVE_CLIENT_MAX_QUEUED = 8;
+
+// Appends to buf at len; returns false (leaving len untouched) if it won't fit
+bool jsonAppend(char *buf, size_t &len, size_t cap, const char *fmt, ...);
+bool jsonAppendString(char *buf, size_t &len, size_t cap, const char *str);
+// One event as an array element, with a leading comma unless it is the first
+bool liveEventToJson(const LiveEvent &ev, char *buf, size_t &len, size_t cap);
+
+// The hits and alerts arrays of one flush round
+struct LiveBatch {
+    char hits[LIVE_MSG_MAX];
+    char alerts[LIVE_MSG_MAX];
+    size_t hitLen, alertLen;
+
+    void begin();
+    // False if ev doesn't fit its array; the round is then sent as it is
+    bool add(const LiveEvent &ev);
+    // Closes the arrays; nullptr for an empty one
+    const char *hitsJson();
+    const char *alertsJson();
+};
+
+enum LiveSendAction : uint8_t { LIVE_SEND, LIVE_SKIP, LIVE_RESYNC_SEND };
+
+// What to do with a broadcast for a client that has packetsWaiting queued.
+// A skipped client is marked lagging and gets a resync before its next send.
+LiveSendAction liveSendAction(bool &lagging, size_t packetsWaiting);
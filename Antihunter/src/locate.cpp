@@ -0,0 +1,237 @@
+#include "locate.h"
+#include <math.h>
+
+static const double WGS84_A = 6378137.0;
+static const double WGS84_E2 = 6.69437999014e-3;
+static const double DEG = M_PI / 180.0;
+static const double LOC_MIN_SPREAD_M = 1.0;     // node spread across the weakest axis
+static const double LOC_CHI2_95_2D = 5.991;
+
+void LocalFrame::ecef(double lat, double lon, double &x, double &y, double &z)
+{
+    double sl = sin(lat * DEG), cl = cos(lat * DEG);
+    double nRad = WGS84_A / sqrt(1 - WGS84_E2 * sl * sl);
+    x = nRad * cl * cos(lon * DEG);
+    y = nRad * cl * sin(lon * DEG);
+    z = nRad * (1 - WGS84_E2) * sl;
+}
+
+void LocalFrame::toEnu(double lat, double lon, double &e, double &n) const
+{
+    double x, y, z;
+    ecef(lat, lon, x, y, z);
+    x -= x0;
+    y -= y0;
+    z -= z0;
+    e = -sinLon * x + cosLon * y;
+    n = -sinLat * cosLon * x - sinLat * sinLon * y + cosLat * z;
+}
+
+// A few fixed-point steps; the first is already within a metre at 5 km
+void LocalFrame::fromEnu(double e, double n, double &lat, double &lon) const
+{
+    lat = lat0 + n / mPerDegN;
+    lon = lon0 + e / mPerDegE;
+    for (int i = 0; i < 3; i++) {
+        double ge, gn;
+        toEnu(lat, lon, ge, gn);
+        lat += (n - gn) / mPerDegN;
+        lon += (e - ge) / mPerDegE;
+    }
+}
+
+LocalFrame makeFrame(double lat0, double lon0)
+{
+    LocalFrame f;
+    f.lat0 = lat0;
+    f.lon0 = lon0;
+    LocalFrame::ecef(lat0, lon0, f.x0, f.y0, f.z0);
+    f.sinLat = sin(lat0 * DEG);
+    f.cosLat = cos(lat0 * DEG);
+    f.sinLon = sin(lon0 * DEG);
+    f.cosLon = cos(lon0 * DEG);
+    double w = sqrt(1 - WGS84_E2 * f.sinLat * f.sinLat);
+    f.mPerDegN = WGS84_A * (1 - WGS84_E2) / (w * w * w) * DEG;    // meridian radius
+    f.mPerDegE = WGS84_A / w * f.cosLat * DEG;                     // prime vertical radius
+    return f;
+}
+
+// Weighted sum of squared residuals; also the gradient g and curvature H if
+// given. H is J'WJ, plus the second-order terms when newton is set and the
+// result stays positive definite. Without them the steps crawl along the
+// curved valley that ranges longer than the node spacing produce.
+static double evalAt(const double *xs, const double *ys, const float *range, const double *w, size_t n,
+                     double px, double py, double H[3], double g[2], bool newton = false)
+{
+    double cost = 0;
+    double S[3] = {0, 0, 0};
+    if (H) H[0] = H[1] = H[2] = g[0] = g[1] = 0;
+    for (size_t i = 0; i < n; i++) {
+        double dx = px - xs[i], dy = py - ys[i];
+        double d = sqrt(dx * dx + dy * dy);
+        double r = d - range[i];
+        cost += w[i] * r * r;
+        if (!H) continue;
+        double ux = d > 1e-6 ? dx / d : 1, uy = d > 1e-6 ? dy / d : 0;
+        H[0] += w[i] * ux * ux;
+        H[1] += w[i] * ux * uy;
+        H[2] += w[i] * uy * uy;
+        g[0] += w[i] * ux * r;
+        g[1] += w[i] * uy * r;
+        if (newton && d > 1e-6) {
+            double k = w[i] * r / d;
+            S[0] += k * (1 - ux * ux);
+            S[1] -= k * ux * uy;
+            S[2] += k * (1 - uy * uy);
+        }
+    }
+    if (newton) {
+        double a = H[0] + S[0], b = H[1] + S[1], c = H[2] + S[2];
+        if (a > 0 && a * c - b * b > 1e-12 * (a + c) * (a + c)) {
+            H[0] = a;
+            H[1] = b;
+            H[2] = c;
+        }
+    }
+    return cost;
+}
+
+LocStatus locateWls(const LocObs *obs, size_t n, LocFix &fix, const LocFix *start)
+{
+    if (n > LOC_MAX_OBS) n = LOC_MAX_OBS;
+    if (n < 3) return LOC_TOO_FEW;
+
+    double lat0 = 0, lon0 = 0;
+    for (size_t i = 0; i < n; i++) {
+        lat0 += obs[i].lat;
+        lon0 += obs[i].lon;
+    }
+    LocalFrame frame = makeFrame(lat0 / n, lon0 / n);
+
+    double xs[LOC_MAX_OBS], ys[LOC_MAX_OBS], w[LOC_MAX_OBS];
+    float range[LOC_MAX_OBS];
+    double sxx = 0, sxy = 0, syy = 0;
+    for (size_t i = 0; i < n; i++) {
+        frame.toEnu(obs[i].lat, obs[i].lon, xs[i], ys[i]);
+        range[i] = obs[i].range > 0 ? obs[i].range : 0;
+        double sigma = obs[i].sigma > 0.5f ? obs[i].sigma : 0.5;
+        w[i] = 1 / (sigma * sigma);
+        sxx += xs[i] * xs[i];
+        sxy += xs[i] * ys[i];
+        syy += ys[i] * ys[i];
+    }
+
+    // Smallest principal spread of the nodes: ~0 when they sit on a line
+    sxx /= n;
+    sxy /= n;
+    syy /= n;
+    double half = (sxx + syy) / 2;
+    double minEig = half - sqrt((sxx - syy) * (sxx - syy) / 4 + sxy * sxy);
+    if (minEig < LOC_MIN_SPREAD_M * LOC_MIN_SPREAD_M) return LOC_DEGENERATE;
+
+    double px = 0, py = 0;
+    if (start) {
+        frame.toEnu(start->lat, start->lon, px, py);
+    } else {
+        double ws = 0;
+        for (size_t i = 0; i < n; i++) {
+            double k = 1 / (range[i] + 1);
+            px += k * xs[i];
+            py += k * ys[i];
+            ws += k;
+        }
+        px /= ws;
+        py /= ws;
+    }
+
+    double H[3], g[2];
+    double cost = evalAt(xs, ys, range, w, n, px, py, H, g, true);
+    double lambda = 1e-3;
+    bool converged = false;
+    uint8_t it = 0;
+    while (it < LOC_MAX_ITERS && !converged) {
+        it++;
+        bool accepted = false;
+        while (!accepted && lambda < 1e10) {
+            // Marquardt damping scales with the diagonal so units don't matter
+            double a = H[0] * (1 + lambda) + 1e-12, b = H[1], c = H[2] * (1 + lambda) + 1e-12;
+            double det = a * c - b * b;
+            double dx = -(c * g[0] - b * g[1]) / det;
+            double dy = -(a * g[1] - b * g[0]) / det;
+            double nc = evalAt(xs, ys, range, w, n, px + dx, py + dy, nullptr, nullptr);
+            if (nc <= cost) {
+                px += dx;
+                py += dy;
+                converged = sqrt(dx * dx + dy * dy) < 1e-3 || cost - nc < 1e-9 * (cost + 1e-12);
+                cost = evalAt(xs, ys, range, w, n, px, py, H, g, true);
+                lambda = lambda > 1e-9 ? lambda / 10 : lambda;
+                accepted = true;
+            } else {
+                lambda *= 10;
+            }
+        }
+        if (!accepted) converged = true;     // no downhill step left: at the minimum
+    }
+    if (!converged) return LOC_NO_CONVERGE;
+
+    // Covariance = (J'WJ)^-1, inflated when residuals exceed the range model
+    evalAt(xs, ys, range, w, n, px, py, H, g);
+    double det = H[0] * H[2] - H[1] * H[1];
+    double tr = H[0] + H[2];
+    if (det <= 1e-9 * tr * tr) return LOC_DEGENERATE;
+    double scale = n > 2 ? cost / (n - 2) : 1;
+    if (scale < 1) scale = 1;
+    double cEE = H[2] / det * scale, cEN = -H[1] / det * scale, cNN = H[0] / det * scale;
+
+    double sq = 0;
+    for (size_t i = 0; i < n; i++) {
+        double d = sqrt((px - xs[i]) * (px - xs[i]) + (py - ys[i]) * (py - ys[i]));
+        sq += (d - range[i]) * (d - range[i]);
+    }
+
+    fix.east = (float)px;
+    fix.north = (float)py;
+    frame.fromEnu(px, py, fix.lat, fix.lon);
+    locSetCovariance(fix, cEE, cEN, cNN);
+    fix.rmsResidual = (float)sqrt(sq / n);
+    fix.iterations = it;
+    fix.used = (uint8_t)n;
+    return LOC_OK;
+}
+
+void locSetCovariance(LocFix &fix, double cEE, double cEN, double cNN)
+{
+    double m = (cEE + cNN) / 2;
+    double r = sqrt((cEE - cNN) * (cEE - cNN) / 4 + cEN * cEN);
+    double k = sqrt(LOC_CHI2_95_2D);
+    double thetaFromEast = 0.5 * atan2(2 * cEN, cEE - cNN) / DEG;
+    double heading = 90 - thetaFromEast;
+    if (heading < 0) heading += 180;
+    if (heading >= 180) heading -= 180;
+
+    fix.covEE = (float)cEE;
+    fix.covEN = (float)cEN;
+    fix.covNN = (float)cNN;
+    fix.major = (float)(k * sqrt(m + r));
+    fix.minor = (float)(k * sqrt(m - r > 0 ? m - r : 0));
+    fix.headingDeg = (float)heading;
+}
+
+double locDistance(double lat1, double lon1, double lat2, double lon2)
+{
+    double x1, y1, z1, x2, y2, z2;
+    LocalFrame::ecef(lat1, lon1, x1, y1, z1);
+    LocalFrame::ecef(lat2, lon2, x2, y2, z2);
+    return sqrt((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2) + (z1 - z2) * (z1 - z2));
+}
+
+const char *locStatusName(LocStatus s)
+{
+    switch (s) {
+    case LOC_OK: return "ok";
+    case LOC_TOO_FEW: return "too few nodes with GPS";
+    case LOC_DEGENERATE: return "nodes too close/collinear";
+    case LOC_NO_CONVERGE: return "did not converge";
+    }
+    return "?";
+}
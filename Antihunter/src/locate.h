@@ -0,0 +1,64 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Position from ranges to nodes at known GPS positions.
+//
+// Node positions go through ECEF onto the east/north plane tangent to the
+// WGS84 ellipsoid at their centroid (metres); over the few km a mesh spans,
+// plane distances are within a millimetre of the ground ones. The position
+// is then found by Levenberg-Marquardt weighted least squares over every
+// range: each residual is (distance to node - measured range) / sigma.
+
+const size_t LOC_MAX_OBS = 32;
+const uint8_t LOC_MAX_ITERS = 50;
+
+// East/north on the plane tangent to the WGS84 ellipsoid at (lat0, lon0)
+struct LocalFrame {
+    double lat0, lon0;
+    double x0, y0, z0;
+    double sinLat, cosLat, sinLon, cosLon;
+    double mPerDegN, mPerDegE;      // local scale, for the inverse
+
+    static void ecef(double lat, double lon, double &x, double &y, double &z);
+    void toEnu(double lat, double lon, double &e, double &n) const;
+    void fromEnu(double e, double n, double &lat, double &lon) const;
+};
+
+LocalFrame makeFrame(double lat0, double lon0);
+
+struct LocObs {
+    double lat, lon;
+    float range;        // metres
+    float sigma;        // 1-sigma range error, metres
+};
+
+struct LocFix {
+    double lat, lon;
+    float east, north;      // metres from the node centroid
+    float covEE, covEN, covNN;
+    float major, minor;     // 95% error ellipse semi-axes, metres
+    float headingDeg;       // major axis, degrees clockwise from north
+    float rmsResidual;      // metres
+    uint8_t iterations;
+    uint8_t used;           // observations used
+};
+
+enum LocStatus : uint8_t {
+    LOC_OK,
+    LOC_TOO_FEW,        // fewer than 3 nodes
+    LOC_DEGENERATE,     // nodes co-located or in a line: the position is ambiguous
+    LOC_NO_CONVERGE
+};
+
+// start, if given, seeds the solver (e.g. the previous fix); otherwise it
+// starts from the range-weighted centroid of the nodes
+LocStatus locateWls(const LocObs *obs, size_t n, LocFix &fix, const LocFix *start = nullptr);
+
+const char *locStatusName(LocStatus s);
+
+// Fills the covariance and the 95% error ellipse from an east/north covariance
+void locSetCovariance(LocFix &fix, double cEE, double cEN, double cNN);
+
+// Straight-line distance between two points on the ellipsoid, metres
+double locDistance(double lat1, double lon1, double lat2, double lon2);
@@ -5,6 +5,8 @@
 #include "network.h"
 #include "scanner.h" 
 #include "hardware.h"
+#include "meshtx.h"
+#include "commands.h"
 #include <SD.h>
 #include <TinyGPSPlus.h>
 #include <HardwareSerial.h>
@@ -23,38 +25,10 @@ TaskHandle_t workerTaskHandle = nullptr;
 TaskHandle_t blueTeamTaskHandle = nullptr;
 
 std::string antihunter::lastResults = "No scan data yet.";
+ResultsBody antihunter::lastResultsBody = RESULTS_BODY_NONE;
+uint32_t antihunter::lastResultsGen = 0;
 std::mutex antihunter::lastResultsMutex;
 
-void uartForwardTask(void *parameter) {
-  static String meshBuffer = "";
-  
-  for (;;) {
-    while (Serial1.available()) {
-      char c = Serial1.read();
-      Serial.write(c);
-      
-      if (c == '\n' || c == '\r') {
-        if (meshBuffer.length() > 0) {
-          Serial.printf("[MESH RX] %s\n", meshBuffer.c_str());
-          String toProcess = meshBuffer;
-          int colonPos = meshBuffer.indexOf(": ");
-          if (colonPos > 0) {
-            toProcess = meshBuffer.substring(colonPos + 2);
-          }
-          processMeshMessage(toProcess);
-          meshBuffer = "";
-        }
-      } else {
-        meshBuffer += c;
-        if (meshBuffer.length() > 1024) {
-          meshBuffer = "";
-        }
-      }
-    }
-    delay(2);
-  }
-}
-
 String macFmt6(const uint8_t *m) {
     char b[18];
     snprintf(b, sizeof(b), "%02X:%02X:%02X:%02X:%02X:%02X", 
@@ -94,25 +68,17 @@ inline int clampi(int v, int lo, int hi) {
     return v;
 }
 
+void applyChannels(const ChannelList &list, std::initializer_list<uint8_t> fallback) {
+    CHANNELS.assign(list.ch, list.ch + list.count);
+    if (CHANNELS.empty()) CHANNELS = fallback;
+}
+
+// Web form channels, same syntax as mesh commands ("1,6,11", "1..13" or a mix)
 void parseChannelsCSV(const String &csv) {
-    CHANNELS.clear();
-    if (csv.indexOf("..") >= 0) {
-        int a = csv.substring(0, csv.indexOf("..")).toInt();
-        int b = csv.substring(csv.indexOf("..") + 2).toInt();
-        for (int ch = a; ch <= b; ch++) {
-            if (ch >= 1 && ch <= 14) CHANNELS.push_back((uint8_t)ch);
-        }
-    } else {
-        int start = 0;
-        while (start < csv.length()) {
-            int comma = csv.indexOf(',', start);
-            if (comma < 0) comma = csv.length();
-            int ch = csv.substring(start, comma).toInt();
-            if (ch >= 1 && ch <= 14) CHANNELS.push_back((uint8_t)ch);
-            start = comma + 1;
-        }
-    }
-    if (CHANNELS.empty()) CHANNELS = {1, 6, 11};
+    ChannelList list = {};
+    ArgReader args(csv.c_str(), csv.length());
+    if (!args.readChannels(list)) list.count = 0;
+    applyChannels(list, {1, 6, 11});
 }
 
 void sendNodeIdUpdate() {
@@ -123,9 +89,8 @@ void sendNodeIdUpdate() {
     }
     Serial.println(nodeMsg);
     // send mesh
-    if (Serial1.availableForWrite() >= nodeMsg.length()) {
-        Serial1.println(nodeMsg);
-    }
+    meshSend(MESH_STATUS, nodeMsg, "nodeid");
+    announcePathLoss();
 }
 
 void setup() {
@@ -149,7 +114,6 @@ void setup() {
     initializeVibrationSensor();
     initializeScanner();
     
-    xTaskCreatePinnedToCore(uartForwardTask, "UARTForwardTask", 4096, NULL, 2, NULL, 1);
     delay(120);
 
     esp_task_wdt_config_t wdt_config = {
@@ -176,12 +140,16 @@ void loop() {
     // Update RTC time every second
     if (millis() - lastRTCUpdate > 1000) {
         updateRTCTime();
+        pollTimeSync();
         lastRTCUpdate = millis();
     }
 
     updateGPSLocation();
     processUSBToMesh();
     checkAndSendVibrationAlert();
+    flushLiveEvents();
+    flushMeshHits();
+    pollMeshCommands();
 
   delay(120);
 }
\ No newline at end of file
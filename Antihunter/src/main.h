@@ -3,7 +3,19 @@
 #include <string>
 #include "esp_task_wdt.h" 
 
+// Structured section streamed after the lastResults text
+enum ResultsBody : uint8_t { RESULTS_BODY_NONE, RESULTS_BODY_LIST_HITS, RESULTS_BODY_SNIFFER_HITS };
+
 namespace antihunter {
     extern std::string lastResults;
+    extern ResultsBody lastResultsBody;
+    extern uint32_t lastResultsGen;
     extern std::mutex lastResultsMutex;
-}
\ No newline at end of file
+
+    // Caller holds lastResultsMutex
+    inline void setResultsLocked(const std::string &text, ResultsBody body) {
+        lastResults = text;
+        lastResultsBody = body;
+        lastResultsGen++;
+    }
+}
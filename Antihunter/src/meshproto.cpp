@@ -0,0 +1,305 @@
+#include "meshproto.h"
+#include <string.h>
+
+// Writer / reader
+
+void MpWriter::u8(uint8_t v)
+{
+    if (len >= cap) {
+        overflow = true;
+        return;
+    }
+    buf[len++] = v;
+}
+
+void MpWriter::varint(uint32_t v)
+{
+    while (v >= 0x80) {
+        u8((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    u8((uint8_t)v);
+}
+
+void MpWriter::svarint(int32_t v)
+{
+    varint(((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+}
+
+void MpWriter::bytes(const void *p, size_t n)
+{
+    if (len + n > cap) {
+        overflow = true;
+        return;
+    }
+    memcpy(buf + len, p, n);
+    len += n;
+}
+
+uint8_t MpReader::u8()
+{
+    if (pos >= len) {
+        err = true;
+        return 0;
+    }
+    return buf[pos++];
+}
+
+uint32_t MpReader::varint()
+{
+    uint32_t v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        uint8_t b = u8();
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return v;
+    }
+    err = true;
+    return 0;
+}
+
+int32_t MpReader::svarint()
+{
+    uint32_t v = varint();
+    return (int32_t)((v >> 1) ^ (~(v & 1) + 1));
+}
+
+bool MpReader::bytes(void *out, size_t n)
+{
+    if (pos + n > len) {
+        err = true;
+        return false;
+    }
+    memcpy(out, buf + pos, n);
+    pos += n;
+    return true;
+}
+
+// CRC-16/CCITT-FALSE
+
+uint16_t mpCrc16(const uint8_t *p, size_t n, uint16_t crc)
+{
+    while (n--) {
+        crc ^= (uint16_t)*p++ << 8;
+        for (int i = 0; i < 8; i++) crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+// COBS
+
+size_t mpCobsEncode(const uint8_t *in, size_t n, uint8_t *out)
+{
+    size_t w = 1, codePos = 0;
+    uint8_t code = 1;
+    for (size_t i = 0; i < n; i++) {
+        if (in[i] == 0) {
+            out[codePos] = code;
+            codePos = w++;
+            code = 1;
+            continue;
+        }
+        out[w++] = in[i];
+        if (++code == 0xFF) {
+            out[codePos] = code;
+            codePos = w++;
+            code = 1;
+        }
+    }
+    out[codePos] = code;
+    return w;
+}
+
+size_t mpCobsDecode(const uint8_t *in, size_t n, uint8_t *out)
+{
+    size_t r = 0, w = 0;
+    while (r < n) {
+        uint8_t code = in[r++];
+        if (code == 0) return 0;
+        for (uint8_t i = 1; i < code; i++) {
+            if (r >= n || in[r] == 0) return 0;
+            out[w++] = in[r++];
+        }
+        if (code != 0xFF && r < n) out[w++] = 0;
+    }
+    return w;
+}
+
+// Frames
+
+static void writeHeader(MpWriter &w, MpType type, const char *node, uint32_t seq)
+{
+    size_t n = strnlen(node, MP_NODE_MAX);
+    w.u8((uint8_t)(MP_VERSION << 4 | type));
+    w.u8((uint8_t)n);
+    w.bytes(node, n);
+    w.varint(seq);
+}
+
+// Worst-case framed size of a payload of n bytes plus CRC
+static size_t framedSize(size_t n)
+{
+    n += 2;
+    return n + n / 254 + 1 + 2;
+}
+
+static size_t finishFrame(uint8_t *payload, size_t n, uint8_t *frame)
+{
+    uint16_t crc = mpCrc16(payload, n);
+    payload[n++] = (uint8_t)crc;
+    payload[n++] = (uint8_t)(crc >> 8);
+    frame[0] = 0;
+    size_t k = mpCobsEncode(payload, n, frame + 1);
+    frame[1 + k] = 0;
+    return k + 2;
+}
+
+static void writeHit(MpWriter &w, const MpHit &h, int8_t prevRssi, uint16_t prevAge, int prevCh)
+{
+    size_t nameLen = strnlen(h.name, MP_NAME_MAX);
+    uint8_t flags = (h.ble ? MP_HIT_BLE : 0) | (nameLen ? MP_HIT_NAME : 0) |
+                    (h.count > 1 ? MP_HIT_STATS : 0) | (h.ch == prevCh ? MP_HIT_SAME_CH : 0);
+    w.u8(flags);
+    w.bytes(h.mac, 6);
+    if (!(flags & MP_HIT_SAME_CH)) w.u8(h.ch);
+    w.svarint(h.rssi - prevRssi);
+    w.svarint((int32_t)h.ageS - prevAge);
+    if (flags & MP_HIT_STATS) {
+        w.varint(h.count);
+        w.svarint(h.rssiMax - h.rssi);
+        w.svarint(h.rssiMean - h.rssi);
+    }
+    if (flags & MP_HIT_NAME) {
+        w.u8((uint8_t)nameLen);
+        w.bytes(h.name, nameLen);
+    }
+}
+
+size_t mpEncodeHits(const MpBatch &b, const MpHit *hits, size_t n, uint8_t *frame, size_t mtu, size_t &used)
+{
+    uint8_t payload[MP_PAYLOAD_MAX];
+    MpWriter w(payload, sizeof(payload) - 2);
+    used = 0;
+
+    writeHeader(w, MP_HITS, b.node, b.seq);
+    w.u8(b.hasGps ? MP_BATCH_GPS : 0);
+    if (b.hasGps) {
+        w.svarint(b.lat1e6);
+        w.svarint(b.lon1e6);
+    }
+    w.varint(b.t0);
+    size_t countPos = w.len;
+    w.u8(0);
+    if (w.overflow) return 0;
+
+    int8_t prevRssi = 0;
+    uint16_t prevAge = 0;
+    int prevCh = -1;
+    while (used < n && used < 255) {
+        const MpHit &h = hits[used];
+        size_t mark = w.len;
+        writeHit(w, h, prevRssi, prevAge, prevCh);
+        if (w.overflow || framedSize(w.len) > mtu) {
+            w.len = mark;
+            w.overflow = false;
+            break;
+        }
+        prevRssi = h.rssi;
+        prevAge = h.ageS;
+        prevCh = h.ch;
+        used++;
+    }
+    if (used == 0) return 0;
+    payload[countPos] = (uint8_t)used;
+    return finishFrame(payload, w.len, frame);
+}
+
+size_t mpEncodeText(const char *node, uint32_t seq, const char *text, uint8_t *frame, size_t mtu)
+{
+    uint8_t payload[MP_PAYLOAD_MAX];
+    MpWriter w(payload, sizeof(payload) - 2);
+    writeHeader(w, MP_TEXT, node, seq);
+    size_t n = strlen(text);
+    while (n > 0 && framedSize(w.len + n) > mtu) n--;
+    w.bytes(text, n);
+    if (w.overflow || framedSize(w.len) > mtu) return 0;
+    return finishFrame(payload, w.len, frame);
+}
+
+bool mpDecodeFrame(const uint8_t *data, size_t n, MpFrame &f)
+{
+    if (n == 0 || n > sizeof(f.payload) + 1) return false;
+    size_t len = mpCobsDecode(data, n, f.payload);
+    if (len < 4) return false;
+    uint16_t crc = f.payload[len - 2] | (uint16_t)f.payload[len - 1] << 8;
+    if (mpCrc16(f.payload, len - 2) != crc) return false;
+
+    MpReader r(f.payload, len - 2);
+    uint8_t vt = r.u8();
+    if ((vt >> 4) != MP_VERSION) return false;
+    f.type = (MpType)(vt & 0x0F);
+    uint8_t nodeLen = r.u8();
+    if (nodeLen > MP_NODE_MAX || !r.bytes(f.node, nodeLen)) return false;
+    f.node[nodeLen] = '\0';
+    f.seq = r.varint();
+    f.body = MpReader(f.payload + r.pos, r.len - r.pos);
+    return !r.err;
+}
+
+bool mpBeginHits(const MpFrame &f, MpHitReader &hr)
+{
+    if (f.type != MP_HITS) return false;
+    hr.r = f.body;
+    memcpy(hr.batch.node, f.node, sizeof(hr.batch.node));
+    hr.batch.seq = f.seq;
+    uint8_t flags = hr.r.u8();
+    hr.batch.hasGps = flags & MP_BATCH_GPS;
+    hr.batch.lat1e6 = hr.batch.hasGps ? hr.r.svarint() : 0;
+    hr.batch.lon1e6 = hr.batch.hasGps ? hr.r.svarint() : 0;
+    hr.batch.t0 = hr.r.varint();
+    hr.remaining = hr.r.u8();
+    hr.prevRssi = 0;
+    hr.prevAge = 0;
+    hr.prevCh = 0;
+    return !hr.r.err;
+}
+
+bool mpNextHit(MpHitReader &hr, MpHit &h)
+{
+    if (hr.remaining == 0 || hr.r.err) return false;
+    MpReader &r = hr.r;
+    uint8_t flags = r.u8();
+    r.bytes(h.mac, 6);
+    h.ble = flags & MP_HIT_BLE;
+    h.ch = (flags & MP_HIT_SAME_CH) ? hr.prevCh : r.u8();
+    h.rssi = (int8_t)(hr.prevRssi + r.svarint());
+    h.ageS = (uint16_t)(hr.prevAge + r.svarint());
+    h.count = 1;
+    h.rssiMax = h.rssiMean = h.rssi;
+    if (flags & MP_HIT_STATS) {
+        h.count = (uint16_t)r.varint();
+        h.rssiMax = (int8_t)(h.rssi + r.svarint());
+        h.rssiMean = (int8_t)(h.rssi + r.svarint());
+    }
+    h.name[0] = '\0';
+    if (flags & MP_HIT_NAME) {
+        uint8_t n = r.u8();
+        if (n > MP_NAME_MAX || !r.bytes(h.name, n)) return false;
+        h.name[n] = '\0';
+    }
+    if (r.err) return false;
+    hr.prevRssi = h.rssi;
+    hr.prevAge = h.ageS;
+    hr.prevCh = h.ch;
+    hr.remaining--;
+    return true;
+}
+
+bool mpReadText(const MpFrame &f, char *out, size_t cap)
+{
+    if (f.type != MP_TEXT || cap == 0) return false;
+    size_t n = f.body.len - f.body.pos;
+    if (n >= cap) n = cap - 1;
+    memcpy(out, f.body.buf + f.body.pos, n);
+    out[n] = '\0';
+    return true;
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Binary mesh framing, shared with host tools (no Arduino dependencies).
+//
+// On the wire a frame is 0x00 COBS(payload | crc16) 0x00; the leading
+// delimiter lets a receiver that was mid-text-line resync. Payload:
+//   u8  MP_VERSION << 4 | type
+//   u8  node id length, node id bytes
+//   varint sequence (per node, with the node id it makes the message id)
+//   body, per type
+// Body integers are LEB128 varints, signed ones zigzagged; MACs are raw.
+//
+// MP_HITS body:
+//   u8  flags (MP_BATCH_GPS)
+//   [svarint lat*1e6, svarint lon*1e6]
+//   varint t0 (epoch seconds, or uptime seconds without a clock)
+//   u8  count, then count records:
+//     u8  flags (MP_HIT_*)
+//     6   mac
+//     [u8 channel]                unless MP_HIT_SAME_CH
+//     svarint rssi - previous rssi (first record: rssi)
+//     svarint age - previous age  (age = seconds before t0)
+//     [varint count, svarint max - rssi, svarint mean - rssi]   MP_HIT_STATS
+//     [u8 len, name bytes]        MP_HIT_NAME
+
+const uint8_t MP_VERSION = 2;
+const size_t MP_NODE_MAX = 16;
+const size_t MP_NAME_MAX = 32;
+const size_t MP_MTU = 230;          // whole frame including both delimiters
+const size_t MP_PAYLOAD_MAX = 256;
+
+enum MpType : uint8_t { MP_TEXT = 1, MP_HITS = 2 };
+
+enum MpBatchFlags : uint8_t { MP_BATCH_GPS = 0x01 };
+enum MpHitFlags : uint8_t {
+    MP_HIT_BLE = 0x01,
+    MP_HIT_NAME = 0x02,
+    MP_HIT_STATS = 0x04,
+    MP_HIT_SAME_CH = 0x08,
+};
+
+struct MpHit {
+    uint8_t mac[6];
+    int8_t rssi;            // last seen
+    uint8_t ch;
+    bool ble;
+    uint16_t ageS;
+    uint16_t count;         // sightings folded into this record, 1 = single
+    int8_t rssiMax;
+    int8_t rssiMean;
+    char name[MP_NAME_MAX + 1];
+};
+
+struct MpBatch {
+    char node[MP_NODE_MAX + 1];
+    uint32_t seq;
+    bool hasGps;
+    int32_t lat1e6;
+    int32_t lon1e6;
+    uint32_t t0;
+};
+
+struct MpWriter {
+    uint8_t *buf;
+    size_t cap;
+    size_t len = 0;
+    bool overflow = false;
+
+    MpWriter(uint8_t *b, size_t c) : buf(b), cap(c) {}
+    void u8(uint8_t v);
+    void varint(uint32_t v);
+    void svarint(int32_t v);
+    void bytes(const void *p, size_t n);
+};
+
+struct MpReader {
+    const uint8_t *buf;
+    size_t len;
+    size_t pos = 0;
+    bool err = false;
+
+    MpReader() : buf(nullptr), len(0) {}
+    MpReader(const uint8_t *b, size_t n) : buf(b), len(n) {}
+    uint8_t u8();
+    uint32_t varint();
+    int32_t svarint();
+    bool bytes(void *out, size_t n);
+};
+
+uint16_t mpCrc16(const uint8_t *p, size_t n, uint16_t crc = 0xFFFF);
+// out needs n + n / 254 + 1 bytes; returns bytes written
+size_t mpCobsEncode(const uint8_t *in, size_t n, uint8_t *out);
+// Returns decoded length, 0 if malformed; out needs n bytes
+size_t mpCobsDecode(const uint8_t *in, size_t n, uint8_t *out);
+
+// Packs as many of hits[0..n) as fit in mtu bytes into one frame; used is
+// set to how many went in. Returns the frame length, 0 if not even one fit.
+size_t mpEncodeHits(const MpBatch &b, const MpHit *hits, size_t n, uint8_t *frame, size_t mtu, size_t &used);
+size_t mpEncodeText(const char *node, uint32_t seq, const char *text, uint8_t *frame, size_t mtu);
+
+struct MpFrame {
+    MpType type;
+    char node[MP_NODE_MAX + 1];
+    uint32_t seq;
+    MpReader body;
+    uint8_t payload[MP_PAYLOAD_MAX];
+};
+
+// data is one frame without its delimiters; false on bad COBS, CRC,
+// version or header
+bool mpDecodeFrame(const uint8_t *data, size_t n, MpFrame &f);
+
+struct MpHitReader {
+    MpReader r;
+    MpBatch batch;
+    uint8_t remaining;
+    int8_t prevRssi;
+    uint16_t prevAge;
+    uint8_t prevCh;
+};
+
+bool mpBeginHits(const MpFrame &f, MpHitReader &hr);
+bool mpNextHit(MpHitReader &hr, MpHit &out);
+// Copies an MP_TEXT body, NUL-terminated
+bool mpReadText(const MpFrame &f, char *out, size_t cap);
@@ -0,0 +1,272 @@
+#include "meshtx.h"
+#include "metrics.h"
+#include "meshuart.h"
+#include "network.h"
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+struct MeshTxItem {
+    uint32_t key;       // 0 = never coalesced
+    uint32_t enqMs;
+    uint16_t len;
+    uint16_t stampAt;
+    MeshStampFn stamp;  // filled in at write time, see meshSendStamped
+    uint8_t data[MESH_TX_ITEM_MAX];
+};
+
+struct MeshTxQueue {
+    MeshTxItem *slots;
+    uint8_t depth;
+    uint32_t head;
+    uint32_t tail;
+};
+
+static MeshTxItem controlSlots[8];
+static MeshTxItem alertSlots[8];
+static MeshTxItem hitSlots[16];
+static MeshTxItem trackerSlots[2];
+static MeshTxItem statusSlots[12];
+
+static MeshTxQueue queues[MESH_CLASS_COUNT] = {
+    {controlSlots, 8, 0, 0},
+    {alertSlots, 8, 0, 0},
+    {hitSlots, 16, 0, 0},
+    {trackerSlots, 2, 0, 0},
+    {statusSlots, 12, 0, 0},
+};
+
+static portMUX_TYPE meshTxMux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t meshTxTask = nullptr;
+static volatile uint32_t txRate = MESH_TX_RATE_BPS;
+
+static const uint32_t LATENCY_BOUNDS[] = {50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000, 60000};
+static const uint8_t LATENCY_N = sizeof(LATENCY_BOUNDS) / sizeof(LATENCY_BOUNDS[0]);
+
+static Counter mSent[MESH_CLASS_COUNT] = {
+    {"antihunter_mesh_tx_total{class=\"control\"}", "Mesh messages written to the radio UART"},
+    {"antihunter_mesh_tx_total{class=\"alert\"}", "Mesh messages written to the radio UART"},
+    {"antihunter_mesh_tx_total{class=\"hit\"}", "Mesh messages written to the radio UART"},
+    {"antihunter_mesh_tx_total{class=\"tracker\"}", "Mesh messages written to the radio UART"},
+    {"antihunter_mesh_tx_total{class=\"status\"}", "Mesh messages written to the radio UART"},
+};
+static Counter mDropped[MESH_CLASS_COUNT] = {
+    {"antihunter_mesh_tx_dropped_total{class=\"control\"}", "Queued mesh messages evicted by newer ones", "Mesh drops control"},
+    {"antihunter_mesh_tx_dropped_total{class=\"alert\"}", "Queued mesh messages evicted by newer ones", "Mesh drops alert"},
+    {"antihunter_mesh_tx_dropped_total{class=\"hit\"}", "Queued mesh messages evicted by newer ones", "Mesh drops hit"},
+    {"antihunter_mesh_tx_dropped_total{class=\"tracker\"}", "Queued mesh messages evicted by newer ones", "Mesh drops tracker"},
+    {"antihunter_mesh_tx_dropped_total{class=\"status\"}", "Queued mesh messages evicted by newer ones", "Mesh drops status"},
+};
+static Counter mCoalesced[MESH_CLASS_COUNT] = {
+    {"antihunter_mesh_tx_coalesced_total{class=\"control\"}", "Mesh messages that replaced an unsent one with the same key"},
+    {"antihunter_mesh_tx_coalesced_total{class=\"alert\"}", "Mesh messages that replaced an unsent one with the same key"},
+    {"antihunter_mesh_tx_coalesced_total{class=\"hit\"}", "Mesh messages that replaced an unsent one with the same key"},
+    {"antihunter_mesh_tx_coalesced_total{class=\"tracker\"}", "Mesh messages that replaced an unsent one with the same key"},
+    {"antihunter_mesh_tx_coalesced_total{class=\"status\"}", "Mesh messages that replaced an unsent one with the same key"},
+};
+static Histogram mLatency[MESH_CLASS_COUNT] = {
+    {"antihunter_mesh_tx_latency_ms{class=\"control\"}", "Queue-to-UART delay", LATENCY_BOUNDS, LATENCY_N},
+    {"antihunter_mesh_tx_latency_ms{class=\"alert\"}", "Queue-to-UART delay", LATENCY_BOUNDS, LATENCY_N, "Mesh alert latency ms"},
+    {"antihunter_mesh_tx_latency_ms{class=\"hit\"}", "Queue-to-UART delay", LATENCY_BOUNDS, LATENCY_N, "Mesh hit latency ms"},
+    {"antihunter_mesh_tx_latency_ms{class=\"tracker\"}", "Queue-to-UART delay", LATENCY_BOUNDS, LATENCY_N},
+    {"antihunter_mesh_tx_latency_ms{class=\"status\"}", "Queue-to-UART delay", LATENCY_BOUNDS, LATENCY_N},
+};
+
+static double sampleQueued()
+{
+    uint32_t n = 0;
+    portENTER_CRITICAL(&meshTxMux);
+    for (auto &q : queues) n += q.head - q.tail;
+    portEXIT_CRITICAL(&meshTxMux);
+    return n;
+}
+static double sampleRate() { return txRate; }
+
+static Gauge mQueued("antihunter_mesh_tx_queued", "Mesh messages waiting to be sent", "Mesh TX queued", sampleQueued);
+static Gauge mRate("antihunter_mesh_tx_rate_bytes", "Mesh token bucket rate (bytes/s)", nullptr, sampleRate);
+
+static uint32_t keyHash(const String &key)
+{
+    if (!key.length()) return 0;
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < key.length(); i++) h = (h ^ (uint8_t)key[i]) * 16777619u;
+    return h ? h : 1;
+}
+
+uint32_t meshNextSeq()
+{
+    static const uint32_t base = esp_random() & 0xFFFFF;
+    static std::atomic<uint32_t> counter{0};
+    return base + counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+// suffix (the message id) and CRLF are appended to text lines
+static bool enqueue(MeshClass cls, const uint8_t *data, size_t len, const char *suffix, const String &key,
+                    MeshStampFn stamp = nullptr, size_t stampAt = 0)
+{
+    bool crlf = suffix != nullptr;
+    size_t suffixLen = crlf ? strlen(suffix) : 0;
+    size_t total = len + suffixLen + (crlf ? 2 : 0);
+    if (cls >= MESH_CLASS_COUNT || total == 0 || total > MESH_TX_ITEM_MAX) return false;
+    if (stamp && stampAt + MESH_STAMP_WIDTH > len) return false;
+    uint32_t k = keyHash(key);
+    MeshTxQueue &q = queues[cls];
+
+    portENTER_CRITICAL(&meshTxMux);
+    MeshTxItem *slot = nullptr;
+    if (k) {
+        for (uint32_t i = q.tail; i != q.head; i++) {
+            if (q.slots[i % q.depth].key == k) {
+                slot = &q.slots[i % q.depth];
+                mCoalesced[cls].inc();
+                break;
+            }
+        }
+    }
+    if (!slot) {
+        if (q.head - q.tail >= q.depth) {
+            q.tail++;
+            mDropped[cls].inc();
+        }
+        slot = &q.slots[q.head % q.depth];
+        slot->key = k;
+        slot->enqMs = millis();
+        q.head++;
+    }
+    memcpy(slot->data, data, len);
+    if (crlf) {
+        memcpy(slot->data + len, suffix, suffixLen);
+        slot->data[len + suffixLen] = '\r';
+        slot->data[len + suffixLen + 1] = '\n';
+    }
+    slot->len = total;
+    slot->stamp = stamp;
+    slot->stampAt = (uint16_t)stampAt;
+    portEXIT_CRITICAL(&meshTxMux);
+
+    if (meshTxTask) xTaskNotifyGive(meshTxTask);
+    return true;
+}
+
+bool meshSend(MeshClass cls, const String &line, const String &key)
+{
+    return meshSendSeq(cls, line, meshNextSeq(), key);
+}
+
+static bool sendLine(MeshClass cls, const String &line, uint32_t seq, const String &key, MeshStampFn stamp,
+                     size_t stampAt)
+{
+    String node = getNodeId();
+    char id[40];
+    bool prefixed = line.length() > node.length() + 1 && line.startsWith(node) &&
+                    line[node.length()] == ':' && line[node.length() + 1] == ' ';
+    if (prefixed) snprintf(id, sizeof(id), " ~%u", (unsigned)seq);
+    else snprintf(id, sizeof(id), " ~%s.%u", node.c_str(), (unsigned)seq);
+    return enqueue(cls, (const uint8_t *)line.c_str(), line.length(), id, key, stamp, stampAt);
+}
+
+bool meshSendSeq(MeshClass cls, const String &line, uint32_t seq, const String &key)
+{
+    return sendLine(cls, line, seq, key, nullptr, 0);
+}
+
+bool meshSendStamped(MeshClass cls, const String &line, size_t stampAt, MeshStampFn stamp, const String &key)
+{
+    return sendLine(cls, line, meshNextSeq(), key, stamp, stampAt);
+}
+
+bool meshSendFrame(MeshClass cls, const uint8_t *frame, size_t len, const String &key)
+{
+    return enqueue(cls, frame, len, nullptr, key);
+}
+
+// Length of the next item to send and its class, -1 if all queues are empty
+static int peekNext(uint16_t &len)
+{
+    int cls = -1;
+    portENTER_CRITICAL(&meshTxMux);
+    for (int c = 0; c < MESH_CLASS_COUNT; c++) {
+        MeshTxQueue &q = queues[c];
+        if (q.head != q.tail) {
+            len = q.slots[q.tail % q.depth].len;
+            cls = c;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&meshTxMux);
+    return cls;
+}
+
+static bool popNext(int cls, MeshTxItem &out)
+{
+    bool ok = false;
+    portENTER_CRITICAL(&meshTxMux);
+    MeshTxQueue &q = queues[cls];
+    if (q.head != q.tail) {
+        out = q.slots[q.tail % q.depth];
+        q.tail++;
+        ok = true;
+    }
+    portEXIT_CRITICAL(&meshTxMux);
+    return ok;
+}
+
+static void meshTxLoop(void *)
+{
+    static MeshTxItem item;
+    float tokens = MESH_TX_BURST;
+    uint32_t lastRefill = millis();
+
+    for (;;) {
+        uint32_t now = millis();
+        tokens += (now - lastRefill) * txRate / 1000.0f;
+        if (tokens > MESH_TX_BURST) tokens = MESH_TX_BURST;
+        lastRefill = now;
+
+        uint16_t len;
+        int cls = peekNext(len);
+        if (cls < 0) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        if (tokens < len) {
+            // Woken early if something more urgent arrives
+            uint32_t waitMs = (uint32_t)((len - tokens) * 1000 / (txRate ? txRate : 1)) + 1;
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs));
+            continue;
+        }
+        if (meshUartWritable() < len) {
+            vTaskDelay(pdMS_TO_TICKS(20));
+            continue;
+        }
+        if (!popNext(cls, item)) continue;
+
+        if (item.stamp) {
+            char ts[MESH_STAMP_WIDTH + 1];
+            snprintf(ts, sizeof(ts), "%016lld", (long long)item.stamp());
+            memcpy(item.data + item.stampAt, ts, MESH_STAMP_WIDTH);
+        }
+        meshUartWrite(item.data, item.len);
+        tokens -= item.len;
+        mSent[cls].inc();
+        mLatency[cls].observe(millis() - item.enqMs);
+    }
+}
+
+void meshTxBegin()
+{
+    if (meshTxTask) return;
+    xTaskCreatePinnedToCore(meshTxLoop, "meshtx", 3072, nullptr, 2, &meshTxTask, 1);
+    Serial.printf("[MESH] TX scheduler: %u B/s, burst %u B\n", (unsigned)txRate, (unsigned)MESH_TX_BURST);
+}
+
+void meshTxSetRate(uint32_t bytesPerSec)
+{
+    txRate = bytesPerSec ? bytesPerSec : 1;
+    if (meshTxTask) xTaskNotifyGive(meshTxTask);
+}
+
+uint32_t meshTxRate()
+{
+    return txRate;
+}
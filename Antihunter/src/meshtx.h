@@ -0,0 +1,58 @@
+#pragma once
+#include <Arduino.h>
+
+// Everything bound for the mesh radio goes through one scheduler so a burst
+// of hits can't starve alerts, and senders never block on the UART.
+//
+// Each class has its own small ring; the writer task always drains the
+// highest non-empty class first, paced by a token bucket sized to what the
+// radio actually gets on air. Entries queued with a key replace an earlier
+// unsent entry of the same class and key, so a fast-changing value (one
+// target's RSSI, tracker state) costs one slot no matter how often it
+// updates. A full ring drops its oldest entry.
+
+enum MeshClass : uint8_t {
+    MESH_CONTROL,   // operator commands and their ACKs
+    MESH_ALERT,     // attack / intrusion alerts
+    MESH_HIT,       // target sightings
+    MESH_TRACKER,   // tracker updates
+    MESH_STATUS,    // status, heartbeats, command output
+    MESH_CLASS_COUNT
+};
+
+#ifndef MESH_TX_RATE_BPS
+#define MESH_TX_RATE_BPS 40     // sustained bytes/s; LoRa LongFast nets ~1 short message per 5 s
+#endif
+#ifndef MESH_TX_BURST
+#define MESH_TX_BURST 464       // two full-size messages
+#endif
+
+const size_t MESH_TX_ITEM_MAX = 232;    // largest line incl. CRLF and id, or frame
+const size_t MESH_LINE_MAX = MESH_TX_ITEM_MAX - 2 - 12;   // leaves room for " ~seq"
+
+// Text lines are tagged with a message id (see dedupe.h) as they are
+// queued: " ~seq" if the line starts with "<nodeId>: ", else " ~nodeId.seq".
+
+// Queues a text line (CRLF is appended). False if it is too long.
+bool meshSend(MeshClass cls, const String &line, const String &key = String());
+// Same with a given sequence number, so a retransmit keeps its id
+bool meshSendSeq(MeshClass cls, const String &line, uint32_t seq, const String &key = String());
+// Queues a binary frame as-is
+bool meshSendFrame(MeshClass cls, const uint8_t *frame, size_t len, const String &key = String());
+
+// A line carrying a timestamp that should not include time spent queued
+// behind the token bucket (time sync t1/t3): the MESH_STAMP_WIDTH characters
+// at stampAt are overwritten with stamp(), as zero-padded decimal, just
+// before the line is written to the radio UART.
+const size_t MESH_STAMP_WIDTH = 16;
+typedef int64_t (*MeshStampFn)();
+bool meshSendStamped(MeshClass cls, const String &line, size_t stampAt, MeshStampFn stamp,
+                     const String &key = String());
+
+// Next message sequence number; starts at a random base each boot so ids
+// from before a reboot aren't mistaken for new ones
+uint32_t meshNextSeq();
+
+void meshTxBegin();
+void meshTxSetRate(uint32_t bytesPerSec);
+uint32_t meshTxRate();
@@ -0,0 +1,154 @@
+#include "meshuart.h"
+#include "lineframer.h"
+#include "metrics.h"
+#include "network.h"
+#include "driver/uart.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+static const uart_port_t MESH_UART = UART_NUM_1;
+static const int MESH_UART_RX_BUF = 2048;
+static const int MESH_UART_TX_BUF = 1024;
+static const int MESH_UART_EVENTS = 16;
+
+static QueueHandle_t uartEvents = nullptr;
+static TaskHandle_t uartTask = nullptr;
+static uint8_t rxBuf[1024];
+static LineFramer rxFramer(rxBuf, sizeof(rxBuf), true);
+
+static Counter mUartRxBytes("antihunter_mesh_uart_rx_bytes_total", "Bytes read from the mesh UART");
+static Counter mUartOverflow("antihunter_mesh_uart_overflows_total", "Mesh UART FIFO/ring overflows and oversized lines", "Mesh UART overflows");
+
+// "NODE_1: payload" -> "payload"; lines without a sender prefix pass as-is
+static void dispatchLine(const char *line, size_t len)
+{
+    Serial.write((const uint8_t *)line, len);
+    Serial.println();
+    Serial.printf("[MESH RX] %.*s\n", (int)len, line);
+
+    const char *p = line;
+    const char *end = line + len;
+    while ((p = (const char *)memchr(p, ':', end - p)) != nullptr && p + 1 < end) {
+        if (p[1] == ' ') {
+            line = p + 2;
+            break;
+        }
+        p++;
+    }
+    String msg;
+    msg.concat(line, end - line);
+    processMeshMessage(msg);
+}
+
+static void drainFramer()
+{
+    const uint8_t *data;
+    size_t len;
+    FrameKind k;
+    while ((k = rxFramer.next(data, len)) != FRAME_NONE) {
+        if (k == FRAME_LINE) dispatchLine((const char *)data, len);
+        else if (k == FRAME_BINARY) processMeshFrame(data, len);
+        else mUartOverflow.inc();
+    }
+}
+
+// Reads everything the driver has buffered, in as few calls as the framer's
+// free space allows
+static void readBuffered()
+{
+    for (;;) {
+        size_t buffered = 0;
+        uart_get_buffered_data_len(MESH_UART, &buffered);
+        if (buffered == 0) return;
+        size_t avail;
+        uint8_t *dst = rxFramer.writeSpace(avail);
+        if (avail == 0) {
+            drainFramer();
+            continue;
+        }
+        int n = uart_read_bytes(MESH_UART, dst, buffered < avail ? buffered : avail, 0);
+        if (n <= 0) return;
+        rxFramer.commit(n);
+        mUartRxBytes.inc(n);
+        drainFramer();
+    }
+}
+
+static void meshUartTask(void *)
+{
+    uart_event_t ev;
+    for (;;) {
+        if (xQueueReceive(uartEvents, &ev, portMAX_DELAY) != pdTRUE) continue;
+        switch (ev.type) {
+        case UART_DATA:
+            readBuffered();
+            break;
+        case UART_PATTERN_DET:
+            // Positions aren't needed (the framer finds delimiters itself),
+            // but the driver's position queue must not fill up
+            while (uart_pattern_pop_pos(MESH_UART) != -1) {
+            }
+            readBuffered();
+            break;
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+            mUartOverflow.inc();
+            uart_flush_input(MESH_UART);
+            xQueueReset(uartEvents);
+            uart_pattern_queue_reset(MESH_UART, MESH_UART_EVENTS);
+            rxFramer.reset();
+            Serial.println("[MESH] UART RX overflow, resyncing");
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void meshUartBegin(int rxPin, int txPin, uint32_t baud)
+{
+    if (uart_is_driver_installed(MESH_UART)) uart_driver_delete(MESH_UART);
+
+    uart_config_t cfg = {};
+    cfg.baud_rate = baud;
+    cfg.data_bits = UART_DATA_8_BITS;
+    cfg.parity = UART_PARITY_DISABLE;
+    cfg.stop_bits = UART_STOP_BITS_1;
+    cfg.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+    cfg.source_clk = UART_SCLK_DEFAULT;
+
+    uart_driver_install(MESH_UART, MESH_UART_RX_BUF, MESH_UART_TX_BUF, MESH_UART_EVENTS, &uartEvents, 0);
+    uart_param_config(MESH_UART, &cfg);
+    uart_set_pin(MESH_UART, txPin, rxPin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    uart_enable_pattern_det_baud_intr(MESH_UART, '\n', 1, 9, 0, 0);
+    uart_pattern_queue_reset(MESH_UART, MESH_UART_EVENTS);
+    // Binary frames don't end in '\n'; they arrive on the RX timeout event
+    uart_set_rx_timeout(MESH_UART, 10);
+
+    // Clear any garbage data
+    delay(100);
+    uart_flush_input(MESH_UART);
+    xQueueReset(uartEvents);
+    rxFramer.reset();
+
+    if (!uartTask) {
+        // Lines are handled on this task, triangulation reports included:
+        // the WLS solve and particle filter update take ~3 KB of stack on
+        // top of the line parsing. The high-water mark is on /metrics.
+        xTaskCreatePinnedToCore(meshUartTask, "UARTForwardTask", 8192, nullptr, 2, &uartTask, 1);
+    }
+}
+
+size_t meshUartWritable()
+{
+    size_t n = 0;
+    uart_get_tx_buffer_free_size(MESH_UART, &n);
+    return n;
+}
+
+size_t meshUartWrite(const uint8_t *data, size_t len)
+{
+    int n = uart_write_bytes(MESH_UART, data, len);
+    return n > 0 ? n : 0;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <Arduino.h>
+
+// Mesh radio UART, driven by the ESP-IDF driver directly: an event task
+// wakes on '\n' pattern detection or RX timeout, reads whatever is buffered
+// in one call and frames it with LineFramer. Text lines go to
+// processMeshMessage(), binary frames to processMeshFrame().
+
+void meshUartBegin(int rxPin, int txPin, uint32_t baud);
+size_t meshUartWritable();
+size_t meshUartWrite(const uint8_t *data, size_t len);
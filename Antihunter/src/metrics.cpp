@@ -0,0 +1,245 @@
+#include "metrics.h"
+#include "freertos/task.h"
+
+extern TaskHandle_t workerTaskHandle;
+extern TaskHandle_t blueTeamTaskHandle;
+
+// Constant-initialized, so safe to use from other files' static constructors
+static Metric *metricsHead = nullptr;
+static Metric *metricsTail = nullptr;
+
+Metric::Metric(MetricType t, const char *n, const char *h, const char *d)
+    : type(t), name(n), help(h), diag(d)
+{
+    if (metricsTail) metricsTail->next = this;
+    else metricsHead = this;
+    metricsTail = this;
+}
+
+Metric *Metric::first()
+{
+    return metricsHead;
+}
+
+Histogram::Histogram(const char *name, const char *help, const uint32_t *b, uint8_t n, const char *diag)
+    : Metric(METRIC_HISTOGRAM, name, help, diag), bounds(b), nBounds(n > MAX_BOUNDS ? MAX_BOUNDS : n)
+{
+    for (auto &c : counts) c.store(0, std::memory_order_relaxed);
+}
+
+void Histogram::observe(uint32_t x)
+{
+    uint8_t i = 0;
+    while (i < nBounds && x > bounds[i]) i++;
+    counts[i].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sumv.fetch_add(x, std::memory_order_relaxed);
+}
+
+uint32_t Histogram::quantileBound(float q) const
+{
+    uint32_t n = count();
+    if (n == 0) return 0;
+    uint32_t want = (uint32_t)(q * n + 0.5f), acc = 0;
+    for (uint8_t i = 0; i < nBounds; i++) {
+        acc += bucket(i);
+        if (acc >= want) return bounds[i];
+    }
+    return UINT32_MAX;
+}
+
+// System gauges; everything else is registered next to the code it measures
+
+static double sampleUptime() { return millis() / 1000; }
+static double sampleHeapFree() { return ESP.getFreeHeap(); }
+static double sampleHeapMin() { return ESP.getMinFreeHeap(); }
+static double sampleHeapLargest() { return ESP.getMaxAllocHeap(); }
+static double sampleTemp() { return temperatureRead(); }
+
+static double stackFree(TaskHandle_t t) { return t ? uxTaskGetStackHighWaterMark(t) : 0; }
+static double sampleStackLoop() { return stackFree(xTaskGetHandle("loopTask")); }
+static double sampleStackAsync() { return stackFree(xTaskGetHandle("async_tcp")); }
+static double sampleStackWorker() { return stackFree(workerTaskHandle); }
+static double sampleStackBlueTeam() { return stackFree(blueTeamTaskHandle); }
+static double sampleStackMesh() { return stackFree(xTaskGetHandle("UARTForwardTask")); }
+
+static Gauge mUptime("antihunter_uptime_seconds", "Seconds since boot", nullptr, sampleUptime);
+static Gauge mHeapFree("antihunter_heap_free_bytes", "Free heap", "Heap free", sampleHeapFree);
+static Gauge mHeapMin("antihunter_heap_min_free_bytes", "Lowest free heap since boot", "Heap min free", sampleHeapMin);
+static Gauge mHeapLargest("antihunter_heap_largest_block_bytes", "Largest allocatable heap block", nullptr, sampleHeapLargest);
+static Gauge mTemp("antihunter_temperature_celsius", "Chip temperature", nullptr, sampleTemp);
+static Gauge mStackLoop("antihunter_task_stack_free_bytes{task=\"loop\"}", "Task stack high-water mark (bytes never used)", nullptr, sampleStackLoop);
+static Gauge mStackAsync("antihunter_task_stack_free_bytes{task=\"async_tcp\"}", "Task stack high-water mark (bytes never used)", "Web task stack free", sampleStackAsync);
+static Gauge mStackWorker("antihunter_task_stack_free_bytes{task=\"worker\"}", "Task stack high-water mark (bytes never used)", nullptr, sampleStackWorker);
+static Gauge mStackBlueTeam("antihunter_task_stack_free_bytes{task=\"blueteam\"}", "Task stack high-water mark (bytes never used)", nullptr, sampleStackBlueTeam);
+static Gauge mStackMesh("antihunter_task_stack_free_bytes{task=\"mesh_uart\"}", "Task stack high-water mark (bytes never used)", "Mesh task stack free", sampleStackMesh);
+
+// Rendering
+
+static size_t baseLen(const char *name)
+{
+    return strcspn(name, "{");
+}
+
+// Label body without braces, empty if none
+static String labelsOf(const char *name)
+{
+    const char *b = strchr(name, '{');
+    if (!b) return String();
+    String l(b + 1);
+    if (l.endsWith("}")) l.remove(l.length() - 1);
+    return l;
+}
+
+static bool sameBase(const Metric *a, const Metric *b)
+{
+    size_t n = baseLen(a->name);
+    return n == baseLen(b->name) && strncmp(a->name, b->name, n) == 0;
+}
+
+static Metric *metricAt(uint32_t index, bool &firstOfName)
+{
+    Metric *m = Metric::first();
+    for (uint32_t i = 0; m && i < index; i++) m = m->next;
+    firstOfName = true;
+    if (!m) return nullptr;
+    for (Metric *p = Metric::first(); p != m; p = p->next) {
+        if (sameBase(p, m)) {
+            firstOfName = false;
+            break;
+        }
+    }
+    return m;
+}
+
+static void formatValue(char *out, size_t n, double v)
+{
+    if (v == (double)(int64_t)v) snprintf(out, n, "%lld", (long long)v);
+    else snprintf(out, n, "%.3f", v);
+}
+
+static const char *typeName(MetricType t)
+{
+    return t == METRIC_COUNTER ? "counter" : t == METRIC_GAUGE ? "gauge" : "histogram";
+}
+
+// c.index is the metric, c.section the line within it:
+// 0 HELP, 1 TYPE, 2.. samples
+bool metricsNextLine(TextCursor &c)
+{
+    for (;;) {
+        bool firstOfName;
+        Metric *m = metricAt(c.index, firstOfName);
+        if (!m) return false;
+        int base = (int)baseLen(m->name);
+        uint8_t line = c.section++;
+
+        if (line < 2) {
+            if (!firstOfName) continue;
+            if (line == 0) return cursorPrintf(c, "# HELP %.*s %s\n", base, m->name, m->help);
+            return cursorPrintf(c, "# TYPE %.*s %s\n", base, m->name, typeName(m->type));
+        }
+
+        char v[24];
+        if (m->type != METRIC_HISTOGRAM) {
+            formatValue(v, sizeof(v), m->type == METRIC_COUNTER ? ((Counter *)m)->value()
+                                                                : ((Gauge *)m)->value());
+            c.index++;
+            c.section = 0;
+            return cursorPrintf(c, "%s %s\n", m->name, v);
+        }
+
+        Histogram *h = (Histogram *)m;
+        String labels = labelsOf(m->name);
+        const char *sep = labels.length() ? "," : "";
+        uint8_t b = line - 2;
+        if (b <= h->boundCount()) {
+            uint32_t acc = 0;
+            for (uint8_t i = 0; i <= b; i++) acc += h->bucket(i);
+            if (b < h->boundCount()) snprintf(v, sizeof(v), "%u", (unsigned)h->bound(b));
+            else strcpy(v, "+Inf");
+            return cursorPrintf(c, "%.*s_bucket{%s%sle=\"%s\"} %u\n", base, m->name,
+                                labels.c_str(), sep, v, (unsigned)acc);
+        }
+        const char *lb = labels.length() ? "{" : "";
+        const char *rb = labels.length() ? "}" : "";
+        if (b == h->boundCount() + 1)
+            return cursorPrintf(c, "%.*s_sum%s%s%s %u\n", base, m->name, lb, labels.c_str(), rb, (unsigned)h->sum());
+        c.index++;
+        c.section = 0;
+        return cursorPrintf(c, "%.*s_count%s%s%s %u\n", base, m->name, lb, labels.c_str(), rb, (unsigned)h->count());
+    }
+}
+
+static String boundStr(uint32_t b)
+{
+    return b == UINT32_MAX ? String("inf") : String(b);
+}
+
+void appendMetricsDiag(String &s)
+{
+    char v[24];
+    for (Metric *m = Metric::first(); m; m = m->next) {
+        if (!m->diag) continue;
+        if (m->type == METRIC_HISTOGRAM) {
+            Histogram *h = (Histogram *)m;
+            uint32_t n = h->count();
+            s += String(m->diag) + ": n=" + String(n);
+            if (n) {
+                s += " avg=" + String(h->sum() / n) + " p50<=" + boundStr(h->quantileBound(0.5f)) +
+                     " p95<=" + boundStr(h->quantileBound(0.95f));
+            }
+            s += "\n";
+            continue;
+        }
+        formatValue(v, sizeof(v), m->type == METRIC_COUNTER ? ((Counter *)m)->value()
+                                                            : ((Gauge *)m)->value());
+        s += String(m->diag) + ": " + v + "\n";
+    }
+}
+
+// antihunter_queue_drops_total{queue="mac"} -> queue_drops.mac
+static String shortName(const Metric *m)
+{
+    String n(m->name);
+    int brace = n.indexOf('{');
+    String base = brace >= 0 ? n.substring(0, brace) : n;
+    if (base.startsWith("antihunter_")) base = base.substring(11);
+    if (base.endsWith("_total")) base.remove(base.length() - 6);
+    if (brace >= 0) {
+        int q1 = n.indexOf('"', brace);
+        int q2 = q1 >= 0 ? n.indexOf('"', q1 + 1) : -1;
+        if (q2 > q1) base += "." + n.substring(q1 + 1, q2);
+    }
+    return base;
+}
+
+std::vector<String> metricsSummaryLines(const String &prefix, size_t maxLen, size_t maxLines)
+{
+    std::vector<String> lines;
+    String cur = prefix;
+    char v[24];
+    for (Metric *m = Metric::first(); m; m = m->next) {
+        String tok;
+        if (m->type == METRIC_HISTOGRAM) {
+            Histogram *h = (Histogram *)m;
+            if (!h->count()) continue;
+            tok = shortName(m) + "=" + String(h->count()) + "/" + String(h->sum() / h->count()) +
+                  "/" + boundStr(h->quantileBound(0.95f));
+        } else {
+            double x = m->type == METRIC_COUNTER ? ((Counter *)m)->value() : ((Gauge *)m)->value();
+            if (x == 0) continue;
+            formatValue(v, sizeof(v), x);
+            tok = shortName(m) + "=" + v;
+        }
+        if (cur.length() > prefix.length() && cur.length() + 1 + tok.length() > maxLen) {
+            lines.push_back(cur);
+            if (lines.size() >= maxLines) return lines;
+            cur = prefix;
+        }
+        if (cur.length() > prefix.length()) cur += " ";
+        cur += tok;
+    }
+    if (cur.length() > prefix.length()) lines.push_back(cur);
+    return lines;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include <vector>
+#include "scanner.h"
+
+enum MetricType : uint8_t { METRIC_COUNTER, METRIC_GAUGE, METRIC_HISTOGRAM };
+
+// Metrics are file-scope statics that link themselves into one registry at
+// startup; nothing is registered or freed afterwards, so readers walk the
+// list without locking. Updates are relaxed 32-bit atomics and are safe from
+// any task, the promiscuous RX callback included.
+//
+// name may carry Prometheus labels, e.g. "antihunter_queue_drops_total{queue=\"mac\"}".
+// diag, when set, is the label the metric gets on /diag.
+class Metric {
+  public:
+    Metric(MetricType type, const char *name, const char *help, const char *diag);
+
+    const MetricType type;
+    const char *const name;
+    const char *const help;
+    const char *const diag;
+    Metric *next = nullptr;
+
+    static Metric *first();
+};
+
+class Counter : public Metric {
+  public:
+    Counter(const char *name, const char *help, const char *diag = nullptr)
+        : Metric(METRIC_COUNTER, name, help, diag) {}
+    void inc(uint32_t n = 1) { v.fetch_add(n, std::memory_order_relaxed); }
+    uint32_t value() const { return v.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<uint32_t> v{0};
+};
+
+// Either set by its owner or, with a sampler, read on demand at scrape time
+class Gauge : public Metric {
+  public:
+    typedef double (*Sampler)();
+    Gauge(const char *name, const char *help, const char *diag = nullptr, Sampler fn = nullptr)
+        : Metric(METRIC_GAUGE, name, help, diag), sampler(fn) {}
+    void set(int32_t x) { v.store(x, std::memory_order_relaxed); }
+    void add(int32_t d) { v.fetch_add(d, std::memory_order_relaxed); }
+    double value() const { return sampler ? sampler() : v.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<int32_t> v{0};
+    Sampler sampler;
+};
+
+// Fixed upper bounds, ascending; observations above the last go to +Inf
+class Histogram : public Metric {
+  public:
+    static const uint8_t MAX_BOUNDS = 12;
+    Histogram(const char *name, const char *help, const uint32_t *bounds, uint8_t nBounds,
+              const char *diag = nullptr);
+    void observe(uint32_t x);
+
+    uint8_t boundCount() const { return nBounds; }
+    uint32_t bound(uint8_t i) const { return bounds[i]; }
+    uint32_t bucket(uint8_t i) const { return counts[i].load(std::memory_order_relaxed); }
+    uint32_t count() const { return total.load(std::memory_order_relaxed); }
+    uint32_t sum() const { return sumv.load(std::memory_order_relaxed); }
+    // Upper bound of the bucket holding quantile q, UINT32_MAX for +Inf
+    uint32_t quantileBound(float q) const;
+
+  private:
+    const uint32_t *bounds;
+    uint8_t nBounds;
+    std::atomic<uint32_t> counts[MAX_BOUNDS + 1];
+    std::atomic<uint32_t> total{0};
+    std::atomic<uint32_t> sumv{0};
+};
+
+// Prometheus text exposition, one line per call (LineSource for /metrics)
+bool metricsNextLine(TextCursor &c);
+// "label: value" lines for every metric that has a diag label
+void appendMetricsDiag(String &s);
+// Non-zero metrics as short name=value tokens packed into lines of at most
+// maxLen characters, each starting with prefix
+std::vector<String> metricsSummaryLines(const String &prefix, size_t maxLen, size_t maxLines);
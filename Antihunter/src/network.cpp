@@ -2,7 +2,26 @@
 #include "hardware.h"
 #include "scanner.h"
 #include "main.h"
+#include "api.h"
+#include "metrics.h"
+#include "meshproto.h"
+#include "meshtx.h"
+#include "meshuart.h"
+#include "lineframer.h"
+#include "liveevents.h"
+#include "commands.h"
+#include "dedupe.h"
+#include "reliable.h"
+#include "locate.h"
+#include "rssimodel.h"
+#include "particles.h"
+#include "nodetable.h"
+#include "radio_esp.h"
+#include "web_assets.h"
 #include <AsyncTCP.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
 #include "esp_task_wdt.h"
 
 extern "C"
@@ -15,14 +34,38 @@ extern "C"
 // Network
 AsyncWebServer *server = nullptr;
 bool meshEnabled = true;
-static unsigned long lastMeshSend = 0;
-const unsigned long MESH_SEND_INTERVAL = 3500;
 const int MAX_MESH_SIZE = 230;
+static const size_t METRICS_MESH_LINES = 3;
+static const size_t MESH_AGG_MAX = 64;             // distinct MACs per hit batch
+static const uint32_t MESH_HIT_WINDOW_MS = 10000;
+static Counter mMeshRx("antihunter_mesh_rx_total", "Mesh messages received");
+static Counter mMeshRxBad("antihunter_mesh_rx_bad_frames_total", "Binary mesh frames failing COBS/CRC/header checks");
+static Counter mMeshRxDup("antihunter_mesh_rx_duplicates_total", "Mesh messages dropped as already seen", "Mesh RX duplicates");
+static Counter mMeshRxEcho("antihunter_mesh_rx_echoes_total", "Own mesh messages heard back from the mesh and dropped");
+static const uint32_t MESH_DEDUPE_TTL_MS = 600000;        // messages with an id
+static const uint32_t MESH_DEDUPE_ANON_TTL_MS = 5000;     // id-less lines, keyed by content
+static const uint32_t MESH_PEER_WINDOW_MS = 1800000;     // peers heard this recently must ack @ALL
+static Counter mMeshCmdRetx("antihunter_mesh_cmd_retransmits_total", "Mesh commands re-sent for missing acks");
+static Counter mMeshCmdAcked("antihunter_mesh_cmd_acked_total", "Mesh commands acked by every recipient");
+static Counter mMeshCmdFailed("antihunter_mesh_cmd_failed_total", "Mesh commands given up on with acks missing", "Mesh cmd failures");
+static Counter mMeshCmdReack("antihunter_mesh_cmd_reacks_total", "Repeated mesh commands acked again instead of re-run");
+static bool meshBinary = false;   // hits go out as MP_HITS frames instead of text
+static uint32_t meshHitWindow = MESH_HIT_WINDOW_MS;   // 0 = one message per hit
 static String nodeId = "";
 
+static void flushHitBatch(bool force);
+struct MeshCmdId {
+    uint32_t key = 0;
+    String text;        // "origin.seq", echoed back in the ACK
+};
+static void handleMeshLine(const String &cleanMessage, const MeshCmdId &cmdId = MeshCmdId());
+static void processConsoleLine(const String &message);
+
 // Scanner vars
 extern volatile bool scanning;
 extern volatile int totalHits;
+extern volatile uint32_t framesSeen;
+extern volatile uint32_t bleFramesSeen;
 extern volatile bool trackerMode;
 extern std::set<String> uniqueMacs;
 
@@ -38,12 +81,38 @@ TaskHandle_t probeFloodTaskHandle = nullptr;
 extern String macFmt6(const uint8_t *m);
 extern bool parseMac6(const String &in, uint8_t out[6]);
 extern void parseChannelsCSV(const String &csv);
-
-static std::vector<TriangulationNode> triangulationNodes;
+extern bool gpsValid;
+extern bool rtcAvailable;
+extern bool rtcSynced;
+
+// Nodes reporting the target. Written by the mesh task, read by the web
+// task's report and cleared when a triangulation starts.
+static const uint32_t TRI_NODE_STALE_MS = 120000;     // silent this long: dropped from the solve and the table
+static const uint32_t TRI_EXPIRE_EVERY_MS = 1000;
+static portMUX_TYPE nodeMux = portMUX_INITIALIZER_UNLOCKED;
+static NodeTable triangulationNodes;
+static uint32_t lastNodeExpireMs = 0;
+static Counter mTriNodeEvictions("antihunter_triangulation_node_evictions_total",
+                                 "Triangulation nodes dropped for going silent or to make room");
 bool triangulationActive = false;
 static uint8_t triangulationTarget[6];
 static uint32_t triangulationStart = 0;
 static uint32_t triangulationDuration = 0;
+static bool triangulationCoordinator = false;    // we started it: publish the estimate to the mesh
+
+// Path-loss models: our own (fitted by CALIBRATE_FIT) and the ones other
+// nodes announce with "NODE: PATHLOSS:p0:n:sigma"
+static const size_t PATHLOSS_NODES = 16;
+struct NodePathLoss {
+    NodeName node;
+    PathLoss model;
+};
+static portMUX_TYPE pathLossMux = portMUX_INITIALIZER_UNLOCKED;
+static NodePathLoss pathLossTable[PATHLOSS_NODES];
+static size_t pathLossCount = 0;
+static size_t pathLossNext = 0;     // slot to reuse once the table is full
+static PathLoss ownPathLoss = PATHLOSS_DEFAULT;
+static bool ownPathLossFitted = false;
 
 
 // Triangulation 
@@ -52,58 +121,372 @@ bool isTriangulationActive() {
     return triangulationActive;
 }
 
-float rssiToDistance(int8_t rssi) {
-    return pow(10.0, (-59.0 - rssi) / (10.0 * 2.0));
+bool isTriangulationTarget(const uint8_t mac[6]) {
+    return triangulationActive && memcmp(mac, triangulationTarget, 6) == 0;
 }
 
-String calculateTriangulation() {
-    String results = "Triangulation Results\n";
-    results += "Target: " + macFmt6(triangulationTarget) + "\n";
-    results += "Duration: " + String(triangulationDuration) + "s\n";
-    results += "Nodes reporting: " + String(triangulationNodes.size()) + "\n\n";
-    
-    std::vector<TriangulationNode> gpsNodes;
-    for (const auto& node : triangulationNodes) {
-        results += node.nodeId + ": RSSI=" + String(node.rssi) + "dBm Hits=" + String(node.hitCount);
-        if (node.hasGPS) {
-            results += " GPS=" + String(node.lat, 6) + "," + String(node.lon, 6);
-            results += " Dist=" + String(rssiToDistance(node.rssi), 1) + "m";
-            gpsNodes.push_back(node);
+// Nodes that never announced a model get the default one
+static PathLoss pathLossFor(const char *node) {
+    PathLoss m = PATHLOSS_DEFAULT;
+    portENTER_CRITICAL(&pathLossMux);
+    if (nodeId == node) {
+        m = ownPathLoss;
+    } else {
+        for (size_t i = 0; i < pathLossCount; i++) {
+            if (strcmp(pathLossTable[i].node, node) == 0) {
+                m = pathLossTable[i].model;
+                break;
+            }
         }
-        results += "\n";
     }
-    
-    if (gpsNodes.size() >= 3) {
-        float x1 = gpsNodes[0].lat, y1 = gpsNodes[0].lon, r1 = rssiToDistance(gpsNodes[0].rssi);
-        float x2 = gpsNodes[1].lat, y2 = gpsNodes[1].lon, r2 = rssiToDistance(gpsNodes[1].rssi);
-        float x3 = gpsNodes[2].lat, y3 = gpsNodes[2].lon, r3 = rssiToDistance(gpsNodes[2].rssi);
-        
-        float A = 2 * (x2 - x1);
-        float B = 2 * (y2 - y1);
-        float C = pow(r1, 2) - pow(r2, 2) - pow(x1, 2) + pow(x2, 2) - pow(y1, 2) + pow(y2, 2);
-        float D = 2 * (x3 - x2);
-        float E = 2 * (y3 - y2);
-        float F = pow(r2, 2) - pow(r3, 2) - pow(x2, 2) + pow(x3, 2) - pow(y2, 2) + pow(y3, 2);
-        
-        float denominator = A * E - B * D;
-        if (abs(denominator) > 0.0001) {
-            float estLat = (C * E - F * B) / denominator;
-            float estLon = (A * F - D * C) / denominator;
-            
-            results += "\nEstimated Position:\n";
-            results += "Latitude: " + String(estLat, 6) + "\n";
-            results += "Longitude: " + String(estLon, 6) + "\n";
-            results += "Method: GPS+RSSI Trilateration\n";
+    portEXIT_CRITICAL(&pathLossMux);
+    return m;
+}
+
+// Triangulation nodes carry their model, looked up once when they are added
+static void applyNodePathLoss(const String &node, const PathLoss &m) {
+    portENTER_CRITICAL(&nodeMux);
+    int s = triangulationNodes.find(node.c_str(), node.length());
+    if (s >= 0) triangulationNodes.at(s).model = m;
+    portEXIT_CRITICAL(&nodeMux);
+}
+
+static void storePathLoss(const String &node, const PathLoss &m) {
+    if (node.length() >= RELIABLE_NODE_LEN) return;
+    portENTER_CRITICAL(&pathLossMux);
+    size_t i = 0;
+    while (i < pathLossCount && strcmp(pathLossTable[i].node, node.c_str()) != 0) i++;
+    if (i == pathLossCount) {
+        if (pathLossCount < PATHLOSS_NODES) {
+            pathLossCount++;
         } else {
-            results += "\nTrilateration failed: nodes too close/collinear\n";
+            i = pathLossNext;
+            pathLossNext = (pathLossNext + 1) % PATHLOSS_NODES;
         }
-    } else if (triangulationNodes.size() >= 3) {
-        results += "\nRSSI-only fallback (less accurate)\n";
-        results += "Need GPS coordinates for precise positioning\n";
-    } else {
-        results += "\nInsufficient nodes with GPS (" + String(triangulationNodes.size()) + "/3)\n";
+        strcpy(pathLossTable[i].node, node.c_str());
+    }
+    pathLossTable[i].model = m;
+    portEXIT_CRITICAL(&pathLossMux);
+    applyNodePathLoss(node, m);
+}
+
+static LocStatus solveTriangulation(LocFix &fix, size_t &gpsCount, const LocFix *start = nullptr) {
+    LocObs obs[LOC_MAX_OBS];
+    PathLoss models[LOC_MAX_OBS];
+    float levels[LOC_MAX_OBS];
+    gpsCount = 0;
+    portENTER_CRITICAL(&nodeMux);
+    for (int s = triangulationNodes.next(-1); s >= 0 && gpsCount < LOC_MAX_OBS; s = triangulationNodes.next(s)) {
+        const NodeStats &node = triangulationNodes.at(s);
+        if (!node.hasGPS) continue;
+        obs[gpsCount].lat = node.lat;
+        obs[gpsCount].lon = node.lon;
+        models[gpsCount] = node.model;
+        levels[gpsCount++] = node.filter.value();
+    }
+    portEXIT_CRITICAL(&nodeMux);
+    for (size_t i = 0; i < gpsCount; i++) {
+        obs[i].range = pathLossDistance(models[i], levels[i]);
+        obs[i].sigma = pathLossRangeSigma(models[i], obs[i].range);
+    }
+    return locateWls(obs, gpsCount, fix, start);
+}
+
+// Live estimate. Written by the mesh task as reports arrive, read by the
+// web and loop tasks.
+static const size_t TRACK_SIZE = 32;
+static portMUX_TYPE trackMux = portMUX_INITIALIZER_UNLOCKED;
+static LocStatus liveStatus = LOC_TOO_FEW;
+static LocFix liveFix;
+static bool liveFixValid = false;
+static size_t liveGpsCount = 0;
+static TrackPoint track[TRACK_SIZE];
+static uint32_t trackSeq = 0;
+static uint32_t trackStartSeq = 0;      // last seq before this triangulation
+static Counter mTrackUpdates("antihunter_triangulation_updates_total", "Triangulation re-solves on incoming reports");
+static Counter mTrackColdStarts("antihunter_triangulation_cold_starts_total",
+                                "Triangulation re-solves retried from the node centroid");
+
+// Particle filter over every report, for moving targets. An update takes
+// too long for a critical section, so it has its own mutex.
+static const size_t PF_MIN_NODES = 3;       // distinct GPS nodes before its estimate is published
+static std::mutex pfMutex;
+static ParticleLocator targetPf;
+static bool trackParticles = false;         // track follows the particle filter, else WLS
+static Counter mPfResamples("antihunter_particle_resamples_total", "Particle filter resampling steps");
+
+const char *trackMethodName(uint8_t method)
+{
+    return method == TRACK_PARTICLE ? "pf" : "wls";
+}
+
+bool nextTrackPointSince(uint32_t afterSeq, TrackPoint &out)
+{
+    bool found = false;
+    portENTER_CRITICAL(&trackMux);
+    uint32_t oldest = trackSeq >= TRACK_SIZE ? trackSeq - TRACK_SIZE + 1 : 1;
+    uint32_t seq = afterSeq + 1 > oldest ? afterSeq + 1 : oldest;
+    if (seq <= trackSeq) {
+        out = track[seq % TRACK_SIZE];
+        found = true;
+    }
+    portEXIT_CRITICAL(&trackMux);
+    return found;
+}
+
+static void resetTriangulation(const uint8_t mac[6], uint32_t secs, bool coordinator)
+{
+    memcpy(triangulationTarget, mac, 6);
+    portENTER_CRITICAL(&nodeMux);
+    triangulationNodes.clear();
+    portEXIT_CRITICAL(&nodeMux);
+    triangulationActive = true;
+    triangulationCoordinator = coordinator;
+    triangulationStart = millis();
+    triangulationDuration = secs;
+    portENTER_CRITICAL(&trackMux);
+    liveStatus = LOC_TOO_FEW;
+    liveFixValid = false;
+    liveGpsCount = 0;
+    trackStartSeq = trackSeq;
+    portEXIT_CRITICAL(&trackMux);
+
+    std::lock_guard<std::mutex> lock(pfMutex);
+    targetPf.configure(PfConfig(), millis() | 1);
+}
+
+// Re-solve after a report, seeded with the previous fix so it usually
+// takes 2-4 iterations. Cost is bounded by LOC_MAX_OBS x LOC_MAX_ITERS,
+// twice if the seeded solve fails. The particle filter takes the report
+// itself, O(particles).
+static void updateTriangulationEstimate(const NodeStats &node, float level)
+{
+    LocFix pfFix;
+    bool pfOk = false;
+    if (node.hasGPS) {
+        std::lock_guard<std::mutex> lock(pfMutex);
+        uint32_t before = targetPf.resamples();
+        targetPf.update(node.lat, node.lon, level, node.model, millis());
+        mPfResamples.inc(targetPf.resamples() - before);
+        pfOk = targetPf.estimate(pfFix);
+    }
+
+    portENTER_CRITICAL(&trackMux);
+    LocFix prev = liveFix;
+    bool warm = liveFixValid;
+    portEXIT_CRITICAL(&trackMux);
+
+    LocFix fix;
+    size_t gpsCount;
+    LocStatus st = solveTriangulation(fix, gpsCount, warm ? &prev : nullptr);
+    if (st == LOC_NO_CONVERGE && warm) {
+        mTrackColdStarts.inc();
+        st = solveTriangulation(fix, gpsCount);
+    }
+    mTrackUpdates.inc();
+
+    // The track follows one engine
+    const LocFix *tracked = nullptr;
+    if (trackParticles) {
+        if (pfOk && gpsCount >= PF_MIN_NODES) {
+            pfFix.used = (uint8_t)gpsCount;
+            tracked = &pfFix;
+        }
+    } else if (st == LOC_OK) {
+        tracked = &fix;
+    }
+
+    TrackPoint p = {};
+    p.ms = millis();
+    p.epoch = (uint32_t)getRTCEpoch();
+    portENTER_CRITICAL(&trackMux);
+    liveStatus = st;
+    liveGpsCount = gpsCount;
+    if (st == LOC_OK) {
+        liveFix = fix;
+        liveFixValid = true;
+    }
+    if (tracked) {
+        p.seq = ++trackSeq;
+        p.lat = tracked->lat;
+        p.lon = tracked->lon;
+        p.major = tracked->major;
+        p.minor = tracked->minor;
+        p.headingDeg = tracked->headingDeg;
+        p.rmsResidual = tracked->rmsResidual;
+        p.nodes = tracked->used;
+        p.method = trackParticles ? TRACK_PARTICLE : TRACK_WLS;
+        track[p.seq % TRACK_SIZE] = p;
+    }
+    portEXIT_CRITICAL(&trackMux);
+    if (!tracked || !triangulationCoordinator || !meshEnabled) return;
+
+    // Keyed, so a queued update is replaced rather than piling up
+    char line[MAX_MESH_SIZE];
+    snprintf(line, sizeof(line), "%s: POSITION:%s:%.7f:%.7f:%.1f:%.1f:%.0f:%u:%s", nodeId.c_str(),
+             macFmt6(triangulationTarget).c_str(), p.lat, p.lon, p.major, p.minor, p.headingDeg, (unsigned)p.nodes,
+             trackMethodName(p.method));
+    meshSend(MESH_TRACKER, line, "position");
+}
+
+// Snapshot of the live estimate, taken on the report's first line past the
+// node list (the node count on its own line) and kept in the cursor, so
+// concurrent requests each see their own
+struct TriangulationReport {
+    size_t nodeCount;
+    LocStatus status;
+    LocFix fix;
+    size_t gpsCount;
+    uint32_t trackFrom, trackTo;
+    bool pfValid;
+    LocFix pf;
+    float pfSpeed;
+    uint32_t pfUpdates;
+};
+
+static TriangulationReport &triangulationReport(TextCursor &c) {
+    if (!c.state) c.state = std::make_shared<TriangulationReport>();
+    return *static_cast<TriangulationReport *>(c.state.get());
+}
+
+
+static uint32_t wlsReportLines(const TriangulationReport &rep) {
+    switch (rep.status) {
+    case LOC_OK: return 6;
+    case LOC_TOO_FEW: return rep.nodeCount >= 3 ? 2 : 1;
+    default: return 1;
+    }
+}
+
+static bool wlsReportLine(TextCursor &c, const TriangulationReport &rep, uint32_t j) {
+    const LocFix &fix = rep.fix;
+    switch (rep.status) {
+    case LOC_OK:
+        switch (j) {
+        case 0: return cursorPrintf(c, "\nEstimated Position:\n");
+        case 1: return cursorPrintf(c, "Latitude: %.7f\n", fix.lat);
+        case 2: return cursorPrintf(c, "Longitude: %.7f\n", fix.lon);
+        case 3: return cursorPrintf(c, "Error ellipse (95%%): %.1fm x %.1fm, major axis %.0f deg\n", fix.major,
+                                    fix.minor, fix.headingDeg);
+        case 4: return cursorPrintf(c, "Residual RMS: %.1fm\n", fix.rmsResidual);
+        case 5: return cursorPrintf(c, "Method: Weighted least squares, %u GPS nodes\n", (unsigned)fix.used);
+        }
+        return false;
+    case LOC_TOO_FEW:
+        if (j == 0 && wlsReportLines(rep) == 2) {
+            return cursorPrintf(c, "\nRSSI-only fallback (less accurate)\n");
+        }
+        if (j == 1) return cursorPrintf(c, "Need GPS coordinates for precise positioning\n");
+        return j == 0 && cursorPrintf(c, "\nInsufficient nodes with GPS (%u/3)\n", (unsigned)rep.gpsCount);
+    default:
+        return j == 0 && cursorPrintf(c, "\nTrilateration failed: %s\n", locStatusName(rep.status));
+    }
+}
+
+// Streams the triangulation report one line per call, c.index is the line number
+bool triangulationNextLine(TextCursor &c) {
+    const uint32_t i = c.index++;
+    TriangulationReport &rep = triangulationReport(c);
+    if (i == 3) {
+        portENTER_CRITICAL(&nodeMux);
+        rep.nodeCount = triangulationNodes.size();
+        portEXIT_CRITICAL(&nodeMux);
+    }
+    const size_t nodeCount = rep.nodeCount;
+
+    switch (i) {
+    case 0: return cursorPrintf(c, "Triangulation Results\n");
+    case 1: return cursorPrintf(c, "Target: %s\n", macFmt6(triangulationTarget).c_str());
+    case 2: return cursorPrintf(c, "Duration: %us\n", (unsigned)triangulationDuration);
+    case 3: return cursorPrintf(c, "Nodes reporting: %u\n\n", (unsigned)nodeCount);
+    default: break;
+    }
+
+    if (i - 4 < nodeCount) {
+        // k-th node in slot order; one that expired mid-report leaves a blank line
+        NodeStats node;
+        bool found = false;
+        portENTER_CRITICAL(&nodeMux);
+        int s = triangulationNodes.next(-1);
+        for (uint32_t k = 0; s >= 0 && k < i - 4; k++) s = triangulationNodes.next(s);
+        if (s >= 0) {
+            node = triangulationNodes.at(s);
+            found = true;
+        }
+        portEXIT_CRITICAL(&nodeMux);
+        if (!found) return cursorPrintf(c, "");
+
+        uint32_t now = millis();
+        cursorPrintf(c, "%s: RSSI=%ddBm Filtered=%.1fdBm Hits=%u Rate=%.1f/min SD=%.1fdB", node.name,
+                     (int)node.rssi, node.filter.value(), (unsigned)node.hitCount, node.hitRate(),
+                     node.rssiSpread());
+        if (node.hasGPS) {
+            cursorPrintf(c, " GPS=%.6f,%.6f (%us old) Dist=%.1fm (P0=%.0f n=%.1f)", node.lat, node.lon,
+                         (unsigned)((now - node.gpsMs) / 1000), pathLossDistance(node.model, node.filter.value()),
+                         node.model.p0, node.model.n);
+        }
+        return cursorPrintf(c, "\n");
+    }
+
+    uint32_t j = i - 4 - (uint32_t)nodeCount;
+    if (j == 0) {
+        portENTER_CRITICAL(&trackMux);
+        rep.status = liveStatus;
+        rep.fix = liveFix;
+        rep.gpsCount = liveGpsCount;
+        rep.trackTo = trackSeq;
+        rep.trackFrom = trackSeq - trackStartSeq > TRACK_SIZE ? trackSeq - TRACK_SIZE : trackStartSeq;
+        portEXIT_CRITICAL(&trackMux);
+
+        std::lock_guard<std::mutex> lock(pfMutex);
+        rep.pfValid = rep.gpsCount >= PF_MIN_NODES && targetPf.estimate(rep.pf);
+        float ve, vn;
+        targetPf.velocity(ve, vn);
+        rep.pfSpeed = sqrtf(ve * ve + vn * vn);
+        rep.pfUpdates = targetPf.updates();
+    }
+
+    // Least squares, then the particle filter, then the track
+    const uint32_t wlsLines = wlsReportLines(rep);
+    if (j < wlsLines) return wlsReportLine(c, rep, j);
+    j -= wlsLines;
+    if (rep.pfValid) {
+        switch (j) {
+        case 0: return cursorPrintf(c, "\nParticle filter (%u reports):\n", (unsigned)rep.pfUpdates);
+        case 1: return cursorPrintf(c, "Position: %.7f,%.7f\n", rep.pf.lat, rep.pf.lon);
+        case 2: return cursorPrintf(c, "Spread (95%%): %.1fm x %.1fm, major axis %.0f deg, speed %.1fm/s\n",
+                                    rep.pf.major, rep.pf.minor, rep.pf.headingDeg, rep.pfSpeed);
+        }
+        j -= 3;
+    }
+    if (rep.trackTo == rep.trackFrom) return false;
+    if (j == 0) {
+        return cursorPrintf(c, "\nTrack (%u fixes):\n", (unsigned)(rep.trackTo - rep.trackFrom));
+    }
+    // Oldest first
+    TrackPoint p;
+    uint32_t seq = rep.trackFrom + j;
+    if (seq > rep.trackTo || !nextTrackPointSince(seq - 1, p) || p.seq != seq) return false;
+    if (p.epoch) cursorPrintf(c, "  %u", (unsigned)p.epoch);
+    else cursorPrintf(c, "  +%us", (unsigned)((p.ms - triangulationStart) / 1000));
+    return cursorPrintf(c, " %.7f,%.7f +/-%.0fm (%u nodes, %s)\n", p.lat, p.lon, p.major, (unsigned)p.nodes,
+                        trackMethodName(p.method));
+}
+
+bool hasTriangulationData() {
+    portENTER_CRITICAL(&nodeMux);
+    size_t n = triangulationNodes.size();
+    portEXIT_CRITICAL(&nodeMux);
+    return triangulationActive || n > 0;
+}
+
+String calculateTriangulation() {
+    TextCursor c;
+    String results;
+    while (triangulationNextLine(c)) {
+        results += c.line;
+        c.len = 0;
     }
-    
     return results;
 }
 
@@ -119,496 +502,316 @@ void initializeNetwork()
   initializeMesh();
 
   Serial.println("Starting AP...");
-  WiFi.mode(WIFI_AP);
-  WiFi.softAPConfig(IPAddress(192, 168, 4, 1), IPAddress(192, 168, 4, 1), IPAddress(255, 255, 255, 0));
-  WiFi.softAP(AP_SSID, AP_PASS, AP_CHANNEL, 0);
-  delay(500);
-  WiFi.setHostname("Antihunter");
-  delay(100);
+  initializeRadio();
+  radioSetMode(RADIO_AP);
   Serial.println("Starting web server...");
   startWebServer();
 }
 
-static const char INDEX_HTML[] PROGMEM = R"HTML(
-<!doctype html><html><head><meta charset="utf-8">
-<meta name="viewport" content="width=device-width,initial-scale=1">
-<title>Antihunter</title>
-<style>
-:root{--bg:#000;--fg:#00ff7f;--fg2:#00cc66;--accent:#0aff9d;--card:#0b0b0b;--muted:#00ff7f99;--danger:#ff4444}
-*{box-sizing:border-box} html,body{height:100%}
-body{margin:0;background:var(--bg);color:var(--fg);font-family:ui-monospace,SFMono-Regular,Menlo,Monaco,Consolas,"Liberation Mono","Courier New",monospace}
-.header{padding:22px 18px;border-bottom:1px solid #003b24;background:linear-gradient(180deg,#001a10,#000);display:flex;align-items:center;gap:14px}
-h1{margin:0;font-size:22px;letter-spacing:1px}
-h3{margin:12px 0 8px;color:var(--fg)}
-.container{max-width:1400px;margin:0 auto;padding:16px}
-.card{background:var(--card);border:1px solid #003b24;border-radius:12px;padding:16px;margin:16px 0;box-shadow:0 8px 30px rgba(0,255,127,.05)}
-label{display:block;margin:6px 0 4px;color:var(--muted);font-size:13px}
-textarea, input[type=text], input[type=number], select{width:100%;background:#000;border:1px solid #003b24;border-radius:10px;color:var(--fg);padding:10px 12px;outline:none;font-family:inherit;font-size:13px}
-textarea{min-height:128px;resize:vertical}
-select{cursor:pointer}
-select option{background:#000;color:var(--fg)}
-.btn{display:inline-block;padding:10px 14px;border-radius:10px;border:1px solid #004e2f;background:#001b12;color:var(--fg);text-decoration:none;cursor:pointer;transition:transform .05s ease, box-shadow .2s;font-size:13px}
-.btn:hover{box-shadow:0 6px 18px rgba(10,255,157,.15);transform:translateY(-1px)}
-.btn.primary{background:#002417;border-color:#00cc66}
-.btn.alt{background:#00140d;border-color:#004e2f;color:var(--accent)}
-.btn.danger{background:#330000;border-color:#ff4444;color:#ff6666}
-.row{display:flex;gap:10px;flex-wrap:wrap;align-items:center}
-.small{opacity:.65;font-size:12px} 
-pre{white-space:pre-wrap;background:#000;border:1px dashed #003b24;border-radius:10px;padding:12px;font-size:12px;line-height:1.4;overflow-x:auto}
-a{color:var(--accent)} hr{border:0;border-top:1px dashed #003b24;margin:14px 0}
-.banner{font-size:12px;color:#0aff9d;border:1px dashed #004e2f;padding:8px;border-radius:10px;background:#001108}
-.grid{display:grid;grid-template-columns:repeat(2, minmax(380px, 1fr));grid-auto-rows:minmax(200px, auto);gap:14px}
-.grid-2col{display:grid;grid-template-columns:1fr 1fr;gap:14px}
-@media(max-width:900px){.grid-2col{grid-template-columns:1fr}}
-#toast{position:fixed;right:16px;bottom:16px;display:flex;flex-direction:column;gap:8px;z-index:9999}
-.toast{background:#001d12;border:1px solid #0aff9d55;color:var(--fg);padding:10px 12px;border-radius:10px;box-shadow:0 8px 30px rgba(10,255,157,.2);opacity:0;transform:translateY(8px);transition:opacity .15s, transform .15s}
-.toast.show{opacity:1;transform:none}
-.toast .title{color:#0aff9d;font-weight:bold}
-.footer{opacity:.7;font-size:12px;padding:8px 16px;text-align:center}
-.logo{width:28px;height:28px}
-.status-bar{display:flex;gap:10px;align-items:center;margin-left:auto;font-size:12px}
-.status-item{background:#001a10;border:1px solid #003b24;padding:6px 10px;border-radius:6px}
-.status-item.active{border-color:#00cc66;background:#002417}
-.status-item.error{border-color:#ff4444;background:#330000}
-.tab-buttons{display:flex;gap:8px;margin-bottom:12px}
-.tab-btn{padding:8px 16px;background:#001b12;border:1px solid #003b24;border-radius:8px;cursor:pointer;color:var(--muted)}
-.tab-btn.active{background:#002417;border-color:#00cc66;color:var(--fg)}
-.tab-content{display:none}
-.tab-content.active{display:block}
-.stat-grid{display:grid;grid-template-columns:repeat(auto-fit, minmax(150px, 1fr));gap:10px;margin:10px 0}
-.stat-item{background:#001108;border:1px solid #003b24;padding:10px;border-radius:8px}
-.stat-label{color:var(--muted);font-size:11px;text-transform:uppercase}
-.stat-value{color:var(--fg);font-size:18px;font-weight:bold}
-.diag-section{margin:8px 0}
-.diag-label{color:var(--accent);font-weight:bold}
-.scan-controls{display:grid;grid-template-columns:2fr 1fr;gap:10px}
-</style></head><body>
-<div class="header">
-  <svg class="logo" viewBox="0 0 64 64" xmlns="http://www.w3.org/2000/svg" aria-hidden="true">
-    <rect x="6" y="6" width="52" height="52" rx="8" fill="#00180F" stroke="#00ff7f" stroke-width="2"/>
-    <path d="M16 40 L32 16 L48 40" fill="none" stroke="#0aff9d" stroke-width="3"/>
-    <circle cx="32" cy="44" r="3" fill="#00ff7f"/>
-  </svg>
-  <h1>Antihunter v5</h1>
-  <div class="status-bar">
-    <div class="status-item" id="modeStatus">WiFi</div>
-    <div class="status-item" id="scanStatus">Idle</div>
-    <div class="status-item" id="meshStatus">Mesh</div>
-    <div class="status-item" id="gpsStatus">GPS</div>
-    <div class="status-item" id="rtcStatus">RTC</div>
-  </div>
-</div>
-<div id="toast"></div>
-<div class="container">
-
-<div class="grid">
-  <div class="card">
-    <h3>Target Configuration</h3>
-    <div class="banner">Enter full MACs (<code>AA:BB:CC:DD:EE:FF</code>) or OUIs (<code>AA:BB:CC</code>), one per line.</div>
-    <form id="f" method="POST" action="/save">
-      <label for="list">Target MAC Addresses</label>
-      <textarea id="list" name="list" placeholder="AA:BB:CC:DD:EE:FF&#10;DC:A6:32&#10;# Comments allowed"></textarea>
-      <div class="row" style="margin-top:10px">
-        <button class="btn primary" type="submit">Save Targets</button>
-        <a class="btn" href="/export" data-ajax="false">Export List</a>
-        <span class="small" id="targetCount">0 targets</span>
-      </div>
-    </form>
-  </div>
-
-  <div class="card">
-    <h3>Scanning Operations</h3>
-    <form id="s" method="POST" action="/scan">
-      <div class="scan-controls">
-        <div>
-          <label>Scan Mode</label>
-          <select name="mode" id="scanMode">
-            <option value="0">WiFi Only</option>
-            <option value="1">BLE Only</option>
-            <option value="2">WiFi + BLE Combined</option>
-          </select>
-        </div>
-        <div>
-          <label>Duration (seconds)</label>
-          <input type="number" name="secs" min="0" max="86400" value="60" id="scanDuration">
-        </div>
-      </div>
-      
-      <div class="row" style="margin:10px 0">
-        <input type="checkbox" id="forever1" name="forever" value="1">
-        <label for="forever1" style="margin:0">Run Forever</label>
-      </div>
-      
-      <label>WiFi Channels</label>
-      <input type="text" name="ch" value="1,6,11" placeholder="1,6,11 or 1..14">
-      
-      <div class="row" style="margin-top:10px">
-        <input type="checkbox" id="triangulate" name="triangulate" value="1">
-        <label for="triangulate" style="margin:0">Triangulation Mode (Multi-node)</label>
-      </div>
-      
-      <div id="triangulateOptions" style="display:none;margin-top:10px">
-        <label>Target MAC for Triangulation</label>
-        <input type="text" name="targetMac" placeholder="34:21:09:83:D9:51">
-      </div>
-      
-      <div class="row" style="margin-top:12px">
-        <button class="btn primary" type="submit">Start Scan</button>
-        <!--
-        <a class="btn danger" href="/stop" data-ajax="true">Stop All</a>
-        -->
-      </div>
-    </form>
-  </div>
-
-  <div class="card">
-    <h3>Detection & Analysis</h3>
-    <form id="sniffer" method="POST" action="/sniffer">  
-      <label>Detection Method</label>
-      <select name="detection" id="detectionMode">
-        <option value="device-scan">Device Discovery (WiFi/BLE)</option>
-        <!--
-        <option value="deauth">Deauth Attack Detection</option>
-        <option value="beacon-flood">Beacon Flood Detection</option>
-        <option value="karma">Karma Attack Detection</option>
-        <option value="probe-flood">Probe Flood Detection</option>
-        <option value="ble-spam">BLE Spam Detection</option>
-        -->
-      </select>
-      
-      <div class="scan-controls" style="margin-top:10px">
-        <div>
-          <label>Duration (seconds)</label>
-          <input type="number" name="secs" min="0" max="86400" value="60">
-        </div>
-        <div>
-          <input type="checkbox" id="forever3" name="forever" value="1">
-          <label for="forever3" style="margin:0">Run Forever</label>
-        </div>
-      </div>
-      
-      <div class="row" style="margin-top:12px">
-        <button class="btn primary" type="submit">Start Detection</button>
-        <a class="btn alt" href="/sniffer-cache" data-ajax="false">View Cache</a>
-      </div>
-    </form>
-  </div>
-
-  <div class="card">
-    <h3>Node Configuration</h3>
-    <form id="nodeForm" method="POST" action="/node-id">
-      <label for="nodeId">Node Identifier</label>
-      <input type="text" id="nodeId" name="id" maxlength="16" placeholder="NODE_01">
-      <div class="row" style="margin-top:10px">
-        <button class="btn primary" type="submit">Update Node ID</button>
-      </div>
-    </form>
-    
-    <hr>
-    
-    <div class="row" style="margin-top:10px">
-      <input type="checkbox" id="meshEnabled" checked>
-      <label for="meshEnabled" style="margin:0">Enable Mesh Communications</label>
-    </div>
-    
-    <div class="row" style="margin-top:10px">
-      <a class="btn alt" href="/mesh-test" data-ajax="true">Test Mesh</a>
-      <a class="btn" href="/gps" data-ajax="false">GPS Status</a>
-      <a class="btn" href="/sd-status" data-ajax="false">SD Card</a>
-    </div>
-  </div>
-</div>
-
-<div class="card">
-  <h3>System Diagnostics</h3>
-  <div class="tab-buttons">
-    <div class="tab-btn active" onclick="switchTab('overview')">Overview</div>
-    <div class="tab-btn" onclick="switchTab('hardware')">Hardware</div>
-    <div class="tab-btn" onclick="switchTab('network')">Network</div>
-  </div>
-  
-  <div id="overview" class="tab-content active">
-    <div class="stat-grid">
-      <div class="stat-item">
-        <div class="stat-label">Uptime</div>
-        <div class="stat-value" id="uptime">--:--:--</div>
-      </div>
-      <div class="stat-item">
-        <div class="stat-label">WiFi Frames</div>
-        <div class="stat-value" id="wifiFrames">0</div>
-      </div>
-      <div class="stat-item">
-        <div class="stat-label">BLE Frames</div>
-        <div class="stat-value" id="bleFrames">0</div>
-      </div>
-      <div class="stat-item">
-        <div class="stat-label">Total Hits</div>
-        <div class="stat-value" id="totalHits">0</div>
-      </div>
-      <div class="stat-item">
-        <div class="stat-label">Unique MACs</div>
-        <div class="stat-value" id="uniqueDevices">0</div>
-      </div>
-      <div class="stat-item">
-        <div class="stat-label">Temperature</div>
-        <div class="stat-value" id="temperature">--°C</div>
-      </div>
-    </div>
-  </div>
-  
-  <div id="hardware" class="tab-content">
-    <pre id="hardwareDiag">Loading hardware info...</pre>
-  </div>
-  
-  <div id="network" class="tab-content">
-    <pre id="networkDiag">Loading network info...</pre>
-  </div>
-</div>
- 
-<div class="card">
-  <h3>Scan Results</h3>
-  <pre id="r">No scan data yet.</pre>
-</div>
-
-<div class="footer">© Team AntiHunter 2025 | Node: <span id="footerNodeId">--</span></div>
-</div>
-<script>
-let selectedMode = '0';
-
-function toast(msg){
-  const wrap = document.getElementById('toast');
-  const el = document.createElement('div');
-  el.className = 'toast';
-  el.innerHTML = '<div class="title">System</div><div class="msg">'+msg+'</div>';
-  wrap.appendChild(el);
-  requestAnimationFrame(()=>{ el.classList.add('show'); });
-  setTimeout(()=>{ el.classList.remove('show'); setTimeout(()=>wrap.removeChild(el), 200); }, 3000);
-}
-
-function switchTab(tabName) {
-  document.querySelectorAll('.tab-btn').forEach(btn => btn.classList.remove('active'));
-  document.querySelectorAll('.tab-content').forEach(content => content.classList.remove('active'));
-  
-  event.target.classList.add('active');
-  document.getElementById(tabName).classList.add('active');
-}
-
-async function ajaxForm(form, okMsg){
-  const fd = new FormData(form);
-  try{
-    const r = await fetch(form.action, {method:'POST', body:fd});
-    const t = await r.text();
-    toast(okMsg || t);
-  }catch(e){
-    toast('Error: '+e.message);
+// UI assets are gzipped at build time (scripts/embed_web.py); a matching
+// If-None-Match gets a bodiless 304
+static void sendWebAsset(AsyncWebServerRequest *r, const WebAsset &a)
+{
+  AsyncWebServerResponse *res;
+  if (r->hasHeader("If-None-Match") && r->getHeader("If-None-Match")->value() == a.etag)
+  {
+    res = r->beginResponse(304);
+  }
+  else
+  {
+    res = r->beginResponse(200, a.mime, a.data, a.len);
+    res->addHeader("Content-Encoding", "gzip");
   }
+  res->addHeader("ETag", a.etag);
+  res->addHeader("Cache-Control", a.cacheControl);
+  r->send(res);
 }
 
-async function load(){
-  try{
-    const r = await fetch('/export'); 
-    const text = await r.text();
-    document.getElementById('list').value = text;
-    const lines = text.split('\n').filter(l => l.trim() && !l.startsWith('#'));
-    document.getElementById('targetCount').innerText = lines.length + ' targets';
-    
-    const rr = await fetch('/results'); 
-    document.getElementById('r').innerText = await rr.text();
-    loadNodeId();
-  }catch(e){}
-}
-
-async function loadNodeId(){
-  try{
-    const r = await fetch('/node-id');
-    const data = await r.json();
-    document.getElementById('nodeId').value = data.nodeId;
-    document.getElementById('footerNodeId').innerText = data.nodeId;
-  }catch(e){}
-}
-
-function updateStatusIndicators(diagText) {
-  // Scan status
-  if (diagText.includes('Scanning: yes')) {
-    document.getElementById('scanStatus').innerText = 'Active';
-    document.getElementById('scanStatus').classList.add('active');
-  } else {
-    document.getElementById('scanStatus').innerText = 'Idle';
-    document.getElementById('scanStatus').classList.remove('active');
-  }
-  
-  // Mode status
-  const modeMatch = diagText.match(/Scan Mode: (\w+)/);
-  if (modeMatch) {
-    document.getElementById('modeStatus').innerText = modeMatch[1];
-  }
-  
-  // GPS status
-  if (diagText.includes('GPS: Locked')) {
-    document.getElementById('gpsStatus').classList.add('active');
-    document.getElementById('gpsStatus').innerText = 'GPS Lock';
-  } else {
-    document.getElementById('gpsStatus').classList.remove('active');
-    document.getElementById('gpsStatus').innerText = 'GPS';
-  }
-  
-  // RTC status
-  if (diagText.includes('RTC: Synced')) {
-    document.getElementById('rtcStatus').classList.add('active');
-    document.getElementById('rtcStatus').innerText = 'RTC OK';
-  } else if (diagText.includes('RTC: Not')) {
-    document.getElementById('rtcStatus').classList.remove('active');
-    document.getElementById('rtcStatus').innerText = 'RTC';
-  }
+// Chunked text response, rendered a line at a time from the cursor
+static void sendChunkedCursor(AsyncWebServerRequest *r, std::shared_ptr<TextCursor> cursor, LineSource source,
+                              const char *mime = "text/plain")
+{
+  AsyncWebServerResponse *res = r->beginChunkedResponse(mime,
+      [cursor, source](uint8_t *buf, size_t maxLen, size_t) -> size_t
+      { return streamLines(*cursor, source, buf, maxLen); });
+  res->addHeader("Cache-Control", "no-store");
+  r->send(res);
 }
 
-async function tick(){
-  try{
-    const d = await fetch('/diag'); 
-    const diagText = await d.text();
-    
-    // Parse diagnostics for different sections
-    const sections = diagText.split('\n');
-    let overview = '';
-    let hardware = '';
-    let network = '';
-    let currentSection = 'overview';
-    
-    sections.forEach(line => {
-      if (line.includes('WiFi Frames')) {
-        const match = line.match(/(\d+)/);
-        if (match) document.getElementById('wifiFrames').innerText = match[1];
-      }
-      if (line.includes('BLE Frames')) {
-        const match = line.match(/(\d+)/);
-        if (match) document.getElementById('bleFrames').innerText = match[1];
-      }
-      if (line.includes('Total hits')) {
-        const match = line.match(/(\d+)/);
-        if (match) document.getElementById('totalHits').innerText = match[1];
-      }
-      if (line.includes('Unique devices')) {
-        const match = line.match(/(\d+)/);
-        if (match) document.getElementById('uniqueDevices').innerText = match[1];
-      }
-      if (line.includes('ESP32 Temp')) {
-        const match = line.match(/([\d.]+)°C/);
-        if (match) document.getElementById('temperature').innerText = match[1] + '°C';
-      }
-      
-      // Build sections
-      if (line.includes('SD Card') || line.includes('GPS') || line.includes('RTC') || line.includes('Vibration')) {
-        hardware += line + '\n';
-      } else if (line.includes('AP IP') || line.includes('Mesh') || line.includes('WiFi Channels')) {
-        network += line + '\n';
-      } else {
-        overview += line + '\n';
-      }
-    });
-    
-    document.getElementById('hardwareDiag').innerText = hardware || 'No hardware data';
-    document.getElementById('networkDiag').innerText = network || 'No network data';
-    
-    // Update uptime
-    const uptimeMatch = diagText.match(/Up:(\d+):(\d+):(\d+)/);
-    if (uptimeMatch) {
-      document.getElementById('uptime').innerText = uptimeMatch[1] + ':' + uptimeMatch[2] + ':' + uptimeMatch[3];
+static void sendChunkedLines(AsyncWebServerRequest *r, LineSource source, const char *mime = "text/plain")
+{
+  sendChunkedCursor(r, std::make_shared<TextCursor>(), source, mime);
+}
+
+// Live events (SSE)
+//
+// Scan tasks drop hits and alerts into a small ring; the main loop drains it
+// every LIVE_FLUSH_INTERVAL and pushes one batched message per event type.
+// Clients whose queue is backed up are skipped and get a "resync" once they
+// drain, telling the UI to refetch /results instead of replaying the gap.
+
+struct LiveClient {
+    AsyncEventSourceClient *client;
+    bool lagging;
+};
+
+static const size_t LIVE_RING_SIZE = 64;
+static const unsigned long LIVE_FLUSH_INTERVAL = 200;
+static const unsigned long LIVE_STATUS_INTERVAL = 1000;
+static const int LIVE_MAX_ROUNDS = 3;
+
+static AsyncEventSource *liveEvents = nullptr;
+static LiveEvent liveRing[LIVE_RING_SIZE];
+static uint32_t liveHead = 0;
+static uint32_t liveTail = 0;
+static bool liveOverflow = false;
+static portMUX_TYPE liveMux = portMUX_INITIALIZER_UNLOCKED;
+static std::vector<LiveClient> liveClients;
+static std::recursive_mutex liveClientsMutex;
+static volatile size_t liveClientCount = 0;
+static uint32_t liveMsgId = 0;
+
+static double sampleLiveClients() { return liveClientCount; }
+
+static Gauge mLiveClients("antihunter_sse_clients", "Connected /events clients", "Live clients", sampleLiveClients);
+static Counter mLiveDrops("antihunter_live_events_dropped_total", "Live events dropped because the ring was full");
+static Counter mLiveSkipped("antihunter_live_client_skips_total", "Broadcasts skipped for a lagging /events client");
+
+static const size_t ALERT_HISTORY_SIZE = 32;
+static AlertRecord alertHistory[ALERT_HISTORY_SIZE];
+static uint32_t alertSeq = 0;
+static portMUX_TYPE alertMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void livePush(const LiveEvent &ev)
+{
+    portENTER_CRITICAL(&liveMux);
+    if (liveHead - liveTail >= LIVE_RING_SIZE) {
+        liveTail++;
+        liveOverflow = true;
+        mLiveDrops.inc();
     }
-    
-    updateStatusIndicators(diagText);
-    
-    const rr = await fetch('/results'); 
-    document.getElementById('r').innerText = await rr.text();
-  }catch(e){}
-}
-
-document.getElementById('triangulate').addEventListener('change', e=>{
-  document.getElementById('triangulateOptions').style.display = e.target.checked ? 'block' : 'none';
-});
-
-document.getElementById('f').addEventListener('submit', e=>{ 
-  e.preventDefault(); 
-  ajaxForm(e.target, 'Targets saved ✓'); 
-  setTimeout(load, 500);
-});
-
-document.getElementById('nodeForm').addEventListener('submit', e=>{
-  e.preventDefault();
-  ajaxForm(e.target, 'Node ID updated');
-  setTimeout(loadNodeId, 500);
-});
-
-document.getElementById('s').addEventListener('submit', e=>{
-  e.preventDefault();
-  const fd = new FormData(e.target);
-  fetch('/scan', {method:'POST', body:fd}).then(r=>r.text()).then(t=>toast(t))
-    .catch(err=>toast('Error: '+err.message));
-});
-
-document.getElementById('meshEnabled').addEventListener('change', e=>{
-  const enabled = e.target.checked;
-  fetch('/mesh', {method:'POST', body: new URLSearchParams({enabled: enabled})})
-    .then(r=>r.text())
-    .then(t=>{
-      toast(t);
-      document.getElementById('meshStatus').classList.toggle('active', enabled);
-    })
-    .catch(err=>toast('Error: '+err.message));
-});
-
-document.getElementById('sniffer').addEventListener('submit', e=>{
-  e.preventDefault();
-  const fd = new FormData(e.target);
-  fetch('/sniffer', {method:'POST', body:fd}).then(()=>toast('Detection started'))
-    .catch(err=>toast('Error: '+err.message));
-});
-
-document.addEventListener('click', e=>{
-  const a = e.target.closest('a[href="/stop"]');
-  if (!a) return;
-  e.preventDefault();
-  fetch('/stop').then(r=>r.text()).then(t=>toast(t));
-});
-
-document.addEventListener('click', e=>{
-  const a = e.target.closest('a[href="/mesh-test"]');
-  if (!a) return;
-  e.preventDefault();
-  fetch('/mesh-test').then(r=>r.text()).then(t=>toast('Mesh test sent'));
-});
-
-// Initialize
-load();
-setInterval(tick, 2000);
-</script>
-</body></html>
-)HTML";
+    liveRing[liveHead % LIVE_RING_SIZE] = ev;
+    liveHead++;
+    portEXIT_CRITICAL(&liveMux);
+}
+
+void pushHitEvent(const Hit &h)
+{
+    if (liveClientCount == 0) return;
+    LiveEvent ev = {};
+    ev.kind = LIVE_HIT;
+    memcpy(ev.mac, h.mac, 6);
+    ev.rssi = h.rssi;
+    ev.ch = h.ch;
+    ev.isBLE = h.isBLE;
+    strncpy(ev.text, h.name, sizeof(ev.text) - 1);
+    livePush(ev);
+}
+
+void pushAlertEvent(const char *tag, const String &text)
+{
+    AlertRecord rec = {};
+    rec.ms = millis();
+    rec.epoch = (uint32_t)getRTCEpoch();
+    strncpy(rec.tag, tag, sizeof(rec.tag) - 1);
+    strncpy(rec.text, text.c_str(), sizeof(rec.text) - 1);
+    portENTER_CRITICAL(&alertMux);
+    rec.seq = ++alertSeq;
+    alertHistory[rec.seq % ALERT_HISTORY_SIZE] = rec;
+    portEXIT_CRITICAL(&alertMux);
+
+    if (liveClientCount == 0) return;
+    LiveEvent ev = {};
+    ev.kind = LIVE_ALERT;
+    strncpy(ev.tag, tag, sizeof(ev.tag) - 1);
+    strncpy(ev.text, text.c_str(), sizeof(ev.text) - 1);
+    livePush(ev);
+}
+
+// Oldest retained alert with seq > afterSeq
+bool nextAlertSince(uint32_t afterSeq, AlertRecord &out)
+{
+    bool found = false;
+    portENTER_CRITICAL(&alertMux);
+    uint32_t oldest = alertSeq >= ALERT_HISTORY_SIZE ? alertSeq - ALERT_HISTORY_SIZE + 1 : 1;
+    uint32_t seq = afterSeq + 1 > oldest ? afterSeq + 1 : oldest;
+    if (seq <= alertSeq) {
+        out = alertHistory[seq % ALERT_HISTORY_SIZE];
+        found = true;
+    }
+    portEXIT_CRITICAL(&alertMux);
+    return found;
+}
+
+static size_t liveStatusJson(char *buf, size_t cap)
+{
+    const char *mode = (currentScanMode == SCAN_WIFI) ? "WiFi" :
+                       (currentScanMode == SCAN_BLE) ? "BLE" : "WiFi+BLE";
+    int n = snprintf(buf, cap,
+                     "{\"up\":%lu,\"scan\":%d,\"mode\":\"%s\",\"wf\":%u,\"bf\":%u,\"hits\":%d,"
+                     "\"uniq\":%u,\"temp\":%.1f,\"gps\":%d,\"rtc\":%d}",
+                     millis() / 1000, scanning ? 1 : 0, mode, (unsigned)framesSeen, (unsigned)bleFramesSeen,
+                     (int)totalHits, (unsigned)uniqueMacs.size(), temperatureRead(), gpsValid ? 1 : 0,
+                     rtcAvailable ? (rtcSynced ? 1 : 0) : -1);
+    return (n < 0 || (size_t)n >= cap) ? 0 : n;
+}
+
+static void liveBroadcast(const char *event, const char *data)
+{
+    uint32_t id = ++liveMsgId;
+    std::lock_guard<std::recursive_mutex> lock(liveClientsMutex);
+    // Index loop: a failed send can disconnect (and erase) a client under us
+    for (size_t i = 0; i < liveClients.size(); i++) {
+        AsyncEventSourceClient *client = liveClients[i].client;
+        if (!client->connected()) continue;
+        LiveSendAction action = liveSendAction(liveClients[i].lagging, client->packetsWaiting());
+        if (action == LIVE_SKIP) {
+            mLiveSkipped.inc();
+            continue;
+        }
+        if (action == LIVE_RESYNC_SEND) {
+            client->send("{}", "resync", id);
+            if (i >= liveClients.size() || liveClients[i].client != client) continue;
+        }
+        client->send(data, event, id);
+    }
+}
+
+void flushLiveEvents()
+{
+    static unsigned long lastFlush = 0;
+    static unsigned long lastStatus = 0;
+    static LiveBatch batch;
+
+    if (millis() - lastFlush < LIVE_FLUSH_INTERVAL) return;
+    lastFlush = millis();
+
+    if (liveClientCount == 0) {
+        portENTER_CRITICAL(&liveMux);
+        liveTail = liveHead;
+        liveOverflow = false;
+        portEXIT_CRITICAL(&liveMux);
+        return;
+    }
+
+    bool overflow;
+    portENTER_CRITICAL(&liveMux);
+    overflow = liveOverflow;
+    liveOverflow = false;
+    portEXIT_CRITICAL(&liveMux);
+    if (overflow) liveBroadcast("resync", "{}");
+
+    for (int round = 0; round < LIVE_MAX_ROUNDS; round++) {
+        batch.begin();
+        bool more = false;
+
+        while (true) {
+            LiveEvent ev;
+            uint32_t slot = 0;
+            bool have = false;
+            portENTER_CRITICAL(&liveMux);
+            if (liveTail != liveHead) {
+                slot = liveTail;
+                ev = liveRing[slot % LIVE_RING_SIZE];
+                have = true;
+            }
+            portEXIT_CRITICAL(&liveMux);
+            if (!have) break;
+
+            if (!batch.add(ev)) {
+                more = true;
+                break;
+            }
+
+            portENTER_CRITICAL(&liveMux);
+            // On overflow the producer already moved the tail past this slot
+            if (liveTail == slot) liveTail++;
+            portEXIT_CRITICAL(&liveMux);
+        }
+
+        if (const char *hits = batch.hitsJson()) liveBroadcast("hits", hits);
+        if (const char *alerts = batch.alertsJson()) liveBroadcast("alerts", alerts);
+        if (!more) break;
+    }
+
+    // Newest triangulation fix, once per flush however many arrived
+    static uint32_t lastTrackSeq = 0;
+    portENTER_CRITICAL(&trackMux);
+    uint32_t newest = trackSeq;
+    portEXIT_CRITICAL(&trackMux);
+    TrackPoint p;
+    if (newest != lastTrackSeq && nextTrackPointSince(newest - 1, p)) {
+        lastTrackSeq = newest;
+        char pos[224];
+        char ts[12] = "null";
+        if (p.epoch) snprintf(ts, sizeof(ts), "%u", (unsigned)p.epoch);
+        int n = snprintf(pos, sizeof(pos),
+                         "{\"seq\":%u,\"ts\":%s,\"mac\":\"%s\",\"lat\":%.7f,\"lon\":%.7f,\"maj\":%.1f,"
+                         "\"min\":%.1f,\"hdg\":%.0f,\"rms\":%.1f,\"n\":%u,\"src\":\"%s\"}",
+                         (unsigned)p.seq, ts, macFmt6(triangulationTarget).c_str(), p.lat, p.lon, p.major, p.minor,
+                         p.headingDeg, p.rmsResidual, (unsigned)p.nodes, trackMethodName(p.method));
+        if (n > 0 && (size_t)n < sizeof(pos)) liveBroadcast("position", pos);
+    }
+
+    if (millis() - lastStatus >= LIVE_STATUS_INTERVAL) {
+        lastStatus = millis();
+        char status[256];
+        if (liveStatusJson(status, sizeof(status)) > 0) liveBroadcast("status", status);
+    }
+}
+
+static void startLiveEvents()
+{
+    liveEvents = new AsyncEventSource("/events");
+    liveEvents->onConnect([](AsyncEventSourceClient *client)
+                          {
+        {
+            std::lock_guard<std::recursive_mutex> lock(liveClientsMutex);
+            liveClients.push_back({client, false});
+            liveClientCount = liveClients.size();
+        }
+        char status[256];
+        if (liveStatusJson(status, sizeof(status)) > 0) client->send(status, "status", ++liveMsgId, 2000);
+        Serial.printf("[WEB] Live client connected (%u)\n", (unsigned)liveClients.size()); });
+    liveEvents->onDisconnect([](AsyncEventSourceClient *client)
+                             {
+        std::lock_guard<std::recursive_mutex> lock(liveClientsMutex);
+        for (size_t i = 0; i < liveClients.size(); i++) {
+            if (liveClients[i].client == client) {
+                liveClients.erase(liveClients.begin() + i);
+                liveClientCount = liveClients.size();
+                break;
+            }
+        } });
+    server->addHandler(liveEvents);
+}
+
+// The server owns the handler; drop our references before it is deleted
+static void stopLiveEvents()
+{
+    std::lock_guard<std::recursive_mutex> lock(liveClientsMutex);
+    liveClients.clear();
+    liveClientCount = 0;
+    liveEvents = nullptr;
+}
 
 void startWebServer()
 {
   if (!server)
     server = new AsyncWebServer(80);
 
-  server->on("/", HTTP_GET, [](AsyncWebServerRequest *r)
-             {
-        AsyncWebServerResponse* res = r->beginResponse(200, "text/html", (const uint8_t*)INDEX_HTML, strlen_P(INDEX_HTML));
-        res->addHeader("Cache-Control", "no-store");
-        r->send(res); });
+  for (const WebAsset &asset : WEB_ASSETS)
+  {
+    const WebAsset *a = &asset;
+    server->on(a->url, HTTP_GET, [a](AsyncWebServerRequest *r)
+               { sendWebAsset(r, *a); });
+  }
 
   server->on("/export", HTTP_GET, [](AsyncWebServerRequest *r)
              { r->send(200, "text/plain", getTargetsList()); });
 
-  server->on("/results", HTTP_GET, [](AsyncWebServerRequest *r) {
-      std::lock_guard<std::mutex> lock(antihunter::lastResultsMutex);
-      String results = antihunter::lastResults.empty() ? "None yet." : String(antihunter::lastResults.c_str());
-      
-      // Add triangulation results if active
-      if (triangulationActive || triangulationNodes.size() > 0) {
-          results += "\n\n" + calculateTriangulation();
-      }
-      
-      r->send(200, "text/plain", results);
-  });
+  server->on("/results", HTTP_GET, [](AsyncWebServerRequest *r)
+             { sendChunkedLines(r, resultsNextLine); });
 
   server->on("/save", HTTP_POST, [](AsyncWebServerRequest *req)
              {
@@ -632,8 +835,15 @@ void startWebServer()
 
   server->on("/node-id", HTTP_GET, [](AsyncWebServerRequest *r)
              {
-    String j = "{\"nodeId\":\"" + getNodeId() + "\"}";
-    r->send(200, "application/json", j); });
+    String id = getNodeId();
+    char buf[96];
+    ApiWriter w((uint8_t *)buf, sizeof(buf) - 1, API_JSON);
+    w.beginMap(1);
+    w.key("nodeId");
+    w.text(id.c_str(), id.length());
+    w.endMap();
+    buf[w.overflow ? 0 : w.len] = '\0';
+    r->send(200, "application/json", buf); });
 
   server->on("/scan", HTTP_POST, [](AsyncWebServerRequest *req)
            {
@@ -669,11 +879,11 @@ void startWebServer()
                 return;
             }
             
-            triangulationNodes.clear();
-            triangulationActive = true;
-            triangulationStart = millis();
-            triangulationDuration = secs;
-            memcpy(triangulationTarget, tmp, 6);
+            if (req->hasParam("engine", true)) {
+                trackParticles = req->getParam("engine", true)->value() == "pf";
+                prefs.putBool("locPf", trackParticles);
+            }
+            resetTriangulation(tmp, secs, true);
             
             String cmd = "@ALL TRIANGULATE_START:" + targetMac + ":" + String(secs);
             sendMeshCommand(cmd);
@@ -736,7 +946,7 @@ void startWebServer()
   server->on("/stop", HTTP_GET, [](AsyncWebServerRequest *r)
              {
         stopRequested = true;
-        r->send(200, "text/plain", "Stopping… (AP will return shortly)"); });
+        r->send(200, "text/plain", "Stopping…"); });
 
   server->on("/config", HTTP_GET, [](AsyncWebServerRequest *r)
              {
@@ -750,7 +960,33 @@ void startWebServer()
 
   server->on("/mesh", HTTP_POST, [](AsyncWebServerRequest *req)
              {
-        if (req->hasParam("enabled", true)) {
+        if (req->hasParam("format", true)) {
+            meshBinary = req->getParam("format", true)->value() == "binary";
+            prefs.putBool("meshBin", meshBinary);
+            Serial.printf("[MESH] Hit format: %s\n", meshBinary ? "binary" : "text");
+            req->send(200, "text/plain", meshBinary ? "Mesh hits: binary frames" : "Mesh hits: text");
+        } else if (req->hasParam("rate", true)) {
+            uint32_t rate = req->getParam("rate", true)->value().toInt();
+            if (rate < 1 || rate > 2000) {
+                req->send(400, "text/plain", "rate must be 1-2000 bytes/s");
+                return;
+            }
+            meshTxSetRate(rate);
+            prefs.putUInt("meshRate", rate);
+            Serial.printf("[MESH] TX rate: %u B/s\n", (unsigned)rate);
+            req->send(200, "text/plain", "Mesh TX rate " + String(rate) + " B/s");
+        } else if (req->hasParam("window", true)) {
+            int secs = req->getParam("window", true)->value().toInt();
+            if (secs < 0 || secs > 300) {
+                req->send(400, "text/plain", "window must be 0-300 s");
+                return;
+            }
+            flushHitBatch(true);
+            meshHitWindow = secs * 1000;
+            prefs.putUInt("meshWin", meshHitWindow);
+            Serial.printf("[MESH] Hit batch window: %ds\n", secs);
+            req->send(200, "text/plain", secs ? "Mesh hits batched every " + String(secs) + "s" : String("Mesh hits sent individually"));
+        } else if (req->hasParam("enabled", true)) {
             meshEnabled = req->getParam("enabled", true)->value() == "true";
             Serial.printf("[MESH] %s\n", meshEnabled ? "Enabled" : "Disabled");
             req->send(200, "text/plain", meshEnabled ? "Mesh enabled" : "Mesh disabled");
@@ -762,9 +998,12 @@ void startWebServer()
              {
         char test_msg[] = "Antihunter: Test mesh notification";
         Serial.printf("[MESH] Test: %s\n", test_msg);
-        Serial1.println(test_msg);
+        meshSend(MESH_CONTROL, test_msg);
         r->send(200, "text/plain", "Test message sent to mesh"); });
 
+  server->on("/metrics", HTTP_GET, [](AsyncWebServerRequest *r)
+             { sendChunkedLines(r, metricsNextLine, "text/plain; version=0.0.4"); });
+
   server->on("/diag", HTTP_GET, [](AsyncWebServerRequest *r)
              {
         String s = getDiagnostics();
@@ -878,174 +1117,99 @@ else if (detection == "multi-ssid") {
   } });
 
   server->on("/deauth-results", HTTP_GET, [](AsyncWebServerRequest *r)
+             { sendChunkedLines(r, deauthResultsNextLine); });
+
+  server->on("/sniffer-cache", HTTP_GET, [](AsyncWebServerRequest *r)
              {
-  String results = "Deauth Detection Results\n";
-  results += "Deauth frames: " + String(deauthCount) + "\n";
-  results += "Disassoc frames: " + String(disassocCount) + "\n\n";
-  
-  int show = min((int)deauthLog.size(), 100);
-  for (int i = 0; i < show; i++) {
-    const auto &hit = deauthLog[i];
-    results += String(hit.isDisassoc ? "DISASSOC" : "DEAUTH") + " ";
-    results += macFmt6(hit.srcMac) + " -> " + macFmt6(hit.destMac);
-    results += " BSSID:" + macFmt6(hit.bssid);
-    results += " RSSI:" + String(hit.rssi) + "dBm";
-    results += " CH:" + String(hit.channel);
-    results += " Reason:" + String(hit.reasonCode) + "\n";
-  }  
-  r->send(200, "text/plain", results); });
-
-  server->on("/sniffer-cache", HTTP_GET, [](AsyncWebServerRequest *r) {
-      r->send(200, "text/plain", getSnifferCache());
-  });
+        if (!r->hasParam("since")) {
+            sendChunkedLines(r, snifferCacheNextLine);
+            return;
+        }
+        auto cursor = std::make_shared<TextCursor>();
+        cursor->index = strtoul(r->getParam("since")->value().c_str(), nullptr, 10);
+        sendChunkedCursor(r, cursor, snifferCacheDeltaNextLine); });
+
+  registerApiRoutes(server);
+  startLiveEvents();
 
   server->begin();
   Serial.println("[WEB] Server started.");
 }
 
+bool isAPActive() {
+    return radioGetMode() & RADIO_AP;
+}
+
+uint8_t getAPChannel() {
+    return radioGetAPChannel();
+}
+
+// Scans sniff alongside the AP, so this is normally a no-op; it only
+// brings the AP back if a scan had to run without it
+void ensureAPAndServer() {
+    if (!isAPActive() || !server) startAPAndServer();
+}
+
+// Drops any scan radios and brings the AP up; the web server outlives
+// radio mode changes and is only created if missing
 void startAPAndServer() {
     Serial.println("[SYS] Starting AP and web server...");
     
-    if (server) {
-        server->end();
-        delay(1000);
-        delete server;
-        server = nullptr;
-        delay(1000);
-    }
-    
-    esp_wifi_set_promiscuous(false);
-    esp_wifi_set_promiscuous_rx_cb(nullptr);
-    esp_wifi_set_promiscuous_filter(nullptr);
-    delay(500);
-    
-    WiFi.persistent(false);
-    WiFi.disconnect(true);
-    WiFi.softAPdisconnect(true);
-    delay(1000);
-    
-    esp_err_t err = esp_wifi_stop();
-    if (err != ESP_OK) {
-        // Serial.printf("[SYS] WiFi stop error: %d\n", err);
-        delay(500);
-    }
-    
-    // err = esp_wifi_deinit();
-    // if (err != ESP_OK) {
-    //     // Serial.printf("[SYS] WiFi deinit error: %d\n", err);
-    //     esp_wifi_stop();
-    //     delay(500);
-    //     esp_wifi_deinit();
-    // }
-    
-    WiFi.mode(WIFI_OFF);
-    delay(3000);
-    
-    const int MAX_RETRIES = 3;
-    bool apStarted = false;
-    
-    for (int attempt = 1; attempt <= MAX_RETRIES && !apStarted; attempt++) {
-        Serial.printf("[SYS] AP start attempt %d/%d\n", attempt, MAX_RETRIES);
-        
-        wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-        err = esp_wifi_init(&cfg);
-        if (err != ESP_OK) {
-            Serial.printf("[SYS] WiFi init failed: %d\n", err);
-            delay(2000);
-            continue;
-        }
-        
-        WiFi.mode(WIFI_AP);
-        delay(1500);
-        
-        IPAddress local_IP(192, 168, 4, 1);
-        IPAddress gateway(192, 168, 4, 1);
-        IPAddress subnet(255, 255, 255, 0);
-        
-        if (!WiFi.softAPConfig(local_IP, gateway, subnet)) {
-            Serial.println("[SYS] AP Config failed");
-            delay(1000);
-        }
-        
-        int channel = (attempt == 3) ? 11 : AP_CHANNEL;
-        apStarted = WiFi.softAP(AP_SSID, AP_PASS, channel, 0, 8);
-        
-        if (!apStarted) {
-            WiFi.mode(WIFI_OFF);
-            delay(2000);
-        }
-    }
-    
-    if (apStarted) {
-        delay(3000);
-        
-        IPAddress ip = WiFi.softAPIP();
-        for (int retries = 0; retries < 10 && ip == IPAddress(0,0,0,0); retries++) {
-            delay(500);
-            ip = WiFi.softAPIP();
-        }
-        
-        Serial.printf("[SYS] AP started successfully. IP: %s\n", ip.toString().c_str());
-        WiFi.setHostname("Antihunter");
-        delay(2000);
-        
-        server = new AsyncWebServer(80);
-        startWebServer();
-        
-    } else {
+    if (!radioSetMode(RADIO_AP)) {
         Serial.println("[CRITICAL] Cannot start ANY AP mode!");
         Serial.println("[CRITICAL] Device will restart in 5 seconds...");
         delay(5000);
         ESP.restart();
     }
+    
+    Serial.printf("[SYS] AP up on channel %u. IP: %s\n", getAPChannel(), WiFi.softAPIP().toString().c_str());
+    if (!server) startWebServer();
 }
 
 void stopAPAndServer() {
     Serial.println("[SYS] Stopping AP and web server...");
     
     if (server) {
+        stopLiveEvents();
         server->end();
-        delay(500);
         delete server;
         server = nullptr;
-        delay(500);
-    }
-    
-    esp_wifi_set_promiscuous(false);
-    esp_wifi_set_promiscuous_rx_cb(nullptr);
-    esp_wifi_set_promiscuous_filter(nullptr);
-    delay(200);
-    
-    WiFi.softAPdisconnect(true);
-    WiFi.disconnect(true);
-    delay(1000);
-    
-    esp_err_t err = esp_wifi_stop();
-    if (err != ESP_OK) {
-        Serial.printf("[SYS] WiFi stop error: %d\n", err);
-        delay(500);
-        esp_wifi_stop();
-    }
-    
-    err = esp_wifi_deinit();
-    if (err != ESP_OK) {
-        Serial.printf("[SYS] WiFi deinit error: %d\n", err);
-        delay(500);
-        esp_wifi_stop();
-        delay(200);
-        esp_wifi_deinit();
     }
-    
-    WiFi.mode(WIFI_OFF);
-    delay(2000);
-    WiFi.persistent(false);
+    radioSetMode(RADIO_OFF);
 }
 
 // Mesh UART Message Sender
-void sendMeshNotification(const Hit &hit) {
-    if (!meshEnabled || millis() - lastMeshSend < MESH_SEND_INTERVAL) return;
-    lastMeshSend = millis();
-    
+
+// Hits are folded per MAC over meshHitWindow and sent as batches; a window of
+// 0 sends every hit on its own (the original one-line-per-hit format).
+struct AggHit {
+    uint8_t mac[6];
+    int8_t last;
+    int8_t max;
+    int32_t sum;
+    uint16_t count;
+    uint8_t ch;
+    bool ble;
+    uint32_t lastMs;
+    char name[MP_NAME_MAX + 1];
+};
+
+static AggHit aggHits[MESH_AGG_MAX];
+static size_t aggCount = 0;
+static uint32_t aggStartMs = 0;
+static portMUX_TYPE aggMux = portMUX_INITIALIZER_UNLOCKED;
+
+static Counter mAggHits("antihunter_mesh_hits_aggregated_total", "Hit sightings folded into mesh batches");
+static Counter mAggBatches("antihunter_mesh_hit_batches_total", "Hit batches sent", "Mesh hit batches");
+static Counter mAggFrames("antihunter_mesh_hit_batch_frames_total", "Mesh frames/lines used by hit batches");
+static Counter mAggFull("antihunter_mesh_hit_batch_full_total", "Batches flushed early because the window table was full");
+
+static bool hasUsefulName(const char *name)
+{
+    return name[0] && strcmp(name, "WiFi") != 0 && strcmp(name, "Unknown") != 0;
+}
+
+static void sendMeshHitLine(const Hit &hit) {
     char mac_str[18];
     snprintf(mac_str, sizeof(mac_str), "%02x:%02x:%02x:%02x:%02x:%02x",
              hit.mac[0], hit.mac[1], hit.mac[2], hit.mac[3], hit.mac[4], hit.mac[5]);
@@ -1079,15 +1243,190 @@ void sendMeshNotification(const Hit &hit) {
     
     msg_len = snprintf(mesh_msg, sizeof(mesh_msg) - 1, "%s", baseMsg.c_str());
     
-    if (msg_len > 0 && msg_len < MAX_MESH_SIZE) {
+    if (msg_len > 0 && msg_len <= (int)MESH_LINE_MAX) {
         mesh_msg[msg_len] = '\0';
-        
-        delay(10);
-        if (Serial1.availableForWrite() >= msg_len + 2) {
-            Serial.printf("[MESH] %s\n", mesh_msg);
-            Serial1.println(mesh_msg);
-            Serial1.flush();
+        // A newer sighting of the same MAC replaces one still queued
+        Serial.printf("[MESH] %s\n", mesh_msg);
+        meshSend(MESH_HIT, mesh_msg, "hit:" + String(mac_str));
+    }
+}
+
+
+static bool aggAdd(const Hit &hit)
+{
+    bool added = true;
+    uint32_t now = millis();
+    portENTER_CRITICAL(&aggMux);
+    AggHit *a = nullptr;
+    for (size_t i = 0; i < aggCount; i++) {
+        if (memcmp(aggHits[i].mac, hit.mac, 6) == 0) {
+            a = &aggHits[i];
+            break;
+        }
+    }
+    if (a) {
+        a->last = hit.rssi;
+        if (hit.rssi > a->max) a->max = hit.rssi;
+        a->sum += hit.rssi;
+        if (a->count < UINT16_MAX) a->count++;
+        a->ch = hit.ch;
+        a->lastMs = now;
+        if (!a->name[0] && hasUsefulName(hit.name)) strncpy(a->name, hit.name, MP_NAME_MAX);
+    } else if (aggCount < MESH_AGG_MAX) {
+        if (aggCount == 0) aggStartMs = now;
+        a = &aggHits[aggCount++];
+        memcpy(a->mac, hit.mac, 6);
+        a->last = a->max = hit.rssi;
+        a->sum = hit.rssi;
+        a->count = 1;
+        a->ch = hit.ch;
+        a->ble = hit.isBLE;
+        a->lastMs = now;
+        a->name[0] = '\0';
+        if (hasUsefulName(hit.name)) strncpy(a->name, hit.name, MP_NAME_MAX);
+        a->name[MP_NAME_MAX] = '\0';
+    } else {
+        added = false;
+    }
+    portEXIT_CRITICAL(&aggMux);
+    return added;
+}
+
+static void sendHitBatchFrames(const std::vector<AggHit> &hits, uint32_t now, const String &key = String())
+{
+    MpBatch b = {};
+    strncpy(b.node, nodeId.c_str(), MP_NODE_MAX);
+    b.hasGps = gpsValid;
+    b.lat1e6 = (int32_t)lroundf(gpsLat * 1e6f);
+    b.lon1e6 = (int32_t)lroundf(gpsLon * 1e6f);
+    uint32_t epoch = (uint32_t)getRTCEpoch();
+    b.t0 = epoch ? epoch : now / 1000;
+
+    std::vector<MpHit> recs(hits.size());
+    for (size_t i = 0; i < hits.size(); i++) {
+        const AggHit &a = hits[i];
+        MpHit &h = recs[i];
+        memcpy(h.mac, a.mac, 6);
+        h.rssi = a.last;
+        h.ch = a.ch;
+        h.ble = a.ble;
+        uint32_t age = (now - a.lastMs) / 1000;
+        h.ageS = age > UINT16_MAX ? UINT16_MAX : age;
+        h.count = a.count;
+        h.rssiMax = a.max;
+        h.rssiMean = (int8_t)(a.sum / (int32_t)a.count);
+        memcpy(h.name, a.name, sizeof(h.name));
+    }
+
+    uint8_t frame[MP_MTU];
+    size_t off = 0;
+    while (off < recs.size()) {
+        size_t used;
+        b.seq = meshNextSeq();
+        size_t len = mpEncodeHits(b, &recs[off], recs.size() - off, frame, sizeof(frame), used);
+        if (len == 0) break;
+        meshSendFrame(MESH_HIT, frame, len, key);
+        mAggFrames.inc();
+        off += used;
+    }
+}
+
+// NODE: HITS:[ GPS=lat,lon] | mac,W|B,last,max,mean,count,ch[,name] | ...
+static void sendHitBatchLines(const std::vector<AggHit> &hits)
+{
+    String header = nodeId + ": HITS:";
+    if (gpsValid) header += " GPS=" + String(gpsLat, 6) + "," + String(gpsLon, 6);
+
+    String line = header;
+    for (const AggHit &a : hits) {
+        char rec[96];
+        int n = snprintf(rec, sizeof(rec), " | %s,%c,%d,%d,%d,%u,%u", macFmt6(a.mac).c_str(),
+                         a.ble ? 'B' : 'W', a.last, a.max, (int)(a.sum / (int32_t)a.count),
+                         (unsigned)a.count, (unsigned)a.ch);
+        if (a.name[0]) {
+            rec[n++] = ',';
+            for (const char *p = a.name; *p && n < (int)sizeof(rec) - 1; p++) {
+                if (*p >= 32 && *p <= 126 && *p != '|' && *p != ',') rec[n++] = *p;
+            }
+            rec[n] = '\0';
+        }
+        if (line.length() > header.length() && line.length() + n > MESH_LINE_MAX) {
+            meshSend(MESH_HIT, line);
+            mAggFrames.inc();
+            line = header;
+        }
+        line += rec;
+    }
+    if (line.length() > header.length()) {
+        meshSend(MESH_HIT, line);
+        mAggFrames.inc();
+    }
+}
+
+// Sends the current window if it is due (or force is set). Safe from any task.
+static void flushHitBatch(bool force)
+{
+    std::vector<AggHit> batch;
+    batch.reserve(MESH_AGG_MAX);
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&aggMux);
+    bool due = aggCount > 0 && (force || now - aggStartMs >= meshHitWindow);
+    size_t n = due ? aggCount : 0;
+    if (due) {
+        batch.resize(n);
+        memcpy(batch.data(), aggHits, n * sizeof(AggHit));
+        aggCount = 0;
+    }
+    portEXIT_CRITICAL(&aggMux);
+    if (!n) return;
+
+    // Grouping by channel lets consecutive records share it in binary form
+    std::sort(batch.begin(), batch.end(), [](const AggHit &x, const AggHit &y) {
+        return x.ch != y.ch ? x.ch < y.ch : x.last > y.last;
+    });
+    uint32_t sightings = 0;
+    for (const AggHit &a : batch) sightings += a.count;
+    mAggBatches.inc();
+    mAggHits.inc(sightings);
+    Serial.printf("[MESH] Hit batch: %u devices, %u sightings\n", (unsigned)n, (unsigned)sightings);
+
+    if (meshBinary) sendHitBatchFrames(batch, now);
+    else sendHitBatchLines(batch);
+}
+
+void flushMeshHits()
+{
+    if (meshHitWindow) flushHitBatch(false);
+}
+
+void sendMeshNotification(const Hit &hit) {
+    if (!meshEnabled) return;
+
+    if (meshHitWindow == 0) {
+        if (meshBinary) {
+            std::vector<AggHit> one(1);
+            AggHit &a = one[0];
+            memcpy(a.mac, hit.mac, 6);
+            a.last = a.max = hit.rssi;
+            a.sum = hit.rssi;
+            a.count = 1;
+            a.ch = hit.ch;
+            a.ble = hit.isBLE;
+            a.lastMs = millis();
+            a.name[0] = '\0';
+            if (hasUsefulName(hit.name)) strncpy(a.name, hit.name, MP_NAME_MAX);
+            sendHitBatchFrames(one, a.lastMs, "hit:" + macFmt6(hit.mac));
+        } else {
+            sendMeshHitLine(hit);
         }
+        return;
+    }
+
+    if (!aggAdd(hit)) {
+        mAggFull.inc();
+        flushHitBatch(true);
+        aggAdd(hit);
     }
 }
 
@@ -1111,129 +1450,44 @@ void sendTrackerMeshUpdate() {
     char tracker_msg[MAX_MESH_SIZE];
     uint32_t ago = trackerLastSeen ? (millis() - trackerLastSeen) / 1000 : 999;
 
-    int msg_len = snprintf(tracker_msg, sizeof(tracker_msg),
-                          "%s: Tracking: %s RSSI:%ddBm LastSeen:%us Pkts:%u",
-                          nodeId.c_str(), mac_str, (int)trackerRssi, ago, (unsigned)trackerPackets);
+    snprintf(tracker_msg, sizeof(tracker_msg), "%s: Tracking: %s RSSI:%ddBm LastSeen:%us Pkts:%u",
+             nodeId.c_str(), mac_str, (int)trackerRssi, ago, (unsigned)trackerPackets);
 
-    if (Serial1.availableForWrite() >= msg_len) {
-        Serial.printf("[MESH] %s\n", tracker_msg);
-        Serial1.println(tracker_msg);
-    }
+    Serial.printf("[MESH] %s\n", tracker_msg);
+    meshSend(MESH_TRACKER, tracker_msg, "tracker");
 }
 
 void initializeMesh() {
-    Serial1.end();
-    delay(100);
-  
-    Serial1.setRxBufferSize(2048);
-    Serial1.setTxBufferSize(1024);
-    Serial1.begin(115200, SERIAL_8N1, MESH_RX_PIN, MESH_TX_PIN);
-    Serial1.setTimeout(100);
-    
-    // Clear any garbage data
-    delay(100);
-    while (Serial1.available()) {
-        Serial1.read();
+    meshUartBegin(MESH_RX_PIN, MESH_TX_PIN, 115200);
+    meshBinary = prefs.getBool("meshBin", false);
+    meshTxSetRate(prefs.getUInt("meshRate", MESH_TX_RATE_BPS));
+    meshTxBegin();
+    meshHitWindow = prefs.getUInt("meshWin", MESH_HIT_WINDOW_MS);
+    trackParticles = prefs.getBool("locPf", false);
+    if (prefs.isKey("plN")) {
+        ownPathLoss.p0 = prefs.getFloat("plP0", PATHLOSS_DEFAULT.p0);
+        ownPathLoss.n = prefs.getFloat("plN", PATHLOSS_DEFAULT.n);
+        ownPathLoss.sigmaDb = prefs.getFloat("plSig", PATHLOSS_DEFAULT.sigmaDb);
+        ownPathLossFitted = true;
+        Serial.printf("[CALIBRATE] Path loss: P0=%.1f n=%.2f sigma=%.1fdB\n", ownPathLoss.p0, ownPathLoss.n,
+                      ownPathLoss.sigmaDb);
     }
     
     Serial.println("[MESH] UART initialized");
     Serial.printf("[MESH] Config: 115200 8N1 on RX=%d TX=%d\n", MESH_RX_PIN, MESH_TX_PIN);
 }
 
-void processCommand(const String &command)
+bool processCommand(const String &command)
 {
+  return dispatchCommand(command.c_str(), command.length());
+}
 
-  if (command.startsWith("CONFIG_CHANNELS:"))
-  {
-    String channels = command.substring(16);
-    parseChannelsCSV(channels);
-    Serial.printf("[MESH] Updated channels: %s\n", channels.c_str());
-    Serial1.println(nodeId + ": CONFIG_ACK:CHANNELS:" + channels);
-  }
-  else if (command.startsWith("CONFIG_TARGETS:"))
-  {
-    String targets = command.substring(15);
-    saveTargetsList(targets);
-    Serial.printf("[MESH] Updated targets list\n");
-    Serial1.println(nodeId + ": CONFIG_ACK:TARGETS:OK");
-  }
-  else if (command.startsWith("SCAN_START:"))
-  {
-    String params = command.substring(11);
-    int modeDelim = params.indexOf(':');
-    int secsDelim = params.indexOf(':', modeDelim + 1);
-    int channelDelim = params.indexOf(':', secsDelim + 1);
-
-    if (modeDelim > 0 && secsDelim > 0)
-    {
-      int mode = params.substring(0, modeDelim).toInt();
-      int secs = params.substring(modeDelim + 1, secsDelim).toInt();
-      String channels = (channelDelim > 0) ? params.substring(secsDelim + 1, channelDelim) : "1,6,11";
-      bool forever = (channelDelim > 0 && params.substring(channelDelim + 1) == "FOREVER");
-
-      if (mode >= 0 && mode <= 2)
-      {
-        currentScanMode = (ScanMode)mode;
-        parseChannelsCSV(channels);
-        stopRequested = false;
-
-        if (!workerTaskHandle)
-        {
-          xTaskCreatePinnedToCore(listScanTask, "scan", 8192,
-                                  (void *)(intptr_t)(forever ? 0 : secs), 1, &workerTaskHandle, 1);
-        }
-        Serial.printf("[MESH] Started scan via mesh command\n");
-        Serial1.println(nodeId + ": SCAN_ACK:STARTED");
-      }
-    }
-  }
-  else if (command.startsWith("TRACK_START:"))
-  {
-    String params = command.substring(12);
-    int macDelim = params.indexOf(':');
-    int modeDelim = params.indexOf(':', macDelim + 1);
-    int secsDelim = params.indexOf(':', modeDelim + 1);
-    int channelDelim = params.indexOf(':', secsDelim + 1);
-
-    if (macDelim > 0 && modeDelim > 0 && secsDelim > 0)
-    {
-      String mac = params.substring(0, macDelim);
-      int mode = params.substring(macDelim + 1, modeDelim).toInt();
-      int secs = params.substring(modeDelim + 1, secsDelim).toInt();
-      String channels = (channelDelim > 0) ? params.substring(secsDelim + 1, channelDelim) : "6";
-      bool forever = (channelDelim > 0 && params.indexOf("FOREVER", channelDelim) > 0);
-
-      uint8_t trackerMac[6];
-      if (parseMac6(mac, trackerMac) && mode >= 0 && mode <= 2)
-      {
-        setTrackerMac(trackerMac);
-        currentScanMode = (ScanMode)mode;
-        parseChannelsCSV(channels);
-        stopRequested = false;
-
-        if (!workerTaskHandle)
-        {
-          xTaskCreatePinnedToCore(trackerTask, "tracker", 8192,
-                                  (void *)(intptr_t)(forever ? 0 : secs), 1, &workerTaskHandle, 1);
-        }
-        Serial.printf("[MESH] Started tracker via mesh command for %s\n", mac.c_str());
-        Serial1.println(nodeId + ": TRACK_ACK:STARTED:" + mac);
-      }
-    }
-  }
-  else if (command.startsWith("STOP"))
-  {
-    stopRequested = true;
-    Serial.println("[MESH] Stop command received via mesh");
-    Serial1.println(nodeId + ": STOP_ACK:OK");
-  }
-  else if (command.startsWith("STATUS"))
-  {
-    // Get current status info
+static void handleStatus(ArgReader &)
+{
     float esp_temp = temperatureRead();
     float esp_temp_f = (esp_temp * 9.0 / 5.0) + 32.0;
-    String modeStr = (currentScanMode == SCAN_WIFI) ? "WiFi" : (currentScanMode == SCAN_BLE) ? "BLE"
-                                                                                             : "WiFi+BLE";
+    const char *modeStr = (currentScanMode == SCAN_WIFI) ? "WiFi" : (currentScanMode == SCAN_BLE) ? "BLE"
+                                                                                               : "WiFi+BLE";
 
     uint32_t uptime_secs = millis() / 1000;
     uint32_t uptime_mins = uptime_secs / 60;
@@ -1244,7 +1498,7 @@ void processCommand(const String &command)
     snprintf(status_msg, sizeof(status_msg),
              "%s: STATUS: Mode:%s Scan:%s Hits:%d Targets:%d Unique:%d Temp:%.1fC/%.1fF Up:%02d:%02d:%02d",
              nodeId.c_str(),
-             modeStr.c_str(),
+             modeStr,
              scanning ? "YES" : "NO",
              totalHits,
              (int)getTargetCount(),
@@ -1252,7 +1506,7 @@ void processCommand(const String &command)
              esp_temp, esp_temp_f,
              (int)uptime_hours, (int)(uptime_mins % 60), (int)(uptime_secs % 60));
 
-    Serial1.println(status_msg);
+    meshSend(MESH_STATUS, status_msg);
 
     if (trackerMode)
     {
@@ -1268,7 +1522,7 @@ void processCommand(const String &command)
                macFmt6(trackerMac).c_str(),
                (int)trackerRssi,
                (unsigned)trackerPackets);
-      Serial1.println(tracker_status);
+      meshSend(MESH_STATUS, tracker_status);
     }
     if (gpsValid)
     {
@@ -1276,47 +1530,282 @@ void processCommand(const String &command)
       snprintf(gps_status, sizeof(gps_status),
                "%s: GPS: %.6f,%.6f",
                nodeId.c_str(), gpsLat, gpsLon);
-      Serial1.println(gps_status);
+      meshSend(MESH_STATUS, gps_status);
     }
-  }
-  else if (command.startsWith("VIBRATION_STATUS"))
-  {
-    String status = lastVibrationTime > 0 ? ("Last vibration: " + String(lastVibrationTime) + "ms (" + String((millis() - lastVibrationTime) / 1000) + "s ago)") : "No vibrations detected";
-    Serial1.println(nodeId + ": VIBRATION_STATUS: " + status);
-  }
-  else if (command.startsWith("TRIANGULATE_START:"))
-  {
-    String params = command.substring(18);
-    int colonPos = params.indexOf(':');
-    String mac = params.substring(0, colonPos);
-    int duration = params.substring(colonPos + 1).toInt();
+}
 
-    if (parseMac6(mac, triangulationTarget))
+static void handleMetrics(ArgReader &)
+{
+    for (const String &line : metricsSummaryLines(nodeId + ": METRICS: ", MESH_LINE_MAX, METRICS_MESH_LINES))
     {
-      triangulationNodes.clear();
-      triangulationActive = true;
-      triangulationStart = millis();
-      triangulationDuration = duration;
+      meshSend(MESH_STATUS, line);
+    }
+}
 
-      currentScanMode = SCAN_BOTH;
-      stopRequested = false;
-      if (!workerTaskHandle)
-      {
-        xTaskCreatePinnedToCore(listScanTask, "triangulate", 8192,
-                                (void *)(intptr_t)duration, 1, &workerTaskHandle, 1);
-      }
+// TRIANGULATE_START:mac:secs
+static void handleTriangulateStart(ArgReader &args)
+{
+    uint8_t mac[6];
+    uint32_t duration;
+    if (!parseTriangulateStart(args, mac, duration)) return;
+
+    resetTriangulation(mac, duration, false);
 
-      Serial.printf("[TRIANGULATE] Started for %s (%ds)\n", mac.c_str(), duration);
-      Serial1.println(nodeId + ": TRIANGULATE_ACK:" + mac);
+    currentScanMode = SCAN_BOTH;
+    stopRequested = false;
+    if (!workerTaskHandle)
+    {
+      xTaskCreatePinnedToCore(listScanTask, "triangulate", 8192,
+                              (void *)(intptr_t)duration, 1, &workerTaskHandle, 1);
     }
-  }
+
+    String macStr = macFmt6(mac);
+    Serial.printf("[TRIANGULATE] Started for %s (%us)\n", macStr.c_str(), (unsigned)duration);
+    meshSend(MESH_CONTROL, nodeId + ": TRIANGULATE_ACK:" + macStr);
+    announcePathLoss();
 }
 
+// Path-loss calibration. The node scans for beacons at known positions
+// while it moves between a few and a few tens of metres from them; each
+// sighting pairs the RSSI with the GPS distance to the beacon. The beacon
+// MACs must be in the target list, as for triangulation.
+static const size_t CAL_BEACONS = 4;
+struct CalBeacon {
+    uint8_t mac[6];
+    double lat, lon;
+};
+static portMUX_TYPE calMux = portMUX_INITIALIZER_UNLOCKED;
+static CalBeacon calBeacons[CAL_BEACONS];
+static size_t calBeaconCount = 0;
+static PathLossFit calFit;
+
+// Called by the scan task for every target sighting, before its dedupe
+void observeCalibrationHit(const Hit &h)
+{
+    if (!gpsValid) return;
+    double lat = 0, lon = 0;
+    bool found = false;
+    portENTER_CRITICAL(&calMux);
+    for (size_t i = 0; i < calBeaconCount && !found; i++) {
+        if (memcmp(calBeacons[i].mac, h.mac, 6) == 0) {
+            lat = calBeacons[i].lat;
+            lon = calBeacons[i].lon;
+            found = true;
+        }
+    }
+    portEXIT_CRITICAL(&calMux);
+    if (!found) return;
+
+    float dist = (float)locDistance(gpsLat, gpsLon, lat, lon);
+    portENTER_CRITICAL(&calMux);
+    calFit.add(dist, h.rssi);
+    portEXIT_CRITICAL(&calMux);
+}
+
+void announcePathLoss()
+{
+    portENTER_CRITICAL(&pathLossMux);
+    PathLoss m = ownPathLoss;
+    bool fitted = ownPathLossFitted;
+    portEXIT_CRITICAL(&pathLossMux);
+    if (!fitted) return;
+    char line[MAX_MESH_SIZE];
+    snprintf(line, sizeof(line), "%s: PATHLOSS:%.1f:%.2f:%.1f", nodeId.c_str(), m.p0, m.n, m.sigmaDb);
+    meshSend(MESH_STATUS, line, "pathloss");
+}
+
+// CALIBRATE_START:mac:lat:lon[:secs]; repeat with other beacons to add them
+static void handleCalibrateStart(ArgReader &args)
+{
+    CalibrateStartArgs a;
+    if (!parseCalibrateStart(args, a)) return;
+    CalBeacon b;
+    memcpy(b.mac, a.mac, 6);
+    b.lat = a.lat;
+    b.lon = a.lon;
+    uint32_t secs = a.secs;
+
+    portENTER_CRITICAL(&calMux);
+    size_t i = 0;
+    while (i < calBeaconCount && memcmp(calBeacons[i].mac, b.mac, 6) != 0) i++;
+    bool added = i < CAL_BEACONS;
+    if (added) {
+        if (i == calBeaconCount) calBeaconCount++;
+        calBeacons[i] = b;
+    }
+    portEXIT_CRITICAL(&calMux);
+
+    String macStr = macFmt6(b.mac);
+    if (!added) {
+        Serial.printf("[CALIBRATE] Beacon table full, %s ignored\n", macStr.c_str());
+        return;
+    }
+
+    currentScanMode = SCAN_BOTH;
+    stopRequested = false;
+    if (!workerTaskHandle)
+    {
+      xTaskCreatePinnedToCore(listScanTask, "calibrate", 8192,
+                              (void *)(intptr_t)secs, 1, &workerTaskHandle, 1);
+    }
+    Serial.printf("[CALIBRATE] Beacon %s at %.6f,%.6f (%us)\n", macStr.c_str(), b.lat, b.lon, (unsigned)secs);
+    meshSend(MESH_CONTROL, nodeId + ": CALIBRATE_ACK:" + macStr);
+}
+
+static void endCalibration()
+{
+    portENTER_CRITICAL(&calMux);
+    calBeaconCount = 0;
+    calFit.clear();
+    portEXIT_CRITICAL(&calMux);
+}
+
+// CALIBRATE_FIT: solve, keep the model and announce it
+static void handleCalibrateFit(ArgReader &)
+{
+    PathLoss m;
+    portENTER_CRITICAL(&calMux);
+    size_t samples = calFit.count();
+    bool ok = calFit.solve(m);
+    portEXIT_CRITICAL(&calMux);
+
+    if (!ok) {
+        Serial.printf("[CALIBRATE] Fit failed with %u samples (need %u over a 2x range of distances)\n",
+                      (unsigned)samples, (unsigned)PATHLOSS_FIT_MIN_SAMPLES);
+        meshSend(MESH_CONTROL, nodeId + ": CALIBRATE_FAIL:" + String((unsigned)samples));
+        return;
+    }
+    endCalibration();
+    portENTER_CRITICAL(&pathLossMux);
+    ownPathLoss = m;
+    ownPathLossFitted = true;
+    portEXIT_CRITICAL(&pathLossMux);
+    applyNodePathLoss(nodeId, m);
+    prefs.putFloat("plP0", m.p0);
+    prefs.putFloat("plN", m.n);
+    prefs.putFloat("plSig", m.sigmaDb);
+
+    Serial.printf("[CALIBRATE] P0=%.1f n=%.2f sigma=%.1fdB from %u samples\n", m.p0, m.n, m.sigmaDb,
+                  (unsigned)samples);
+    announcePathLoss();
+}
+
+// CALIBRATE_CLEAR: back to the default model
+static void handleCalibrateClear(ArgReader &)
+{
+    endCalibration();
+    portENTER_CRITICAL(&pathLossMux);
+    ownPathLoss = PATHLOSS_DEFAULT;
+    ownPathLossFitted = false;
+    portEXIT_CRITICAL(&pathLossMux);
+    applyNodePathLoss(nodeId, PATHLOSS_DEFAULT);
+    prefs.remove("plP0");
+    prefs.remove("plN");
+    prefs.remove("plSig");
+    Serial.println("[CALIBRATE] Path loss reset to default");
+    meshSend(MESH_STATUS, nodeId + ": PATHLOSS:default");
+}
+
+// "PATHLOSS:p0:n:sigma" or "PATHLOSS:default" from node
+static void handlePathLossLine(const String &node, const String &content)
+{
+    ArgReader args(content.c_str() + 9, content.length() - 9);
+    PathLoss m = PATHLOSS_DEFAULT;
+    double p0, n, sigma;
+    if (!args.readFlag("default")) {
+        if (!args.readDouble(p0) || !args.readDouble(n) || !args.readDouble(sigma)) return;
+        if (n < 1.0 || n > 8.0 || p0 < -120 || p0 > 0 || sigma <= 0) return;
+        m.p0 = (float)p0;
+        m.n = (float)n;
+        m.sigmaDb = (float)sigma;
+    }
+    storePathLoss(node, m);
+    Serial.printf("[MESH] %s path loss: P0=%.1f n=%.2f\n", node.c_str(), m.p0, m.n);
+}
+
+static Command cmdStatus("STATUS", handleStatus);
+static Command cmdMetrics("METRICS", handleMetrics);
+static Command cmdTriangulateStart("TRIANGULATE_START", handleTriangulateStart, true);
+static Command cmdCalibrateStart("CALIBRATE_START", handleCalibrateStart, true);
+static Command cmdCalibrateFit("CALIBRATE_FIT", handleCalibrateFit);
+static Command cmdCalibrateClear("CALIBRATE_CLEAR", handleCalibrateClear);
+
+// Commands we sent, waiting on acks; shared by the web, loop and mesh UART tasks
+static portMUX_TYPE cmdMux = portMUX_INITIALIZER_UNLOCKED;
+static ReliableSender cmdSender;
+static PeerTable meshPeers;
+
 void sendMeshCommand(const String &command)
   {
-    if (meshEnabled && Serial1.availableForWrite() >= command.length()) {
-        Serial.printf("[MESH] Sending command: %s\n", command.c_str());
-        Serial1.println(command);
+    if (!meshEnabled) return;
+    uint32_t seq = meshNextSeq();
+    Serial.printf("[MESH] Sending command: %s (%u)\n", command.c_str(), (unsigned)seq);
+    meshSendSeq(MESH_CONTROL, command, seq, "cmd" + String(seq));
+
+    // @ALL waits on every node heard lately, @NODE on that node
+    NodeName dests[RELIABLE_DESTS];
+    size_t n = 0;
+    int sp = command.indexOf(' ');
+    if (command.startsWith("@") && sp > 1) {
+        String target = command.substring(1, sp);
+        if (target == "ALL") {
+            portENTER_CRITICAL(&cmdMux);
+            n = meshPeers.collect(dests, RELIABLE_DESTS, millis(), MESH_PEER_WINDOW_MS);
+            portEXIT_CRITICAL(&cmdMux);
+        } else if (target.length() < RELIABLE_NODE_LEN) {
+            strcpy(dests[0], target.c_str());
+            n = 1;
+        }
+    }
+    portENTER_CRITICAL(&cmdMux);
+    bool tracked = cmdSender.add(seq, command.c_str(), command.length(), dests, n, millis());
+    portEXIT_CRITICAL(&cmdMux);
+    if (!tracked) {
+        Serial.printf("[MESH] Command %u sent once, not tracked (%s)\n", (unsigned)seq,
+                      n ? "too many in flight" : "no known recipients");
+    }
+}
+
+void pollMeshCommands()
+{
+    static ReliableEvent events[2];
+    portENTER_CRITICAL(&cmdMux);
+    size_t n = cmdSender.poll(millis(), events, 2);
+    portEXIT_CRITICAL(&cmdMux);
+
+    for (size_t i = 0; i < n; i++) {
+        const ReliableEvent &e = events[i];
+        if (e.expired) {
+            mMeshCmdFailed.inc();
+            Serial.printf("[MESH] Command %u gave up after %u sends, %u/%u acked, missing: %s\n", (unsigned)e.seq,
+                          e.attempt, e.acked, e.total, e.missing);
+            continue;
+        }
+        mMeshCmdRetx.inc();
+        Serial.printf("[MESH] Resending command %u (send %u, %u/%u acked)\n", (unsigned)e.seq, e.attempt, e.acked,
+                      e.total);
+        String line;
+        line.concat(e.line, e.len);
+        meshSendSeq(MESH_CONTROL, line, e.seq, "cmd" + String(e.seq));
+    }
+}
+
+// "ACK:<origin>.<seq>" from node; only acks for our own commands matter
+static void handleCommandAck(const String &node, const String &id)
+{
+    int dot = id.lastIndexOf('.');
+    if (dot <= 0 || id.substring(0, dot) != nodeId) return;
+    uint32_t seq = strtoul(id.c_str() + dot + 1, nullptr, 10);
+
+    portENTER_CRITICAL(&cmdMux);
+    AckResult r = cmdSender.ack(seq, node.c_str(), node.length());
+    portEXIT_CRITICAL(&cmdMux);
+
+    if (r == ACK_COMPLETE) {
+        mMeshCmdAcked.inc();
+        Serial.printf("[MESH] Command %u acked by all recipients\n", (unsigned)seq);
+    } else if (r == ACK_RECORDED) {
+        Serial.printf("[MESH] Command %u acked by %s\n", (unsigned)seq, node.c_str());
     }
 }
 
@@ -1330,17 +1819,243 @@ String getNodeId() {
     return nodeId;
 }
 
-void processMeshMessage(const String &message) {
-    if (message.length() == 0 || message.length() > MAX_MESH_SIZE) return;
-    
+// One target report from another node, from either framing. level is the
+// mean RSSI over the report's batch window (the single reading if unbatched).
+static void recordTriangulationHit(const char *sendingNode, size_t nodeLen, int rssi, float level, bool hasGPS,
+                                   double lat, double lon)
+{
+    uint32_t now = millis();
+    // A new node's model is looked up outside the critical section
+    PathLoss model = PATHLOSS_DEFAULT;
+    portENTER_CRITICAL(&nodeMux);
+    bool known = triangulationNodes.find(sendingNode, nodeLen) >= 0;
+    portEXIT_CRITICAL(&nodeMux);
+    if (!known && nodeLen < sizeof(NodeName)) {
+        NodeName name;
+        memcpy(name, sendingNode, nodeLen);
+        name[nodeLen] = 0;
+        model = pathLossFor(name);
+    }
+
+    NodeStats node;
+    size_t expired = 0;
+    portENTER_CRITICAL(&nodeMux);
+    uint32_t evictedBefore = triangulationNodes.evictions();
+    if (now - lastNodeExpireMs >= TRI_EXPIRE_EVERY_MS) {
+        expired = triangulationNodes.expire(now, TRI_NODE_STALE_MS);
+        lastNodeExpireMs = now;
+    }
+    int s = triangulationNodes.intern(sendingNode, nodeLen, now);
+    if (s >= 0) {
+        NodeStats &e = triangulationNodes.at(s);
+        if (e.hitCount == 0) e.model = model;
+        e.record(rssi, level, now);
+        if (hasGPS) e.setPosition(lat, lon, now);
+        node = e;
+    }
+    uint32_t evicted = triangulationNodes.evictions() - evictedBefore;
+    portEXIT_CRITICAL(&nodeMux);
+
+    mTriNodeEvictions.inc(evicted);
+    if (expired) Serial.printf("[TRIANGULATE] Dropped %u silent node(s)\n", (unsigned)expired);
+    if (s >= 0) updateTriangulationEstimate(node, level);
+}
+
+// "HITS:[ GPS=lat,lon] | mac,W,last,max,mean,count,ch[,name] | ..."
+static void recordTriangulationBatchLine(const String &sendingNode, const String &content)
+{
+    double lat = 0, lon = 0;
+    bool hasGPS = false;
+    int gpsIdx = content.indexOf("GPS=");
+    int firstRec = content.indexOf(" | ");
+    if (gpsIdx > 0 && (firstRec < 0 || gpsIdx < firstRec)) {
+        int commaIdx = content.indexOf(',', gpsIdx);
+        if (commaIdx > 0) {
+            lat = content.substring(gpsIdx + 4, commaIdx).toDouble();
+            lon = content.substring(commaIdx + 1).toDouble();
+            hasGPS = true;
+        }
+    }
+    for (int pos = firstRec; pos >= 0; pos = content.indexOf(" | ", pos + 3)) {
+        int macEnd = content.indexOf(',', pos + 3);
+        if (macEnd < 0) break;
+        uint8_t mac[6];
+        if (!parseMac6(content.substring(pos + 3, macEnd), mac) || memcmp(mac, triangulationTarget, 6) != 0) continue;
+        int rssiStart = content.indexOf(',', macEnd + 1);
+        int maxStart = rssiStart < 0 ? -1 : content.indexOf(',', rssiStart + 1);
+        int meanStart = maxStart < 0 ? -1 : content.indexOf(',', maxStart + 1);
+        if (meanStart < 0) break;
+        recordTriangulationHit(sendingNode.c_str(), sendingNode.length(), content.substring(rssiStart + 1).toInt(),
+                               content.substring(meanStart + 1).toInt(), hasGPS, lat, lon);
+    }
+}
+
+// Only called from the mesh UART task, so no locking
+static DedupeCache meshSeen;
+// Commands we ran and acked. Kept apart from meshSeen so hit traffic can't
+// evict them before the sender's last retransmit.
+static DedupeCache meshAcked;
+
+static void ackCommand(const MeshCmdId &id)
+{
+    meshAcked.seen(id.key, millis(), MESH_DEDUPE_TTL_MS);
+    meshSend(MESH_CONTROL, nodeId + ": ACK:" + id.text, "ack" + id.text);
+}
+
+static bool addressedToUs(const char *line, size_t len)
+{
+    if (len < 2 || line[0] != '@') return false;
+    const char *sp = (const char *)memchr(line, ' ', len);
+    if (!sp) return false;
+    size_t n = sp - line - 1;
+    return (n == 3 && memcmp(line + 1, "ALL", 3) == 0) ||
+           (n == nodeId.length() && memcmp(line + 1, nodeId.c_str(), n) == 0);
+}
+
+static String cleanMeshText(const String &message)
+{
     String cleanMessage = "";
+    if (message.length() == 0 || message.length() > MAX_MESH_SIZE) return cleanMessage;
     for (size_t i = 0; i < message.length(); i++) {
         char c = message[i];
         if (c >= 32 && c <= 126) cleanMessage += c;
     }
-    if (cleanMessage.length() == 0) return;
+    return cleanMessage;
+}
+
+// Strips the message id and applies the receive rules: our own messages
+// heard back through relays are dropped, as is anything already seen.
+// Nothing is ever re-sent from here; relaying is the radio's job. A repeat
+// of a command we already acked is acked again but not passed on; cmdId is
+// set for a new one so the caller can ack it once it has run.
+static bool acceptMeshMessage(String &msg, MeshCmdId &cmdId)
+{
+    const char *line = msg.c_str();
+    size_t len = msg.length();
+    const char *origin = nullptr;
+    size_t originLen = 0;
+    uint32_t seq = 0;
+    bool hasId = splitMessageId(line, len, origin, originLen, seq);
+    bool speaker = false;   // origin is the "NODE: " prefix
+    if (!origin) {
+        const char *sep = strstr(line, ": ");
+        if (sep && (size_t)(sep - line) < len && memchr(line, ' ', sep - line) == nullptr) {
+            origin = line;
+            originLen = sep - line;
+            speaker = true;
+        }
+    }
+
+    if (origin && originLen == nodeId.length() && memcmp(origin, nodeId.c_str(), originLen) == 0) {
+        mMeshRxEcho.inc();
+        return false;
+    }
+    // Only nodes that tag their messages know to ack commands
+    if (hasId && speaker) {
+        portENTER_CRITICAL(&cmdMux);
+        meshPeers.note(origin, originLen, millis());
+        portEXIT_CRITICAL(&cmdMux);
+    }
+    if (hasId && origin && addressedToUs(line, len)) {
+        cmdId.key = dedupeKey(origin, originLen, seq);
+        cmdId.text = "";
+        cmdId.text.concat(origin, originLen);
+        cmdId.text += "." + String(seq);
+        if (meshAcked.contains(cmdId.key, millis(), MESH_DEDUPE_TTL_MS)) {
+            mMeshCmdReack.inc();
+            Serial.printf("[MESH] Repeated command %s, acking again\n", cmdId.text.c_str());
+            ackCommand(cmdId);
+            return false;
+        }
+    }
+    bool dup = hasId && origin ? meshSeen.seen(dedupeKey(origin, originLen, seq), millis(), MESH_DEDUPE_TTL_MS)
+                               : meshSeen.seen(dedupeContentKey(line, len), millis(), MESH_DEDUPE_ANON_TTL_MS);
+    if (dup) {
+        mMeshRxDup.inc();
+        Serial.printf("[MESH] Duplicate dropped: '%s'\n", msg.c_str());
+        return false;
+    }
+    if (len != msg.length()) msg.remove(len);
+    return true;
+}
+
+// Binary frame from the mesh UART (delimiters already stripped)
+void processMeshFrame(const uint8_t *data, size_t len)
+{
+    MpFrame f;
+    if (!mpDecodeFrame(data, len, f)) {
+        mMeshRxBad.inc();
+        Serial.printf("[MESH] Dropped bad binary frame (%u bytes)\n", (unsigned)len);
+        return;
+    }
+    if (nodeId == f.node) {
+        mMeshRxEcho.inc();
+        return;
+    }
+    portENTER_CRITICAL(&cmdMux);
+    meshPeers.note(f.node, strlen(f.node), millis());
+    portEXIT_CRITICAL(&cmdMux);
+    if (meshSeen.seen(dedupeKey(f.node, strlen(f.node), f.seq), millis(), MESH_DEDUPE_TTL_MS)) {
+        mMeshRxDup.inc();
+        return;
+    }
+    if (f.type == MP_TEXT) {
+        char text[MAX_MESH_SIZE + 1];
+        mpReadText(f, text, sizeof(text));
+        String line = cleanMeshText(String(text));
+        if (line.length()) handleMeshLine(line);
+        return;
+    }
+    mMeshRx.inc();
+    if (f.type != MP_HITS) return;
+
+    MpHitReader hr;
+    if (!mpBeginHits(f, hr)) {
+        mMeshRxBad.inc();
+        return;
+    }
+    MpHit h;
+    while (mpNextHit(hr, h)) {
+        Serial.printf("[MESH] %s: Target: %s %s RSSI:%d\n", hr.batch.node, h.ble ? "BLE" : "WiFi",
+                      macFmt6(h.mac).c_str(), h.rssi);
+        if (triangulationActive && memcmp(h.mac, triangulationTarget, 6) == 0) {
+            recordTriangulationHit(hr.batch.node, strlen(hr.batch.node), h.rssi, h.rssiMean, hr.batch.hasGps,
+                                   hr.batch.lat1e6 / 1e6, hr.batch.lon1e6 / 1e6);
+        }
+    }
+}
+
+void processMeshMessage(const String &message) {
+    String cleanMessage = cleanMeshText(message);
+    MeshCmdId cmdId;
+    if (cleanMessage.length() == 0 || !acceptMeshMessage(cleanMessage, cmdId)) return;
+    handleMeshLine(cleanMessage, cmdId);
+}
+
+// Console input skips the duplicate check: repeating a command there is deliberate
+static void processConsoleLine(const String &message) {
+    String cleanMessage = cleanMeshText(message);
+    if (cleanMessage.length()) handleMeshLine(cleanMessage);
+}
+
+static void handleMeshLine(const String &cleanMessage, const MeshCmdId &cmdId) {
+    mMeshRx.inc();
     
     Serial.printf("[MESH] Processing message: '%s'\n", cleanMessage.c_str());
+
+    int ackColon = cleanMessage.indexOf(':');
+    if (ackColon > 0 && cleanMessage.startsWith(" ACK:", ackColon + 1)) {
+        handleCommandAck(cleanMessage.substring(0, ackColon), cleanMessage.substring(ackColon + 6));
+        return;
+    }
+    if (ackColon > 0 && cleanMessage.startsWith(" TSYNC", ackColon + 1) &&
+        handleTimeSyncLine(cleanMessage.substring(0, ackColon), cleanMessage.substring(ackColon + 2))) {
+        return;
+    }
+    if (ackColon > 0 && cleanMessage.startsWith(" PATHLOSS:", ackColon + 1)) {
+        handlePathLossLine(cleanMessage.substring(0, ackColon), cleanMessage.substring(ackColon + 2));
+        return;
+    }
     
     // Triangulation data collection
     int colonPos = cleanMessage.indexOf(':');
@@ -1348,7 +2063,9 @@ void processMeshMessage(const String &message) {
         String sendingNode = cleanMessage.substring(0, colonPos);
         String content = cleanMessage.substring(colonPos + 2);
         
-        if (content.startsWith("Target:")) {
+        if (content.startsWith("HITS:")) {
+            recordTriangulationBatchLine(sendingNode, content);
+        } else if (content.startsWith("Target:")) {
             int macStart = content.indexOf(' ', 8) + 1;
             int macEnd = content.indexOf(' ', macStart);
             if (macEnd > macStart) {
@@ -1361,38 +2078,22 @@ void processMeshMessage(const String &message) {
                         if (rssiEnd < 0) rssiEnd = content.length();
                         int rssi = content.substring(rssiIdx + 5, rssiEnd).toInt();
                         
-                        float lat = 0, lon = 0;
+                        double lat = 0, lon = 0;
                         bool hasGPS = false;
                         int gpsIdx = content.indexOf("GPS=");
                         if (gpsIdx > 0) {
                             int commaIdx = content.indexOf(',', gpsIdx);
                             if (commaIdx > 0) {
-                                lat = content.substring(gpsIdx + 4, commaIdx).toFloat();
+                                lat = content.substring(gpsIdx + 4, commaIdx).toDouble();
                                 int gpsEnd = content.indexOf(' ', commaIdx);
                                 if (gpsEnd < 0) gpsEnd = content.length();
-                                lon = content.substring(commaIdx + 1, gpsEnd).toFloat();
+                                lon = content.substring(commaIdx + 1, gpsEnd).toDouble();
                                 hasGPS = true;
                             }
                         }
                         
-                        bool found = false;
-                        for (auto &node : triangulationNodes) {
-                            if (node.nodeId == sendingNode) {
-                                node.rssi = rssi;
-                                node.hitCount++;
-                                if (hasGPS) {
-                                    node.lat = lat;
-                                    node.lon = lon;
-                                    node.hasGPS = true;
-                                }
-                                found = true;
-                                break;
-                            }
-                        }
-                        if (!found) {
-                            TriangulationNode newNode = {sendingNode, lat, lon, (int8_t)rssi, 1, hasGPS};
-                            triangulationNodes.push_back(newNode);
-                        }
+                        recordTriangulationHit(sendingNode.c_str(), sendingNode.length(), rssi, rssi, hasGPS,
+                                               lat, lon);
                     }
                 }
             }
@@ -1405,7 +2106,7 @@ void processMeshMessage(const String &message) {
             String targetId = cleanMessage.substring(1, spaceIndex);
             if (targetId != nodeId && targetId != "ALL") return;
             String command = cleanMessage.substring(spaceIndex + 1);
-            processCommand(command);
+            if (processCommand(command) && cmdId.key) ackCommand(cmdId);
         }
     } else {
         processCommand(cleanMessage);
@@ -1414,32 +2115,33 @@ void processMeshMessage(const String &message) {
 
 
 void processUSBToMesh() {
-    static String usbBuffer = "";
-    
-    while (Serial.available()) {
-        char c = Serial.read();
-        Serial.write(c);
-        // Only process printable ASCII characters and line endings for mesh
-        if ((c >= 32 && c <= 126) || c == '\n' || c == '\r') {
-            if (c == '\n' || c == '\r') {
-                if (usbBuffer.length() > 5 && usbBuffer.length() <= 240) {  // Mesh 240 char limit
-                    Serial.printf("[MESH RX] %s\n", usbBuffer.c_str());
-                    processMeshMessage(usbBuffer.c_str());
-                } else if (usbBuffer.length() > 0) {
-                    Serial.println("[MESH] Ignoring invalid message length");
-                }
-                usbBuffer = "";
+    // Console lines are handled like mesh lines; binary frames only come from the radio
+    static uint8_t usbBuf[256];
+    static LineFramer usbFramer(usbBuf, sizeof(usbBuf), false);
+
+    int pending;
+    while ((pending = Serial.available()) > 0) {
+        size_t avail;
+        uint8_t *dst = usbFramer.writeSpace(avail);
+        size_t n = Serial.read(dst, (size_t)pending < avail ? (size_t)pending : avail);
+        if (n == 0) break;
+        Serial.write(dst, n);
+        usbFramer.commit(n);
+
+        const uint8_t *line;
+        size_t len;
+        FrameKind k;
+        while ((k = usbFramer.next(line, len)) != FRAME_NONE) {
+            if (k == FRAME_OVERFLOW) {
+                Serial.println("[MESH] at 240 chars, clearing");
+            } else if (len > 5 && len <= 240) {  // Mesh 240 char limit
+                Serial.printf("[MESH RX] %.*s\n", (int)len, (const char *)line);
+                String msg;
+                msg.concat((const char *)line, len);
+                processConsoleLine(msg);
             } else {
-                usbBuffer += c;
+                Serial.println("[MESH] Ignoring invalid message length");
             }
-        } else {
-            // ecchooooo
-        }
-        
-        // Prevent buffer overflow at mesh limit
-        if (usbBuffer.length() > 240) {
-            Serial.println("[MESH] at 240 chars, clearing");
-            usbBuffer = "";
         }
     }
 }
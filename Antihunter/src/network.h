@@ -20,19 +20,37 @@ extern bool meshEnabled;
 #define AP_CHANNEL 6
 #endif
 
-struct TriangulationNode {
-    String nodeId;
-    float lat, lon;
-    int8_t rssi;
-    uint32_t hitCount;
-    bool hasGPS;
+enum TrackMethod : uint8_t { TRACK_WLS, TRACK_PARTICLE };
+
+// One live position estimate of the triangulation target
+struct TrackPoint {
+    uint32_t seq;
+    uint32_t ms;
+    uint32_t epoch;
+    double lat, lon;
+    float major, minor;     // 95% error ellipse semi-axes, metres
+    float headingDeg;
+    float rmsResidual;      // 0 for the particle filter
+    uint8_t nodes;
+    uint8_t method;         // TrackMethod
 };
 
 // Triangulation functions
 String calculateTriangulationResults();
+bool triangulationNextLine(TextCursor &c);
+bool hasTriangulationData();
 void stopTriangulation();
 void startTriangulation(const String &targetMac, int duration);
 bool isTriangulationActive();
+bool isTriangulationTarget(const uint8_t mac[6]);
+// Track of the live estimate, re-solved as each report arrives; oldest
+// retained point with seq > afterSeq
+bool nextTrackPointSince(uint32_t afterSeq, TrackPoint &out);
+const char *trackMethodName(uint8_t method);
+
+// Path-loss calibration against beacons at known positions
+void observeCalibrationHit(const Hit &h);
+void announcePathLoss();
 
 // Network and Web Server functions
 void initializeNetwork();
@@ -40,12 +58,33 @@ void initializeMesh();
 void startWebServer();
 void startAPAndServer();
 void stopAPAndServer();
+void ensureAPAndServer();
+bool isAPActive();
+uint8_t getAPChannel();
 
 // Mesh communication functions
 void sendMeshNotification(const Hit &hit);
+void flushMeshHits();
 void sendTrackerMeshUpdate();
+// Sends an @NODE/@ALL command and re-sends it until the recipients ack
 void sendMeshCommand(const String &command);
+void pollMeshCommands();
 void processMeshMessage(const String &message);
+void processMeshFrame(const uint8_t *data, size_t len);
 void processUSBToMesh();
 void setNodeId(const String &id);
-String getNodeId();
\ No newline at end of file
+String getNodeId();
+
+struct AlertRecord {
+    uint32_t seq;
+    uint32_t ms;
+    uint32_t epoch;
+    char tag[12];
+    char text[96];
+};
+
+// Live event push (SSE on /events) and recent alert history
+void pushHitEvent(const Hit &h);
+void pushAlertEvent(const char *tag, const String &text);
+void flushLiveEvents();
+bool nextAlertSince(uint32_t afterSeq, AlertRecord &out);
\ No newline at end of file
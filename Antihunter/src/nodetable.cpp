@@ -0,0 +1,150 @@
+#include "nodetable.h"
+#include <math.h>
+#include <string.h>
+
+uint32_t nodeIdHash(const char *name, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) h = (h ^ (uint8_t)name[i]) * 16777619u;
+    return h ? h : 1;
+}
+
+void NodeStats::record(int r, float level, uint32_t nowMs)
+{
+    rssi = (int8_t)r;
+    filter.update(level);
+    hitCount++;
+    lastMs = nowMs;
+    ring[ringPos] = level;
+    ringMs[ringPos] = nowMs;
+    ringPos = (ringPos + 1) % NODE_RSSI_RING;
+    if (ringLen < NODE_RSSI_RING) ringLen++;
+}
+
+void NodeStats::setPosition(double la, double lo, uint32_t nowMs)
+{
+    lat = la;
+    lon = lo;
+    hasGPS = true;
+    gpsMs = nowMs;
+}
+
+float NodeStats::hitRate() const
+{
+    if (ringLen < 2) return 0;
+    uint8_t newest = (ringPos + NODE_RSSI_RING - 1) % NODE_RSSI_RING;
+    uint8_t oldest = (ringPos + NODE_RSSI_RING - ringLen) % NODE_RSSI_RING;
+    uint32_t span = ringMs[newest] - ringMs[oldest];
+    return span ? (ringLen - 1) * 60000.0f / span : 0;
+}
+
+float NodeStats::rssiSpread() const
+{
+    if (ringLen < 2) return 0;
+    float mean = 0;
+    for (uint8_t i = 0; i < ringLen; i++) mean += ring[i];
+    mean /= ringLen;
+    float sq = 0;
+    for (uint8_t i = 0; i < ringLen; i++) sq += (ring[i] - mean) * (ring[i] - mean);
+    return sqrtf(sq / (ringLen - 1));
+}
+
+void NodeTable::clear()
+{
+    for (size_t i = 0; i < NODE_TABLE_SLOTS; i++) slots[i] = NodeStats();
+    memset(index, -1, sizeof(index));
+    count = 0;
+    ready = true;
+}
+
+int NodeTable::find(const char *name, size_t len) const
+{
+    if (!ready) return -1;
+    uint32_t h = nodeIdHash(name, len);
+    for (size_t i = h & (INDEX_SIZE - 1), n = 0; n < INDEX_SIZE; i = (i + 1) & (INDEX_SIZE - 1), n++) {
+        int s = index[i];
+        if (s < 0) return -1;
+        if (slots[s].hash == h && slots[s].nameLen == len && memcmp(slots[s].name, name, len) == 0) return s;
+    }
+    return -1;
+}
+
+int NodeTable::intern(const char *name, size_t len, uint32_t nowMs)
+{
+    if (!ready) clear();
+    if (len == 0 || len >= sizeof(NodeName)) return -1;
+    int s = find(name, len);
+    if (s >= 0) return s;
+
+    if (count == NODE_TABLE_SLOTS) {
+        // Full: the node heard from longest ago makes room
+        int lru = 0;
+        for (size_t i = 1; i < NODE_TABLE_SLOTS; i++) {
+            if (nowMs - slots[i].lastMs > nowMs - slots[lru].lastMs) lru = (int)i;
+        }
+        remove(lru);
+        evicted++;
+    }
+    s = 0;
+    while (slots[s].hash) s++;
+
+    NodeStats &e = slots[s];
+    e = NodeStats();
+    memcpy(e.name, name, len);
+    e.name[len] = 0;
+    e.nameLen = (uint8_t)len;
+    e.hash = nodeIdHash(name, len);
+    e.model = PATHLOSS_DEFAULT;
+    e.firstMs = e.lastMs = nowMs;
+    size_t i = e.hash & (INDEX_SIZE - 1);
+    while (index[i] >= 0) i = (i + 1) & (INDEX_SIZE - 1);
+    index[i] = (int8_t)s;
+    count++;
+    return s;
+}
+
+// Backward-shift deletion, as in DedupeCache
+void NodeTable::remove(int slot)
+{
+    uint32_t h = slots[slot].hash;
+    size_t i = h & (INDEX_SIZE - 1);
+    while (index[i] >= 0 && index[i] != slot) i = (i + 1) & (INDEX_SIZE - 1);
+    if (index[i] < 0) return;
+    size_t j = i;
+    for (;;) {
+        j = (j + 1) & (INDEX_SIZE - 1);
+        if (index[j] < 0) break;
+        size_t home = slots[index[j]].hash & (INDEX_SIZE - 1);
+        bool stays = i <= j ? (home > i && home <= j) : (home > i || home <= j);
+        if (!stays) {
+            index[i] = index[j];
+            i = j;
+        }
+    }
+    index[i] = -1;
+    slots[slot].hash = 0;
+    count--;
+}
+
+int NodeTable::next(int slot) const
+{
+    if (!ready) return -1;
+    for (int s = slot + 1; s < (int)NODE_TABLE_SLOTS; s++) {
+        if (slots[s].hash) return s;
+    }
+    return -1;
+}
+
+size_t NodeTable::expire(uint32_t nowMs, uint32_t staleMs)
+{
+    if (!ready) return 0;
+    size_t n = 0;
+    for (size_t s = 0; s < NODE_TABLE_SLOTS; s++) {
+        if (slots[s].hash && nowMs - slots[s].lastMs > staleMs) {
+            remove((int)s);
+            n++;
+        }
+    }
+    evicted += n;
+    return n;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "reliable.h"
+#include "rssimodel.h"
+
+// Nodes reporting the triangulation target. A node id is hashed once per
+// report and interned into a fixed slot that keeps its number while the
+// node keeps reporting; an open-addressed index over the slot hashes finds
+// it without walking names (one memcmp confirms the hit). Nodes not heard
+// from within the stale window are evicted, and adding to a full table
+// evicts the one heard from longest ago.
+
+const size_t NODE_TABLE_SLOTS = 32;
+const uint8_t NODE_RSSI_RING = 16;
+
+struct NodeStats {
+    NodeName name;
+    uint8_t nameLen;
+    uint32_t hash;          // 0 = free slot
+    double lat, lon;
+    bool hasGPS;
+    uint32_t gpsMs;         // when lat/lon were last reported
+    PathLoss model;         // this node's RSSI to range model
+    int8_t rssi;            // last reported
+    uint32_t hitCount;
+    uint32_t firstMs, lastMs;
+    RssiFilter filter;      // smoothed RSSI, used for the range
+    // Last NODE_RSSI_RING report levels and when they arrived
+    float ring[NODE_RSSI_RING];
+    uint32_t ringMs[NODE_RSSI_RING];
+    uint8_t ringPos, ringLen;
+
+    void record(int rssi, float level, uint32_t nowMs);
+    void setPosition(double lat, double lon, uint32_t nowMs);
+    // Reports per minute over the ring; 0 until there are two
+    float hitRate() const;
+    // Standard deviation of the ring levels, dB
+    float rssiSpread() const;
+};
+
+class NodeTable {
+  public:
+    // Slot of node, added if new; -1 if the id is empty or too long
+    int intern(const char *name, size_t len, uint32_t nowMs);
+    int find(const char *name, size_t len) const;
+    NodeStats &at(int slot) { return slots[slot]; }
+    const NodeStats &at(int slot) const { return slots[slot]; }
+    // Occupied slots in slot order: start from -1, -1 at the end
+    int next(int slot) const;
+    // Evicts nodes silent for staleMs; returns how many
+    size_t expire(uint32_t nowMs, uint32_t staleMs);
+    size_t size() const { return count; }
+    uint32_t evictions() const { return evicted; }
+    void clear();
+
+  private:
+    static const size_t INDEX_SIZE = NODE_TABLE_SLOTS * 2;
+    NodeStats slots[NODE_TABLE_SLOTS] = {};
+    int8_t index[INDEX_SIZE];
+    size_t count = 0;
+    uint32_t evicted = 0;
+    bool ready = false;
+
+    void remove(int slot);
+};
+
+uint32_t nodeIdHash(const char *name, size_t len);
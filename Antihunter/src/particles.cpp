@@ -0,0 +1,175 @@
+#include "particles.h"
+#include <math.h>
+#include <string.h>
+
+static const float PF_ROUGHEN_M = 0.5f;     // jitter on resampled copies so they don't stay identical
+static const float PF_MAX_SEED_M = 2000.0f;
+static const float PF_TWO_PI = 6.28318531f;
+
+void ParticleLocator::configure(const PfConfig &c, uint32_t s)
+{
+    cfg = c;
+    n = cfg.particles < 16 ? 16 : cfg.particles > PF_MAX_PARTICLES ? PF_MAX_PARTICLES : cfg.particles;
+    rng = s ? s : 1;
+    reset();
+}
+
+void ParticleLocator::reset()
+{
+    active = false;
+    updateCount = 0;
+    resampleCount = 0;
+}
+
+// xorshift32: fast, and the same sequence on the node and on a host
+float ParticleLocator::uniform()
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return (rng >> 8) * (1.0f / 16777216.0f);
+}
+
+float ParticleLocator::gauss()
+{
+    // Box-Muller; the cosine half is enough
+    float u = uniform();
+    if (u < 1e-7f) u = 1e-7f;
+    return sqrtf(-2.0f * logf(u)) * cosf(PF_TWO_PI * uniform());
+}
+
+void ParticleLocator::seed(float nodeX, float nodeY, float rssi, const PathLoss &m)
+{
+    float d0 = pathLossDistance(m, rssi);
+    float sigmaLn = 0.230259f * m.sigmaDb / m.n;
+    for (uint16_t i = 0; i < n; i++) {
+        float r = d0 * expf(sigmaLn * gauss());
+        if (r > PF_MAX_SEED_M) r = PF_MAX_SEED_M;
+        float a = PF_TWO_PI * uniform();
+        x[i] = nodeX + r * cosf(a);
+        y[i] = nodeY + r * sinf(a);
+        vx[i] = 0.5f * gauss();
+        vy[i] = 0.5f * gauss();
+        w[i] = 1.0f / n;
+    }
+}
+
+void ParticleLocator::predict(float dt)
+{
+    if (dt <= 0) return;
+    float decay = expf(-dt / cfg.speedTau);
+    float sa = cfg.accelSigma * sqrtf(dt);
+    float max2 = cfg.maxSpeed * cfg.maxSpeed;
+    for (uint16_t i = 0; i < n; i++) {
+        vx[i] = vx[i] * decay + sa * gauss();
+        vy[i] = vy[i] * decay + sa * gauss();
+        float s2 = vx[i] * vx[i] + vy[i] * vy[i];
+        if (s2 > max2) {
+            float k = cfg.maxSpeed / sqrtf(s2);
+            vx[i] *= k;
+            vy[i] *= k;
+        }
+        x[i] += vx[i] * dt;
+        y[i] += vy[i] * dt;
+    }
+}
+
+// Systematic resampling. cumW doubles as the copy buffer.
+void ParticleLocator::resample()
+{
+    float acc = 0;
+    for (uint16_t i = 0; i < n; i++) {
+        acc += w[i];
+        cumW[i] = acc;
+    }
+    float step = acc / n;
+    float u = uniform() * step;
+    uint16_t j = 0;
+    for (uint16_t i = 0; i < n; i++) {
+        while (j < n - 1 && cumW[j] < u) j++;
+        idx[i] = j;
+        u += step;
+    }
+    float *fields[4] = {x, y, vx, vy};
+    for (float *f : fields) {
+        for (uint16_t i = 0; i < n; i++) cumW[i] = f[idx[i]];
+        memcpy(f, cumW, n * sizeof(float));
+    }
+    for (uint16_t i = 0; i < n; i++) {
+        x[i] += PF_ROUGHEN_M * gauss();
+        y[i] += PF_ROUGHEN_M * gauss();
+        w[i] = 1.0f / n;
+    }
+    resampleCount++;
+}
+
+void ParticleLocator::update(double lat, double lon, float rssi, const PathLoss &m, uint32_t ms)
+{
+    updateCount++;
+    if (!active) {
+        frame = makeFrame(lat, lon);
+        seed(0, 0, rssi, m);
+        lastMs = ms;
+        active = true;
+        return;
+    }
+
+    double ne, nn;
+    frame.toEnu(lat, lon, ne, nn);
+    uint32_t gap = ms - lastMs;
+    if (gap > cfg.maxGapMs) gap = cfg.maxGapMs;
+    lastMs = ms;
+    predict(gap / 1000.0f);
+
+    // rssi ~ N(p0 - 10 n log10(d), sigmaDb), computed from d^2 to skip the sqrt
+    float inv2s2 = 0.5f / (m.sigmaDb * m.sigmaDb);
+    float halfSlope = 5.0f * m.n;
+    float total = 0;
+    for (uint16_t i = 0; i < n; i++) {
+        float dx = x[i] - (float)ne, dy = y[i] - (float)nn;
+        float d2 = dx * dx + dy * dy;
+        if (d2 < 0.25f) d2 = 0.25f;
+        float r = rssi - (m.p0 - halfSlope * log10f(d2));
+        w[i] *= expf(-r * r * inv2s2) + cfg.outlierFloor;
+        total += w[i];
+    }
+
+    float sq = 0;
+    for (uint16_t i = 0; i < n; i++) {
+        w[i] /= total;
+        sq += w[i] * w[i];
+    }
+    if (1.0f / sq < n / 2.0f) resample();
+}
+
+bool ParticleLocator::estimate(LocFix &out) const
+{
+    if (!active) return false;
+    double mx = 0, my = 0;
+    for (uint16_t i = 0; i < n; i++) {
+        mx += w[i] * x[i];
+        my += w[i] * y[i];
+    }
+    double cxx = 0, cxy = 0, cyy = 0;
+    for (uint16_t i = 0; i < n; i++) {
+        double dx = x[i] - mx, dy = y[i] - my;
+        cxx += w[i] * dx * dx;
+        cxy += w[i] * dx * dy;
+        cyy += w[i] * dy * dy;
+    }
+    memset(&out, 0, sizeof(out));
+    out.east = (float)mx;
+    out.north = (float)my;
+    frame.fromEnu(mx, my, out.lat, out.lon);
+    locSetCovariance(out, cxx, cxy, cyy);
+    return true;
+}
+
+void ParticleLocator::velocity(float &east, float &north) const
+{
+    east = north = 0;
+    for (uint16_t i = 0; i < n; i++) {
+        east += w[i] * vx[i];
+        north += w[i] * vy[i];
+    }
+}
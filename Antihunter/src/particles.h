@@ -0,0 +1,72 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "locate.h"
+#include "rssimodel.h"
+
+// Particle filter for a moving target, fed one node report at a time.
+//
+// Each particle is a position and velocity on the local east/north plane.
+// Between reports they move at their velocity, which wanders by a random
+// acceleration and decays towards standstill, so a parked target settles
+// and a walking one is followed. A report (node position, RSSI, that
+// node's path-loss model) weights each particle by how likely the RSSI is
+// at its distance from the node; a small floor keeps one multipath outlier
+// from wiping out the right particles. Systematic resampling runs once the
+// weights concentrate on under half of the particles.
+//
+// Storage is fixed (PF_MAX_PARTICLES), and an update is O(particles) with
+// no allocation. Like locate and rssimodel it has no Arduino dependency,
+// so the command center can build it on a host and feed it the same
+// reports from the mesh.
+
+const uint16_t PF_MAX_PARTICLES = 512;
+const uint16_t PF_DEFAULT_PARTICLES = 256;
+
+struct PfConfig {
+    uint16_t particles = PF_DEFAULT_PARTICLES;
+    float accelSigma = 0.3f;        // m/s^2, random acceleration
+    float speedTau = 20.0f;         // s, velocity decay
+    float maxSpeed = 4.0f;          // m/s
+    float outlierFloor = 0.02f;     // likelihood floor, relative to a perfect match
+    uint32_t maxGapMs = 30000;      // longer silences are predicted as this long
+};
+
+class ParticleLocator {
+  public:
+    void configure(const PfConfig &cfg, uint32_t seed = 1);
+    void reset();
+
+    // One report: a node at lat/lon heard the target at rssi at time ms.
+    // The first report seeds the particles on a ring around that node.
+    void update(double lat, double lon, float rssi, const PathLoss &m, uint32_t ms);
+
+    // Weighted mean and covariance; east/north are from the first reporting
+    // node and used is left 0. False before the first report.
+    bool estimate(LocFix &out) const;
+    void velocity(float &east, float &north) const;
+    bool started() const { return active; }
+    uint32_t updates() const { return updateCount; }
+    uint32_t resamples() const { return resampleCount; }
+
+  private:
+    PfConfig cfg;
+    uint16_t n = PF_DEFAULT_PARTICLES;
+    bool active = false;
+    LocalFrame frame;
+    uint32_t lastMs = 0;
+    uint32_t updateCount = 0;
+    uint32_t resampleCount = 0;
+    uint32_t rng = 1;
+    float x[PF_MAX_PARTICLES], y[PF_MAX_PARTICLES];
+    float vx[PF_MAX_PARTICLES], vy[PF_MAX_PARTICLES];
+    float w[PF_MAX_PARTICLES];
+    float cumW[PF_MAX_PARTICLES];
+    uint16_t idx[PF_MAX_PARTICLES];
+
+    float uniform();
+    float gauss();
+    void seed(float nodeX, float nodeY, float rssi, const PathLoss &m);
+    void predict(float dt);
+    void resample();
+};
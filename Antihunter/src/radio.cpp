@@ -0,0 +1,146 @@
+#include "radio.h"
+
+// Pure transition logic; everything hardware-specific goes through RadioDriver
+
+RadioWifiMode RadioStateMachine::wifiModeFor(uint8_t mode)
+{
+    if (mode & RADIO_AP) return RADIO_WIFI_AP;
+    if (mode & RADIO_PROMISC) return RADIO_WIFI_STA;
+    return RADIO_WIFI_OFF;
+}
+
+const char *RadioStateMachine::modeName(uint8_t mode)
+{
+    switch (mode & (RADIO_AP | RADIO_PROMISC | RADIO_BLE)) {
+        case RADIO_OFF: return "OFF";
+        case RADIO_AP: return "AP";
+        case RADIO_PROMISC: return "PROMISC";
+        case RADIO_BLE: return "BLE";
+        case RADIO_PROMISC_BLE: return "PROMISC+BLE";
+        case RADIO_AP_PROMISC: return "AP+PROMISC";
+        case RADIO_AP | RADIO_BLE: return "AP+BLE";
+        default: return "AP+PROMISC+BLE";
+    }
+}
+
+bool RadioStateMachine::transition(uint8_t target, RadioTransition &t)
+{
+    int64_t start = drv.nowUs();
+    t.from = current;
+    t.to = target;
+    t.driverCalls = 0;
+
+    RadioWifiMode curWifi = wifiModeFor(current);
+    RadioWifiMode newWifi = wifiModeFor(target);
+
+    // Tear down first, innermost layer first
+    if ((current & RADIO_BLE) && !(target & RADIO_BLE)) {
+        t.driverCalls++;
+        drv.setBLE(false);
+        current &= ~RADIO_BLE;
+    }
+    // Promiscuous RX doesn't survive a driver mode switch cleanly
+    if ((current & RADIO_PROMISC) && (!(target & RADIO_PROMISC) || curWifi != newWifi)) {
+        t.driverCalls++;
+        drv.setPromiscuous(false);
+        current &= ~RADIO_PROMISC;
+    }
+    if (curWifi != newWifi) {
+        t.driverCalls++;
+        if (drv.setWifiMode(newWifi)) {
+            current = (current & ~RADIO_AP) | (newWifi == RADIO_WIFI_AP ? RADIO_AP : 0);
+        } else {
+            // Leave the driver in a known state rather than half-configured
+            drv.setWifiMode(RADIO_WIFI_OFF);
+            current &= ~RADIO_AP;
+            newWifi = RADIO_WIFI_OFF;
+        }
+    }
+
+    // Then bring up what's missing
+    if ((target & RADIO_PROMISC) && !(current & RADIO_PROMISC) && newWifi != RADIO_WIFI_OFF) {
+        t.driverCalls++;
+        if (drv.setPromiscuous(true)) current |= RADIO_PROMISC;
+    }
+    if ((target & RADIO_BLE) && !(current & RADIO_BLE)) {
+        t.driverCalls++;
+        if (drv.setBLE(true)) current |= RADIO_BLE;
+    }
+
+    t.reached = current;
+    t.us = drv.nowUs() - start;
+    return current == target;
+}
+
+BleScanParams bleScanParamsFor(uint8_t mode, bool tracking)
+{
+    if (tracking && (mode & (RADIO_PROMISC | RADIO_AP))) return {3000, 1050, RADIO_COEX_BALANCE};
+    if (mode & RADIO_PROMISC) return {100, 30, RADIO_COEX_BALANCE};
+    if (mode & RADIO_AP) return {100, 50, RADIO_COEX_BALANCE};     // the AP keeps beaconing and serving the UI
+    return {100, 100, RADIO_COEX_BT};
+}
+
+const char *coexPrefName(RadioCoexPref p)
+{
+    switch (p) {
+        case RADIO_COEX_WIFI: return "Wi-Fi";
+        case RADIO_COEX_BT: return "BLE";
+        default: return "balance";
+    }
+}
+
+static double segmentListenMs(const BleScanParams &p, uint32_t ms)
+{
+    return p.intervalMs ? (double)ms * p.windowMs / p.intervalMs : 0;
+}
+
+void BleDutyMeter::start(const BleScanParams &p, uint32_t nowMs, uint32_t adverts)
+{
+    on = true;
+    cur = p;
+    startMs = segMs = nowMs;
+    listenMs = 0;
+    rateMs = nowMs;
+    rateCount = adverts;
+    rate = 0;
+}
+
+void BleDutyMeter::change(const BleScanParams &p, uint32_t nowMs)
+{
+    if (!on) return;
+    listenMs += segmentListenMs(cur, nowMs - segMs);
+    segMs = nowMs;
+    cur = p;
+}
+
+void BleDutyMeter::stop(uint32_t nowMs)
+{
+    if (!on) return;
+    listenMs += segmentListenMs(cur, nowMs - segMs);
+    stopMs = nowMs;
+    on = false;
+}
+
+uint32_t BleDutyMeter::elapsedMs(uint32_t nowMs) const
+{
+    return (on ? nowMs : stopMs) - startMs;
+}
+
+float BleDutyMeter::duty(uint32_t nowMs) const
+{
+    uint32_t total = elapsedMs(nowMs);
+    if (!total) return 0;
+    double l = listenMs + (on ? segmentListenMs(cur, nowMs - segMs) : 0);
+    return (float)(l / total);
+}
+
+float BleDutyMeter::advertRate(uint32_t nowMs, uint32_t adverts)
+{
+    uint32_t span = nowMs - rateMs;
+    if (on && span >= RATE_WINDOW_MS) {
+        rate = (adverts - rateCount) * 1000.0f / span;
+        rateMs = nowMs;
+        rateCount = adverts;
+    }
+    return rate;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <stdint.h>
+
+// Radio modes are combinations of these bits; the named ones are what the
+// scan tasks and the web UI actually use.
+enum RadioModeBits : uint8_t {
+    RADIO_AP = 0x01,
+    RADIO_PROMISC = 0x02,
+    RADIO_BLE = 0x04,
+};
+
+const uint8_t RADIO_OFF = 0;
+const uint8_t RADIO_PROMISC_BLE = RADIO_PROMISC | RADIO_BLE;
+const uint8_t RADIO_AP_PROMISC = RADIO_AP | RADIO_PROMISC;
+
+// What the Wi-Fi driver itself runs as; derived from the mode bits
+enum RadioWifiMode : uint8_t { RADIO_WIFI_OFF, RADIO_WIFI_STA, RADIO_WIFI_AP };
+
+// Driver calls the state machine is built on. Each call blocks until the
+// driver reports the change (or times out) and returns false on failure.
+class RadioDriver {
+  public:
+    virtual ~RadioDriver() {}
+    virtual bool setWifiMode(RadioWifiMode mode) = 0;
+    virtual bool setPromiscuous(bool on) = 0;
+    virtual bool setBLE(bool on) = 0;
+    virtual int64_t nowUs() = 0;
+};
+
+struct RadioTransition {
+    uint8_t from;
+    uint8_t to;
+    uint8_t reached;
+    uint8_t driverCalls;
+    int64_t us;
+};
+
+// Moves between modes with the fewest driver calls: AP <-> AP+PROMISC only
+// toggles promiscuous RX, the Wi-Fi driver is only restarted when the
+// underlying OFF/STA/AP mode has to change.
+class RadioStateMachine {
+  public:
+    explicit RadioStateMachine(RadioDriver &driver) : drv(driver) {}
+
+    bool transition(uint8_t target, RadioTransition &t);
+    uint8_t mode() const { return current; }
+
+    static RadioWifiMode wifiModeFor(uint8_t mode);
+    static const char *modeName(uint8_t mode);
+
+  private:
+    RadioDriver &drv;
+    uint8_t current = RADIO_OFF;
+};
+
+// BLE scanning is continuous; what changes with the radio mode is how much
+// of each scan interval BLE asks for (the window) and which side the coex
+// arbiter favours when Wi-Fi wants the antenna at the same time. While
+// promiscuous RX is on BLE asks for under a third, so channel hops still
+// see most of each dwell; with BLE alone it listens the whole interval.
+//
+// A short window every 100 ms aliases with periodic advertisers: one at
+// ~1 s drifts through the interval by its 0-10 ms advDelay and can sit
+// outside a 30 ms window for tens of seconds. The tracker follows a single
+// device, so while tracking the window is made longer than a 1 s advert
+// period instead; every such device lands in each 3 s interval.
+enum RadioCoexPref : uint8_t { RADIO_COEX_BALANCE, RADIO_COEX_WIFI, RADIO_COEX_BT };
+
+struct BleScanParams {
+    uint16_t intervalMs;
+    uint16_t windowMs;
+    RadioCoexPref coex;
+};
+
+BleScanParams bleScanParamsFor(uint8_t mode, bool tracking = false);
+const char *coexPrefName(RadioCoexPref p);
+
+// Share of wall time BLE has been listening since start(), and the advert
+// rate, for reporting. Times are millis(); adverts is a running count.
+class BleDutyMeter {
+  public:
+    void start(const BleScanParams &p, uint32_t nowMs, uint32_t adverts);
+    void change(const BleScanParams &p, uint32_t nowMs);
+    void stop(uint32_t nowMs);
+    bool running() const { return on; }
+    const BleScanParams &params() const { return cur; }
+    float duty(uint32_t nowMs) const;
+    uint32_t elapsedMs(uint32_t nowMs) const;
+    // Adverts per second over the last RATE_WINDOW_MS or more
+    float advertRate(uint32_t nowMs, uint32_t adverts);
+
+    static const uint32_t RATE_WINDOW_MS = 5000;
+
+  private:
+    bool on = false;
+    BleScanParams cur = {};
+    uint32_t startMs = 0, segMs = 0, stopMs = 0;
+    double listenMs = 0;        // closed segments
+    uint32_t rateMs = 0, rateCount = 0;
+    float rate = 0;
+};
@@ -0,0 +1,305 @@
+#include "radio_esp.h"
+#include "network.h"
+#include "metrics.h"
+#include <WiFi.h>
+#include <NimBLEDevice.h>
+#include <atomic>
+#include <mutex>
+#include "freertos/event_groups.h"
+
+extern "C"
+{
+#include "esp_wifi.h"
+#include "esp_timer.h"
+#include "esp_coexist.h"
+}
+
+#ifndef COUNTRY
+#define COUNTRY "NO"
+#endif
+
+static const uint32_t RADIO_EVENT_TIMEOUT_MS = 2000;
+static const int AP_FALLBACK_CHANNEL = 11;
+
+static const EventBits_t RADIO_EV_STA_START = 1 << 0;
+static const EventBits_t RADIO_EV_AP_START = 1 << 1;
+
+class EspRadioDriver : public RadioDriver {
+  public:
+    wifi_promiscuous_cb_t promiscCb = nullptr;
+    uint8_t apChannel = AP_CHANNEL;
+
+    bool setWifiMode(RadioWifiMode mode) override;
+    bool setPromiscuous(bool on) override;
+    bool setBLE(bool on) override;
+    int64_t nowUs() override { return esp_timer_get_time(); }
+
+  private:
+    bool startAP(int channel);
+};
+
+static EventGroupHandle_t radioEvents = nullptr;
+static EspRadioDriver espDriver;
+static RadioStateMachine radioSM(espDriver);
+static RadioTransition lastTransition = {};
+static std::mutex radioMutex;
+
+// BLE scan state, under radioMutex
+static NimBLEScan *bleScan = nullptr;
+static BleDutyMeter bleDuty;
+static bool bleTracking = false;
+static std::atomic<uint32_t> bleAdverts{0};
+static std::atomic<float> bleShare{0};
+
+static double sampleBleDuty();
+static double sampleBleAdvertRate();
+static Gauge mBleDuty("antihunter_ble_scan_duty_ratio", "Share of time the BLE scan has been listening this scan",
+                      nullptr, sampleBleDuty);
+static Gauge mBleAdvertRate("antihunter_ble_adverts_per_second", "BLE advertisements per second, recent",
+                            nullptr, sampleBleAdvertRate);
+
+static void radioWifiEvent(arduino_event_id_t event, arduino_event_info_t)
+{
+    switch (event) {
+        case ARDUINO_EVENT_WIFI_STA_START:
+            xEventGroupSetBits(radioEvents, RADIO_EV_STA_START);
+            break;
+        case ARDUINO_EVENT_WIFI_AP_START:
+            xEventGroupSetBits(radioEvents, RADIO_EV_AP_START);
+            break;
+        default:
+            break;
+    }
+}
+
+static bool waitRadioEvent(EventBits_t bit)
+{
+    return xEventGroupWaitBits(radioEvents, bit, pdFALSE, pdTRUE, pdMS_TO_TICKS(RADIO_EVENT_TIMEOUT_MS)) & bit;
+}
+
+bool EspRadioDriver::startAP(int channel)
+{
+    xEventGroupClearBits(radioEvents, RADIO_EV_AP_START);
+    if (!WiFi.mode(WIFI_AP)) return false;
+    WiFi.softAPConfig(IPAddress(192, 168, 4, 1), IPAddress(192, 168, 4, 1), IPAddress(255, 255, 255, 0));
+    if (!WiFi.softAP(AP_SSID, AP_PASS, channel, 0, 8)) return false;
+    if (!waitRadioEvent(RADIO_EV_AP_START)) return false;
+    WiFi.setHostname("Antihunter");
+    apChannel = channel;
+    return true;
+}
+
+bool EspRadioDriver::setWifiMode(RadioWifiMode mode)
+{
+    switch (mode) {
+        case RADIO_WIFI_OFF:
+            return WiFi.mode(WIFI_OFF);
+        case RADIO_WIFI_STA:
+            xEventGroupClearBits(radioEvents, RADIO_EV_STA_START);
+            if (!WiFi.mode(WIFI_STA)) return false;
+            return waitRadioEvent(RADIO_EV_STA_START);
+        case RADIO_WIFI_AP:
+            if (startAP(AP_CHANNEL)) return true;
+            Serial.printf("[RADIO] AP on channel %d failed, trying %d\n", AP_CHANNEL, AP_FALLBACK_CHANNEL);
+            return startAP(AP_FALLBACK_CHANNEL);
+    }
+    return false;
+}
+
+bool EspRadioDriver::setPromiscuous(bool on)
+{
+    if (!on) {
+        esp_wifi_set_promiscuous(false);
+        esp_wifi_set_promiscuous_rx_cb(nullptr);
+        return true;
+    }
+
+    wifi_country_t ctry = {};
+    ctry.schan = 1;
+    ctry.nchan = 14;
+    ctry.max_tx_power = 78;
+    ctry.policy = WIFI_COUNTRY_POLICY_MANUAL;
+    memcpy(ctry.cc, COUNTRY, 2);
+    ctry.cc[2] = 0;
+    esp_wifi_set_country(&ctry);
+
+    wifi_promiscuous_filter_t filter = {};
+    filter.filter_mask = WIFI_PROMIS_FILTER_MASK_ALL;
+    esp_wifi_set_promiscuous_filter(&filter);
+    esp_wifi_set_promiscuous_rx_cb(promiscCb);
+    return esp_wifi_set_promiscuous(true) == ESP_OK;
+}
+
+bool EspRadioDriver::setBLE(bool on)
+{
+    if (on) {
+        NimBLEDevice::init("");
+        return NimBLEDevice::getInitialized();
+    }
+    if (NimBLEDevice::getInitialized()) {
+        NimBLEDevice::getScan()->stop();
+        NimBLEDevice::deinit(false);
+    }
+    if (bleScan) {
+        bleDuty.stop(millis());
+        bleScan = nullptr;
+    }
+    return true;
+}
+
+static esp_coex_prefer_t espCoexPref(RadioCoexPref p)
+{
+    switch (p) {
+        case RADIO_COEX_WIFI: return ESP_COEX_PREFER_WIFI;
+        case RADIO_COEX_BT: return ESP_COEX_PREFER_BT;
+        default: return ESP_COEX_PREFER_BALANCE;
+    }
+}
+
+// Caller holds radioMutex. NimBLE only takes new timing on a fresh start,
+// so the scan is restarted when it changes; it runs until stopped.
+static void applyBleSchedule(bool restart)
+{
+    if (!bleScan) return;
+    BleScanParams p = bleScanParamsFor(radioSM.mode(), bleTracking);
+    const BleScanParams &cur = bleDuty.params();
+    bool changed = !bleDuty.running() || p.intervalMs != cur.intervalMs || p.windowMs != cur.windowMs ||
+                   p.coex != cur.coex;
+    if (!changed && !restart) return;
+
+    esp_coex_preference_set(espCoexPref(p.coex));
+    if (bleScan->isScanning()) bleScan->stop();
+    bleScan->setInterval(p.intervalMs);
+    bleScan->setWindow(p.windowMs);
+    if (!bleScan->start(0, nullptr, false)) {
+        Serial.println("[RADIO] BLE scan start failed");
+        bleDuty.stop(millis());
+        bleShare.store(0, std::memory_order_relaxed);
+        return;
+    }
+    bleShare.store((float)p.windowMs / p.intervalMs, std::memory_order_relaxed);
+    if (bleDuty.running()) bleDuty.change(p, millis());
+    else bleDuty.start(p, millis(), bleAdverts.load(std::memory_order_relaxed));
+    Serial.printf("[RADIO] BLE scan window %u/%u ms (%u%%), coex prefers %s\n", p.windowMs, p.intervalMs,
+                  (unsigned)(100 * p.windowMs / p.intervalMs), coexPrefName(p.coex));
+}
+
+void initializeRadio()
+{
+    if (radioEvents) return;
+    radioEvents = xEventGroupCreate();
+    WiFi.onEvent(radioWifiEvent);
+}
+
+bool radioSetMode(uint8_t mode, wifi_promiscuous_cb_t cb)
+{
+    std::lock_guard<std::mutex> lock(radioMutex);
+    if (cb) {
+        espDriver.promiscCb = cb;
+        if (radioSM.mode() & mode & RADIO_PROMISC) esp_wifi_set_promiscuous_rx_cb(cb);
+    }
+    if (mode == radioSM.mode()) return true;
+
+    RadioTransition t;
+    bool ok = radioSM.transition(mode, t);
+    lastTransition = t;
+    applyBleSchedule(false);
+    Serial.printf("[RADIO] %s -> %s in %.1f ms (%u driver calls)%s\n",
+                  RadioStateMachine::modeName(t.from), RadioStateMachine::modeName(t.to),
+                  t.us / 1000.0, t.driverCalls, ok ? "" : " FAILED");
+    if (!ok) {
+        Serial.printf("[RADIO] Stayed in %s\n", RadioStateMachine::modeName(t.reached));
+    }
+    return ok;
+}
+
+uint8_t radioGetMode()
+{
+    return radioSM.mode();
+}
+
+uint8_t radioGetAPChannel()
+{
+    return espDriver.apChannel;
+}
+
+String getRadioInfo()
+{
+    std::lock_guard<std::mutex> lock(radioMutex);
+    char buf[96];
+    uint8_t mode = radioSM.mode();
+    int n = snprintf(buf, sizeof(buf), "%s", RadioStateMachine::modeName(mode));
+    if (mode & RADIO_AP) n += snprintf(buf + n, sizeof(buf) - n, " (ch %u)", espDriver.apChannel);
+    if (lastTransition.us > 0) {
+        snprintf(buf + n, sizeof(buf) - n, ", last %s -> %s %.1f ms",
+                 RadioStateMachine::modeName(lastTransition.from),
+                 RadioStateMachine::modeName(lastTransition.to), lastTransition.us / 1000.0);
+    }
+    return String(buf);
+}
+
+bool bleScanStart(NimBLEAdvertisedDeviceCallbacks *cb, bool active, bool tracking)
+{
+    std::lock_guard<std::mutex> lock(radioMutex);
+    if (!(radioSM.mode() & RADIO_BLE)) return false;
+    bleTracking = tracking;
+    bleScan = NimBLEDevice::getScan();
+    if (bleScan->isScanning()) bleScan->stop();
+    bleScan->setAdvertisedDeviceCallbacks(cb, true);    // every advertisement, not just a device's first
+    bleScan->setDuplicateFilter(false);
+    bleScan->setMaxResults(0);                           // callbacks only, no result list
+    bleScan->setActiveScan(active);
+    applyBleSchedule(true);
+    return bleDuty.running();
+}
+
+void bleScanStop()
+{
+    std::lock_guard<std::mutex> lock(radioMutex);
+    if (!bleScan) return;
+    bleScan->stop();
+    bleScan = nullptr;
+    bleTracking = false;
+    bleShare.store(0, std::memory_order_relaxed);
+    uint32_t now = millis();
+    bleDuty.stop(now);
+    esp_coex_preference_set(ESP_COEX_PREFER_BALANCE);
+    Serial.printf("[RADIO] BLE scan stopped: %.0f%% duty over %us\n", 100 * bleDuty.duty(now),
+                  (unsigned)(bleDuty.elapsedMs(now) / 1000));
+}
+
+float bleScanShare()
+{
+    return bleShare.load(std::memory_order_relaxed);
+}
+
+void bleAdvertSeen()
+{
+    bleAdverts.fetch_add(1, std::memory_order_relaxed);
+}
+
+static double sampleBleDuty()
+{
+    std::lock_guard<std::mutex> lock(radioMutex);
+    return bleDuty.duty(millis());
+}
+
+static double sampleBleAdvertRate()
+{
+    std::lock_guard<std::mutex> lock(radioMutex);
+    return bleDuty.advertRate(millis(), bleAdverts.load(std::memory_order_relaxed));
+}
+
+String getBleScanInfo()
+{
+    std::lock_guard<std::mutex> lock(radioMutex);
+    uint32_t now = millis();
+    if (!bleDuty.running() && !bleDuty.elapsedMs(now)) return "off";
+    const BleScanParams &p = bleDuty.params();
+    char buf[112];
+    snprintf(buf, sizeof(buf), "%s, window %u/%u ms, coex %s, %.0f%% duty over %us, %.1f adv/s",
+             bleDuty.running() ? "scanning" : "stopped", p.windowMs, p.intervalMs, coexPrefName(p.coex),
+             100 * bleDuty.duty(now), (unsigned)(bleDuty.elapsedMs(now) / 1000),
+             bleDuty.advertRate(now, bleAdverts.load(std::memory_order_relaxed)));
+    return String(buf);
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <Arduino.h>
+#include "radio.h"
+
+class NimBLEAdvertisedDeviceCallbacks;
+
+extern "C" {
+#include "esp_wifi.h"
+}
+
+// Firmware-wide radio, backed by the ESP-IDF and NimBLE drivers
+void initializeRadio();
+bool radioSetMode(uint8_t mode, wifi_promiscuous_cb_t cb = nullptr);
+uint8_t radioGetMode();
+uint8_t radioGetAPChannel();
+String getRadioInfo();
+
+// Continuous BLE scan (needs RADIO_BLE). Every advertisement goes to cb and
+// NimBLE keeps no result list. Interval, window and coex preference follow
+// the radio mode and tracking (bleScanParamsFor) and are re-applied on each
+// mode change.
+bool bleScanStart(NimBLEAdvertisedDeviceCallbacks *cb, bool active, bool tracking = false);
+void bleScanStop();
+// Window / interval of the running scan, 0 when stopped. Lock-free, for the
+// scan callbacks.
+float bleScanShare();
+// Called by the scan callbacks for each advertisement, for the advert rate
+void bleAdvertSeen();
+String getBleScanInfo();
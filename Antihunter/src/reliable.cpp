@@ -0,0 +1,131 @@
+#include "reliable.h"
+#include <string.h>
+
+static_assert(RELIABLE_DESTS <= 16, "acked is a 16-bit mask");
+
+static bool nameEquals(const NodeName &name, const char *node, size_t len)
+{
+    return len < RELIABLE_NODE_LEN && strncmp(name, node, len) == 0 && name[len] == '\0';
+}
+
+uint32_t reliableBackoff(uint32_t seq, uint8_t attempts)
+{
+    uint32_t delay = RELIABLE_RETRY_MS;
+    for (uint8_t i = 1; i < attempts && delay < RELIABLE_RETRY_MAX_MS; i++) delay *= 2;
+    if (delay > RELIABLE_RETRY_MAX_MS) delay = RELIABLE_RETRY_MAX_MS;
+    // Up to +25% jitter so nodes retrying at once don't stay in step
+    uint32_t h = (seq ^ (attempts * 0x9E3779B9u)) * 2654435761u;
+    return delay + (h >> 8) % (delay / 4 + 1);
+}
+
+bool ReliableSender::add(uint32_t seq, const char *line, size_t len, const NodeName *dests, size_t destCount,
+                         uint32_t nowMs)
+{
+    if (destCount == 0 || len > RELIABLE_LINE_MAX) return false;
+    if (destCount > RELIABLE_DESTS) destCount = RELIABLE_DESTS;
+    for (auto &p : slots) {
+        if (p.used) continue;
+        p.used = true;
+        p.attempts = 1;
+        p.destCount = (uint8_t)destCount;
+        p.acked = 0;
+        p.len = (uint16_t)len;
+        p.seq = seq;
+        p.nextMs = nowMs + reliableBackoff(seq, 1);
+        memcpy(p.dests, dests, destCount * sizeof(NodeName));
+        memcpy(p.line, line, len);
+        return true;
+    }
+    return false;
+}
+
+AckResult ReliableSender::ack(uint32_t seq, const char *node, size_t nodeLen)
+{
+    for (auto &p : slots) {
+        if (!p.used || p.seq != seq) continue;
+        for (uint8_t i = 0; i < p.destCount; i++) {
+            if (!nameEquals(p.dests[i], node, nodeLen)) continue;
+            p.acked |= 1u << i;
+            if (p.acked != (1u << p.destCount) - 1) return ACK_RECORDED;
+            p.used = false;
+            return ACK_COMPLETE;
+        }
+        return ACK_UNKNOWN;
+    }
+    return ACK_UNKNOWN;
+}
+
+size_t ReliableSender::poll(uint32_t nowMs, ReliableEvent *out, size_t max)
+{
+    size_t n = 0;
+    for (auto &p : slots) {
+        if (n >= max) break;
+        if (!p.used || (int32_t)(nowMs - p.nextMs) < 0) continue;
+
+        ReliableEvent &e = out[n++];
+        e.seq = p.seq;
+        e.expired = p.attempts >= RELIABLE_ATTEMPTS;
+        e.total = p.destCount;
+        e.acked = 0;
+        e.missing[0] = '\0';
+        size_t m = 0;
+        for (uint8_t i = 0; i < p.destCount; i++) {
+            if (p.acked & (1u << i)) {
+                e.acked++;
+            } else if (e.expired) {
+                size_t l = strlen(p.dests[i]);
+                if (m + l + 2 > sizeof(e.missing)) continue;
+                if (m) e.missing[m++] = ',';
+                memcpy(e.missing + m, p.dests[i], l + 1);
+                m += l;
+            }
+        }
+        if (e.expired) {
+            e.attempt = p.attempts;
+            e.len = 0;
+            p.used = false;
+            continue;
+        }
+        p.attempts++;
+        p.nextMs = nowMs + reliableBackoff(p.seq, p.attempts);
+        e.attempt = p.attempts;
+        e.len = p.len;
+        memcpy(e.line, p.line, p.len);
+    }
+    return n;
+}
+
+size_t ReliableSender::pending() const
+{
+    size_t n = 0;
+    for (auto &p : slots) n += p.used;
+    return n;
+}
+
+// PeerTable
+
+void PeerTable::note(const char *node, size_t len, uint32_t nowMs)
+{
+    if (len == 0 || len >= RELIABLE_NODE_LEN) return;
+    size_t oldest = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (nameEquals(peers[i].name, node, len)) {
+            peers[i].lastMs = nowMs;
+            return;
+        }
+        if ((int32_t)(peers[i].lastMs - peers[oldest].lastMs) < 0) oldest = i;
+    }
+    Peer &p = count < RELIABLE_DESTS ? peers[count++] : peers[oldest];
+    memcpy(p.name, node, len);
+    p.name[len] = '\0';
+    p.lastMs = nowMs;
+}
+
+size_t PeerTable::collect(NodeName *out, size_t max, uint32_t nowMs, uint32_t windowMs) const
+{
+    size_t n = 0;
+    for (size_t i = 0; i < count && n < max; i++) {
+        if (nowMs - peers[i].lastMs <= windowMs) memcpy(out[n++], peers[i].name, sizeof(NodeName));
+    }
+    return n;
+}
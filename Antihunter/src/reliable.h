@@ -0,0 +1,81 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Delivery tracking for commands this node sends over the mesh. A command
+// goes out once with a message id (see dedupe.h) and is tracked against
+// the nodes expected to run it; each of them answers "NODE: ACK:<id>".
+// Until every one has, the same line (same id) is re-sent with exponential
+// backoff. Receivers remember which ids they acked, so a retransmit is
+// re-acked rather than run twice.
+
+const size_t RELIABLE_PENDING = 4;          // commands in flight
+const size_t RELIABLE_DESTS = 16;           // ackers per command, and known peers
+const size_t RELIABLE_NODE_LEN = 24;        // node id incl. NUL
+const size_t RELIABLE_LINE_MAX = 200;
+const uint32_t RELIABLE_RETRY_MS = 20000;       // first retransmit, past a multi-hop round trip; doubles
+const uint32_t RELIABLE_RETRY_MAX_MS = 80000;
+const uint8_t RELIABLE_ATTEMPTS = 5;            // sends including the first
+
+typedef char NodeName[RELIABLE_NODE_LEN];
+
+enum AckResult : uint8_t {
+    ACK_UNKNOWN,    // no such command, or not from an expected node
+    ACK_RECORDED,
+    ACK_COMPLETE    // that was the last one outstanding
+};
+
+// Something the caller has to act on, returned by poll()
+struct ReliableEvent {
+    uint32_t seq;
+    bool expired;       // out of attempts and dropped; otherwise resend line
+    uint8_t attempt;    // sends so far, including this one
+    uint8_t acked;
+    uint8_t total;
+    char missing[64];   // comma-separated unacked nodes, for expired
+    uint16_t len;
+    char line[RELIABLE_LINE_MAX];
+};
+
+class ReliableSender {
+  public:
+    // Starts tracking a command that has just been sent once. False if the
+    // table is full, the line is too long or there is nobody to wait for.
+    bool add(uint32_t seq, const char *line, size_t len, const NodeName *dests, size_t destCount, uint32_t nowMs);
+    AckResult ack(uint32_t seq, const char *node, size_t nodeLen);
+    // Fills out with commands due for a resend or given up on
+    size_t poll(uint32_t nowMs, ReliableEvent *out, size_t max);
+    size_t pending() const;
+
+  private:
+    struct Pending {
+        bool used;
+        uint8_t attempts;
+        uint8_t destCount;
+        uint16_t acked;     // bit per dest
+        uint16_t len;
+        uint32_t seq;
+        uint32_t nextMs;
+        NodeName dests[RELIABLE_DESTS];
+        char line[RELIABLE_LINE_MAX];
+    };
+    Pending slots[RELIABLE_PENDING] = {};
+};
+
+// Delay before the next send of a command sent attempts times so far
+uint32_t reliableBackoff(uint32_t seq, uint8_t attempts);
+
+// Nodes recently heard on the mesh: who is expected to ack an @ALL command
+class PeerTable {
+  public:
+    void note(const char *node, size_t len, uint32_t nowMs);
+    size_t collect(NodeName *out, size_t max, uint32_t nowMs, uint32_t windowMs) const;
+
+  private:
+    struct Peer {
+        NodeName name;
+        uint32_t lastMs;
+    };
+    Peer peers[RELIABLE_DESTS] = {};
+    size_t count = 0;
+};
@@ -0,0 +1,78 @@
+#include "rssimodel.h"
+#include <math.h>
+
+static const float RSSI_EWMA_ALPHA = 0.3f;
+
+float pathLossDistance(const PathLoss &m, float rssi)
+{
+    return powf(10.0f, (m.p0 - rssi) / (10.0f * m.n));
+}
+
+float pathLossRangeSigma(const PathLoss &m, float dist)
+{
+    float s = dist * 0.230259f * m.sigmaDb / m.n;
+    return s > 1.0f ? s : 1.0f;
+}
+
+float RssiFilter::update(float rssi)
+{
+    win[pos] = rssi;
+    pos = (pos + 1) % WINDOW;
+    if (filled < WINDOW) filled++;
+
+    // Insertion sort of at most 5
+    float s[WINDOW];
+    for (uint8_t i = 0; i < filled; i++) {
+        float v = win[i];
+        uint8_t j = i;
+        while (j > 0 && s[j - 1] > v) {
+            s[j] = s[j - 1];
+            j--;
+        }
+        s[j] = v;
+    }
+    float med = filled & 1 ? s[filled / 2] : (s[filled / 2 - 1] + s[filled / 2]) / 2;
+
+    ewma = total == 0 ? med : ewma + RSSI_EWMA_ALPHA * (med - ewma);
+    total++;
+    return ewma;
+}
+
+void PathLossFit::add(float distM, float rssi)
+{
+    if (distM < PATHLOSS_FIT_MIN_DIST) return;
+    double x = 10.0 * log10(distM);
+    sx += x;
+    sy += rssi;
+    sxx += x * x;
+    sxy += x * rssi;
+    syy += (double)rssi * rssi;
+    if (x < minX) minX = x;
+    if (x > maxX) maxX = x;
+    n++;
+}
+
+bool PathLossFit::solve(PathLoss &out) const
+{
+    // Distances must span at least a factor of 2 (3 dB in x)
+    if (n < PATHLOSS_FIT_MIN_SAMPLES || maxX - minX < 3.0) return false;
+    double den = n * sxx - sx * sx;
+    if (den <= 0) return false;
+    double slope = (n * sxy - sx * sy) / den;
+    double p0 = (sy - slope * sx) / n;
+    double exp = -slope;
+    if (exp < 1.2 || exp > 6.0 || p0 < -100 || p0 > -10) return false;
+
+    // Residual sum of squares from the running sums
+    double ssr = syy - p0 * sy - slope * sxy;
+    double sigma = n > 2 && ssr > 0 ? sqrt(ssr / (n - 2)) : 0;
+    out.p0 = (float)p0;
+    out.n = (float)exp;
+    out.sigmaDb = sigma > 2.0 ? (float)sigma : 2.0f;
+    return true;
+}
+
+void PathLossFit::clear()
+{
+    *this = PathLossFit();
+}
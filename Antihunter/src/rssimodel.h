@@ -0,0 +1,60 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// RSSI to range. Log-distance path loss:
+//
+//   rssi = p0 - 10 * n * log10(d)
+//
+// p0 is the RSSI at 1 m and n the path-loss exponent. Both depend on the
+// receiving node's radio, antenna and surroundings, so each node can fit
+// its own from a beacon at a known position (PathLossFit) and announce it.
+
+struct PathLoss {
+    float p0;
+    float n;
+    float sigmaDb;      // spread of readings around the model
+};
+
+const PathLoss PATHLOSS_DEFAULT = {-59.0f, 2.0f, 6.0f};
+
+float pathLossDistance(const PathLoss &m, float rssi);
+// 1-sigma of that distance: sigmaDb of RSSI error scales it by ln(10)/(10n)
+float pathLossRangeSigma(const PathLoss &m, float dist);
+
+// Per-node RSSI smoothing: a median over the last 5 readings throws out
+// single multipath spikes and deep fades; an EWMA on the medians then
+// smooths what is left.
+class RssiFilter {
+  public:
+    float update(float rssi);
+    float value() const { return ewma; }
+    uint32_t count() const { return total; }
+
+  private:
+    static const uint8_t WINDOW = 5;
+    float win[WINDOW] = {};
+    uint8_t filled = 0;
+    uint8_t pos = 0;
+    float ewma = 0;
+    uint32_t total = 0;
+};
+
+// Least-squares fit of p0 and n from (distance, rssi) pairs
+class PathLossFit {
+  public:
+    void add(float distM, float rssi);
+    // False if the samples don't pin the model down: too few, too narrow a
+    // range of distances, or a physically implausible result
+    bool solve(PathLoss &out) const;
+    size_t count() const { return n; }
+    void clear();
+
+  private:
+    double sx = 0, sy = 0, sxx = 0, sxy = 0, syy = 0;
+    double minX = 1e9, maxX = -1e9;
+    size_t n = 0;
+};
+
+const float PATHLOSS_FIT_MIN_DIST = 3.0f;     // closer than this, GPS error dominates
+const size_t PATHLOSS_FIT_MIN_SAMPLES = 20;
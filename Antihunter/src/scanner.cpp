@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cstdarg>
 #include <string>
 #include <mutex>
 #include <WiFi.h>
@@ -7,6 +8,13 @@
 #include <NimBLEAdvertisedDevice.h>
 #include <NimBLEScan.h>
 #include "scanner.h"
+#include "hitstore.h"
+#include "advparse.h"
+#include "dedupe.h"
+#include "metrics.h"
+#include "meshtx.h"
+#include "commands.h"
+#include "radio_esp.h"
 #include "hardware.h"
 #include "network.h"
 #include "main.h"
@@ -31,6 +39,7 @@ struct Target {
 
 // AP handlers
 static void radioStartSTA();
+static void radioStartBLE(bool sniffAll = false);
 static void radioStopSTA();
 
 // Scanner state variables
@@ -41,17 +50,46 @@ std::set<String> uniqueMacs;
 std::set<String> seenDevices;
 std::map<String, uint32_t> deviceLastSeen;
 const uint32_t DEDUPE_WINDOW = 30000;
-std::vector<Hit> hitsLog;
 static esp_timer_handle_t hopTimer = nullptr;
+static volatile bool hopConcurrent = false;
+static const uint64_t HOP_PERIOD_US = 300000;
+static const uint64_t HOP_SLOT_US = 51200;       // half of a 102.4 ms beacon interval
+static const uint8_t HOP_VISITS_PER_CHANNEL = 6;
 static uint32_t lastScanStart = 0, lastScanEnd = 0;
 uint32_t lastScanSecs = 0;
 bool lastScanForever = false;
-static std::map<String, String> apCache;
-static std::map<String, String> bleDeviceCache;
+
+// Sniffer device cache. Every insert or meaningful change takes the next
+// change seq and is indexed by it, so clients can ask for what changed
+// since the last seq they saw instead of re-reading the whole cache.
+struct CacheEntry {
+    String name;
+    int8_t rssi;
+    uint8_t ch;
+    uint32_t seq;
+    uint32_t lastSeen;
+};
+struct CacheChange {
+    String key;
+    bool isBLE;
+    bool removed;
+};
+static std::map<String, CacheEntry> apCache;
+static std::map<String, CacheEntry> bleDeviceCache;
+static std::map<uint32_t, CacheChange> cacheChanges;   // seq -> latest change of that key
+static std::mutex cacheMutex;
+// deauthLog is appended from the promiscuous callback and blueTeamTask and
+// read by /deauth-results across chunks
+static std::mutex deauthLogMutex;
+static uint32_t cacheSeq = 0;
+static uint32_t cacheFloor = 0;          // deltas from below this need a full resync
+static size_t cacheTombstones = 0;
+static const size_t CACHE_TOMBSTONE_MAX = 128;
+static const uint32_t CACHE_TTL_MS = 300000;
+static const int CACHE_RSSI_DELTA = 10;
 static unsigned long lastSnifferScan = 0;
 const unsigned long SNIFFER_SCAN_INTERVAL = 10000;
 
-NimBLEScan *pBLEScan;
 static void sniffer_cb(void *buf, wifi_promiscuous_pkt_type_t type);
 
 // Tracker variables
@@ -144,11 +182,39 @@ extern Preferences prefs;
 extern volatile bool stopRequested;
 extern ScanMode currentScanMode;
 extern std::vector<uint8_t> CHANNELS;
+extern void applyChannels(const ChannelList &list, std::initializer_list<uint8_t> fallback);
 extern TaskHandle_t blueTeamTaskHandle;
 extern String macFmt6(const uint8_t *m);
 extern bool parseMac6(const String &in, uint8_t out[6]);
 extern bool isZeroOrBroadcast(const uint8_t *mac);
 
+// Metrics
+static const uint32_t RX_US_BOUNDS[] = {5, 10, 20, 50, 100, 200, 500, 1000, 5000};
+
+static double sampleFramesSeen() { return framesSeen; }
+static double sampleBleFramesSeen() { return bleFramesSeen; }
+static double sampleScanHits() { return totalHits; }
+static double sampleUniqueDevices() { return uniqueMacs.size(); }
+static double sampleTargets() { return getTargetCount(); }
+
+static Gauge mScanFrames("antihunter_scan_wifi_frames", "WiFi frames seen in the current or last scan", "WiFi Frames seen", sampleFramesSeen);
+static Gauge mScanBleFrames("antihunter_scan_ble_frames", "BLE frames seen in the current or last scan", "BLE Frames seen", sampleBleFramesSeen);
+static Gauge mScanHits("antihunter_scan_hits", "Hits in the current or last scan", "Total hits", sampleScanHits);
+static Gauge mUnique("antihunter_scan_unique_devices", "Unique devices in the current or last scan", "Unique devices", sampleUniqueDevices);
+static Gauge mTargets("antihunter_targets", "Configured target MACs/OUIs", "Targets", sampleTargets);
+static Counter mWifiFrames("antihunter_wifi_frames_total", "Promiscuous frames received");
+static Counter mBleFrames("antihunter_ble_frames_total", "BLE advertisements received");
+static Histogram mRxCallbackUs("antihunter_rx_callback_us", "Promiscuous RX callback duration", RX_US_BOUNDS, 9, "RX callback us");
+static Histogram mDetectorsUs("antihunter_detectors_us", "Time spent in frame detectors per frame", RX_US_BOUNDS, 9);
+static Counter mDropMac("antihunter_queue_drops_total{queue=\"mac\"}", "Items dropped because a queue was full", "Queue drops (mac)");
+static Counter mDropBeacon("antihunter_queue_drops_total{queue=\"beacon\"}", "Items dropped because a queue was full");
+static Counter mDropEvilTwin("antihunter_queue_drops_total{queue=\"eviltwin\"}", "Items dropped because a queue was full");
+static Counter mDropKarma("antihunter_queue_drops_total{queue=\"karma\"}", "Items dropped because a queue was full");
+static Counter mDropProbe("antihunter_queue_drops_total{queue=\"probeflood\"}", "Items dropped because a queue was full");
+static Counter mDropEapol("antihunter_queue_drops_total{queue=\"eapol\"}", "Items dropped because a queue was full");
+static Counter mDropBleSpam("antihunter_queue_drops_total{queue=\"blespam\"}", "Items dropped because a queue was full");
+static Counter mDropBleSniff("antihunter_queue_drops_total{queue=\"ble_sniff\"}", "Items dropped because a queue was full", "Queue drops (sniffer BLE)");
+
 inline uint16_t u16(const uint8_t *p)
 {
     return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
@@ -297,13 +363,39 @@ static inline bool isTrackerTarget(const uint8_t *mac)
     return true;
 }
 
+// With the softAP up, every other slot returns to the AP channel so it is
+// home once per beacon interval. A scan channel keeps its ~300 ms of listen
+// time, spread over HOP_VISITS_PER_CHANNEL excursions.
 static void hopTimerCb(void *)
 {
     static size_t idx = 0;
+    static uint8_t visits = 0;
+    static bool onAP = false;
     if (CHANNELS.empty())
         return;
-    idx = (idx + 1) % CHANNELS.size();
-    esp_wifi_set_channel(CHANNELS[idx], WIFI_SECOND_CHAN_NONE);
+
+    if (!hopConcurrent)
+    {
+        idx = (idx + 1) % CHANNELS.size();
+        esp_wifi_set_channel(CHANNELS[idx], WIFI_SECOND_CHAN_NONE);
+        return;
+    }
+
+    uint8_t apCh = getAPChannel();
+    if (!onAP)
+    {
+        onAP = true;
+        esp_wifi_set_channel(apCh, WIFI_SECOND_CHAN_NONE);
+        return;
+    }
+    onAP = false;
+    if (++visits >= HOP_VISITS_PER_CHANNEL)
+    {
+        visits = 0;
+        idx = (idx + 1) % CHANNELS.size();
+    }
+    if (CHANNELS[idx] != apCh)
+        esp_wifi_set_channel(CHANNELS[idx], WIFI_SECOND_CHAN_NONE);
 }
 
 static int periodFromRSSI(int8_t rssi)
@@ -631,7 +723,10 @@ static void IRAM_ATTR detectDeauthFrame(const wifi_promiscuous_pkt_t *ppkt) {
         }
         
         if (isAttack || hit.isBroadcast) {
-            deauthLog.push_back(hit);
+            {
+                std::lock_guard<std::mutex> lock(deauthLogMutex);
+                deauthLog.push_back(hit);
+            }
             
             if (hit.isDisassoc) {
                 uint32_t temp = disassocCount;
@@ -646,12 +741,11 @@ static void IRAM_ATTR detectDeauthFrame(const wifi_promiscuous_pkt_t *ppkt) {
                           " Reason:" + String(hit.reasonCode);
             Serial.println(alert);
             logToSD(alert);
+            pushAlertEvent("deauth", alert);
             
             if (meshEnabled) {
                 String meshAlert = getNodeId() + ": " + alert;
-                if (Serial1.availableForWrite() >= (int)meshAlert.length()) {
-                    Serial1.println(meshAlert);
-                }
+                meshSend(MESH_ALERT, meshAlert, "deauth:" + macFmt6(hit.srcMac));
             }
         }
     }
@@ -705,7 +799,7 @@ static void IRAM_ATTR detectBeaconFlood(const wifi_promiscuous_pkt_t *ppkt) {
         
         if (beaconQueue) {
             BaseType_t w = pdFALSE;
-            xQueueSendFromISR(beaconQueue, &hit, &w);
+            if (xQueueSendFromISR(beaconQueue, &hit, &w) != pdTRUE) mDropBeacon.inc();
             if (w) portYIELD_FROM_ISR();
         }
     }
@@ -745,7 +839,7 @@ static void IRAM_ATTR detectEvilTwin(const wifi_promiscuous_pkt_t *ppkt) {
         
         if (evilTwinQueue) {
             BaseType_t w = pdFALSE;
-            xQueueSendFromISR(evilTwinQueue, &hit, &w);
+            if (xQueueSendFromISR(evilTwinQueue, &hit, &w) != pdTRUE) mDropEvilTwin.inc();
             if (w) portYIELD_FROM_ISR();
         }
     }
@@ -782,7 +876,7 @@ static void IRAM_ATTR detectKarmaAttack(const wifi_promiscuous_pkt_t *ppkt) {
         
         if (karmaQueue) {
             BaseType_t w = pdFALSE;
-            xQueueSendFromISR(karmaQueue, &hit, &w);
+            if (xQueueSendFromISR(karmaQueue, &hit, &w) != pdTRUE) mDropKarma.inc();
             if (w) portYIELD_FROM_ISR();
         }
     }
@@ -828,7 +922,7 @@ static void IRAM_ATTR detectProbeFlood(const wifi_promiscuous_pkt_t *ppkt) {
         
         if (probeFloodQueue) {
             BaseType_t w = pdFALSE;
-            xQueueSendFromISR(probeFloodQueue, &hit, &w);
+            if (xQueueSendFromISR(probeFloodQueue, &hit, &w) != pdTRUE) mDropProbe.inc();
             if (w) portYIELD_FROM_ISR();
         }
     }
@@ -861,7 +955,7 @@ static void IRAM_ATTR detectEAPOLHarvesting(const wifi_promiscuous_pkt_t *ppkt)
         
         if (eapolQueue) {
             BaseType_t w = pdFALSE;
-            xQueueSendFromISR(eapolQueue, &hit, &w);
+            if (xQueueSendFromISR(eapolQueue, &hit, &w) != pdTRUE) mDropEapol.inc();
             if (w) portYIELD_FROM_ISR();
         }
         
@@ -879,8 +973,6 @@ void karmaDetectionTask(void *pv) {
     Serial.printf("[KARMA] Starting Karma attack detection %s\n",
                   forever ? "(forever)" : ("for " + String(duration) + "s").c_str());
 
-    stopAPAndServer();
-
     // Isolate: Disable others, enable only Karma
     deauthDetectionEnabled = false;
     beaconFloodDetectionEnabled = false;
@@ -922,14 +1014,13 @@ void karmaDetectionTask(void *pv) {
 
             Serial.println("[ALERT] " + alert);
             logToSD(alert);
+            pushAlertEvent("karma", alert);
 
             if (meshEnabled) {
                 String meshAlert = getNodeId() + ": KARMA: " + macFmt6(hit.apMAC) + " " + hit.clientSSID;
                 if (gpsValid) meshAlert += " GPS:" + String(gpsLat, 6) + "," + String(gpsLon, 6);
                 if (hit.reason.length() > 0) meshAlert += " " + hit.reason;
-                if (Serial1.availableForWrite() >= (int)meshAlert.length()) {
-                    Serial1.println(meshAlert);
-                }
+                meshSend(MESH_ALERT, meshAlert, "karma:" + macFmt6(hit.apMAC));
             }
 
             uint32_t temp = karmaCount;
@@ -972,10 +1063,10 @@ void karmaDetectionTask(void *pv) {
             results += " SSIDs\n";
         }
         
-        antihunter::lastResults = results;
+        antihunter::setResultsLocked(results, RESULTS_BODY_NONE);
     }
 
-    startAPAndServer();
+    ensureAPAndServer();
     blueTeamTaskHandle = nullptr;  // Reset shared handle
     vTaskDelete(nullptr);
 }
@@ -988,8 +1079,6 @@ void probeFloodDetectionTask(void *pv) {
     Serial.printf("[PROBE] Starting probe flood detection %s\n",
                   forever ? "(forever)" : ("for " + String(duration) + "s").c_str());
 
-    stopAPAndServer();
-
     // Isolate: Disable others, enable only Probe Flood
     deauthDetectionEnabled = false;
     beaconFloodDetectionEnabled = false;
@@ -1030,14 +1119,13 @@ void probeFloodDetectionTask(void *pv) {
 
             Serial.println("[ALERT] " + alert);
             logToSD(alert);
+            pushAlertEvent("probeflood", alert);
 
             if (meshEnabled) {
                 String meshAlert = getNodeId() + ": PROBE-FLOOD: " + macFmt6(hit.clientMAC) + " " + String(hit.probeCount);
                 if (gpsValid) meshAlert += " GPS:" + String(gpsLat, 6) + "," + String(gpsLon, 6);
                 if (hit.reason.length() > 0) meshAlert += " " + hit.reason;
-                if (Serial1.availableForWrite() >= (int)meshAlert.length()) {
-                    Serial1.println(meshAlert);
-                }
+                meshSend(MESH_ALERT, meshAlert, "probeflood:" + macFmt6(hit.clientMAC));
             }
 
             uint32_t temp = probeFloodCount;
@@ -1080,40 +1168,40 @@ void probeFloodDetectionTask(void *pv) {
             results += " probes\n";
         }
         
-        antihunter::lastResults = results;
+        antihunter::setResultsLocked(results, RESULTS_BODY_NONE);
     }
 
-    startAPAndServer();
+    ensureAPAndServer();
     blueTeamTaskHandle = nullptr;
     vTaskDelete(nullptr);
 }
 
-// Main NimBLE callback
+static const uint32_t BLE_SNIFF_REPOST_MS = 1000;
+// Sniffer BLE reposts have their own queue: with more devices in range
+// than DEDUPE_SLOTS they can outrun the drain while WiFi.scanNetworks
+// blocks, and in macQueue they would crowd out Wi-Fi target frames.
+// Created once and reset per scan, since the BLE callback may still hold it.
+static const UBaseType_t BLE_SNIFF_QUEUE_LEN = 256;
+static QueueHandle_t bleSniffQueue = nullptr;
+
+// Main NimBLE callback. Works on the raw address and payload; only a
+// device that is passed on (a match, or any device for the sniffer) has
+// its name copied out.
 class MyBLEAdvertisedDeviceCallbacks : public NimBLEAdvertisedDeviceCallbacks {
+  public:
+    // Sniffer: every device goes to bleSniffQueue, at most once per
+    // BLE_SNIFF_REPOST_MS unless more than DEDUPE_SLOTS are in range
+    bool sniffAll = false;
+    DedupeCache recent;
+
     void onResult(NimBLEAdvertisedDevice* advertisedDevice) {
         bleFramesSeen = bleFramesSeen + 1;
+        mBleFrames.inc();
+        bleAdvertSeen();
 
         uint8_t mac[6];
         NimBLEAddress addr = advertisedDevice->getAddress();
-        String macStr = addr.toString().c_str();
-        if (!parseMac6(macStr, mac)) return;
-
-        String deviceName = "Unknown";
-        if (advertisedDevice->haveName()) {
-            std::string nimbleName = advertisedDevice->getName();
-            if (nimbleName.length() > 0) {
-                deviceName = "";
-                for (size_t i = 0; i < nimbleName.length() && i < 31; i++) {
-                    uint8_t c = (uint8_t)nimbleName[i];
-                    if (c >= 32 && c <= 126) {
-                        deviceName += (char)c;
-                    }
-                }
-                if (deviceName.length() == 0) {
-                    deviceName = "Unknown";
-                }
-            }
-        }
+        advMacFromNative(addr.getNative(), mac);
 
         if (trackerMode) {
             if (isTrackerTarget(mac)) {
@@ -1121,58 +1209,81 @@ class MyBLEAdvertisedDeviceCallbacks : public NimBLEAdvertisedDeviceCallbacks {
                 trackerLastSeen = millis();
                 trackerPackets =    trackerPackets + 1;
             }
-        } else {
-            if (matchesMac(mac)) {
-                Hit h;
-                memcpy(h.mac, mac, 6);
-                h.rssi = advertisedDevice->getRSSI();
-                h.ch = 0;
-                strncpy(h.name, deviceName.c_str(), sizeof(h.name) - 1);
-                h.name[sizeof(h.name) - 1] = '\0';
-                h.isBLE = true;
-
-                if (macQueue) {
-                    if (xQueueSend(macQueue, &h, pdMS_TO_TICKS(10)) != pdTRUE) {
-                        Serial.printf("[BLE] Queue full for %s\n", macStr.c_str());
-                    }
-                }
+            return;
+        }
+        if (sniffAll) {
+            if (recent.seen(dedupeContentKey((const char *)mac, 6), millis(), BLE_SNIFF_REPOST_MS)) return;
+        } else if (!matchesMac(mac)) {
+            return;
+        }
+
+        AdvFields adv;
+        advParse(advertisedDevice->getPayload(), advertisedDevice->getPayloadLength(), adv);
+        Hit h;
+        memcpy(h.mac, mac, 6);
+        h.rssi = advertisedDevice->getRSSI();
+        h.ch = 0;
+        if (!advCopyName(adv.name, h.name, sizeof(h.name))) strcpy(h.name, "Unknown");
+        h.isBLE = true;
+
+        if (sniffAll) {
+            // A repost can wait for the next one; don't stall the BLE host task
+            if (bleSniffQueue && xQueueSend(bleSniffQueue, &h, 0) != pdTRUE) mDropBleSniff.inc();
+        } else if (macQueue) {
+            if (xQueueSend(macQueue, &h, pdMS_TO_TICKS(10)) != pdTRUE) {
+                mDropMac.inc();
+                Serial.printf("[BLE] Queue full for %s\n", macFmt6(mac).c_str());
             }
         }
     }
 };
 
+static MyBLEAdvertisedDeviceCallbacks bleHitCallbacks;
+
 // BLE Attack Callback
 class BLEAttackDetector : public NimBLEAdvertisedDeviceCallbacks {
 private:
-    std::map<String, std::vector<uint32_t>> deviceTimings;
-    std::map<String, String> lastDeviceNames;
+    // Per device, keyed on the packed address
+    struct DeviceState {
+        std::vector<uint32_t> timings;
+        uint32_t firstSeen = 0;
+        uint32_t nameHash = 0;      // 0 until a name is seen
+    };
+    std::map<uint64_t, DeviceState> devices;
     uint32_t lastCleanup = 0;
     
 public:
+    // Only while the scan is stopped; the callback runs on the NimBLE task
+    void reset() {
+        devices.clear();
+        lastCleanup = 0;
+    }
+
     void onResult(NimBLEAdvertisedDevice* advertisedDevice) {
+        bleAdvertSeen();
         uint8_t mac[6];
         NimBLEAddress addr = advertisedDevice->getAddress();
-        String macStr = addr.toString().c_str();
-        if (!parseMac6(macStr, mac)) return;
+        advMacFromNative(addr.getNative(), mac);
+        uint64_t key = 0;
+        for (int i = 0; i < 6; i++) key = key << 8 | mac[i];
         
         uint32_t now = millis();
         
         // Track timing
-        deviceTimings[macStr].push_back(now);
+        DeviceState &dev = devices[key];
+        if (dev.timings.empty() && !dev.firstSeen) dev.firstSeen = now;
+        dev.timings.push_back(now);
         
         // Clean old entries every 5 seconds
         if (now - lastCleanup > 5000) {
-            for (auto& entry : deviceTimings) {
-                entry.second.erase(
-                    std::remove_if(entry.second.begin(), entry.second.end(),
-                        [now](uint32_t t) { return now - t > BLE_TIMING_WINDOW; }),
-                    entry.second.end()
-                );
-            }
-            // Remove empty entries
-            for (auto it = deviceTimings.begin(); it != deviceTimings.end();) {
-                if (it->second.empty()) {
-                    it = deviceTimings.erase(it);
+            for (auto it = devices.begin(); it != devices.end();) {
+                auto &t = it->second.timings;
+                t.erase(std::remove_if(t.begin(), t.end(),
+                                       [now](uint32_t ts) { return now - ts > BLE_TIMING_WINDOW; }),
+                        t.end());
+                // Never the current device: its timing was just added
+                if (t.empty()) {
+                    it = devices.erase(it);
                 } else {
                     ++it;
                 }
@@ -1180,67 +1291,66 @@ public:
             lastCleanup = now;
         }
         
-        // Count packets in window
-        uint32_t packetsInWindow = deviceTimings[macStr].size();
+        // Every advert is reported, but only while the scan listens: the
+        // count over the window is scaled up by the listening share
+        uint32_t packetsInWindow = dev.timings.size();
+        float share = bleScanShare();
+        if (share <= 0) return;
+        float rate = packetsInWindow * 1000.0f / BLE_TIMING_WINDOW / share;
+        // Fast advertising is normal for a device's first 30 s
+        bool sustained = now - dev.firstSeen >= BLE_FAST_ADV_GRACE_MS;
+        
+        AdvFields adv;
+        advParse(advertisedDevice->getPayload(), advertisedDevice->getPayloadLength(), adv);
         
         bool isSpam = false;
-        String spamType = "";
-        uint16_t companyId = 0;
-        
-        // Check manufacturer data
-        if (advertisedDevice->haveManufacturerData()) {
-            std::string manData = advertisedDevice->getManufacturerData();
-            if (manData.length() >= 2) {
-                companyId = (manData[1] << 8) | manData[0];
-                
-                if (companyId == 0x004C && packetsInWindow >= 15) {  // Apple
-                    isSpam = true;
-                    spamType = "Apple spam";
-                }
-                else if ((companyId == 0x00E0 || companyId == 0xFE2C) && 
-                         packetsInWindow >= 20) {  // Google Fast Pair
-                    isSpam = true;
-                    spamType = "Fast Pair spam";
-                }
-                else if (companyId == 0x0075 && packetsInWindow >= 20) {  // Samsung
-                    isSpam = true;
-                    spamType = "Samsung spam";
-                }
-            }
+        const char *spamType = "";
+        uint16_t companyId = adv.companyId;
+        
+        // Fast Pair is announced as service data (UUID 0xFE2C), not a company id
+        if (sustained && companyId == 0x004C && rate >= BLE_APPLE_SPAM_RATE) {  // Apple
+            isSpam = true;
+            spamType = "Apple spam";
+        }
+        else if (sustained && (companyId == 0x00E0 || adv.serviceUuid == 0xFE2C) &&
+                 rate >= BLE_VENDOR_SPAM_RATE) {  // Google Fast Pair
+            isSpam = true;
+            spamType = "Fast Pair spam";
+        }
+        else if (sustained && companyId == 0x0075 && rate >= BLE_VENDOR_SPAM_RATE) {  // Samsung
+            isSpam = true;
+            spamType = "Samsung spam";
         }
         
         // Generic flood detection - much higher threshold
-        if (!isSpam && packetsInWindow >= 50) {
+        if (!isSpam && sustained && rate >= BLE_ADV_THRESHOLD) {
             isSpam = true;
             spamType = "BLE flood";
         }
         
-        // Check for name changes (spam indicator)
-        if (advertisedDevice->haveName()) {
-            String currentName = String(advertisedDevice->getName().c_str());
-            if (lastDeviceNames.find(macStr) != lastDeviceNames.end()) {
-                if (lastDeviceNames[macStr] != currentName && packetsInWindow >= 10) {
-                    isSpam = true;
-                    spamType = "Name-changing spam";
-                }
+        // Check for name changes (spam indicator); names are compared by hash
+        if (adv.name.len) {
+            uint32_t nameHash = advSpanHash(adv.name);
+            if (dev.nameHash && dev.nameHash != nameHash && rate >= BLE_NAME_CHANGE_RATE) {
+                isSpam = true;
+                spamType = "Name-changing spam";
             }
-            lastDeviceNames[macStr] = currentName;
+            dev.nameHash = nameHash;
         }
         
         if (isSpam) {
-            BLESpamHit hit;
+            BLESpamHit hit = {};
             memcpy(hit.mac, mac, 6);
-            hit.advType = 0;
-            strncpy(hit.deviceName, advertisedDevice->haveName() ? 
-                    advertisedDevice->getName().c_str() : "", sizeof(hit.deviceName) - 1);
+            hit.advType = advertisedDevice->getAdvType();
+            advCopyName(adv.name, hit.deviceName, sizeof(hit.deviceName));
             hit.rssi = advertisedDevice->getRSSI();
             hit.timestamp = now;
-            hit.advCount = packetsInWindow;
-            strncpy(hit.spamType, spamType.c_str(), sizeof(hit.spamType) - 1);
+            hit.advCount = (uint32_t)(rate + 0.5f);
+            strncpy(hit.spamType, spamType, sizeof(hit.spamType) - 1);
             hit.companyId = companyId;
             
             if (bleSpamQueue && bleSpamLog.size() < 500) {
-                xQueueSend(bleSpamQueue, &hit, 0);
+                if (xQueueSend(bleSpamQueue, &hit, 0) != pdTRUE) mDropBleSpam.inc();
                 uint32_t temp = bleSpamCount;
                 bleSpamCount = temp + 1;
             }
@@ -1248,6 +1358,8 @@ public:
     }
 };
 
+static BLEAttackDetector bleAttackDetector;
+
 void bleScannerTask(void *pv) {
     int duration = (int)(intptr_t)pv;
     bool forever = (duration <= 0);
@@ -1255,8 +1367,6 @@ void bleScannerTask(void *pv) {
     Serial.printf("[BLE-SEC] Starting BLE attack detection %s\n",
                   forever ? "(forever)" : ("for " + String(duration) + "s").c_str());
     
-    stopAPAndServer();
-    
     bleSpamLog.clear();
     bleAdvCounts.clear();
     bleAdvTimings.clear();
@@ -1271,12 +1381,9 @@ void bleScannerTask(void *pv) {
     bleSpamQueue = xQueueCreate(256, sizeof(BLESpamHit));
     bleAnomalyQueue = xQueueCreate(256, sizeof(BLEAnomalyHit));
     
-    BLEDevice::init("");
-    NimBLEScan* pBLEScan = BLEDevice::getScan();
-    pBLEScan->setAdvertisedDeviceCallbacks(new BLEAttackDetector());
-    pBLEScan->setActiveScan(false);
-    pBLEScan->setInterval(50);
-    pBLEScan->setWindow(30);
+    radioSetMode(radioGetMode() | RADIO_BLE);
+    bleAttackDetector.reset();
+    bleScanStart(&bleAttackDetector, false);
     
     uint32_t scanStart = millis();
     uint32_t nextStatus = millis() + 5000;
@@ -1287,23 +1394,20 @@ void bleScannerTask(void *pv) {
     while ((forever && !stopRequested) || 
            (!forever && (int)(millis() - scanStart) < duration * 1000 && !stopRequested)) {
         
-        pBLEScan->start(1, false);
-        
         while (xQueueReceive(bleSpamQueue, &spamHit, 0) == pdTRUE) {
             String alert = "BLE SPAM: ";
             alert += spamHit.spamType;
             alert += " MAC:" + macFmt6(spamHit.mac);
-            alert += " Count:" + String(spamHit.advCount);
+            alert += " Rate:" + String(spamHit.advCount) + "/s";
             alert += " RSSI:" + String(spamHit.rssi) + "dBm";
             
             Serial.println("[ALERT] " + alert);
             logToSD(alert);
+            pushAlertEvent("blespam", alert);
             
             if (meshEnabled) {
                 String meshAlert = getNodeId() + ": BLE-ATTACK: " + String(spamHit.spamType);
-                if (Serial1.availableForWrite() >= meshAlert.length()) {
-                    Serial1.println(meshAlert);
-                }
+                meshSend(MESH_ALERT, meshAlert, "blespam:" + String(spamHit.spamType));
             }
         }
         
@@ -1332,8 +1436,8 @@ void bleScannerTask(void *pv) {
     }
     
     bleSpamDetectionEnabled = false;
-    pBLEScan->stop();
-    BLEDevice::deinit(false);
+    bleScanStop();
+    radioSetMode(radioGetMode() & ~RADIO_BLE);
     
     {
         std::lock_guard<std::mutex> lock(antihunter::lastResultsMutex);
@@ -1341,7 +1445,8 @@ void bleScannerTask(void *pv) {
         std::string results = "BLE Attack Detection Results\n";
         results += "Duration: " + (forever ? "Forever" : std::to_string(duration)) + "s\n";
         results += "Spam attacks: " + std::to_string(bleSpamCount) + "\n";
-        results += "Anomalies: " + std::to_string(bleAnomalyCount) + "\n\n";
+        results += "Anomalies: " + std::to_string(bleAnomalyCount) + "\n";
+        results += "BLE scan: " + std::string(getBleScanInfo().c_str()) + "\n\n";
         
         std::map<String, uint32_t> spamTypes;
         for (const auto& hit : bleSpamLog) {
@@ -1352,14 +1457,126 @@ void bleScannerTask(void *pv) {
             results += std::string(entry.first.c_str()) + ": " + std::to_string(entry.second) + " attacks\n";
         }
         
-        antihunter::lastResults = results;
+        antihunter::setResultsLocked(results, RESULTS_BODY_NONE);
     }
     
-    startAPAndServer();
+    ensureAPAndServer();
     blueTeamTaskHandle = nullptr;
     vTaskDelete(nullptr);
 }
 
+// Sniffer cache maintenance; all three take cacheMutex
+
+static void cacheReset()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    apCache.clear();
+    bleDeviceCache.clear();
+    cacheChanges.clear();
+    cacheTombstones = 0;
+    cacheFloor = ++cacheSeq;
+}
+
+// Records a sighting; returns true if the key is new. Only a new name or
+// channel, or an RSSI move of CACHE_RSSI_DELTA, counts as a change.
+static bool cacheTouch(bool isBLE, const String &key, const String &name, int8_t rssi, uint8_t ch)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    std::map<String, CacheEntry> &cache = isBLE ? bleDeviceCache : apCache;
+    auto it = cache.find(key);
+    bool isNew = it == cache.end();
+    if (!isNew)
+    {
+        CacheEntry &e = it->second;
+        e.lastSeen = millis();
+        bool named = name != "Unknown" && name != e.name;
+        if (!named && ch == e.ch && abs(rssi - e.rssi) < CACHE_RSSI_DELTA)
+            return false;
+        if (named)
+            e.name = name;
+        e.ch = ch;
+        e.rssi = rssi;
+        cacheChanges.erase(e.seq);
+        e.seq = ++cacheSeq;
+        cacheChanges[e.seq] = {key, isBLE, false};
+        return false;
+    }
+    CacheEntry e = {name, rssi, ch, ++cacheSeq, (uint32_t)millis()};
+    cache[key] = e;
+    cacheChanges[e.seq] = {key, isBLE, false};
+    return true;
+}
+
+// Drops entries not seen for CACHE_TTL_MS and leaves tombstones; once the
+// tombstone list is full the oldest go and deltas from before them resync.
+static void cacheExpire()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    uint32_t now = millis();
+    for (int pass = 0; pass < 2; pass++)
+    {
+        bool isBLE = pass == 1;
+        std::map<String, CacheEntry> &cache = isBLE ? bleDeviceCache : apCache;
+        for (auto it = cache.begin(); it != cache.end();)
+        {
+            if (now - it->second.lastSeen < CACHE_TTL_MS)
+            {
+                ++it;
+                continue;
+            }
+            cacheChanges.erase(it->second.seq);
+            cacheChanges[++cacheSeq] = {it->first, isBLE, true};
+            cacheTombstones++;
+            it = cache.erase(it);
+        }
+    }
+    for (auto it = cacheChanges.begin(); cacheTombstones > CACHE_TOMBSTONE_MAX && it != cacheChanges.end();)
+    {
+        if (!it->second.removed)
+        {
+            ++it;
+            continue;
+        }
+        cacheFloor = it->first;
+        cacheTombstones--;
+        it = cacheChanges.erase(it);
+    }
+}
+
+// Records one device seen by the sniffer, unless cacheTouch says it is a
+// repeat
+static void recordSnifferHit(const Hit &h)
+{
+    String macStr = macFmt6(h.mac);
+    if (!cacheTouch(h.isBLE, macStr, h.name, h.rssi, h.isBLE ? 0 : h.ch))
+        return;
+
+    uniqueMacs.insert(macStr);
+    totalHits = totalHits + 1;
+    {
+        std::lock_guard<std::mutex> lock(antihunter::lastResultsMutex);
+        hitStore.add(h, millis());
+    }
+    pushHitEvent(h);
+
+    String logEntry = h.isBLE ? "BLE Device: " + macStr + " Name: " + String(h.name)
+                              : "WiFi Device: " + macStr + " CH: " + String(h.ch);
+    logEntry += " RSSI: " + String(h.rssi) + "dBm";
+
+    if (gpsValid)
+    {
+        logEntry += " GPS: " + String(gpsLat, 6) + "," + String(gpsLon, 6);
+    }
+
+    Serial.println("[SNIFFER] " + logEntry);
+    logToSD(logEntry);
+
+    if (matchesMac(h.mac))
+    {
+        sendMeshNotification(h);
+    }
+}
+
 void snifferScanTask(void *pv)
 {
     String modeStr = (currentScanMode == SCAN_WIFI) ? "WiFi" : 
@@ -1371,15 +1588,20 @@ void snifferScanTask(void *pv)
     Serial.printf("[SNIFFER] Starting device scan %s\n",
                   forever ? "(forever)" : String("for " + String(duration) + "s").c_str());
 
-    stopAPAndServer();
-
+    if (macQueue) vQueueDelete(macQueue);
+    macQueue = xQueueCreate(512, sizeof(Hit));
+    if (bleSniffQueue) xQueueReset(bleSniffQueue);
+    else bleSniffQueue = xQueueCreate(BLE_SNIFF_QUEUE_LEN, sizeof(Hit));
     radioStartSTA();
 
     scanning = true;
     uniqueMacs.clear();
-    hitsLog.clear();
-    apCache.clear();
-    bleDeviceCache.clear();
+    {
+        std::lock_guard<std::mutex> lock(antihunter::lastResultsMutex);
+        hitStore.clear();
+        antihunter::setResultsLocked("Sniffer scan in progress (live)\n\n", RESULTS_BODY_SNIFFER_HITS);
+    }
+    cacheReset();
     totalHits = 0;
     framesSeen = 0;
     bleFramesSeen = 0;
@@ -1389,18 +1611,13 @@ void snifferScanTask(void *pv)
     lastScanForever = forever;
 
     int networksFound = 0;
-    unsigned long lastBLEScan = 0;
     unsigned long lastWiFiScan = 0;
-    const unsigned long BLE_SCAN_INTERVAL = 8000;
     const unsigned long WIFI_SCAN_INTERVAL = 5000;
 
-    NimBLEScan *bleScan = nullptr;
-
-    BLEDevice::init("");
-    bleScan = BLEDevice::getScan();
-    bleScan->setActiveScan(true);
-    bleScan->setInterval(100);
-    bleScan->setWindow(99);
+    // BLE runs continuously and posts every device to bleSniffQueue; it
+    // keeps filling while WiFi.scanNetworks blocks
+    radioSetMode(radioGetMode() | RADIO_BLE);
+    radioStartBLE(true);
 
     while ((forever && !stopRequested) ||
            (!forever && (int)(millis() - lastScanStart) < duration * 1000 && !stopRequested))
@@ -1426,9 +1643,8 @@ void snifferScanTask(void *pv)
                         ssid = "[Hidden]";
                     }
 
-                    if (apCache.find(bssid) == apCache.end())
+                    if (cacheTouch(false, bssid, ssid, rssi, WiFi.channel(i)))
                     {
-                        apCache[bssid] = ssid;
                         uniqueMacs.insert(bssid);
                         totalHits = totalHits + 1;
                         framesSeen = framesSeen + 1;
@@ -1441,7 +1657,11 @@ void snifferScanTask(void *pv)
                         h.name[sizeof(h.name) - 1] = '\0';
                         h.isBLE = false;
 
-                        hitsLog.push_back(h);
+                        {
+                            std::lock_guard<std::mutex> lock(antihunter::lastResultsMutex);
+                            hitStore.add(h, millis());
+                        }
+                        pushHitEvent(h);
 
                         String logEntry = "WiFi AP: " + bssid + " SSID: " + ssid +
                                           " RSSI: " + String(rssi) + "dBm CH: " + String(WiFi.channel(i));
@@ -1467,97 +1687,23 @@ void snifferScanTask(void *pv)
             vTaskDelay(pdMS_TO_TICKS(10));
         }
 
-        if (millis() - lastBLEScan >= BLE_SCAN_INTERVAL || lastBLEScan == 0)
-        {
-            lastBLEScan = millis();
-
-            Serial.println("[SNIFFER] Scanning BLE devices...");
-
-            if (bleScan)
-            {
-                // esp_task_wdt_reset();
-                BLEScanResults scanResults = bleScan->start(1, false);
-
-                for (int i = 0; i < scanResults.getCount(); i++)
-                {
-                    BLEAdvertisedDevice device = scanResults.getDevice(i);
-                    String macStr = device.getAddress().toString().c_str();
-
-                    if (bleDeviceCache.find(macStr) == bleDeviceCache.end())
-                    {
-                        String name = device.haveName() ? device.getName().c_str() : "Unknown";
-
-                        String cleanName = "";
-                        for (size_t j = 0; j < name.length(); j++)
-                        {
-                            char c = name[j];
-                            if (c >= 32 && c <= 126)
-                            {
-                                cleanName += c;
-                            }
-                        }
-                        if (cleanName.length() == 0)
-                            cleanName = "Unknown";
-
-                        bleDeviceCache[macStr] = cleanName;
-                        uniqueMacs.insert(macStr);
-                        totalHits = totalHits + 1;
-                        bleFramesSeen = bleFramesSeen + 1;
-
-                        uint8_t mac[6];
-                        if (parseMac6(macStr, mac))
-                        {
-                            Hit h;
-                            memcpy(h.mac, mac, 6);
-                            h.rssi = device.getRSSI();
-                            h.ch = 0;
-                            strncpy(h.name, cleanName.c_str(), sizeof(h.name) - 1);
-                            h.name[sizeof(h.name) - 1] = '\0';
-                            h.isBLE = true;
-
-                            hitsLog.push_back(h);
-
-                            String logEntry = "BLE Device: " + macStr + " Name: " + cleanName +
-                                              " RSSI: " + String(device.getRSSI()) + "dBm";
-
-                            if (gpsValid)
-                            {
-                                logEntry += " GPS: " + String(gpsLat, 6) + "," + String(gpsLon, 6);
-                            }
-
-                            Serial.println("[SNIFFER] " + logEntry);
-                            logToSD(logEntry);
-
-                            if (matchesMac(mac))
-                            {
-                                sendMeshNotification(h);
-                            }
-                        }
-                    }
-                }
-
-                bleScan->clearResults();
-                Serial.printf("[SNIFFER] BLE scan found %d devices\n", scanResults.getCount());
-                vTaskDelay(pdMS_TO_TICKS(10));
-            }
-        }
+        // Wi-Fi target frames from promiscuous RX when it is on, then BLE
+        // devices from the scan callback
+        Hit h;
+        while (xQueueReceive(macQueue, &h, 0) == pdTRUE)
+            recordSnifferHit(h);
+        while (xQueueReceive(bleSniffQueue, &h, 0) == pdTRUE)
+            recordSnifferHit(h);
 
+        cacheExpire();
         Serial.printf("[SNIFFER] Total: WiFi APs=%d, BLE=%d, Unique=%d, Hits=%d\n",
                       apCache.size(), bleDeviceCache.size(), uniqueMacs.size(), totalHits);
 
         vTaskDelay(pdMS_TO_TICKS(200));
     }
 
-    if (bleScan)
-    {
-        bleScan->stop();
-        delay(100);
-        BLEDevice::deinit(false);
-        delay(200);
-    }
+    radioStopSTA();
 
-    stopAPAndServer();
-    
     scanning = false;
     lastScanEnd = millis();
 
@@ -1570,61 +1716,323 @@ void snifferScanTask(void *pv)
             "WiFi Frames seen: " + std::to_string(framesSeen) + "\n" +
             "BLE Frames seen: " + std::to_string(bleFramesSeen) + "\n" +
             "Total hits: " + std::to_string(totalHits) + "\n" +
-            "Unique devices: " + std::to_string(uniqueMacs.size()) + "\n\n";
+            "Unique devices: " + std::to_string(uniqueMacs.size()) + "\n" +
+            "BLE scan: " + getBleScanInfo().c_str() + "\n\n";
         
-        std::vector<Hit> sortedHits = hitsLog;
-        std::sort(sortedHits.begin(), sortedHits.end(), 
-                [](const Hit& a, const Hit& b) { return a.rssi > b.rssi; });
+        antihunter::setResultsLocked(results, RESULTS_BODY_SNIFFER_HITS);
+    }
 
-        int shown = 0;
-        for (const auto& hit : sortedHits) {
-            if (shown++ >= 100) break;
-            
-            results += (hit.isBLE ? "BLE  " : "WiFi ");
-            results += macFmt6(hit.mac).c_str();
-            results += " RSSI=" + std::to_string(hit.rssi) + "dBm";
-            
-            if (!hit.isBLE && hit.ch > 0) {
-                results += " CH=" + std::to_string(hit.ch);
+    vTaskDelay(pdMS_TO_TICKS(100));
+    
+    ensureAPAndServer();
+    workerTaskHandle = nullptr;
+    vTaskDelete(nullptr);
+}
+
+// ================================
+// CHUNKED TEXT RENDERING
+// ================================
+
+size_t streamLines(TextCursor &c, LineSource next, uint8_t *buf, size_t maxLen)
+{
+    size_t out = 0;
+    while (out < maxLen)
+    {
+        if (c.pos >= c.len)
+        {
+            if (c.done)
+                break;
+            c.len = 0;
+            c.pos = 0;
+            if (!next(c))
+            {
+                c.done = true;
             }
-            
-            if (strlen(hit.name) > 0 && strcmp(hit.name, "WiFi") != 0 && strcmp(hit.name, "Unknown") != 0) {
-                results += " \"";
-                results += hit.name;
-                results += "\"";
+            continue;
+        }
+        size_t n = std::min((size_t)(c.len - c.pos), maxLen - out);
+        memcpy(buf + out, c.line + c.pos, n);
+        c.pos += n;
+        out += n;
+    }
+    return out;
+}
+
+bool cursorPrintf(TextCursor &c, const char *fmt, ...)
+{
+    if (c.len >= sizeof(c.line) - 1)
+        return true;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(c.line + c.len, sizeof(c.line) - c.len, fmt, ap);
+    va_end(ap);
+    if (n > 0)
+        c.len = std::min((size_t)(c.len + n), sizeof(c.line) - 1);
+    return true;
+}
+
+static void printMac(TextCursor &c, const uint8_t *m)
+{
+    cursorPrintf(c, "%02X:%02X:%02X:%02X:%02X:%02X", m[0], m[1], m[2], m[3], m[4], m[5]);
+}
+
+static void printHitLine(TextCursor &c, const Hit &e, ResultsBody style)
+{
+    bool named = strlen(e.name) > 0 && strcmp(e.name, "WiFi") != 0 && strcmp(e.name, "Unknown") != 0;
+    if (style == RESULTS_BODY_LIST_HITS)
+    {
+        cursorPrintf(c, "%s ", e.isBLE ? "BLE " : "WiFi");
+        printMac(c, e.mac);
+        cursorPrintf(c, " RSSI=%ddBm", e.rssi);
+        if (!e.isBLE && e.ch > 0)
+            cursorPrintf(c, " CH=%u", e.ch);
+        if (named)
+            cursorPrintf(c, " Name=%s", e.name);
+    }
+    else
+    {
+        cursorPrintf(c, "%s", e.isBLE ? "BLE  " : "WiFi ");
+        printMac(c, e.mac);
+        cursorPrintf(c, " RSSI=%ddBm", e.rssi);
+        if (!e.isBLE && e.ch > 0)
+            cursorPrintf(c, " CH=%u", e.ch);
+        if (named)
+            cursorPrintf(c, " \"%s\"", e.name);
+    }
+    cursorPrintf(c, "\n");
+}
+
+enum
+{
+    RESULTS_HEADER,
+    RESULTS_HITS,
+    RESULTS_MORE,
+    RESULTS_TRI_GAP,
+    RESULTS_TRI,
+    RESULTS_DONE
+};
+
+// /results: lastResults text, then the hit store, then triangulation
+bool resultsNextLine(TextCursor &c)
+{
+    std::lock_guard<std::mutex> lock(antihunter::lastResultsMutex);
+
+    if (c.section == RESULTS_HEADER && c.index == 0)
+    {
+        c.gen = antihunter::lastResultsGen;
+        c.limit = antihunter::lastResultsBody == RESULTS_BODY_LIST_HITS ? 200 : 100;
+    }
+    else if (c.section != RESULTS_DONE && c.gen != antihunter::lastResultsGen)
+    {
+        c.section = RESULTS_DONE;
+        return cursorPrintf(c, "\n[results changed, reload]\n");
+    }
+
+    ResultsBody body = antihunter::lastResultsBody;
+    for (;;)
+    {
+        switch (c.section)
+        {
+        case RESULTS_HEADER:
+        {
+            const std::string &text = antihunter::lastResults;
+            if (text.empty())
+            {
+                c.section = RESULTS_HITS;
+                return cursorPrintf(c, "None yet.");
             }
-            
-            results += "\n";
+            if (c.index < text.size())
+            {
+                size_t n = std::min(text.size() - c.index, sizeof(c.line) - 1);
+                memcpy(c.line, text.data() + c.index, n);
+                c.len = n;
+                c.index += n;
+                return true;
+            }
+            c.section = RESULTS_HITS;
+            c.index = 0;
+            break;
         }
-        
-        if (sortedHits.size() > 100) {
-            results += "... (" + std::to_string(sortedHits.size() - 100) + " more)\n";
+        case RESULTS_HITS:
+            if (body != RESULTS_BODY_NONE && c.index < c.limit)
+            {
+                // Strongest first straight off the RSSI index
+                HitQuery q;
+                q.byRssi = true;
+                StoredHit s;
+                if (hitStore.next(q, c.hitPos, s))
+                {
+                    c.index++;
+                    printHitLine(c, s.hit, body);
+                    return true;
+                }
+            }
+            c.section = RESULTS_MORE;
+            break;
+        case RESULTS_MORE:
+            c.section = RESULTS_TRI_GAP;
+            if (body != RESULTS_BODY_NONE && hitStore.size() > c.limit)
+            {
+                return cursorPrintf(c, "... (%u more)\n", (unsigned)(hitStore.size() - c.limit));
+            }
+            break;
+        case RESULTS_TRI_GAP:
+            if (!hasTriangulationData())
+            {
+                c.section = RESULTS_DONE;
+                break;
+            }
+            c.section = RESULTS_TRI;
+            c.index = 0;
+            return cursorPrintf(c, "\n\n");
+        case RESULTS_TRI:
+            if (triangulationNextLine(c))
+                return true;
+            c.section = RESULTS_DONE;
+            break;
+        default:
+            return false;
         }
+    }
+}
 
-        antihunter::lastResults = results;
+// /deauth-results: counters then up to 100 entries from deauthLog
+bool deauthResultsNextLine(TextCursor &c)
+{
+    std::lock_guard<std::mutex> lock(deauthLogMutex);
+    switch (c.section)
+    {
+    case 0:
+        c.section = 1;
+        return cursorPrintf(c, "Deauth Detection Results\nDeauth frames: %u\nDisassoc frames: %u\n\n",
+                            (unsigned)deauthCount, (unsigned)disassocCount);
+    case 1:
+        if (c.index < deauthLog.size() && c.index < 100)
+        {
+            const DeauthHit hit = deauthLog[c.index++];
+            cursorPrintf(c, "%s ", hit.isDisassoc ? "DISASSOC" : "DEAUTH");
+            printMac(c, hit.srcMac);
+            cursorPrintf(c, " -> ");
+            printMac(c, hit.destMac);
+            cursorPrintf(c, " BSSID:");
+            printMac(c, hit.bssid);
+            return cursorPrintf(c, " RSSI:%ddBm CH:%u Reason:%u\n", hit.rssi, hit.channel, hit.reasonCode);
+        }
+        return false;
+    default:
+        return false;
     }
+}
 
-    vTaskDelay(pdMS_TO_TICKS(100));
-    
-    startAPAndServer();
-    workerTaskHandle = nullptr;
-    vTaskDelete(nullptr);
+// Resumes a map walk after the last key emitted, safe against inserts between chunks
+static bool nextCacheEntry(TextCursor &c, const std::map<String, CacheEntry> &cache)
+{
+    auto it = c.index == 0 ? cache.begin() : cache.upper_bound(c.key);
+    if (it == cache.end())
+        return false;
+    c.key = it->first;
+    c.index++;
+    return cursorPrintf(c, "%s : %s\n", it->first.c_str(), it->second.name.c_str());
+}
+
+// /sniffer-cache: WiFi AP cache then BLE device cache
+bool snifferCacheNextLine(TextCursor &c)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    for (;;)
+    {
+        switch (c.section)
+        {
+        case 0:
+            c.section = 1;
+            return cursorPrintf(c, "=== Sniffer Cache ===\n\nWiFi APs: %u\n", (unsigned)apCache.size());
+        case 1:
+            if (nextCacheEntry(c, apCache))
+                return true;
+            c.section = 2;
+            c.index = 0;
+            return cursorPrintf(c, "\nBLE Devices: %u\n", (unsigned)bleDeviceCache.size());
+        case 2:
+            return nextCacheEntry(c, bleDeviceCache);
+        default:
+            return false;
+        }
+    }
 }
 
-String getSnifferCache()
+// Caller holds cacheMutex
+static void printCacheChange(TextCursor &c, uint32_t seq, const CacheChange &ch)
 {
-    String result = "=== Sniffer Cache ===\n\n";
-    result += "WiFi APs: " + String(apCache.size()) + "\n";
-    for (const auto &entry : apCache)
+    if (ch.removed)
     {
-        result += entry.first + " : " + entry.second + "\n";
+        cursorPrintf(c, "- %u %c %s\n", (unsigned)seq, ch.isBLE ? 'B' : 'W', ch.key.c_str());
+        return;
     }
-    result += "\nBLE Devices: " + String(bleDeviceCache.size()) + "\n";
-    for (const auto &entry : bleDeviceCache)
+    const std::map<String, CacheEntry> &cache = ch.isBLE ? bleDeviceCache : apCache;
+    auto it = cache.find(ch.key);
+    if (it == cache.end())
+        return;
+    const CacheEntry &e = it->second;
+    cursorPrintf(c, "%c %u %s %d %u %s\n", ch.isBLE ? 'B' : 'W', (unsigned)seq, ch.key.c_str(),
+                 e.rssi, e.ch, e.name.c_str());
+}
+
+// /sniffer-cache?since=N, c.index holds N on entry and then the last seq
+// sent. Header: "seq <head> since <N> [reset]"; with reset the client drops
+// its copy first. Lines: "W|B <seq> <mac> <rssi> <ch> <name>" for new or
+// changed entries, "- <seq> W|B <mac>" for removals. A final "! resync"
+// means the cache was reset mid-stream.
+bool snifferCacheDeltaNextLine(TextCursor &c)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (c.section == 0)
     {
-        result += entry.first + " : " + entry.second + "\n";
+        c.section = 1;
+        c.gen = cacheFloor;
+        bool reset = c.index < cacheFloor;
+        cursorPrintf(c, "seq %u since %u%s\n", (unsigned)cacheSeq, (unsigned)c.index, reset ? " reset" : "");
+        if (reset)
+            c.index = 0;
+        return true;
     }
-    return result;
+    if (c.gen != cacheFloor)
+    {
+        cursorPrintf(c, "! resync\n");
+        return false;
+    }
+    auto it = cacheChanges.upper_bound(c.index);
+    if (it == cacheChanges.end())
+        return false;
+    c.index = it->first;
+    printCacheChange(c, it->first, it->second);
+    return true;
+}
+
+std::vector<String> snifferCacheDelta(uint32_t since, size_t maxEntries, uint32_t &next, bool &more, bool &reset)
+{
+    std::vector<String> out;
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    reset = since < cacheFloor;
+    if (reset)
+        since = 0;
+    next = since;
+    auto it = cacheChanges.upper_bound(since);
+    for (; it != cacheChanges.end() && out.size() < maxEntries; ++it)
+    {
+        TextCursor c;
+        printCacheChange(c, it->first, it->second);
+        next = it->first;
+        if (c.len == 0)
+            continue;
+        if (c.line[c.len - 1] == '\n')
+            c.len--;
+        c.line[c.len] = '\0';
+        out.push_back(String(c.line));
+    }
+    more = it != cacheChanges.end();
+    if (!more)
+        next = cacheSeq;
+    return out;
 }
 
 void blueTeamTask(void *pv) {
@@ -1635,9 +2043,10 @@ void blueTeamTask(void *pv) {
                               : String("[BLUE] Starting deauth detection for " + String(duration) + "s\n");
     Serial.print(startMsg);
 
-    stopAPAndServer();
-    
-    deauthLog.clear();
+    {
+        std::lock_guard<std::mutex> lock(deauthLogMutex);
+        deauthLog.clear();
+    }
     deauthCount = 0;
     disassocCount = 0;
     deauthDetectionEnabled = true;
@@ -1669,8 +2078,11 @@ void blueTeamTask(void *pv) {
             while (processed++ < BATCH_LIMIT && xQueueReceive(deauthQueue, &hit, 0) == pdTRUE) {
                 
 
-                if (deauthLog.size() < 1000) {
-                    deauthLog.push_back(hit);
+                {
+                    std::lock_guard<std::mutex> lock(deauthLogMutex);
+                    if (deauthLog.size() < 1000) {
+                        deauthLog.push_back(hit);
+                    }
                 }
                 
                 String alert = String(hit.isDisassoc ? "DISASSOC" : "DEAUTH");
@@ -1685,15 +2097,14 @@ void blueTeamTask(void *pv) {
 
                 Serial.println("[ALERT] " + alert);
                 logToSD(alert);
+                pushAlertEvent("deauth", alert);
 
                 if (meshEnabled) {
                     String meshAlert = getNodeId() + ": ATTACK: " + alert;
                     if (gpsValid) {
                         meshAlert += " GPS:" + String(gpsLat, 6) + "," + String(gpsLon, 6);
                     }
-                    if (Serial1.availableForWrite() >= (int)meshAlert.length()) {
-                        Serial1.println(meshAlert);
-                    }
+                    meshSend(MESH_ALERT, meshAlert, "attack:" + macFmt6(hit.srcMac));
                 }
             }
         
@@ -1729,6 +2140,7 @@ void blueTeamTask(void *pv) {
 
     {
         std::lock_guard<std::mutex> lock(antihunter::lastResultsMutex);
+        std::lock_guard<std::mutex> logLock(deauthLogMutex);
         
         std::string results = "Deauth Detection Results\n";
         results += "Duration: " + (forever ? "Forever" : std::to_string(duration)) + "s\n";
@@ -1760,12 +2172,11 @@ void blueTeamTask(void *pv) {
             results += "... (" + std::to_string((int)deauthLog.size() - show) + " more)\n";
         }
         
-        antihunter::lastResults = results;
+        antihunter::setResultsLocked(results, RESULTS_BODY_NONE);
     }
 
     
-    startAPAndServer();
-    vTaskDelay(pdMS_TO_TICKS(1000));
+    ensureAPAndServer();
     blueTeamTaskHandle = nullptr;
     vTaskDelete(nullptr);
 }
@@ -1777,8 +2188,6 @@ void beaconFloodTask(void *pv) {
     Serial.printf("[BEACON] Starting beacon flood detection %s\n",
                   forever ? "(forever)" : ("for " + String(duration) + "s").c_str());
 
-    stopAPAndServer();
-
     beaconLog.clear();
     beaconCounts.clear();
     beaconLastSeen.clear();
@@ -1814,13 +2223,14 @@ void beaconFloodTask(void *pv) {
 
             Serial.println("[ALERT] " + alert);
             logToSD(alert);
+            pushAlertEvent("beacon", alert);
 
             if (meshEnabled) {
                 String meshAlert = getNodeId() + ": FLOOD: " + alert;
                 if (gpsValid) {
                     meshAlert += " GPS:" + String(gpsLat, 6) + "," + String(gpsLon, 6);
                 }
-                Serial1.println(meshAlert);
+                meshSend(MESH_ALERT, meshAlert, "flood:" + macFmt6(hit.srcMac));
             }
         }
 
@@ -1874,19 +2284,26 @@ void beaconFloodTask(void *pv) {
             results += "... (" + std::to_string((int)sorted.size() - show) + " more MACs)\n";
         }
         
-        antihunter::lastResults = results;
+        antihunter::setResultsLocked(results, RESULTS_BODY_NONE);
     }
 
-    startAPAndServer();
+    ensureAPAndServer();
     blueTeamTaskHandle = nullptr;
     vTaskDelete(nullptr);
 }
 
+static void snifferFrame(const wifi_promiscuous_pkt_t *ppkt);
+
 static void IRAM_ATTR sniffer_cb(void *buf, wifi_promiscuous_pkt_type_t type)
 {
+    int64_t t0 = esp_timer_get_time();
+    snifferFrame((const wifi_promiscuous_pkt_t *)buf);
+    mRxCallbackUs.observe((uint32_t)(esp_timer_get_time() - t0));
+}
 
-    const wifi_promiscuous_pkt_t *ppkt = (wifi_promiscuous_pkt_t *)buf;
-
+static void IRAM_ATTR snifferFrame(const wifi_promiscuous_pkt_t *ppkt)
+{
+    int64_t t0 = esp_timer_get_time();
     detectPwnagotchi(ppkt);
     detectPineapple(ppkt);
     detectMultiSSID(ppkt);
@@ -1897,8 +2314,10 @@ static void IRAM_ATTR sniffer_cb(void *buf, wifi_promiscuous_pkt_type_t type)
     detectProbeFlood(ppkt);
     detectEvilTwin(ppkt);
     detectEAPOLHarvesting(ppkt);
+    mDetectorsUs.observe((uint32_t)(esp_timer_get_time() - t0));
 
     framesSeen = framesSeen + 1;
+    mWifiFrames.inc();
     if (!ppkt || ppkt->rx_ctrl.sig_len < 24)
         return;
 
@@ -2015,7 +2434,7 @@ static void IRAM_ATTR sniffer_cb(void *buf, wifi_promiscuous_pkt_type_t type)
             BaseType_t w = false;
             if (macQueue)
             {
-                xQueueSendFromISR(macQueue, &h, &w);
+                if (xQueueSendFromISR(macQueue, &h, &w) != pdTRUE) mDropMac.inc();
                 if (w)
                     portYIELD_FROM_ISR();
             }
@@ -2033,7 +2452,7 @@ static void IRAM_ATTR sniffer_cb(void *buf, wifi_promiscuous_pkt_type_t type)
             BaseType_t w = false;
             if (macQueue)
             {
-                xQueueSendFromISR(macQueue, &h, &w);
+                if (xQueueSendFromISR(macQueue, &h, &w) != pdTRUE) mDropMac.inc();
                 if (w)
                     portYIELD_FROM_ISR();
             }
@@ -2042,47 +2461,26 @@ static void IRAM_ATTR sniffer_cb(void *buf, wifi_promiscuous_pkt_type_t type)
 }
 
 // ---------- Radio common ----------
-static void radioStartWiFi()
+// Driver bring-up/teardown lives in the radio state machine (radio_esp.cpp);
+// these only add the scan policy on top: channel hopping and BLE scan setup.
+static void stopChannelHop()
 {
-    // Clean initialization
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    esp_err_t err = esp_wifi_init(&cfg);
-    if (err != ESP_OK) {
-        Serial.printf("[RADIO] WiFi init error: %d\n", err);
-        return;
-    }
-    
-    WiFi.mode(WIFI_MODE_STA);
-    delay(500);
-    
-    wifi_country_t ctry = {.schan = 1, .nchan = 14, .max_tx_power = 78, .policy = WIFI_COUNTRY_POLICY_MANUAL};
-    memcpy(ctry.cc, COUNTRY, 2);
-    ctry.cc[2] = 0;
-    esp_wifi_set_country(&ctry);
-    
-    err = esp_wifi_start();
-    if (err != ESP_OK) {
-        Serial.printf("[RADIO] WiFi start error: %d\n", err);
-        return;
-    }
-    delay(300);
-
-    wifi_promiscuous_filter_t filter = {};
-    filter.filter_mask = WIFI_PROMIS_FILTER_MASK_ALL;
-    esp_wifi_set_promiscuous_filter(&filter);
-    esp_wifi_set_promiscuous_rx_cb(&sniffer_cb);
-    esp_wifi_set_promiscuous(true);
-
-    if (CHANNELS.empty()) CHANNELS = {1, 6, 11};
-    esp_wifi_set_channel(CHANNELS[0], WIFI_SECOND_CHAN_NONE);
-    
-    // Setup channel hopping with cleanup check
     if (hopTimer) {
         esp_timer_stop(hopTimer);
         esp_timer_delete(hopTimer);
         hopTimer = nullptr;
     }
+}
+
+static void startChannelHop()
+{
+    // Sharing the radio with the softAP changes the hop pattern
+    hopConcurrent = radioGetMode() & RADIO_AP;
+
+    if (CHANNELS.empty()) CHANNELS = {1, 6, 11};
+    if (!hopConcurrent) esp_wifi_set_channel(CHANNELS[0], WIFI_SECOND_CHAN_NONE);
     
+    stopChannelHop();
     const esp_timer_create_args_t targs = {
         .callback = &hopTimerCb, 
         .arg = nullptr, 
@@ -2090,90 +2488,45 @@ static void radioStartWiFi()
         .name = "hop"
     };
     esp_timer_create(&targs, &hopTimer);
-    esp_timer_start_periodic(hopTimer, 300000); // 300ms
-}
-
-static void radioStopWiFi()
-{
-    esp_wifi_set_promiscuous(false);
-    esp_wifi_set_promiscuous_rx_cb(NULL);
-    if (hopTimer)
-    {
-        esp_timer_stop(hopTimer);
-        esp_timer_delete(hopTimer);
-        hopTimer = nullptr;
-    }
-    esp_wifi_stop();
-    esp_wifi_deinit();
-}
-
-static void radioStopBLE()
-{
-    if (pBLEScan)
-    {
-        pBLEScan->stop();
-        BLEDevice::deinit(false);
-        pBLEScan = nullptr;
-    }
+    esp_timer_start_periodic(hopTimer, hopConcurrent ? HOP_SLOT_US : HOP_PERIOD_US);
 }
 
-static void radioStartBLE()
+// Runs until radioStopSTA; hits arrive through bleHitCallbacks. Stopped
+// first so the callback state is not changed under a running scan.
+static void radioStartBLE(bool sniffAll)
 {
-    BLEDevice::init("");
-    pBLEScan = BLEDevice::getScan();
-    pBLEScan->setAdvertisedDeviceCallbacks(new MyBLEAdvertisedDeviceCallbacks());
-    pBLEScan->setActiveScan(true);
-    pBLEScan->setInterval(100);    
-    pBLEScan->setWindow(99); 
+    bleScanStop();
+    bleHitCallbacks.sniffAll = sniffAll;
+    bleHitCallbacks.recent.clear();
+    bleScanStart(&bleHitCallbacks, true, trackerMode);
 }
 
 static void radioStartSTA()
 {
-    Serial.println("[RADIO] Starting STA mode for scanning");
-    
-    esp_wifi_set_mode(WIFI_MODE_NULL);
-    delay(200);
-    
-    esp_coex_preference_set(ESP_COEX_PREFER_BALANCE);
-
+    uint8_t mode = radioGetMode() & RADIO_AP;
     if (currentScanMode == SCAN_WIFI || currentScanMode == SCAN_BOTH)
-    {
-        radioStartWiFi();
-    }
+        mode |= RADIO_PROMISC;
     if (currentScanMode == SCAN_BLE || currentScanMode == SCAN_BOTH)
-    {
+        mode |= RADIO_BLE;
+
+    radioSetMode(mode, &sniffer_cb);
+
+    if (radioGetMode() & RADIO_PROMISC)
+        startChannelHop();
+    if (radioGetMode() & RADIO_BLE)
         radioStartBLE();
-    }
 }
+
 static void radioStopSTA()
 {
-    esp_wifi_set_promiscuous(false);
-    esp_wifi_set_promiscuous_rx_cb(NULL);
-    delay(230);
-    
-    if (hopTimer) {
-        esp_timer_stop(hopTimer);
-        esp_timer_delete(hopTimer);
-        hopTimer = nullptr;
-        delay(50); 
-    }
-    
-    esp_wifi_set_mode(WIFI_MODE_NULL);
-    delay(200);
-    
-    esp_err_t err = esp_wifi_stop();
-    if (err != ESP_OK) {
-        Serial.printf("[RADIO] WiFi stop warning: %d\n", err);
-    }
-    delay(300);
-    
-    err = esp_wifi_deinit();
-    if (err != ESP_OK) {
-        Serial.printf("[RADIO] WiFi deinit warning: %d\n", err);
-    }
-    delay(200);
-    
-    radioStopBLE();
+    stopChannelHop();
+    hopConcurrent = false;
+    bleScanStop();
+
+    // Keeps the AP if it is up; otherwise the radio goes fully off
+    radioSetMode(radioGetMode() & RADIO_AP);
+    if (radioGetMode() & RADIO_AP)
+        esp_wifi_set_channel(getAPChannel(), WIFI_SECOND_CHAN_NONE);
 }
 
 void initializeScanner()
@@ -2182,6 +2535,11 @@ void initializeScanner()
     String txt = prefs.getString("maclist", "");
     saveTargetsList(txt);
     Serial.printf("Loaded %d targets\n", targets.size());
+
+    if (!hitStore.init(HIT_STORE_CAPACITY))
+        Serial.println("[HITS] Hit store allocation failed");
+    else
+        Serial.printf("[HITS] Hit store: %u records\n", (unsigned)hitStore.capacity());
 }
 
 // Task Functions
@@ -2196,9 +2554,6 @@ void listScanTask(void *pv) {
                   modeStr.c_str());
 
 
-    stopAPAndServer();
-
-
     stopRequested = false;
     if (macQueue) {
         vQueueDelete(macQueue);
@@ -2207,7 +2562,11 @@ void listScanTask(void *pv) {
     macQueue = xQueueCreate(512, sizeof(Hit));
 
     uniqueMacs.clear();
-    hitsLog.clear();
+    {
+        std::lock_guard<std::mutex> lock(antihunter::lastResultsMutex);
+        hitStore.clear();
+        antihunter::setResultsLocked("List scan in progress (live)\n\n", RESULTS_BODY_LIST_HITS);
+    }
     totalHits = 0;
     framesSeen = 0;
     bleFramesSeen = 0;
@@ -2235,14 +2594,24 @@ void listScanTask(void *pv) {
         while (xQueueReceive(macQueue, &h, 0) == pdTRUE) {
             String macStr = macFmt6(h.mac);
             uint32_t now = millis();
+            observeCalibrationHit(h);
 
             if (deviceLastSeen.find(macStr) != deviceLastSeen.end()) {
-                if (now - deviceLastSeen[macStr] < DEDUPE_WINDOW) continue;
+                if (now - deviceLastSeen[macStr] < DEDUPE_WINDOW) {
+                    // Repeats of the triangulation target still feed the
+                    // mesh hit batch, whose mean RSSI the filters run on
+                    if (isTriangulationTarget(h.mac)) sendMeshNotification(h);
+                    continue;
+                }
             }
 
             deviceLastSeen[macStr] = now;
             totalHits = totalHits + 1;
-            hitsLog.push_back(h);
+            {
+                std::lock_guard<std::mutex> lock(antihunter::lastResultsMutex);
+                hitStore.add(h, millis());
+            }
+            pushHitEvent(h);
             uniqueMacs.insert(macStr);
 
             String logEntry = String(h.isBLE ? "BLE" : "WiFi") + " " + macStr +
@@ -2260,15 +2629,6 @@ void listScanTask(void *pv) {
             sendMeshNotification(h);
         }
 
-        if ((currentScanMode == SCAN_BLE || currentScanMode == SCAN_BOTH) && pBLEScan) {
-            static uint32_t lastBLEScan = 0;
-            if (millis() - lastBLEScan >= 3000) {
-                pBLEScan->start(1, false);
-                pBLEScan->clearResults();
-                lastBLEScan = millis();
-            }
-        }
-
         vTaskDelay(pdMS_TO_TICKS(50));
     }
 
@@ -2286,40 +2646,15 @@ void listScanTask(void *pv) {
             "WiFi Frames seen: " + std::to_string(framesSeen) + "\n" +
             "BLE Frames seen: " + std::to_string(bleFramesSeen) + "\n" +
             "Total hits: " + std::to_string(totalHits) + "\n" +
-            "Unique devices: " + std::to_string(uniqueMacs.size()) + "\n\n";
-
-        // Sort hits by RSSI (strongest first)
-        std::vector<Hit> sortedHits = hitsLog;
-        std::sort(sortedHits.begin(), sortedHits.end(),
-                [](const Hit& a, const Hit& b) { return a.rssi > b.rssi; });
-
-        int show = sortedHits.size();
-        if (show > 200) show = 200;
-        for (int i = 0; i < show; i++) {
-            const auto &e = sortedHits[i];
-            results += std::string(e.isBLE ? "BLE " : "WiFi");
-            results += " " + std::string(macFmt6(e.mac).c_str());
-            results += " RSSI=" + std::to_string(e.rssi) + "dBm";
-            if (!e.isBLE && e.ch > 0) results += " CH=" + std::to_string(e.ch);
-            if (strlen(e.name) > 0 && strcmp(e.name, "WiFi") != 0 && strcmp(e.name, "Unknown") != 0) {
-                results += " Name=" + std::string(e.name);
-            }
-            results += "\n";
-        }
-        if (static_cast<int>(sortedHits.size()) > show) {
-            results += "... (" + std::to_string(sortedHits.size() - show) + " more)\n";
-        }
+            "Unique devices: " + std::to_string(uniqueMacs.size()) + "\n" +
+            "BLE scan: " + getBleScanInfo().c_str() + "\n\n";
 
-        antihunter::lastResults = results;
-        Serial.printf("[DEBUG] Results stored: %d chars\n", results.length());
-
-        if (isTriangulationActive()) {
-            antihunter::lastResults += "\n\n" + std::string(calculateTriangulationResults().c_str());
-            triangulationActive = false;
-        }
+        antihunter::setResultsLocked(results, RESULTS_BODY_LIST_HITS);
+        Serial.printf("[DEBUG] Results stored: %u hits\n", (unsigned)hitStore.size());
     }
+    triangulationActive = false;
 
-    startAPAndServer();
+    ensureAPAndServer();
     workerTaskHandle = nullptr;
     vTaskDelete(nullptr);
 }
@@ -2335,8 +2670,6 @@ void trackerTask(void *pv)
                   forever ? "(forever)" : String(String("for ") + secs + " s").c_str(),
                   modeStr.c_str(), macFmt6(trackerMac).c_str());
 
-    stopAPAndServer();
-
     trackerMode = true;
     trackerPackets = 0;
     trackerRssi = -90;
@@ -2360,7 +2693,6 @@ void trackerTask(void *pv)
     }
 
     uint32_t nextStatus = millis() + 1000;
-    uint32_t nextBLEScan = millis();
     float ema = -90.0f;
 
     while ((forever && !stopRequested) ||
@@ -2395,15 +2727,6 @@ void trackerTask(void *pv)
             sendTrackerMeshUpdate();
         }
 
-        // BLE scanning if needed
-        if ((currentScanMode == SCAN_BLE || currentScanMode == SCAN_BOTH) && pBLEScan) {
-            if (millis() - nextBLEScan >= 1000) {
-                pBLEScan->start(1, false);
-                pBLEScan->clearResults();
-                nextBLEScan = millis();
-            }
-        }
-
         vTaskDelay(pdMS_TO_TICKS(10));
     }
 
@@ -2422,11 +2745,12 @@ void trackerTask(void *pv)
         results += "Target: " + std::string(macFmt6(trackerMac).c_str()) + "\n";
         results += "Packets from target: " + std::to_string(trackerPackets) + "\n";
         results += "Last RSSI: " + std::to_string((int)trackerRssi) + "dBm\n";
+        results += "BLE scan: " + std::string(getBleScanInfo().c_str()) + "\n";
         
-        antihunter::lastResults = results;
+        antihunter::setResultsLocked(results, RESULTS_BODY_NONE);
     }
 
-    startAPAndServer();
+    ensureAPAndServer();
     workerTaskHandle = nullptr;
     vTaskDelete(nullptr);
 }
@@ -2467,8 +2791,11 @@ void cleanupMaps() {
     if (deauthQueue) xQueueReset(deauthQueue);  // Flush old hits
 
     // Clean deauth logs (vector - trim oldest)
-    if (deauthLog.size() > MAX_LOG_SIZE) {
-        deauthLog.erase(deauthLog.begin(), deauthLog.begin() + (deauthLog.size() - MAX_LOG_SIZE));
+    {
+        std::lock_guard<std::mutex> lock(deauthLogMutex);
+        if (deauthLog.size() > MAX_LOG_SIZE) {
+            deauthLog.erase(deauthLog.begin(), deauthLog.begin() + (deauthLog.size() - MAX_LOG_SIZE));
+        }
     }
 
     // Clean beacon maps (counts, lastSeen, timings)
@@ -2641,7 +2968,6 @@ void pwnagotchiDetectionTask(void *pv) {
     
     Serial.println("[PWN] Starting Pwnagotchi detection");
     
-    stopAPAndServer();
     pwnagotchiLog.clear();
     pwnagotchiCount = 0;
     stopRequested = false;
@@ -2668,7 +2994,7 @@ void pwnagotchiDetectionTask(void *pv) {
     }
     
     radioStopSTA();
-    startAPAndServer();
+    ensureAPAndServer();
     blueTeamTaskHandle = nullptr;
     vTaskDelete(nullptr);
 }
@@ -2680,7 +3006,6 @@ void multissidDetectionTask(void *pv) {
     
     Serial.println("[MULTI] Starting Multi-SSID AP detection");
     
-    stopAPAndServer();
     multissidTrackers.clear();
     confirmedMultiSSID.clear();
     multissidCount = 0;
@@ -2720,11 +3045,116 @@ void multissidDetectionTask(void *pv) {
             results += " SSIDs: " + std::to_string(c.ssid_count) + "\n";
         }
         
-        antihunter::lastResults = results;
+        antihunter::setResultsLocked(results, RESULTS_BODY_NONE);
     }
     
     radioStopSTA();
-    startAPAndServer();
+    ensureAPAndServer();
     blueTeamTaskHandle = nullptr;
     vTaskDelete(nullptr);
-}
\ No newline at end of file
+}
+// Mesh commands
+
+static const size_t CACHE_SYNC_MAX_LINES = 8;
+
+static String channelsStr()
+{
+    String s;
+    for (size_t i = 0; i < CHANNELS.size(); i++) {
+        if (i) s += ",";
+        s += String(CHANNELS[i]);
+    }
+    return s;
+}
+
+// CONFIG_CHANNELS:list
+static void handleConfigChannels(ArgReader &args)
+{
+    ChannelList list;
+    if (!args.readChannels(list)) return;
+    applyChannels(list, {1, 6, 11});
+    String channels = channelsStr();
+    Serial.printf("[MESH] Updated channels: %s\n", channels.c_str());
+    meshSend(MESH_CONTROL, getNodeId() + ": CONFIG_ACK:CHANNELS:" + channels);
+}
+
+// CONFIG_TARGETS:mac|mac|...
+static void handleConfigTargets(ArgReader &args)
+{
+    char targets[MESH_LINE_MAX];
+    if (!parseConfigTargets(args, targets, sizeof(targets))) return;
+    saveTargetsList(targets);
+    Serial.printf("[MESH] Updated targets list\n");
+    meshSend(MESH_CONTROL, getNodeId() + ": CONFIG_ACK:TARGETS:OK");
+}
+
+// SCAN_START:mode:secs[:channels][:FOREVER]
+static void handleScanStart(ArgReader &args)
+{
+    ScanStartArgs a;
+    if (!parseScanStart(args, a)) return;
+
+    currentScanMode = (ScanMode)a.mode;
+    if (a.haveChannels) applyChannels(a.channels, {1, 6, 11});
+    else CHANNELS = {1, 6, 11};
+    stopRequested = false;
+
+    if (!workerTaskHandle)
+    {
+      xTaskCreatePinnedToCore(listScanTask, "scan", 8192,
+                              (void *)(intptr_t)(a.forever ? 0 : a.secs), 1, &workerTaskHandle, 1);
+    }
+    Serial.printf("[MESH] Started scan via mesh command\n");
+    meshSend(MESH_CONTROL, getNodeId() + ": SCAN_ACK:STARTED");
+}
+
+// TRACK_START:mac:mode:secs[:channels][:FOREVER]
+static void handleTrackStart(ArgReader &args)
+{
+    TrackStartArgs a;
+    if (!parseTrackStart(args, a)) return;
+
+    setTrackerMac(a.mac);
+    currentScanMode = (ScanMode)a.scan.mode;
+    if (a.scan.haveChannels) applyChannels(a.scan.channels, {6});
+    else CHANNELS = {6};
+    stopRequested = false;
+
+    if (!workerTaskHandle)
+    {
+      xTaskCreatePinnedToCore(trackerTask, "tracker", 8192,
+                              (void *)(intptr_t)(a.scan.forever ? 0 : a.scan.secs), 1, &workerTaskHandle, 1);
+    }
+    String macStr = macFmt6(a.mac);
+    Serial.printf("[MESH] Started tracker via mesh command for %s\n", macStr.c_str());
+    meshSend(MESH_CONTROL, getNodeId() + ": TRACK_ACK:STARTED:" + macStr);
+}
+
+static void handleStop(ArgReader &)
+{
+    stopRequested = true;
+    Serial.println("[MESH] Stop command received via mesh");
+    meshSend(MESH_CONTROL, getNodeId() + ": STOP_ACK:OK");
+}
+
+// CACHE_SYNC[:since]; page through by re-sending with the CACHE_END seq
+static void handleCacheSync(ArgReader &args)
+{
+    uint32_t since;
+    if (!parseCacheSync(args, since)) return;
+    uint32_t next;
+    bool more, reset;
+    String prefix = getNodeId() + ": CACHE: ";
+    for (const String &line : snifferCacheDelta(since, CACHE_SYNC_MAX_LINES, next, more, reset))
+    {
+      meshSend(MESH_STATUS, prefix + line);
+    }
+    meshSend(MESH_STATUS, getNodeId() + ": CACHE_END:" + String(next) + (more ? ":MORE" : ":DONE") + (reset ? ":RESET" : ""));
+}
+
+static Command cmdConfigChannels("CONFIG_CHANNELS", handleConfigChannels, true);
+static Command cmdConfigTargets("CONFIG_TARGETS", handleConfigTargets, true);
+static Command cmdScanStart("SCAN_START", handleScanStart, true);
+static Command cmdTrackStart("TRACK_START", handleTrackStart, true);
+static Command cmdStop("STOP", handleStop);
+static Command cmdCacheSync("CACHE_SYNC", handleCacheSync, true);
@@ -3,18 +3,12 @@
 #include <vector>
 #include <set>
 #include <map>
+#include <memory>
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
+#include "hit.h"
 
 
-struct Hit {
-   uint8_t mac[6];
-   int8_t rssi;
-   uint8_t ch;
-   char name[32];
-   bool isBLE;
-};
-
 struct DeauthHit {
    uint8_t srcMac[6];
    uint8_t destMac[6];
@@ -98,7 +92,7 @@ struct BLESpamHit {
     char deviceName[32];
     int8_t rssi;
     uint32_t timestamp;
-    uint32_t advCount;
+    uint32_t advCount;      // adverts per second, scaled to full listening
     char spamType[32];
     uint16_t companyId;
 };
@@ -178,8 +172,15 @@ const uint32_t PROBE_UNIQUE_SSID_THRESHOLD = 10;   // 10+ unique SSIDs from one
 const uint32_t PROBE_TIMING_WINDOW = 1000;         // 1 second window
 const uint32_t PROBE_RANDOM_SSID_LENGTH = 8;       // Random SSID pattern detection
 
-// BLE Spam Detection - Pattern matching
-const uint32_t BLE_ADV_THRESHOLD = 50;             // 50+ advertisements/second  
+// BLE Spam Detection - Pattern matching. Rates are one device's adverts per
+// second, scaled up by the scan's listening share. Apple devices advertise
+// at 20 ms for their first 30 s, then 152.5 ms or slower; Android's fastest
+// mode is 100 ms; legacy adverts are never under 20 ms apart.
+const uint32_t BLE_ADV_THRESHOLD = 40;             // 40+ advertisements/second, any device
+const uint32_t BLE_APPLE_SPAM_RATE = 15;           // 15+/s from an Apple device
+const uint32_t BLE_VENDOR_SPAM_RATE = 20;          // 20+/s from Fast Pair or Samsung
+const uint32_t BLE_NAME_CHANGE_RATE = 3;           // 3+/s with a changed name
+const uint32_t BLE_FAST_ADV_GRACE_MS = 30000;      // a new device may advertise fast this long
 const uint32_t BLE_TIMING_WINDOW = 3000;           // 3 second window
 const uint32_t BLE_UNIQUE_ADDR_THRESHOLD = 20;     // 20+ unique addresses
 const uint32_t BLE_RANDOM_ADDR_PATTERN = 15;       // Random address pattern threshold
@@ -290,6 +291,34 @@ void getTrackerStatus(uint8_t mac[6], int8_t &rssi, uint32_t &lastSeen, uint32_t
 String getTargetsList();
 String getDiagnostics();
 size_t getTargetCount();
-String getSnifferCache();
 void cleanupMaps();
 
+// Line-at-a-time text rendering for chunked HTTP responses. The producer
+// fills line/len and returns false when exhausted; state lives in the
+// cursor so no full response is ever held in memory.
+struct TextCursor {
+    uint8_t section = 0;
+    uint32_t index = 0;
+    uint32_t gen = 0;
+    uint32_t limit = 0;
+    uint64_t hitPos = 0;
+    String key;
+    char line[192];
+    uint16_t len = 0;
+    uint16_t pos = 0;
+    bool done = false;
+    std::shared_ptr<void> state;    // the source's own snapshot, if it needs one
+};
+typedef bool (*LineSource)(TextCursor &c);
+
+size_t streamLines(TextCursor &c, LineSource next, uint8_t *buf, size_t maxLen);
+bool cursorPrintf(TextCursor &c, const char *fmt, ...);
+bool resultsNextLine(TextCursor &c);
+bool deauthResultsNextLine(TextCursor &c);
+bool snifferCacheNextLine(TextCursor &c);
+bool snifferCacheDeltaNextLine(TextCursor &c);
+// Up to maxEntries delta lines after since, oldest change first. next is the
+// seq to ask from on the following call; reset means since was too old and
+// the lines are a full snapshot.
+std::vector<String> snifferCacheDelta(uint32_t since, size_t maxEntries, uint32_t &next, bool &more, bool &reset);
+
@@ -0,0 +1,33 @@
+#include "timesync.h"
+
+int64_t timeSyncError(const TimeSyncSample &s, int64_t nowMonoUs)
+{
+    int64_t age = nowMonoUs > s.monoUs ? nowMonoUs - s.monoUs : 0;
+    return s.refErrUs + s.delayUs / 2 + age * TIME_SYNC_DRIFT_PPM / 1000000;
+}
+
+bool TimeSyncFilter::add(int64_t t1, int64_t t2, int64_t t3, int64_t t4, int64_t refErrUs)
+{
+    int64_t delay = (t4 - t1) - (t3 - t2);
+    if (t4 < t1 || t3 < t2 || delay < 0 || delay > TIME_SYNC_MAX_DELAY_US || refErrUs < 0) return false;
+
+    TimeSyncSample &s = samples[next];
+    s.offsetUs = ((t2 - t1) + (t3 - t4)) / 2;
+    s.delayUs = delay;
+    s.monoUs = t4;
+    s.refErrUs = refErrUs;
+    next = (next + 1) % TIME_SYNC_SAMPLES;
+    if (count < TIME_SYNC_SAMPLES) count++;
+    return true;
+}
+
+bool TimeSyncFilter::best(int64_t nowMonoUs, TimeSyncSample &out) const
+{
+    if (count == 0) return false;
+    size_t b = 0;
+    for (size_t i = 1; i < count; i++) {
+        if (timeSyncError(samples[i], nowMonoUs) < timeSyncError(samples[b], nowMonoUs)) b = i;
+    }
+    out = samples[b];
+    return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Two-way mesh time transfer (NTP-style). A node without GPS broadcasts
+// "NODE: TSYNC_REQ:t1[:REF]" with t1 on its own monotonic clock; a GPS-locked
+// node answers "REF: TSYNC:NODE:t1:t2:t3:err" with t2/t3 its epoch time at
+// receipt and reply, and err its own error bound. t1 and t3 are written
+// into the line as it reaches the radio UART, so local queueing is not
+// counted as transit. A request naming REF is answered by that node alone;
+// an open one is answered after a random delay by whichever GPS node comes
+// first, the others dropping theirs when they hear it. The requester stamps
+// t4 on arrival:
+//
+//   offset = ((t2 - t1) + (t3 - t4)) / 2     epoch minus local monotonic
+//   delay  = (t4 - t1) - (t3 - t2)           round trip spent in transit
+//
+// Whatever the asymmetry of the two legs, the true offset is within
+// delay / 2 of the estimate. Mesh delays swing by seconds, so only the
+// lowest-delay recent sample is trusted (NTP's clock filter).
+
+const size_t TIME_SYNC_SAMPLES = 8;
+const int64_t TIME_SYNC_MAX_DELAY_US = 30000000;
+const int64_t TIME_SYNC_DRIFT_PPM = 20;      // crystal wander assumed between samples
+
+struct TimeSyncSample {
+    int64_t offsetUs;
+    int64_t delayUs;
+    int64_t monoUs;         // t4
+    int64_t refErrUs;
+};
+
+class TimeSyncFilter {
+  public:
+    // False (and ignored) if the exchange is implausible
+    bool add(int64_t t1, int64_t t2, int64_t t3, int64_t t4, int64_t refErrUs);
+    // Sample with the smallest error bound at nowMonoUs
+    bool best(int64_t nowMonoUs, TimeSyncSample &out) const;
+    void clear() { count = 0; }
+
+  private:
+    TimeSyncSample samples[TIME_SYNC_SAMPLES];
+    size_t count = 0;
+    size_t next = 0;
+};
+
+// Bound on |estimate - true epoch| for a sample used at nowMonoUs: the
+// reference's own error, half the round trip, and drift since
+int64_t timeSyncError(const TimeSyncSample &s, int64_t nowMonoUs);
@@ -0,0 +1,303 @@
+let selectedMode = '0';
+
+function toast(msg){
+  const wrap = document.getElementById('toast');
+  const el = document.createElement('div');
+  el.className = 'toast';
+  el.innerHTML = '<div class="title">System</div><div class="msg">'+msg+'</div>';
+  wrap.appendChild(el);
+  requestAnimationFrame(()=>{ el.classList.add('show'); });
+  setTimeout(()=>{ el.classList.remove('show'); setTimeout(()=>wrap.removeChild(el), 200); }, 3000);
+}
+
+function switchTab(tabName) {
+  document.querySelectorAll('.tab-btn').forEach(btn => btn.classList.remove('active'));
+  document.querySelectorAll('.tab-content').forEach(content => content.classList.remove('active'));
+  
+  event.target.classList.add('active');
+  document.getElementById(tabName).classList.add('active');
+}
+
+async function ajaxForm(form, okMsg){
+  const fd = new FormData(form);
+  try{
+    const r = await fetch(form.action, {method:'POST', body:fd});
+    const t = await r.text();
+    toast(okMsg || t);
+  }catch(e){
+    toast('Error: '+e.message);
+  }
+}
+
+async function load(){
+  try{
+    const r = await fetch('/export'); 
+    const text = await r.text();
+    document.getElementById('list').value = text;
+    const lines = text.split('\n').filter(l => l.trim() && !l.startsWith('#'));
+    document.getElementById('targetCount').innerText = lines.length + ' targets';
+    
+    const rr = await fetch('/results'); 
+    document.getElementById('r').innerText = await rr.text();
+    loadNodeId();
+  }catch(e){}
+}
+
+async function loadNodeId(){
+  try{
+    const r = await fetch('/node-id');
+    const data = await r.json();
+    document.getElementById('nodeId').value = data.nodeId;
+    document.getElementById('footerNodeId').innerText = data.nodeId;
+  }catch(e){}
+}
+
+function updateStatusIndicators(diagText) {
+  // Scan status
+  if (diagText.includes('Scanning: yes')) {
+    document.getElementById('scanStatus').innerText = 'Active';
+    document.getElementById('scanStatus').classList.add('active');
+  } else {
+    document.getElementById('scanStatus').innerText = 'Idle';
+    document.getElementById('scanStatus').classList.remove('active');
+  }
+  
+  // Mode status
+  const modeMatch = diagText.match(/Scan Mode: (\w+)/);
+  if (modeMatch) {
+    document.getElementById('modeStatus').innerText = modeMatch[1];
+  }
+  
+  // GPS status
+  if (diagText.includes('GPS: Locked')) {
+    document.getElementById('gpsStatus').classList.add('active');
+    document.getElementById('gpsStatus').innerText = 'GPS Lock';
+  } else {
+    document.getElementById('gpsStatus').classList.remove('active');
+    document.getElementById('gpsStatus').innerText = 'GPS';
+  }
+  
+  // RTC status
+  if (diagText.includes('RTC: Synced')) {
+    document.getElementById('rtcStatus').classList.add('active');
+    document.getElementById('rtcStatus').innerText = 'RTC OK';
+  } else if (diagText.includes('RTC: Not')) {
+    document.getElementById('rtcStatus').classList.remove('active');
+    document.getElementById('rtcStatus').innerText = 'RTC';
+  }
+}
+
+async function tick(){
+  try{
+    const d = await fetch('/diag'); 
+    const diagText = await d.text();
+    
+    // Parse diagnostics for different sections
+    const sections = diagText.split('\n');
+    let overview = '';
+    let hardware = '';
+    let network = '';
+    let currentSection = 'overview';
+    
+    sections.forEach(line => {
+      if (line.includes('WiFi Frames')) {
+        const match = line.match(/(\d+)/);
+        if (match) document.getElementById('wifiFrames').innerText = match[1];
+      }
+      if (line.includes('BLE Frames')) {
+        const match = line.match(/(\d+)/);
+        if (match) document.getElementById('bleFrames').innerText = match[1];
+      }
+      if (line.includes('Total hits')) {
+        const match = line.match(/(\d+)/);
+        if (match) document.getElementById('totalHits').innerText = match[1];
+      }
+      if (line.includes('Unique devices')) {
+        const match = line.match(/(\d+)/);
+        if (match) document.getElementById('uniqueDevices').innerText = match[1];
+      }
+      if (line.includes('ESP32 Temp')) {
+        const match = line.match(/([\d.]+)°C/);
+        if (match) document.getElementById('temperature').innerText = match[1] + '°C';
+      }
+      
+      // Build sections
+      if (line.includes('SD Card') || line.includes('GPS') || line.includes('RTC') || line.includes('Vibration')) {
+        hardware += line + '\n';
+      } else if (line.includes('AP IP') || line.includes('Mesh') || line.includes('WiFi Channels')) {
+        network += line + '\n';
+      } else {
+        overview += line + '\n';
+      }
+    });
+    
+    document.getElementById('hardwareDiag').innerText = hardware || 'No hardware data';
+    document.getElementById('networkDiag').innerText = network || 'No network data';
+    
+    // Update uptime
+    const uptimeMatch = diagText.match(/Up:(\d+):(\d+):(\d+)/);
+    if (uptimeMatch) {
+      document.getElementById('uptime').innerText = uptimeMatch[1] + ':' + uptimeMatch[2] + ':' + uptimeMatch[3];
+    }
+    
+    updateStatusIndicators(diagText);
+    
+    const rr = await fetch('/results'); 
+    document.getElementById('r').innerText = await rr.text();
+  }catch(e){}
+}
+
+document.getElementById('triangulate').addEventListener('change', e=>{
+  document.getElementById('triangulateOptions').style.display = e.target.checked ? 'block' : 'none';
+});
+
+document.getElementById('f').addEventListener('submit', e=>{ 
+  e.preventDefault(); 
+  ajaxForm(e.target, 'Targets saved ✓'); 
+  setTimeout(load, 500);
+});
+
+document.getElementById('nodeForm').addEventListener('submit', e=>{
+  e.preventDefault();
+  ajaxForm(e.target, 'Node ID updated');
+  setTimeout(loadNodeId, 500);
+});
+
+document.getElementById('s').addEventListener('submit', e=>{
+  e.preventDefault();
+  const fd = new FormData(e.target);
+  fetch('/scan', {method:'POST', body:fd}).then(r=>r.text()).then(t=>toast(t))
+    .catch(err=>toast('Error: '+err.message));
+});
+
+document.getElementById('meshEnabled').addEventListener('change', e=>{
+  const enabled = e.target.checked;
+  fetch('/mesh', {method:'POST', body: new URLSearchParams({enabled: enabled})})
+    .then(r=>r.text())
+    .then(t=>{
+      toast(t);
+      document.getElementById('meshStatus').classList.toggle('active', enabled);
+    })
+    .catch(err=>toast('Error: '+err.message));
+});
+
+document.getElementById('sniffer').addEventListener('submit', e=>{
+  e.preventDefault();
+  const fd = new FormData(e.target);
+  fetch('/sniffer', {method:'POST', body:fd}).then(()=>toast('Detection started'))
+    .catch(err=>toast('Error: '+err.message));
+});
+
+document.addEventListener('click', e=>{
+  const a = e.target.closest('a[href="/stop"]');
+  if (!a) return;
+  e.preventDefault();
+  fetch('/stop').then(r=>r.text()).then(t=>toast(t));
+});
+
+document.addEventListener('click', e=>{
+  const a = e.target.closest('a[href="/mesh-test"]');
+  if (!a) return;
+  e.preventDefault();
+  fetch('/mesh-test').then(r=>r.text()).then(t=>toast('Mesh test sent'));
+});
+
+function esc(s){
+  return String(s).replace(/[&<>"]/g, c=>({'&':'&amp;','<':'&lt;','>':'&gt;','"':'&quot;'}[c]));
+}
+
+async function refreshResults(){
+  try{
+    const rr = await fetch('/results');
+    document.getElementById('r').innerText = await rr.text();
+  }catch(e){}
+}
+
+async function refreshDiag(){
+  try{
+    const d = await fetch('/diag');
+    const diagText = await d.text();
+    let hardware = '', network = '';
+    diagText.split('\n').forEach(line => {
+      if (line.includes('SD Card') || line.includes('GPS') || line.includes('RTC') || line.includes('Vibration')) hardware += line + '\n';
+      else if (line.includes('AP IP') || line.includes('Mesh') || line.includes('WiFi Channels')) network += line + '\n';
+    });
+    document.getElementById('hardwareDiag').innerText = hardware || 'No hardware data';
+    document.getElementById('networkDiag').innerText = network || 'No network data';
+  }catch(e){}
+}
+
+// Live updates over /events; falls back to polling while it is down
+let pollTimer = null, diagTimer = null, liveScanning = null, liveLines = [];
+const LIVE_MAX_LINES = 200;
+
+function startPolling(){
+  if (!pollTimer) pollTimer = setInterval(tick, 2000);
+}
+function stopPolling(){
+  if (pollTimer) { clearInterval(pollTimer); pollTimer = null; }
+}
+
+function applyStatus(s){
+  const h = Math.floor(s.up / 3600), m = Math.floor(s.up % 3600 / 60), sec = s.up % 60;
+  document.getElementById('uptime').innerText =
+    String(h).padStart(2,'0') + ':' + String(m).padStart(2,'0') + ':' + String(sec).padStart(2,'0');
+  document.getElementById('wifiFrames').innerText = s.wf;
+  document.getElementById('bleFrames').innerText = s.bf;
+  document.getElementById('totalHits').innerText = s.hits;
+  document.getElementById('uniqueDevices').innerText = s.uniq;
+  document.getElementById('temperature').innerText = s.temp.toFixed(1) + '°C';
+  updateStatusIndicators((s.scan ? 'Scanning: yes' : 'Scanning: no') + '\nScan Mode: ' + s.mode +
+    (s.gps ? '\nGPS: Locked' : '') + (s.rtc === 1 ? '\nRTC: Synced' : s.rtc === 0 ? '\nRTC: Not' : ''));
+
+  if (liveScanning !== null && liveScanning !== !!s.scan) {
+    liveLines = [];
+    refreshResults();
+    refreshDiag();
+  }
+  liveScanning = !!s.scan;
+}
+
+function appendHits(hits){
+  hits.forEach(h => {
+    let line = (h.b ? 'BLE  ' : 'WiFi ') + h.m + ' RSSI=' + h.r + 'dBm';
+    if (!h.b && h.c > 0) line += ' CH=' + h.c;
+    if (h.n && h.n !== 'WiFi' && h.n !== 'Unknown') line += ' Name=' + h.n;
+    liveLines.push(line);
+  });
+  if (liveLines.length > LIVE_MAX_LINES) liveLines.splice(0, liveLines.length - LIVE_MAX_LINES);
+  document.getElementById('r').innerText = 'Live hits (' + liveLines.length + ' shown):\n' + liveLines.join('\n');
+}
+
+// Live triangulation estimate; the full track is in /results and /api/v1/track
+function showPosition(p){
+  const el = document.getElementById('pos');
+  const when = p.ts ? new Date(p.ts * 1000).toLocaleTimeString() : 'now';
+  el.innerText = 'Target ' + p.mac + ' @ ' + p.lat.toFixed(7) + ',' + p.lon.toFixed(7) +
+    '\n95% region ' + p.maj + 'm x ' + p.min + 'm, axis ' + p.hdg + '\u00b0 | ' + p.n + ' nodes | ' + (p.src === 'pf' ? 'particle filter' : 'least squares') + ' | ' + when;
+  el.style.display = 'block';
+}
+
+function liveConnect(){
+  if (!window.EventSource) { startPolling(); return; }
+  const es = new EventSource('/events');
+  es.addEventListener('open', () => {
+    stopPolling();
+    refreshDiag();
+    if (!diagTimer) diagTimer = setInterval(refreshDiag, 15000);
+  });
+  es.addEventListener('status', e => applyStatus(JSON.parse(e.data)));
+  es.addEventListener('hits', e => appendHits(JSON.parse(e.data)));
+  es.addEventListener('alerts', e => JSON.parse(e.data).forEach(a => toast(esc(a.t))));
+  es.addEventListener('position', e => showPosition(JSON.parse(e.data)));
+  es.addEventListener('resync', () => { liveLines = []; refreshResults(); });
+  // EventSource reconnects on its own; poll until it does
+  es.addEventListener('error', () => {
+    if (diagTimer) { clearInterval(diagTimer); diagTimer = null; }
+    startPolling();
+  });
+}
+
+// Initialize
+load();
+liveConnect();
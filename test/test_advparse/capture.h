@@ -0,0 +1,48 @@
+#pragma once
+
+// 40 devices from a synthetic capture, one advert each: "mac,rssi,payload hex",
+// the address as printed (most significant byte first). Apple Continuity
+// and iBeacon, named devices with Samsung data, Samsung, and Fast Pair
+// service data.
+static const char *const ADV_CAPTURE[] = {
+    "37:82:21:65:b2:4c,-84,0201061aff4c000215b39166e73e811b918927e13cf685f3a1e19ebdddc1",
+    "82:7b:61:84:46:5f,-48,020106110947616c6178792042756473322050726f09ff7500000000000000",
+    "24:80:b0:68:94:4f,-46,02011a09ff4c0010056e663be8",
+    "ea:f4:19:0e:96:32,-52,020106110947616c6178792042756473322050726f09ff7500000000000000",
+    "b7:08:c2:e4:e6:29,-56,0201061aff4c0002155e38a65adb6a5f9d040029cc4cb474ad8837018605",
+    "84:dd:ec:76:f7:ca,-76,02011a09ff4c001005ca146509",
+    "e0:9a:cf:c2:9b:28,-47,02010606162cfe000000020af4",
+    "be:86:e6:ef:a9:32,-87,02011a15ff750042040120379b7cdacba31a59d8db354db24c",
+    "04:8e:a5:af:72:70,-54,02011a15ff75004204012026a2a2c0da944232ba13089d9a05",
+    "ea:de:11:d8:6b:b7,-82,02011a09ff4c0010054c9ad09b",
+    "4f:bd:0e:91:5f:5d,-44,02011a15ff750042040120620ec0152aa9381712a48af6e42d",
+    "a3:5a:ba:5e:a0:bd,-43,0201061aff4c0002158799c1350d439e71897aa75fde3134a4aa72e05628",
+    "ea:32:29:07:db:e1,-55,02011a09ff4c001005e3b695ee",
+    "40:81:f4:1f:b4:71,-65,02011a09ff4c0010053d577a8c",
+    "f5:2a:63:b5:06:f9,-92,0201061aff4c000215d7dd3bc8a1d29ab5cd27ed632481e03a872278b28e",
+    "d7:c9:7f:d6:f6:c2,-54,0201061aff4c000215f9a8b6b8f851d7aa39dc770095b4ead09f96b66cd8",
+    "00:1c:40:17:3f:19,-44,02011a09ff4c001005102cfaa1",
+    "a3:0d:36:7d:64:6e,-53,02011a09ff4c0010053b3108dd",
+    "48:c8:1b:5c:5a:9f,-65,02011a09ff4c001005424b184d",
+    "a3:02:00:68:9e:e8,-70,02011a09ff4c001005c076a4cc",
+    "cb:fc:0d:70:7b:30,-53,02011a09ff4c0010056154aa3b",
+    "e1:32:ad:63:85:f7,-89,02011a09ff4c001005e49c65bb",
+    "0e:82:09:af:a2:c5,-48,02011a09ff4c0010053e90652b",
+    "2b:8a:f2:eb:ec:34,-92,02011a09ff4c001005d2ebbde8",
+    "59:55:48:43:ba:8a,-76,02011a09ff4c0010053459e878",
+    "50:a1:24:b3:c5:c7,-69,0201060b094a424c20466c6970203509ff7500000000000000",
+    "aa:07:1b:c2:54:36,-76,0201060d094c452d426f7365205143333509ff7500000000000000",
+    "55:da:a1:8e:11:f0,-89,02011a15ff750042040120eb97365b13d353f9cf963c713e75",
+    "7a:b0:fc:3c:d3:74,-72,0201060b094a424c20466c6970203509ff7500000000000000",
+    "f7:4f:cd:4c:53:31,-75,02011a09ff4c001005f7e25f45",
+    "82:b9:84:51:7c:d0,-87,02010606162cfe000000020af4",
+    "e2:2d:01:9e:a4:aa,-95,0201061aff4c000215a0ce469abb8e7fe9394fb57ebe2bb7699b604e0b2b",
+    "d3:28:fd:75:66:28,-74,020106110947616c6178792042756473322050726f09ff7500000000000000",
+    "66:82:2b:37:ee:cc,-74,02011a09ff4c00100537f8b1ce",
+    "44:eb:10:90:08:f2,-63,0201061aff4c000215c375f131c52b334866cf469e52e4c56a31d9c031ba",
+    "3a:39:6e:48:ac:61,-87,0201061aff4c0002150e8f9d6b0ac74d179caaaf59e0be85715f843f58ff",
+    "ae:b1:62:f8:24:ba,-91,02011a09ff4c001005226d7fb3",
+    "60:84:15:f1:81:63,-47,020106110947616c6178792042756473322050726f09ff7500000000000000",
+    "68:25:92:88:aa:3a,-79,02011a09ff4c0010052901718c",
+    "c7:58:31:83:0d:55,-72,02011a09ff4c001005559b1dfd",
+};
@@ -0,0 +1,260 @@
+#include <unity.h>
+#include <chrono>
+#include <ctype.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "advparse.h"
+#include "capture.h"
+
+// Replays adverts through advParse and through the path the scanner used
+// before it: NimBLE 1.4.3 looks each field up on demand with a fresh walk
+// of the payload, and the callback formatted the address, parsed it back
+// and copied the name through a String (std::string stands in here).
+
+struct Advert {
+    uint8_t native[6];      // least significant byte first, as NimBLE keeps it
+    int8_t rssi;
+    std::vector<uint8_t> payload;
+};
+
+static bool parseCaptureLine(const char *line, Advert &a)
+{
+    unsigned m[6];
+    int rssi, used = 0;
+    if (sscanf(line, "%x:%x:%x:%x:%x:%x,%d,%n", &m[0], &m[1], &m[2], &m[3], &m[4], &m[5], &rssi, &used) != 7) {
+        return false;
+    }
+    for (int i = 0; i < 6; i++) a.native[5 - i] = (uint8_t)m[i];
+    a.rssi = (int8_t)rssi;
+    a.payload.clear();
+    for (const char *p = line + used; isxdigit((int)p[0]) && isxdigit((int)p[1]); p += 2) {
+        char byte[3] = {p[0], p[1], 0};
+        a.payload.push_back((uint8_t)strtoul(byte, nullptr, 16));
+    }
+    return true;
+}
+
+static std::vector<Advert> loadCapture()
+{
+    std::vector<Advert> out;
+    for (const char *line : ADV_CAPTURE) {
+        Advert a;
+        TEST_ASSERT_TRUE(parseCaptureLine(line, a));
+        out.push_back(a);
+    }
+    return out;
+}
+
+// NimBLE's findAdvField: offset of the first structure of that type
+static bool refFind(const Advert &a, uint8_t type, size_t &at)
+{
+    for (size_t i = 0; i < a.payload.size();) {
+        uint8_t len = a.payload[i];
+        if (!len || i + 1 + len > a.payload.size()) break;
+        if (a.payload[i + 1] == type) {
+            at = i;
+            return true;
+        }
+        i += 1 + len;
+    }
+    return false;
+}
+
+static std::string refField(const Advert &a, uint8_t type)
+{
+    size_t at;
+    if (!refFind(a, type, at)) return "";
+    return std::string((const char *)&a.payload[at + 2], a.payload[at] - 1);
+}
+
+static std::string refName(const Advert &a)
+{
+    std::string name = refField(a, AD_NAME_COMPLETE);
+    return name.empty() ? refField(a, AD_NAME_SHORT) : name;
+}
+
+static std::string spanString(const AdvSpan &s)
+{
+    return s.len ? std::string((const char *)s.data, s.len) : std::string();
+}
+
+static volatile uint32_t sink;
+
+static void oldCallback(const Advert &a, const uint8_t target[6])
+{
+    char text[18];
+    snprintf(text, sizeof(text), "%02x:%02x:%02x:%02x:%02x:%02x", a.native[5], a.native[4], a.native[3],
+             a.native[2], a.native[1], a.native[0]);
+    std::string macStr = text, hex;
+    for (char ch : macStr) {
+        if (isxdigit((int)ch)) hex += (char)toupper(ch);
+    }
+    uint8_t mac[6];
+    for (int i = 0; i < 6; i++) mac[i] = (uint8_t)strtoul(hex.substr(i * 2, 2).c_str(), nullptr, 16);
+    std::string name = "Unknown", raw = refName(a);
+    if (!raw.empty()) {
+        name = "";
+        for (size_t i = 0; i < raw.size() && i < 31; i++) {
+            if (raw[i] >= 32 && raw[i] <= 126) name += raw[i];
+        }
+    }
+    std::string mfg = refField(a, AD_MANUFACTURER);
+    if (memcmp(mac, target, 6) == 0) sink += name[0] + (uint32_t)mfg.size();
+}
+
+static void newCallback(const Advert &a, const uint8_t target[6])
+{
+    uint8_t mac[6];
+    advMacFromNative(a.native, mac);
+    AdvFields f;
+    advParse(a.payload.data(), a.payload.size(), f);
+    char name[32];
+    if (!advCopyName(f.name, name, sizeof(name))) strcpy(name, "Unknown");
+    if (memcmp(mac, target, 6) == 0) sink += name[0] + f.manufacturer.len;
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_fields()
+{
+    // Flags, shortened then complete name, manufacturer, Fast Pair service data
+    const uint8_t p[] = {0x02, 0x01, 0x06, 0x04, 0x08, 'A', 'B', 'C', 0x05, 0x09, 'A', 'B', 'C', 'D',
+                         0x05, 0xFF, 0x4C, 0x00, 0x10, 0x05, 0x06, 0x16, 0x2C, 0xFE, 0x00, 0x00, 0x00};
+    AdvFields f;
+    TEST_ASSERT_TRUE(advParse(p, sizeof(p), f));
+    TEST_ASSERT_EQUAL_HEX8(0x06, f.flags);
+    TEST_ASSERT_TRUE(spanString(f.name) == "ABCD");
+    TEST_ASSERT_EQUAL_HEX16(0x004C, f.companyId);
+    TEST_ASSERT_EQUAL_UINT(4, f.manufacturer.len);
+    TEST_ASSERT_EQUAL_HEX16(0xFE2C, f.serviceUuid);
+    TEST_ASSERT_FALSE(f.malformed);
+
+    // Only a shortened name
+    const uint8_t s[] = {0x03, 0x08, 'H', 'i'};
+    TEST_ASSERT_TRUE(advParse(s, sizeof(s), f));
+    TEST_ASSERT_TRUE(spanString(f.name) == "Hi");
+    TEST_ASSERT_EQUAL_HEX16(0, f.companyId);
+
+    // One-byte manufacturer data has no company id
+    const uint8_t m[] = {0x02, 0xFF, 0x4C};
+    TEST_ASSERT_TRUE(advParse(m, sizeof(m), f));
+    TEST_ASSERT_EQUAL_UINT(1, f.manufacturer.len);
+    TEST_ASSERT_EQUAL_HEX16(0, f.companyId);
+}
+
+static void test_malformed_and_padding()
+{
+    AdvFields f;
+    TEST_ASSERT_FALSE(advParse(nullptr, 0, f));
+
+    // Zero padding ends the data
+    const uint8_t pad[] = {0x02, 0x01, 0x1A, 0x00, 0x00, 0x00};
+    TEST_ASSERT_TRUE(advParse(pad, sizeof(pad), f));
+    TEST_ASSERT_EQUAL_HEX8(0x1A, f.flags);
+    TEST_ASSERT_FALSE(f.malformed);
+
+    // A structure running past the end is dropped, the ones before kept
+    const uint8_t cut[] = {0x03, 0x09, 'O', 'K', 0x09, 0xFF, 0x4C, 0x00};
+    TEST_ASSERT_TRUE(advParse(cut, sizeof(cut), f));
+    TEST_ASSERT_TRUE(f.malformed);
+    TEST_ASSERT_TRUE(spanString(f.name) == "OK");
+    TEST_ASSERT_NULL(f.manufacturer.data);
+
+    // Every truncation of every fixture advert stays inside the buffer
+    for (const Advert &a : loadCapture()) {
+        for (size_t len = 0; len <= a.payload.size(); len++) {
+            std::vector<uint8_t> copy(a.payload.begin(), a.payload.begin() + len);
+            advParse(copy.data(), copy.size(), f);
+            const uint8_t *end = copy.data() + copy.size();
+            TEST_ASSERT_TRUE(!f.name.len || f.name.data + f.name.len <= end);
+            TEST_ASSERT_TRUE(!f.manufacturer.len || f.manufacturer.data + f.manufacturer.len <= end);
+        }
+    }
+}
+
+static void test_mac_name_hash()
+{
+    const uint8_t native[6] = {0x66, 0x55, 0x44, 0x33, 0x22, 0x11};
+    uint8_t mac[6];
+    advMacFromNative(native, mac);
+    const uint8_t want[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+    TEST_ASSERT_EQUAL_MEMORY(want, mac, 6);
+
+    const uint8_t raw[] = {'B', 'u', 'd', 0x01, 's', 0xC3, 0xA9};
+    AdvSpan name = {raw, sizeof(raw)};
+    char out[8];
+    TEST_ASSERT_EQUAL_size_t(4, advCopyName(name, out, sizeof(out)));
+    TEST_ASSERT_EQUAL_STRING("Buds", out);
+    TEST_ASSERT_EQUAL_size_t(2, advCopyName(name, out, 3));
+    TEST_ASSERT_EQUAL_STRING("Bu", out);
+    TEST_ASSERT_EQUAL_size_t(0, advCopyName({raw + 3, 1}, out, sizeof(out)));
+
+    TEST_ASSERT_EQUAL_UINT32(0, advSpanHash({nullptr, 0}));
+    TEST_ASSERT_TRUE(advSpanHash({raw, 3}) != advSpanHash({raw, 4}));
+}
+
+// advParse finds the same name and manufacturer data as NimBLE's lookups
+static void test_capture_matches_nimble()
+{
+    std::vector<Advert> capture = loadCapture();
+    TEST_ASSERT_EQUAL_size_t(40, capture.size());
+    size_t named = 0, withMfg = 0, fastPair = 0;
+    for (const Advert &a : capture) {
+        AdvFields f;
+        TEST_ASSERT_TRUE(advParse(a.payload.data(), a.payload.size(), f));
+        TEST_ASSERT_FALSE(f.malformed);
+        TEST_ASSERT_TRUE(spanString(f.name) == refName(a));
+        std::string mfg = refField(a, AD_MANUFACTURER);
+        TEST_ASSERT_TRUE(spanString(f.manufacturer) == mfg);
+        if (mfg.size() >= 2) {
+            TEST_ASSERT_EQUAL_HEX16((uint8_t)mfg[0] | (uint8_t)mfg[1] << 8, f.companyId);
+        }
+        named += f.name.len > 0;
+        withMfg += f.manufacturer.len > 0;
+        fastPair += f.serviceUuid == 0xFE2C;
+    }
+    TEST_ASSERT_EQUAL_size_t(7, named);
+    TEST_ASSERT_EQUAL_size_t(38, withMfg);
+    TEST_ASSERT_EQUAL_size_t(2, fastPair);
+}
+
+// 200k adverts drawn from the fixture through the list/tracker callback,
+// one target present in the capture
+static void test_benchmark_replay()
+{
+    std::vector<Advert> capture = loadCapture();
+    std::mt19937 rng(3);
+    std::vector<Advert> replay;
+    for (int i = 0; i < 200000; i++) {
+        replay.push_back(capture[rng() % capture.size()]);
+        replay.back().rssi = (int8_t)(-95 + (int)(rng() % 56));
+    }
+    uint8_t target[6];
+    advMacFromNative(capture[0].native, target);
+
+    auto nsPerAdvert = [&](void (*cb)(const Advert &, const uint8_t *)) {
+        auto t0 = std::chrono::steady_clock::now();
+        for (const Advert &a : replay) cb(a, target);
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / replay.size();
+    };
+    double oldNs = nsPerAdvert(oldCallback);
+    double newNs = nsPerAdvert(newCallback);
+    printf("%u adverts: old path %.0f ns/advert, advParse %.0f ns/advert\n", (unsigned)replay.size(), oldNs, newNs);
+    TEST_ASSERT_LESS_THAN(oldNs, newNs);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fields);
+    RUN_TEST(test_malformed_and_padding);
+    RUN_TEST(test_mac_name_hash);
+    RUN_TEST(test_capture_matches_nimble);
+    RUN_TEST(test_benchmark_replay);
+    return UNITY_END();
+}
@@ -0,0 +1,164 @@
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include "api.h"
+
+// Chunk size the web server hands apiFill, one TCP segment
+static const size_t CHUNK = 1436;
+static const uint32_t BENCH_RECORDS = 50000;
+static const double MIN_RECORDS_PER_SEC = 10000;
+
+struct BenchHit {
+    uint8_t mac[6];
+    int8_t rssi;
+    uint8_t ch;
+    char name[32];
+    bool isBLE;
+};
+
+static void makeHit(uint32_t i, BenchHit &h)
+{
+    for (int k = 0; k < 6; k++) h.mac[k] = (uint8_t)(i * 7 + k);
+    h.rssi = (int8_t)(-40 - (int)(i % 50));
+    h.ch = (uint8_t)(1 + i % 13);
+    // Every few names carry a quote or invalid UTF-8, as real SSIDs do
+    if (i % 8 == 0) snprintf(h.name, sizeof(h.name), "dev\"%u\xff", (unsigned)i);
+    else snprintf(h.name, sizeof(h.name), "Device-%u", (unsigned)i);
+    h.isBLE = i & 1;
+}
+
+// Same fields and order as emitHitRecord
+static void writeHit(ApiWriter &w, uint32_t seq, const BenchHit &h)
+{
+    w.beginMap(7);
+    w.key("seq");
+    w.u32(seq);
+    w.key("ms");
+    w.u32(seq * 13);
+    w.key("mac");
+    w.mac(h.mac);
+    w.key("rssi");
+    w.i32(h.rssi);
+    w.key("ch");
+    w.u32(h.ch);
+    w.key("ble");
+    w.boolean(h.isBLE);
+    w.key("name");
+    w.text(h.name, strnlen(h.name, sizeof(h.name)));
+    w.endMap();
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_json_record()
+{
+    uint8_t buf[256];
+    ApiWriter w(buf, sizeof(buf), API_JSON);
+    BenchHit h = {{0xAA, 0xBB, 0xCC, 0x01, 0x02, 0x03}, -61, 6, "a\"b", true};
+    writeHit(w, 5, h);
+    TEST_ASSERT_FALSE(w.overflow);
+    buf[w.len] = 0;
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"seq\":5,\"ms\":65,\"mac\":\"AA:BB:CC:01:02:03\",\"rssi\":-61,\"ch\":6,\"ble\":true,\"name\":\"a\\\"b\"}",
+        (const char *)buf);
+}
+
+static void test_cbor_values()
+{
+    uint8_t buf[64];
+    ApiWriter w(buf, sizeof(buf), API_CBOR);
+    w.beginArray();
+    w.u32(23);
+    w.u32(24);
+    w.u32(70000);
+    w.i32(-1);
+    w.i32(-500);
+    w.boolean(false);
+    w.null();
+    w.text("hi");
+    w.endArray();
+    const uint8_t want[] = {0x9F, 0x17, 0x18, 0x18, 0x1A, 0x00, 0x01, 0x11, 0x70, 0x20, 0x39, 0x01, 0xF3,
+                            0xF4, 0xF6, 0x62, 'h', 'i', 0xFF};
+    TEST_ASSERT_EQUAL(sizeof(want), w.len);
+    TEST_ASSERT_EQUAL_MEMORY(want, buf, sizeof(want));
+}
+
+// Invalid bytes go out as '?' one for one so the CBOR length stays exact
+static void test_invalid_utf8()
+{
+    uint8_t buf[16];
+    ApiWriter w(buf, sizeof(buf), API_CBOR);
+    w.text("a\xff\xc3\xa9", 4);
+    const uint8_t want[] = {0x64, 'a', '?', 0xC3, 0xA9};
+    TEST_ASSERT_EQUAL(sizeof(want), w.len);
+    TEST_ASSERT_EQUAL_MEMORY(want, buf, sizeof(want));
+}
+
+static void test_overflow_flags()
+{
+    uint8_t buf[20];
+    ApiWriter w(buf, sizeof(buf), API_JSON);
+    BenchHit h;
+    makeHit(1, h);
+    writeHit(w, 1, h);
+    TEST_ASSERT_TRUE(w.overflow);
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(buf), w.len);
+}
+
+// Records into CHUNK-sized buffers the way apiFill does: one writer per
+// record at the chunk's fill point; a record that overflows ends the chunk
+// and is encoded again at the start of the next.
+static double benchFormat(ApiFormat fmt)
+{
+    BenchHit hits[64];
+    for (uint32_t i = 0; i < 64; i++) makeHit(i, hits[i]);
+
+    static uint8_t buf[CHUNK];
+    size_t out = 0, bytes = 0, chunks = 0;
+    bool comma = false;
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < BENCH_RECORDS;) {
+        ApiWriter w(buf + out, CHUNK - out, fmt, comma);
+        writeHit(w, i + 1, hits[i & 63]);
+        if (w.overflow) {
+            bytes += out;
+            chunks++;
+            out = 0;
+            continue;
+        }
+        out += w.len;
+        comma = w.needComma;
+        i++;
+    }
+    bytes += out;
+    chunks++;
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    printf("%s: %u records, %zu chunks, %zu bytes (%.1f B/record), %.0f records/s\n",
+           fmt == API_JSON ? "JSON" : "CBOR", (unsigned)BENCH_RECORDS, chunks, bytes,
+           (double)bytes / BENCH_RECORDS, BENCH_RECORDS / s);
+    return BENCH_RECORDS / s;
+}
+
+static void test_bench_json()
+{
+    TEST_ASSERT_GREATER_OR_EQUAL(MIN_RECORDS_PER_SEC, benchFormat(API_JSON));
+}
+
+static void test_bench_cbor()
+{
+    TEST_ASSERT_GREATER_OR_EQUAL(MIN_RECORDS_PER_SEC, benchFormat(API_CBOR));
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_json_record);
+    RUN_TEST(test_cbor_values);
+    RUN_TEST(test_invalid_utf8);
+    RUN_TEST(test_overflow_flags);
+    RUN_TEST(test_bench_json);
+    RUN_TEST(test_bench_cbor);
+    return UNITY_END();
+}
@@ -0,0 +1,389 @@
+#include <unity.h>
+#include <chrono>
+#include <initializer_list>
+#include <stdio.h>
+#include <string.h>
+#include "commands.h"
+
+static int stops = 0;
+static ChannelList lastList;
+static bool lastOk = false;
+
+static void handleStop(ArgReader &) { stops++; }
+static void handleChannels(ArgReader &args) { lastOk = args.readChannels(lastList); }
+
+static Command cmdStop("STOP", handleStop);
+static Command cmdChannels("CONFIG_CHANNELS", handleChannels, true);
+
+// The firmware's scan, tracking and calibration verbs, registered with the
+// same arity as in scanner.cpp and network.cpp; each handler records what
+// its parser made of the line
+static int parsed = 0, rejected = 0;
+static ScanStartArgs lastScan;
+static TrackStartArgs lastTrack;
+static CalibrateStartArgs lastCal;
+static uint8_t lastMac[6];
+static uint32_t lastSecs;
+static char lastTargets[128];
+
+static void count(bool ok) { ok ? parsed++ : rejected++; }
+static void handleScanStart(ArgReader &args) { count(parseScanStart(args, lastScan)); }
+static void handleTrackStart(ArgReader &args) { count(parseTrackStart(args, lastTrack)); }
+static void handleTriangulateStart(ArgReader &args) { count(parseTriangulateStart(args, lastMac, lastSecs)); }
+static void handleCalibrateStart(ArgReader &args) { count(parseCalibrateStart(args, lastCal)); }
+static void handleCacheSync(ArgReader &args) { count(parseCacheSync(args, lastSecs)); }
+static void handleConfigTargets(ArgReader &args) { count(parseConfigTargets(args, lastTargets, sizeof(lastTargets))); }
+static void handleNoArgs(ArgReader &) { parsed++; }
+
+static Command cmdScanStart("SCAN_START", handleScanStart, true);
+static Command cmdTrackStart("TRACK_START", handleTrackStart, true);
+static Command cmdTriangulateStart("TRIANGULATE_START", handleTriangulateStart, true);
+static Command cmdCalibrateStart("CALIBRATE_START", handleCalibrateStart, true);
+static Command cmdCalibrateFit("CALIBRATE_FIT", handleNoArgs);
+static Command cmdCalibrateClear("CALIBRATE_CLEAR", handleNoArgs);
+static Command cmdCacheSync("CACHE_SYNC", handleCacheSync, true);
+static Command cmdConfigTargets("CONFIG_TARGETS", handleConfigTargets, true);
+static Command cmdStatus("STATUS", handleNoArgs);
+static Command cmdMetrics("METRICS", handleNoArgs);
+
+static bool run(const char *line) { return dispatchCommand(line, strlen(line)); }
+
+static bool channels(const char *text, ChannelList &out)
+{
+    out = {};
+    ArgReader args(text, strlen(text));
+    return args.readChannels(out);
+}
+
+static void assertChannels(const char *text, const uint8_t *want, uint8_t n)
+{
+    ChannelList list;
+    TEST_ASSERT_TRUE(channels(text, list));
+    TEST_ASSERT_EQUAL_UINT(n, list.count);
+    TEST_ASSERT_EQUAL_MEMORY(want, list.ch, n);
+}
+
+void setUp()
+{
+    stops = 0;
+    parsed = rejected = 0;
+}
+void tearDown() {}
+
+static void test_exact_verbs()
+{
+    TEST_ASSERT_TRUE(run("STOP"));
+    TEST_ASSERT_TRUE(run("STOP\r\n"));
+    TEST_ASSERT_FALSE(run("STOP_ACK:OK"));
+    TEST_ASSERT_FALSE(run("STOP:now"));     // takes no arguments
+    TEST_ASSERT_FALSE(run("NODE_1: STOP_ACK:OK"));
+    TEST_ASSERT_EQUAL(2, stops);
+}
+
+// One syntax for mesh commands and the web forms (parseChannelsCSV)
+static void test_channel_syntax()
+{
+    const uint8_t std3[] = {1, 6, 11};
+    assertChannels("1,6,11", std3, 3);
+    assertChannels(" 1, 6 ,11 ", std3, 3);
+    const uint8_t all[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13};
+    assertChannels("1..13", all, 13);
+    const uint8_t mix[] = {1, 2, 3, 11};
+    assertChannels("1..3,11", mix, 4);
+    const uint8_t clipped[] = {3, 13, 14};
+    assertChannels("0,3,13..20", clipped, 3);
+    const uint8_t trailing[] = {6};
+    assertChannels("6,", trailing, 1);
+
+    ChannelList list;
+    TEST_ASSERT_FALSE(channels("", list));
+    TEST_ASSERT_FALSE(channels("a", list));
+    TEST_ASSERT_FALSE(channels("1;6", list));
+    TEST_ASSERT_FALSE(channels("1..", list));
+}
+
+static void test_channels_through_dispatch()
+{
+    TEST_ASSERT_TRUE(run("CONFIG_CHANNELS:1..3,11"));
+    TEST_ASSERT_TRUE(lastOk);
+    TEST_ASSERT_EQUAL_UINT(4, lastList.count);
+    TEST_ASSERT_TRUE(run("CONFIG_CHANNELS:x"));
+    TEST_ASSERT_FALSE(lastOk);
+}
+
+// Parses one field of text with the given reader call
+template <typename F> static bool readOne(const char *text, F read)
+{
+    ArgReader args(text, strlen(text));
+    return read(args);
+}
+
+static void test_read_uint()
+{
+    uint32_t v = 7;
+    TEST_ASSERT_TRUE(readOne("4294967295", [&](ArgReader &a) { return a.readUInt(v); }));
+    TEST_ASSERT_EQUAL_UINT32(4294967295u, v);
+    TEST_ASSERT_TRUE(readOne("0", [&](ArgReader &a) { return a.readUInt(v); }));
+    TEST_ASSERT_EQUAL_UINT32(0, v);
+    // Past UINT32_MAX used to wrap: 4294967297 read as 1
+    TEST_ASSERT_FALSE(readOne("4294967296", [&](ArgReader &a) { return a.readUInt(v); }));
+    TEST_ASSERT_FALSE(readOne("4294967297", [&](ArgReader &a) { return a.readUInt(v); }));
+    TEST_ASSERT_FALSE(readOne("99999999999999999999", [&](ArgReader &a) { return a.readUInt(v); }));
+    TEST_ASSERT_FALSE(readOne("", [&](ArgReader &a) { return a.readUInt(v); }));
+    TEST_ASSERT_FALSE(readOne("-1", [&](ArgReader &a) { return a.readUInt(v); }));
+    TEST_ASSERT_FALSE(readOne("12a", [&](ArgReader &a) { return a.readUInt(v); }));
+    TEST_ASSERT_EQUAL_UINT32(0, v);
+
+    // A failed read leaves the field for the next reader
+    ArgReader args("x:5", 3);
+    TEST_ASSERT_FALSE(args.readUInt(v));
+    TEST_ASSERT_TRUE(args.readFlag("x"));
+    TEST_ASSERT_TRUE(args.readUInt(v));
+    TEST_ASSERT_EQUAL_UINT32(5, v);
+    TEST_ASSERT_TRUE(args.empty());
+}
+
+static void test_read_int()
+{
+    int32_t v = 0;
+    TEST_ASSERT_TRUE(readOne("-2147483648", [&](ArgReader &a) { return a.readInt(v); }));
+    TEST_ASSERT_EQUAL_INT32(INT32_MIN, v);
+    TEST_ASSERT_TRUE(readOne("2147483647", [&](ArgReader &a) { return a.readInt(v); }));
+    TEST_ASSERT_EQUAL_INT32(INT32_MAX, v);
+    TEST_ASSERT_TRUE(readOne("-75", [&](ArgReader &a) { return a.readInt(v); }));
+    TEST_ASSERT_EQUAL_INT32(-75, v);
+    TEST_ASSERT_FALSE(readOne("2147483648", [&](ArgReader &a) { return a.readInt(v); }));
+    TEST_ASSERT_FALSE(readOne("-2147483649", [&](ArgReader &a) { return a.readInt(v); }));
+    TEST_ASSERT_FALSE(readOne("-", [&](ArgReader &a) { return a.readInt(v); }));
+    TEST_ASSERT_FALSE(readOne("--1", [&](ArgReader &a) { return a.readInt(v); }));
+
+    // Out of range leaves the sign in place too
+    ArgReader args("-9999999999:x", 13);
+    TEST_ASSERT_FALSE(args.readInt(v));
+    size_t n;
+    TEST_ASSERT_EQUAL_size_t(13, (args.rest(n), n));
+}
+
+static void test_read_double()
+{
+    double v = 0;
+    TEST_ASSERT_TRUE(readOne("59.913868", [&](ArgReader &a) { return a.readDouble(v); }));
+    TEST_ASSERT_FLOAT_WITHIN(1e-9, 59.913868, v);
+    TEST_ASSERT_TRUE(readOne("-0.5", [&](ArgReader &a) { return a.readDouble(v); }));
+    TEST_ASSERT_FLOAT_WITHIN(1e-9, -0.5, v);
+    TEST_ASSERT_TRUE(readOne("10", [&](ArgReader &a) { return a.readDouble(v); }));
+    TEST_ASSERT_FALSE(readOne("1e5", [&](ArgReader &a) { return a.readDouble(v); }));
+    TEST_ASSERT_FALSE(readOne("nan", [&](ArgReader &a) { return a.readDouble(v); }));
+    TEST_ASSERT_FALSE(readOne("1.2.3", [&](ArgReader &a) { return a.readDouble(v); }));
+    TEST_ASSERT_FALSE(readOne("5-", [&](ArgReader &a) { return a.readDouble(v); }));
+    TEST_ASSERT_FALSE(readOne("", [&](ArgReader &a) { return a.readDouble(v); }));
+    TEST_ASSERT_FALSE(readOne("1.000000000000000000000001", [&](ArgReader &a) { return a.readDouble(v); }));
+}
+
+static void test_read_mac()
+{
+    const uint8_t want[] = {0xAA, 0xBB, 0xCC, 0x0D, 0xEE, 0xff};
+    uint8_t mac[6];
+    for (const char *text : {"AA:BB:CC:0D:EE:FF", "aa-bb-cc-0d-ee-ff", "AABBCC0DEEFF"}) {
+        memset(mac, 0, 6);
+        TEST_ASSERT_TRUE(readOne(text, [&](ArgReader &a) { return a.readMac(mac); }));
+        TEST_ASSERT_EQUAL_MEMORY(want, mac, 6);
+    }
+    TEST_ASSERT_FALSE(readOne("AA:BB:CC:0D:EE", [&](ArgReader &a) { return a.readMac(mac); }));
+    TEST_ASSERT_FALSE(readOne("AA:BB:CC:0D:EE:FG", [&](ArgReader &a) { return a.readMac(mac); }));
+    TEST_ASSERT_FALSE(readOne("AA:BB:CC:0D:EE:FF0", [&](ArgReader &a) { return a.readMac(mac); }));
+
+    // The MAC's own colons aren't field separators
+    ArgReader args("AA:BB:CC:0D:EE:FF:60", 20);
+    uint32_t secs;
+    TEST_ASSERT_TRUE(args.readMac(mac));
+    TEST_ASSERT_TRUE(args.readUInt(secs));
+    TEST_ASSERT_EQUAL_UINT32(60, secs);
+}
+
+static void test_read_flag()
+{
+    ArgReader args("FOREVER:FOREVERMORE:x", 21);
+    TEST_ASSERT_FALSE(args.readFlag("FOREVERM"));
+    TEST_ASSERT_FALSE(args.readFlag("forever"));
+    TEST_ASSERT_TRUE(args.readFlag("FOREVER"));
+    TEST_ASSERT_FALSE(args.readFlag("FOREVER"));
+    TEST_ASSERT_TRUE(args.readFlag("FOREVERMORE"));
+    TEST_ASSERT_TRUE(args.readFlag("x"));
+    TEST_ASSERT_TRUE(args.empty());
+}
+
+static void test_channel_range()
+{
+    ChannelList list;
+    // Used to wrap: 4294967297 read as channel 1
+    TEST_ASSERT_FALSE(channels("4294967297", list));
+    TEST_ASSERT_FALSE(channels("256", list));
+    TEST_ASSERT_FALSE(channels("1..4294967297", list));
+    const uint8_t none[] = {0};
+    assertChannels("255", none, 0);
+    const uint8_t tail[] = {13, 14};
+    assertChannels("13..255", tail, 2);
+}
+
+static void test_scan_start()
+{
+    TEST_ASSERT_TRUE(run("SCAN_START:2:60"));
+    TEST_ASSERT_EQUAL_INT(1, parsed);
+    TEST_ASSERT_EQUAL_UINT(2, lastScan.mode);
+    TEST_ASSERT_EQUAL_UINT32(60, lastScan.secs);
+    TEST_ASSERT_FALSE(lastScan.haveChannels);
+    TEST_ASSERT_FALSE(lastScan.forever);
+
+    TEST_ASSERT_TRUE(run("SCAN_START:0:300:1..3,11:FOREVER"));
+    TEST_ASSERT_TRUE(lastScan.haveChannels);
+    TEST_ASSERT_EQUAL_UINT(4, lastScan.channels.count);
+    TEST_ASSERT_TRUE(lastScan.forever);
+
+    TEST_ASSERT_TRUE(run("SCAN_START:1:0:FOREVER"));
+    TEST_ASSERT_FALSE(lastScan.haveChannels);
+    TEST_ASSERT_TRUE(lastScan.forever);
+    TEST_ASSERT_EQUAL_INT(3, parsed);
+
+    const char *bad[] = {"SCAN_START:3:60", "SCAN_START:0", "SCAN_START:0:4294967297", "SCAN_START:0:-5",
+                         "SCAN_START:x:60", "SCAN_START"};
+    for (const char *line : bad) TEST_ASSERT_TRUE(run(line));
+    TEST_ASSERT_EQUAL_INT(6, rejected);
+    TEST_ASSERT_EQUAL_INT(3, parsed);
+}
+
+static void test_track_start()
+{
+    const uint8_t mac[] = {0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC};
+    TEST_ASSERT_TRUE(run("TRACK_START:12:34:56:78:9A:BC:1:120"));
+    TEST_ASSERT_EQUAL_INT(1, parsed);
+    TEST_ASSERT_EQUAL_MEMORY(mac, lastTrack.mac, 6);
+    TEST_ASSERT_EQUAL_UINT(1, lastTrack.scan.mode);
+    TEST_ASSERT_EQUAL_UINT32(120, lastTrack.scan.secs);
+    TEST_ASSERT_TRUE(run("TRACK_START:123456789abc:0:0:6:FOREVER"));
+    TEST_ASSERT_EQUAL_MEMORY(mac, lastTrack.mac, 6);
+    TEST_ASSERT_TRUE(lastTrack.scan.haveChannels);
+    TEST_ASSERT_EQUAL_UINT(6, lastTrack.scan.channels.ch[0]);
+    TEST_ASSERT_TRUE(lastTrack.scan.forever);
+
+    const char *bad[] = {"TRACK_START:12:34:56:78:9A:1:120", "TRACK_START:12:34:56:78:9A:BC:1",
+                         "TRACK_START:12:34:56:78:9A:BC:5:120", "TRACK_START:1:120"};
+    for (const char *line : bad) TEST_ASSERT_TRUE(run(line));
+    TEST_ASSERT_EQUAL_INT(4, rejected);
+    TEST_ASSERT_EQUAL_INT(2, parsed);
+}
+
+static void test_triangulate_start()
+{
+    const uint8_t mac[] = {0xDE, 0xAD, 0xBE, 0xEF, 0x00, 0x01};
+    TEST_ASSERT_TRUE(run("TRIANGULATE_START:DE:AD:BE:EF:00:01:90"));
+    TEST_ASSERT_EQUAL_MEMORY(mac, lastMac, 6);
+    TEST_ASSERT_EQUAL_UINT32(90, lastSecs);
+    TEST_ASSERT_TRUE(run("TRIANGULATE_START:DE:AD:BE:EF:00:01"));
+    TEST_ASSERT_TRUE(run("TRIANGULATE_START:DE:AD:BE:EF:00:01:4294967297"));
+    TEST_ASSERT_TRUE(run("TRIANGULATE_START"));
+    TEST_ASSERT_EQUAL_INT(1, parsed);
+    TEST_ASSERT_EQUAL_INT(3, rejected);
+}
+
+static void test_calibrate()
+{
+    TEST_ASSERT_TRUE(run("CALIBRATE_START:AA:BB:CC:DD:EE:FF:59.913868:10.752245"));
+    TEST_ASSERT_FLOAT_WITHIN(1e-9, 59.913868, lastCal.lat);
+    TEST_ASSERT_FLOAT_WITHIN(1e-9, 10.752245, lastCal.lon);
+    TEST_ASSERT_EQUAL_UINT32(CALIBRATE_DEFAULT_SECS, lastCal.secs);
+    TEST_ASSERT_TRUE(run("CALIBRATE_START:AA:BB:CC:DD:EE:FF:-33.8688:151.2093:600"));
+    TEST_ASSERT_EQUAL_UINT32(600, lastCal.secs);
+    TEST_ASSERT_EQUAL_INT(2, parsed);
+
+    const char *bad[] = {"CALIBRATE_START:AA:BB:CC:DD:EE:FF:59.9", "CALIBRATE_START:AA:BB:CC:DD:EE:FF:59.9:10.7:x",
+                         "CALIBRATE_START:AA:BB:CC:DD:EE:FF:91:10.7", "CALIBRATE_START:AA:BB:CC:DD:EE:FF:59.9:181",
+                         "CALIBRATE_START:AA:BB:CC:DD:EE:FF:59.9:10.7:4294967297"};
+    for (const char *line : bad) TEST_ASSERT_TRUE(run(line));
+    TEST_ASSERT_EQUAL_INT(5, rejected);
+
+    // CALIBRATE_FIT and CALIBRATE_CLEAR take no arguments
+    TEST_ASSERT_TRUE(run("CALIBRATE_FIT"));
+    TEST_ASSERT_TRUE(run("CALIBRATE_CLEAR\r\n"));
+    TEST_ASSERT_FALSE(run("CALIBRATE_FIT:now"));
+    TEST_ASSERT_FALSE(run("CALIBRATE_CLEAR:1"));
+    TEST_ASSERT_FALSE(run("CALIBRATE"));
+    TEST_ASSERT_EQUAL_INT(4, parsed);
+}
+
+static void test_cache_sync()
+{
+    TEST_ASSERT_TRUE(run("CACHE_SYNC"));
+    TEST_ASSERT_EQUAL_UINT32(0, lastSecs);
+    TEST_ASSERT_TRUE(run("CACHE_SYNC:1234"));
+    TEST_ASSERT_EQUAL_UINT32(1234, lastSecs);
+    TEST_ASSERT_EQUAL_INT(2, parsed);
+    TEST_ASSERT_TRUE(run("CACHE_SYNC:abc"));
+    TEST_ASSERT_TRUE(run("CACHE_SYNC:4294967297"));
+    TEST_ASSERT_EQUAL_INT(2, rejected);
+}
+
+static void test_config_targets()
+{
+    TEST_ASSERT_TRUE(run("CONFIG_TARGETS:AA:BB:CC|DD:EE:FF:00:11:22"));
+    TEST_ASSERT_EQUAL_STRING("AA:BB:CC\nDD:EE:FF:00:11:22", lastTargets);
+    // An empty list clears the targets
+    TEST_ASSERT_TRUE(run("CONFIG_TARGETS:"));
+    TEST_ASSERT_EQUAL_STRING("", lastTargets);
+    TEST_ASSERT_EQUAL_INT(2, parsed);
+
+    char longList[200] = "CONFIG_TARGETS:";
+    while (strlen(longList) < sizeof(longList) - 10) strcat(longList, "AA:BB:CC|");
+    TEST_ASSERT_TRUE(run(longList));
+    TEST_ASSERT_EQUAL_INT(1, rejected);
+}
+
+// Every mesh line goes through dispatch, most of them other nodes' chatter
+// that matches nothing
+static void test_benchmark_dispatch()
+{
+    const char *lines[] = {
+        "STATUS",
+        "SCAN_START:2:60:1..13:FOREVER",
+        "TRACK_START:12:34:56:78:9A:BC:1:120",
+        "CONFIG_CHANNELS:1,6,11",
+        "CALIBRATE_START:AA:BB:CC:DD:EE:FF:59.913868:10.752245",
+        "NODE_7: Target: AA:BB:CC:DD:EE:FF RSSI:-61 Ch:6 Name:Pixel",
+        "NODE_7: STATUS: Mode:WiFi+BLE Scan:ACTIVE Hits:12 Targets:3 Temp:41C Up:01:02:03",
+        "SCAN_ACK:STARTED",
+    };
+    const size_t N = sizeof(lines) / sizeof(lines[0]);
+    size_t lens[N];
+    for (size_t i = 0; i < N; i++) lens[i] = strlen(lines[i]);
+
+    const int ITERS = 200000;
+    int matched = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERS; i++) matched += dispatchCommand(lines[i % N], lens[i % N]);
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / ITERS;
+    printf("dispatch: %.0f ns per line, parsing included\n", ns);
+    TEST_ASSERT_EQUAL_INT(ITERS / N * 5, matched);
+    TEST_ASSERT_LESS_THAN(5000.0, ns);
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_exact_verbs);
+    RUN_TEST(test_channel_syntax);
+    RUN_TEST(test_channels_through_dispatch);
+    RUN_TEST(test_read_uint);
+    RUN_TEST(test_read_int);
+    RUN_TEST(test_read_double);
+    RUN_TEST(test_read_mac);
+    RUN_TEST(test_read_flag);
+    RUN_TEST(test_channel_range);
+    RUN_TEST(test_scan_start);
+    RUN_TEST(test_track_start);
+    RUN_TEST(test_triangulate_start);
+    RUN_TEST(test_calibrate);
+    RUN_TEST(test_cache_sync);
+    RUN_TEST(test_config_targets);
+    RUN_TEST(test_benchmark_dispatch);
+    return UNITY_END();
+}
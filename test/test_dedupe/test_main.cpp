@@ -0,0 +1,183 @@
+#include <unity.h>
+#include <algorithm>
+#include <deque>
+#include <math.h>
+#include <queue>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "dedupe.h"
+
+void setUp() {}
+void tearDown() {}
+
+// Against a plain FIFO of the last DEDUPE_SLOTS new keys
+static void test_matches_reference_fifo()
+{
+    DedupeCache c;
+    std::deque<uint32_t> ref;
+    std::mt19937 rng(9);
+    for (int i = 0; i < 200000; i++) {
+        uint32_t k = rng() % 300 + 1;
+        bool want = std::find(ref.begin(), ref.end(), k) != ref.end();
+        TEST_ASSERT_EQUAL(want, c.seen(k, 0, 1000000));
+        if (!want) {
+            ref.push_back(k);
+            if (ref.size() > DEDUPE_SLOTS) ref.pop_front();
+        }
+    }
+}
+
+static void test_ttl()
+{
+    DedupeCache c;
+    TEST_ASSERT_FALSE(c.seen(7, 1000, 500));
+    TEST_ASSERT_TRUE(c.contains(7, 1499, 500));
+    TEST_ASSERT_TRUE(c.seen(7, 1499, 500));
+    TEST_ASSERT_FALSE(c.contains(7, 1500, 500));
+    TEST_ASSERT_FALSE(c.seen(7, 1500, 500));   // expired, recorded afresh
+    TEST_ASSERT_TRUE(c.seen(7, 1600, 500));
+    TEST_ASSERT_FALSE(c.contains(8, 1600, 500));
+}
+
+static void test_split_message_id()
+{
+    const char *origin;
+    size_t originLen, len;
+    uint32_t seq;
+
+    const char *own = "NODE_1: Target: WiFi x ~42";
+    len = strlen(own);
+    TEST_ASSERT_TRUE(splitMessageId(own, len, origin, originLen, seq));
+    TEST_ASSERT_EQUAL_UINT32(42, seq);
+    TEST_ASSERT_NULL(origin);
+    TEST_ASSERT_EQUAL(strlen(own) - 4, len);
+
+    const char *relayed = "@ALL STOP ~CC.17";
+    len = strlen(relayed);
+    TEST_ASSERT_TRUE(splitMessageId(relayed, len, origin, originLen, seq));
+    TEST_ASSERT_EQUAL_UINT32(17, seq);
+    TEST_ASSERT_EQUAL(2, originLen);
+    TEST_ASSERT_EQUAL_MEMORY("CC", origin, 2);
+    TEST_ASSERT_EQUAL(9, len);
+
+    const char *none = "NODE_1: GPS: 1,2";
+    len = strlen(none);
+    TEST_ASSERT_FALSE(splitMessageId(none, len, origin, originLen, seq));
+    const char *bad = "x ~a.b";
+    len = strlen(bad);
+    TEST_ASSERT_FALSE(splitMessageId(bad, len, origin, originLen, seq));
+}
+
+// Duplicate storm: a burst of messages in flight at once, each arriving many
+// times in shuffled order. Up to DEDUPE_SLOTS ids in flight, every message
+// is processed exactly once.
+static void test_burst_storm()
+{
+    const int IN_FLIGHT = (int)DEDUPE_SLOTS, COPIES = 20;
+    std::mt19937 rng(4);
+    std::vector<int> arrivals;
+    for (int m = 0; m < IN_FLIGHT; m++)
+        for (int k = 0; k < COPIES; k++) arrivals.push_back(m);
+    std::shuffle(arrivals.begin(), arrivals.end(), rng);
+
+    DedupeCache c;
+    std::vector<int> processed(IN_FLIGHT, 0);
+    uint32_t now = 0;
+    char node[16];
+    for (int m : arrivals) {
+        snprintf(node, sizeof(node), "NODE_%d", m % 7);
+        if (!c.seen(dedupeKey(node, strlen(node), 1000 + m), now += 3, 600000)) processed[m]++;
+    }
+    for (int m = 0; m < IN_FLIGHT; m++) TEST_ASSERT_EQUAL(1, processed[m]);
+}
+
+// Flooding mesh: 20 nodes, every relay rebroadcasts each copy it hears up to
+// 3 hops, 10% loss per link, no radio-layer dedupe. Counts how often a
+// node's application handles a message again (duplicate) or its own message
+// coming back (echo), with and without DedupeCache and the echo rule.
+struct Pkt {
+    int origin;
+    uint32_t seq;
+    int at;
+    int hops;
+};
+
+struct StormResult {
+    long processed, unique, duplicates, echoes;
+};
+
+static StormResult floodMesh(bool useCache)
+{
+    const int N = 20, MSGS = 2000, HOPS = 3;
+    std::mt19937 rng(3);
+    std::vector<double> x(N), y(N);
+    for (int i = 0; i < N; i++) {
+        x[i] = rng() % 1000;
+        y[i] = rng() % 1000;
+    }
+    std::vector<std::vector<int>> nb(N);
+    for (int i = 0; i < N; i++)
+        for (int j = 0; j < N; j++)
+            if (i != j && hypot(x[i] - x[j], y[i] - y[j]) < 380) nb[i].push_back(j);
+
+    std::vector<DedupeCache> cache(N);
+    std::vector<std::vector<uint8_t>> got(N, std::vector<uint8_t>(MSGS, 0));
+    StormResult r = {0, 0, 0, 0};
+    uint32_t now = 0;
+    for (int m = 0; m < MSGS; m++) {
+        int origin = rng() % N;
+        uint32_t seq = 1000 + m;
+        now += 500;
+        char name[16];
+        snprintf(name, sizeof(name), "NODE_%d", origin);
+        std::queue<Pkt> q;
+        q.push({origin, seq, origin, 0});
+        while (!q.empty()) {
+            Pkt p = q.front();
+            q.pop();
+            for (int to : nb[p.at]) {
+                if (rng() % 100 < 10) continue;
+                bool echo = to == origin;
+                bool drop = useCache && (echo || cache[to].seen(dedupeKey(name, strlen(name), seq), now, 600000));
+                if (!drop) {
+                    r.processed++;
+                    if (echo) r.echoes++;
+                    else if (got[to][m]) r.duplicates++;
+                    else {
+                        got[to][m] = 1;
+                        r.unique++;
+                    }
+                }
+                if (p.hops + 1 < HOPS) q.push({origin, seq, to, p.hops + 1});
+            }
+        }
+    }
+    printf("%s: processed %ld, unique %ld, duplicates %ld, echoes %ld (%.1f%% wasted)\n",
+           useCache ? "with cache" : "no cache  ", r.processed, r.unique, r.duplicates, r.echoes,
+           100.0 * (r.duplicates + r.echoes) / r.processed);
+    return r;
+}
+
+static void test_flood_storm()
+{
+    StormResult raw = floodMesh(false);
+    StormResult deduped = floodMesh(true);
+    TEST_ASSERT_GREATER_THAN(raw.unique, raw.duplicates);
+    TEST_ASSERT_EQUAL(0, deduped.duplicates);
+    TEST_ASSERT_EQUAL(0, deduped.echoes);
+    // Same link losses (same seed), so dedupe must not cost any first copy
+    TEST_ASSERT_EQUAL(raw.unique, deduped.unique);
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_matches_reference_fifo);
+    RUN_TEST(test_ttl);
+    RUN_TEST(test_split_message_id);
+    RUN_TEST(test_burst_storm);
+    RUN_TEST(test_flood_storm);
+    return UNITY_END();
+}
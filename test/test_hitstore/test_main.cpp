@@ -0,0 +1,243 @@
+#include <unity.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "hitstore.h"
+
+static Hit makeHit(const uint8_t mac[6], int rssi, uint8_t ch)
+{
+    Hit h = {};
+    memcpy(h.mac, mac, 6);
+    h.rssi = (int8_t)rssi;
+    h.ch = ch;
+    return h;
+}
+
+static const uint8_t MAC_A[6] = {0x10, 0x20, 0x30, 0x01, 0x02, 0x03};
+static const uint8_t MAC_B[6] = {0x10, 0x20, 0x30, 0x0A, 0x0B, 0x0C};
+static const uint8_t MAC_C[6] = {0x44, 0x55, 0x66, 0x01, 0x02, 0x03};
+
+void setUp() {}
+void tearDown() {}
+
+static std::vector<uint32_t> drain(const HitStore &st, const HitQuery &q, size_t page = 1)
+{
+    std::vector<uint32_t> seqs;
+    uint64_t pos = HIT_CURSOR_START;
+    StoredHit s;
+    while (pos != HIT_CURSOR_DONE) {
+        for (size_t k = 0; k < page && st.next(q, pos, s); k++) seqs.push_back(s.seq);
+    }
+    return seqs;
+}
+
+static void test_filters_newest_first()
+{
+    HitStore st;
+    TEST_ASSERT_TRUE(st.init(16));
+    st.add(makeHit(MAC_A, -50, 1), 100);
+    st.add(makeHit(MAC_B, -60, 6), 200);
+    st.add(makeHit(MAC_C, -70, 6), 300);
+    st.add(makeHit(MAC_A, -40, 11), 400);
+
+    HitQuery all;
+    std::vector<uint32_t> want = {4, 3, 2, 1};
+    TEST_ASSERT_TRUE(drain(st, all) == want);
+
+    HitQuery mac;
+    mac.hasMac = true;
+    memcpy(mac.mac, MAC_A, 6);
+    want = {4, 1};
+    TEST_ASSERT_TRUE(drain(st, mac) == want);
+
+    HitQuery oui;
+    oui.hasOui = true;
+    memcpy(oui.oui, MAC_A, 3);
+    want = {4, 2, 1};
+    TEST_ASSERT_TRUE(drain(st, oui) == want);
+
+    HitQuery ch;
+    ch.ch = 6;
+    ch.minRssi = -65;
+    want = {2};
+    TEST_ASSERT_TRUE(drain(st, ch) == want);
+
+    HitQuery since;
+    since.sinceMs = 250;
+    want = {4, 3};
+    TEST_ASSERT_TRUE(drain(st, since) == want);
+}
+
+static void test_rssi_order_and_eviction()
+{
+    HitStore st;
+    TEST_ASSERT_TRUE(st.init(8));
+    for (int i = 0; i < 20; i++) st.add(makeHit(MAC_A, -30 - (i * 7) % 40, 1), i);
+    TEST_ASSERT_EQUAL(8, st.size());
+    TEST_ASSERT_EQUAL(13, st.oldestSeq());
+
+    HitQuery q;
+    q.byRssi = true;
+    uint64_t pos = HIT_CURSOR_START;
+    StoredHit s;
+    int prev = 127;
+    size_t n = 0;
+    while (st.next(q, pos, s)) {
+        TEST_ASSERT_TRUE(s.seq >= st.oldestSeq());
+        TEST_ASSERT_LESS_OR_EQUAL(prev, s.hit.rssi);
+        prev = s.hit.rssi;
+        n++;
+    }
+    TEST_ASSERT_EQUAL(8, n);
+}
+
+// A byRssi cursor resuming inside a bucket whose remaining hits were evicted
+// between pages moves on to the weaker buckets instead of ending
+static void test_rssi_resume_after_eviction()
+{
+    HitStore st;
+    TEST_ASSERT_TRUE(st.init(4));
+    st.add(makeHit(MAC_A, -30, 1), 1);   // seq 1
+    st.add(makeHit(MAC_B, -30, 1), 2);   // seq 2
+    st.add(makeHit(MAC_C, -70, 1), 3);   // seq 3
+    st.add(makeHit(MAC_A, -70, 1), 4);   // seq 4
+
+    HitQuery q;
+    q.byRssi = true;
+    uint64_t pos = HIT_CURSOR_START;
+    StoredHit s;
+    TEST_ASSERT_TRUE(st.next(q, pos, s));
+    TEST_ASSERT_EQUAL(2, s.seq);
+
+    st.add(makeHit(MAC_B, -80, 1), 5);   // evicts seq 1, where the cursor resumes
+    std::vector<uint32_t> rest;
+    while (st.next(q, pos, s)) rest.push_back(s.seq);
+    std::vector<uint32_t> want = {4, 3, 5};
+    TEST_ASSERT_TRUE(rest == want);
+}
+
+static void test_clear()
+{
+    HitStore st;
+    TEST_ASSERT_TRUE(st.init(8));
+    st.add(makeHit(MAC_A, -50, 1), 1);
+    st.clear();
+    HitQuery q;
+    TEST_ASSERT_EQUAL(0, drain(st, q).size());
+    st.add(makeHit(MAC_B, -50, 1), 2);
+    TEST_ASSERT_EQUAL(1, drain(st, q).size());
+}
+
+// Query latency with 100k stored hits (20k more than capacity added, so the
+// chains run through evicted slots), paged 500 at a time like /api/v1/hits
+using Clock = std::chrono::steady_clock;
+
+static double usSince(Clock::time_point t)
+{
+    return std::chrono::duration<double, std::micro>(Clock::now() - t).count();
+}
+
+static const size_t BENCH_HITS = 100000;
+
+static double benchQuery(const HitStore &st, const char *name, const HitQuery &q, size_t page)
+{
+    auto t = Clock::now();
+    size_t total = 0, pages = 0;
+    uint64_t pos = HIT_CURSOR_START;
+    StoredHit s;
+    while (pos != HIT_CURSOR_DONE) {
+        size_t k = 0;
+        while (k < page && st.next(q, pos, s)) k++;
+        total += k;
+        pages++;
+    }
+    double us = usSince(t);
+    printf("%-24s %6zu matches %4zu pages %9.1f us, %.2f us/record\n", name, total, pages, us,
+           total ? us / total : 0.0);
+    return total ? us / total : 0.0;
+}
+
+static void test_bench_100k()
+{
+    static HitStore st;
+    TEST_ASSERT_TRUE(st.init(BENCH_HITS));
+    std::mt19937 rng(1);
+    std::vector<std::array<uint8_t, 6>> macs(5000);
+    for (auto &m : macs) {
+        for (auto &b : m) b = (uint8_t)rng();
+        m[0] = (uint8_t)(rng() % 20);   // 20 OUIs
+        m[1] = m[2] = 0x42;
+    }
+    for (size_t i = 0; i < BENCH_HITS + 20000; i++) {
+        st.add(makeHit(macs[rng() % macs.size()].data(), -30 - (int)(rng() % 70), (uint8_t)(1 + rng() % 13)),
+               (uint32_t)i * 10);
+    }
+    TEST_ASSERT_EQUAL(BENCH_HITS, st.size());
+
+    // Top 200 by RSSI straight off the index, against the copy-and-sort it replaced
+    HitQuery top;
+    top.byRssi = true;
+    auto t = Clock::now();
+    uint64_t pos = HIT_CURSOR_START;
+    StoredHit s;
+    for (int i = 0; i < 200; i++) TEST_ASSERT_TRUE(st.next(top, pos, s));
+    double topUs = usSince(t);
+
+    std::vector<Hit> copy;
+    t = Clock::now();
+    copy.reserve(BENCH_HITS);
+    HitQuery all;
+    pos = HIT_CURSOR_START;
+    while (st.next(all, pos, s)) copy.push_back(s.hit);
+    std::sort(copy.begin(), copy.end(), [](const Hit &a, const Hit &b) { return a.rssi > b.rssi; });
+    double sortUs = usSince(t);
+    printf("top 200 by rssi: %.1f us (copy + sort of %zu: %.1f us)\n", topUs, copy.size(), sortUs);
+    TEST_ASSERT_LESS_THAN(sortUs, topUs);
+
+    HitQuery mac;
+    mac.hasMac = true;
+    memcpy(mac.mac, macs[7].data(), 6);
+    HitQuery oui;
+    oui.hasOui = true;
+    memcpy(oui.oui, macs[7].data(), 3);
+    HitQuery ch;
+    ch.ch = 6;
+    HitQuery strong;
+    strong.minRssi = -40;
+    HitQuery strongByRssi = strong;
+    strongByRssi.byRssi = true;
+    HitQuery recent;
+    recent.afterSeq = st.headSeq() - 1000;
+    HitQuery lastMs;
+    lastMs.sinceMs = (uint32_t)(BENCH_HITS + 20000 - 500) * 10;
+    HitQuery combo = oui;
+    combo.minRssi = -50;
+    combo.sinceMs = (uint32_t)BENCH_HITS * 10;
+
+    // Indexed queries stay well under the per-record cost of a full scan
+    double scan = benchQuery(st, "all newest", all, 2000);
+    TEST_ASSERT_LESS_THAN(5.0, benchQuery(st, "mac=", mac, 500));
+    TEST_ASSERT_LESS_THAN(5.0, benchQuery(st, "oui=", oui, 500));
+    TEST_ASSERT_LESS_THAN(5.0, benchQuery(st, "ch=6", ch, 500));
+    benchQuery(st, "minRssi=-40 newest", strong, 500);
+    TEST_ASSERT_LESS_THAN(5.0, benchQuery(st, "minRssi=-40 order=rssi", strongByRssi, 500));
+    TEST_ASSERT_LESS_THAN(5.0, benchQuery(st, "since=head-1000", recent, 500));
+    TEST_ASSERT_LESS_THAN(5.0, benchQuery(st, "sinceMs=last 500", lastMs, 500));
+    benchQuery(st, "oui+minRssi+sinceMs", combo, 500);
+    TEST_ASSERT_LESS_THAN(5.0, scan);
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_filters_newest_first);
+    RUN_TEST(test_rssi_order_and_eviction);
+    RUN_TEST(test_rssi_resume_after_eviction);
+    RUN_TEST(test_clear);
+    RUN_TEST(test_bench_100k);
+    return UNITY_END();
+}
@@ -0,0 +1,289 @@
+#include <unity.h>
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "lineframer.h"
+#include "meshproto.h"
+
+// What the framer handed back, in order: "L:<line>" for text, "B:<text>"
+// for a binary frame that decodes, "B?" for one that doesn't, "O" for an
+// overflow
+static std::vector<std::string> out;
+
+static void drain(LineFramer &f)
+{
+    const uint8_t *data;
+    size_t len;
+    FrameKind k;
+    while ((k = f.next(data, len)) != FRAME_NONE) {
+        if (k == FRAME_LINE) {
+            out.push_back("L:" + std::string((const char *)data, len));
+        } else if (k == FRAME_BINARY) {
+            static MpFrame fr;
+            char text[MP_PAYLOAD_MAX];
+            if (mpDecodeFrame(data, len, fr) && mpReadText(fr, text, sizeof(text))) out.push_back(std::string("B:") + text);
+            else out.push_back("B?");
+        } else {
+            out.push_back("O");
+        }
+    }
+}
+
+// Feeds bytes the way meshuart's readBuffered does, chunk bytes at a time
+static void feed(LineFramer &f, const std::vector<uint8_t> &bytes, size_t chunk)
+{
+    size_t pos = 0;
+    while (pos < bytes.size()) {
+        size_t avail;
+        uint8_t *dst = f.writeSpace(avail);
+        if (avail == 0) {
+            drain(f);
+            continue;
+        }
+        size_t n = std::min(std::min(chunk, avail), bytes.size() - pos);
+        memcpy(dst, bytes.data() + pos, n);
+        f.commit(n);
+        pos += n;
+        drain(f);
+    }
+}
+
+static void addLine(std::vector<uint8_t> &s, const std::string &line, bool crlf = false)
+{
+    s.insert(s.end(), line.begin(), line.end());
+    if (crlf) s.push_back('\r');
+    s.push_back('\n');
+}
+
+static void addFrame(std::vector<uint8_t> &s, const char *text, uint32_t seq = 1)
+{
+    uint8_t frame[MP_MTU];
+    size_t n = mpEncodeText("AH01", seq, text, frame, sizeof(frame));
+    TEST_ASSERT_GREATER_THAN(0, n);
+    s.insert(s.end(), frame, frame + n);
+}
+
+// Text whose frames carry 0x0A bytes, so a framer that isn't tracking
+// frame boundaries would split them as lines
+static std::string frameText(uint32_t i)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), "Target: %u\n\n\nRSSI:-%u", (unsigned)(i * 2654435761u), (unsigned)(i % 90));
+    return buf;
+}
+
+void setUp() { out.clear(); }
+void tearDown() {}
+
+static void test_chunk_split_lines()
+{
+    std::vector<uint8_t> s;
+    addLine(s, "AH01: STATUS: Mode:WiFi Scan:ACTIVE", true);
+    addLine(s, "");
+    addLine(s, "\rAH02: TARGET_HIT: AA:BB:CC:DD:EE:FF RSSI:-61");
+    addLine(s, "STOP");
+    for (size_t chunk : {1, 2, 3, 7, 64, 512}) {
+        uint8_t buf[128];
+        LineFramer f(buf, sizeof(buf), true);
+        out.clear();
+        feed(f, s, chunk);
+        TEST_ASSERT_EQUAL_size_t(3, out.size());
+        TEST_ASSERT_EQUAL_STRING("L:AH01: STATUS: Mode:WiFi Scan:ACTIVE", out[0].c_str());
+        TEST_ASSERT_EQUAL_STRING("L:AH02: TARGET_HIT: AA:BB:CC:DD:EE:FF RSSI:-61", out[1].c_str());
+        TEST_ASSERT_EQUAL_STRING("L:STOP", out[2].c_str());
+    }
+}
+
+// Lines and frames interleaved, back to back frames included
+static void test_mixed_stream()
+{
+    std::vector<uint8_t> s;
+    std::vector<std::string> want;
+    for (uint32_t i = 0; i < 40; i++) {
+        if (i % 3 != 1) {
+            std::string line = "AH01: line " + std::to_string(i);
+            addLine(s, line, i % 2);
+            want.push_back("L:" + line);
+        }
+        addFrame(s, frameText(i).c_str(), i);
+        want.push_back("B:" + frameText(i));
+    }
+    for (size_t chunk : {1, 5, 33, 300}) {
+        uint8_t buf[256];
+        LineFramer f(buf, sizeof(buf), true);
+        out.clear();
+        feed(f, s, chunk);
+        TEST_ASSERT_TRUE(out == want);
+    }
+}
+
+// Text-only framers (the USB console) pass 0x00 through as line content
+static void test_text_only()
+{
+    std::vector<uint8_t> s = {'a', 0, 'b', '\n'};
+    uint8_t buf[32];
+    LineFramer f(buf, sizeof(buf), false);
+    feed(f, s, 1);
+    TEST_ASSERT_EQUAL_size_t(1, out.size());
+    TEST_ASSERT_EQUAL_size_t(5, out[0].size());
+}
+
+static void test_overflow()
+{
+    std::vector<uint8_t> s;
+    addLine(s, "before");
+    addLine(s, std::string(300, 'x'));
+    addLine(s, "after");
+    addFrame(s, "frame after");
+    uint8_t buf[64];
+    LineFramer f(buf, sizeof(buf), true);
+    feed(f, s, 16);
+    TEST_ASSERT_EQUAL_size_t(4, out.size());
+    TEST_ASSERT_EQUAL_STRING("L:before", out[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("O", out[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("L:after", out[2].c_str());
+    TEST_ASSERT_EQUAL_STRING("B:frame after", out[3].c_str());
+
+    // An oversized frame: its closing delimiter must not be taken for an opening one
+    std::vector<uint8_t> big;
+    addLine(big, "x");
+    big.push_back(0);
+    big.insert(big.end(), 200, 0x41);
+    big.push_back(0);
+    addLine(big, "y");
+    addFrame(big, "z");
+    out.clear();
+    LineFramer g(buf, sizeof(buf), true);
+    feed(g, big, 8);
+    TEST_ASSERT_EQUAL_size_t(4, out.size());
+    TEST_ASSERT_EQUAL_STRING("O", out[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("L:y", out[2].c_str());
+    TEST_ASSERT_EQUAL_STRING("B:z", out[3].c_str());
+}
+
+// The UART overflow handler resets the framer mid-frame: the tail of that
+// frame is dropped and everything after it comes through
+static void test_reset_mid_frame()
+{
+    std::vector<uint8_t> first, rest;
+    addFrame(first, frameText(1).c_str(), 1);
+    for (uint32_t i = 2; i < 12; i++) {
+        addFrame(rest, frameText(i).c_str(), i);
+        addLine(rest, "line " + std::to_string(i));
+    }
+    for (size_t cut = 1; cut < first.size(); cut++) {
+        uint8_t buf[256];
+        LineFramer f(buf, sizeof(buf), true);
+        out.clear();
+        feed(f, std::vector<uint8_t>(first.begin(), first.begin() + cut), 64);
+        f.reset();
+        feed(f, std::vector<uint8_t>(first.begin() + cut, first.end()), 64);
+        feed(f, rest, 64);
+        // The tail can come out as a frame that fails its CRC; meshuart drops those
+        if (out[0] == "B?") out.erase(out.begin());
+        TEST_ASSERT_EQUAL_size_t(20, out.size());
+        TEST_ASSERT_EQUAL_STRING(("B:" + frameText(2)).c_str(), out[0].c_str());
+        TEST_ASSERT_EQUAL_STRING("L:line 11", out[19].c_str());
+    }
+}
+
+// Losing any single byte, delimiter or not, costs the frame or line it
+// belonged to and the one after it. A frame whose body ends in 0x0A can
+// stretch that to one more.
+static void test_lost_byte()
+{
+    std::vector<uint8_t> s;
+    std::vector<std::string> want;
+    size_t tailStart = 0;   // damage before this can't reach the last line
+    for (uint32_t i = 0; i < 6; i++) {
+        addFrame(s, frameText(i).c_str(), i);
+        want.push_back("B:" + frameText(i));
+        if (i == 4) tailStart = s.size();
+        addLine(s, "line " + std::to_string(i));
+        want.push_back("L:line " + std::to_string(i));
+    }
+    for (size_t drop = 0; drop < s.size(); drop++) {
+        std::vector<uint8_t> lossy = s;
+        lossy.erase(lossy.begin() + drop);
+        uint8_t buf[256];
+        LineFramer f(buf, sizeof(buf), true);
+        out.clear();
+        feed(f, lossy, 32);
+        size_t good = 0;
+        for (const std::string &w : want)
+            for (const std::string &o : out)
+                if (o == w) {
+                    good++;
+                    break;
+                }
+        TEST_ASSERT_GREATER_OR_EQUAL(want.size() - 3, good);
+        // Whatever follows the damage comes through: the framer is back in step
+        if (drop < tailStart) TEST_ASSERT_EQUAL_STRING(want.back().c_str(), out.back().c_str());
+    }
+}
+
+// Replay of a busy mesh link: mostly hit lines and binary hit frames.
+// Reports CPU per KB as the meshuart task sees it (framing only).
+static void test_benchmark_replay()
+{
+    std::mt19937 rng(3);
+    std::vector<uint8_t> s;
+    uint32_t lines = 0, frames = 0;
+    while (s.size() < (1u << 20)) {
+        if (rng() % 3) {
+            char line[96];
+            snprintf(line, sizeof(line), "AH%02u: Target: %02X:%02X:%02X:%02X:%02X:%02X RSSI:-%u Ch:%u",
+                     (unsigned)(rng() % 40), (unsigned)(rng() & 0xFF), (unsigned)(rng() & 0xFF),
+                     (unsigned)(rng() & 0xFF), (unsigned)(rng() & 0xFF), (unsigned)(rng() & 0xFF),
+                     (unsigned)(rng() & 0xFF), (unsigned)(30 + rng() % 60), (unsigned)(1 + rng() % 13));
+            addLine(s, line, rng() % 2);
+            lines++;
+        } else {
+            addFrame(s, frameText(rng()).c_str(), frames++);
+        }
+    }
+
+    uint8_t buf[1024];
+    size_t count = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    const int REPS = 5;
+    for (int rep = 0; rep < REPS; rep++) {
+        LineFramer f(buf, sizeof(buf), true);
+        size_t pos = 0;
+        const uint8_t *data;
+        size_t len;
+        while (pos < s.size()) {
+            size_t avail;
+            uint8_t *dst = f.writeSpace(avail);
+            // The UART driver hands over whatever has arrived: 120-byte FIFO reads
+            size_t n = std::min(std::min((size_t)120, avail), s.size() - pos);
+            memcpy(dst, s.data() + pos, n);
+            f.commit(n);
+            pos += n;
+            while (f.next(data, len) != FRAME_NONE) count++;
+        }
+    }
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    double usPerKb = us / REPS / (s.size() / 1024.0);
+    printf("replay %zu KB (%u lines, %u frames): %.2f us/KB, %.0f MB/s\n", s.size() / 1024, (unsigned)lines,
+           (unsigned)frames, usPerKb, s.size() * REPS / us);
+    TEST_ASSERT_EQUAL_size_t((size_t)(lines + frames) * REPS, count);
+    // 115200 baud is ~11 KB/s; framing has to be a rounding error of that
+    TEST_ASSERT_LESS_THAN(50.0, usPerKb);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_chunk_split_lines);
+    RUN_TEST(test_mixed_stream);
+    RUN_TEST(test_text_only);
+    RUN_TEST(test_overflow);
+    RUN_TEST(test_reset_mid_frame);
+    RUN_TEST(test_lost_byte);
+    RUN_TEST(test_benchmark_replay);
+    return UNITY_END();
+}
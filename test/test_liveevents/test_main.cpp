@@ -0,0 +1,364 @@
+#include <unity.h>
+#include <algorithm>
+#include <chrono>
+#include <ctype.h>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "liveevents.h"
+
+void setUp() {}
+void tearDown() {}
+
+// Minimal JSON checker: true if s is exactly one well-formed value
+struct JsonCheck {
+    const char *p;
+    bool ws() { while (*p == ' ' || *p == '\n' || *p == '\t' || *p == '\r') p++; return true; }
+    bool str()
+    {
+        if (*p++ != '"') return false;
+        while (*p != '"') {
+            unsigned char c = *p++;
+            if (c < 0x20) return false;
+            if (c == '\\') {
+                char e = *p++;
+                if (e == 'u') {
+                    for (int i = 0; i < 4; i++)
+                        if (!isxdigit((unsigned char)*p++)) return false;
+                } else if (!strchr("\"\\/bfnrt", e)) {
+                    return false;
+                }
+            }
+        }
+        p++;
+        return true;
+    }
+    bool num()
+    {
+        const char *s = p;
+        if (*p == '-') p++;
+        while (isdigit((unsigned char)*p)) p++;
+        return p > s && isdigit((unsigned char)p[-1]);
+    }
+    bool value()
+    {
+        ws();
+        if (*p == '"') return str();
+        if (*p == '{') {
+            p++;
+            ws();
+            if (*p == '}') return ++p, true;
+            while (true) {
+                ws();
+                if (!str() || !ws() || *p++ != ':' || !value()) return false;
+                ws();
+                if (*p == '}') return ++p, true;
+                if (*p++ != ',') return false;
+            }
+        }
+        if (*p == '[') {
+            p++;
+            ws();
+            if (*p == ']') return ++p, true;
+            while (true) {
+                if (!value()) return false;
+                ws();
+                if (*p == ']') return ++p, true;
+                if (*p++ != ',') return false;
+            }
+        }
+        return num();
+    }
+    static bool valid(const char *s)
+    {
+        JsonCheck c{s};
+        return c.value() && c.ws() && *c.p == '\0';
+    }
+};
+
+static LiveEvent hitEvent(uint32_t seq, const char *name)
+{
+    LiveEvent ev = {};
+    ev.kind = LIVE_HIT;
+    for (int i = 0; i < 6; i++) ev.mac[i] = (uint8_t)(seq >> (i * 4));
+    ev.rssi = -40 - (int8_t)(seq % 50);
+    ev.ch = 1 + seq % 13;
+    ev.isBLE = seq & 1;
+    snprintf(ev.text, sizeof(ev.text), "#%u %s", (unsigned)seq, name);
+    return ev;
+}
+
+static LiveEvent alertEvent(uint32_t seq, const char *tag, const char *text)
+{
+    LiveEvent ev = {};
+    ev.kind = LIVE_ALERT;
+    strncpy(ev.tag, tag, sizeof(ev.tag) - 1);
+    snprintf(ev.text, sizeof(ev.text), "#%u %s", (unsigned)seq, text);
+    return ev;
+}
+
+// Sequence numbers of the events in one batch, read back from the "#<seq>" text prefixes
+static std::vector<uint32_t> batchSeqs(const char *json)
+{
+    std::vector<uint32_t> out;
+    for (const char *p = json; (p = strstr(p, "\"#")); p++) out.push_back(strtoul(p + 2, nullptr, 10));
+    return out;
+}
+
+static void test_escapes_names()
+{
+    char buf[256];
+    size_t len = 1;
+    buf[0] = '[';
+    LiveEvent ev = hitEvent(7, "say \"hi\"\\\n\x01");
+    TEST_ASSERT_TRUE(liveEventToJson(ev, buf, len, sizeof(buf)));
+    buf[len++] = ']';
+    buf[len] = '\0';
+    TEST_ASSERT_TRUE(JsonCheck::valid(buf));
+    TEST_ASSERT_NOT_NULL(strstr(buf, "say \\\"hi\\\"\\\\\\u000a\\u0001"));
+    TEST_ASSERT_NOT_NULL(strstr(buf, "\"c\":8,\"b\":1"));
+}
+
+static void test_rolls_back_when_full()
+{
+    char buf[64];
+    size_t len = 1;
+    buf[0] = '[';
+    TEST_ASSERT_FALSE(liveEventToJson(hitEvent(1, "long enough to not fit in sixty-four bytes"), buf, len, sizeof(buf)));
+    TEST_ASSERT_EQUAL_size_t(1, len);
+    TEST_ASSERT_EQUAL_INT('\0', buf[1]);
+    TEST_ASSERT_TRUE(liveEventToJson(alertEvent(2, "X", "a"), buf, len, sizeof(buf)));
+    TEST_ASSERT_EQUAL_STRING("[{\"k\":\"X\",\"t\":\"#2 a\"}", buf);
+}
+
+static void test_batch_splits_and_closes()
+{
+    static LiveBatch batch;
+    batch.begin();
+    TEST_ASSERT_NULL(batch.hitsJson());
+    TEST_ASSERT_NULL(batch.alertsJson());
+
+    batch.begin();
+    uint32_t seq = 0;
+    while (batch.add(hitEvent(seq, "0123456789012345678901234567890123456789"))) seq++;
+    TEST_ASSERT_TRUE(batch.add(alertEvent(seq + 1, "RANDOMIZED", "alerts have their own array")));
+    const char *hits = batch.hitsJson();
+    const char *alerts = batch.alertsJson();
+    TEST_ASSERT_NOT_NULL(hits);
+    TEST_ASSERT_NOT_NULL(alerts);
+    TEST_ASSERT_LESS_THAN(LIVE_MSG_MAX, strlen(hits));
+    TEST_ASSERT_TRUE(JsonCheck::valid(hits));
+    TEST_ASSERT_TRUE(JsonCheck::valid(alerts));
+    TEST_ASSERT_EQUAL_size_t(seq, batchSeqs(hits).size());
+    TEST_ASSERT_GREATER_THAN(5, seq);
+}
+
+static void test_send_policy()
+{
+    bool lagging = false;
+    TEST_ASSERT_EQUAL_INT(LIVE_SEND, liveSendAction(lagging, 0));
+    TEST_ASSERT_EQUAL_INT(LIVE_SEND, liveSendAction(lagging, LIVE_CLIENT_MAX_QUEUED - 1));
+    TEST_ASSERT_FALSE(lagging);
+    TEST_ASSERT_EQUAL_INT(LIVE_SKIP, liveSendAction(lagging, LIVE_CLIENT_MAX_QUEUED));
+    TEST_ASSERT_TRUE(lagging);
+    TEST_ASSERT_EQUAL_INT(LIVE_SKIP, liveSendAction(lagging, 20));
+    TEST_ASSERT_EQUAL_INT(LIVE_RESYNC_SEND, liveSendAction(lagging, 2));
+    TEST_ASSERT_FALSE(lagging);
+    TEST_ASSERT_EQUAL_INT(LIVE_SEND, liveSendAction(lagging, 3));
+}
+
+// Load test. Scan tasks push bursts of hits (and the odd alert) into the
+// 64-slot ring; every 200 ms tick the flush packs up to three rounds of
+// batches, as flushLiveEvents does, and offers each one to every client.
+// A client drains a set number of messages per tick: fast ones keep up,
+// slow ones fall behind, stalled ones stop draining for a while (a
+// backgrounded tab). Every batch must be valid JSON, clients that never
+// lag must see every flushed event exactly once, and the rest must be
+// told to resync.
+
+struct SimClient {
+    int drainPerTick;
+    int stallFrom, stallTo;     // ticks with no draining
+    size_t queued = 0;
+    bool lagging = false;
+    bool everLagged = false;
+    size_t bytes = 0;
+    int skips = 0, resyncs = 0;
+    std::vector<uint32_t> seen;
+};
+
+struct LoadResult {
+    double usPerFlush;
+    double bytesPerClientS;
+    long flushedEvents, ringDrops;
+    int skips, resyncs;
+    int fastClients;
+    bool allValid, fastExact;
+};
+
+static LoadResult runLoad(int clients, int ticks, double meanPerTick)
+{
+    const size_t RING = 64;
+    const int ROUNDS = 3;
+    std::mt19937 rng(11);
+    std::poisson_distribution<int> arrivals(meanPerTick);
+    std::uniform_real_distribution<double> unif(0, 1);
+    static const char *names[] = {"", "iPhone", "Galaxy Buds2 Pro (5E2A)", "AirTag \"keys\"", "Tile\\Mate"};
+
+    std::vector<SimClient> cl(clients);
+    for (int i = 0; i < clients; i++) {
+        SimClient &c = cl[i];
+        c.drainPerTick = (i % 4 == 3) ? 1 : 8;
+        c.stallFrom = c.stallTo = -1;
+        if (i % 8 == 5) {
+            c.stallFrom = 100 + (int)(rng() % 200);
+            c.stallTo = c.stallFrom + 50;
+        }
+    }
+
+    std::vector<LiveEvent> ring(RING);
+    uint32_t head = 0, tail = 0, seq = 0;
+    bool overflow = false;
+    std::vector<uint32_t> flushed;
+    LoadResult res = {};
+    res.allValid = true;
+    static LiveBatch batch;
+    double flushUs = 0;
+
+    auto broadcast = [&](const char *json) {
+        size_t n = strlen(json);
+        std::vector<uint32_t> seqs = batchSeqs(json);
+        for (SimClient &c : cl) {
+            LiveSendAction action = liveSendAction(c.lagging, c.queued);
+            if (action == LIVE_SKIP) {
+                c.everLagged = true;
+                c.skips++;
+                continue;
+            }
+            if (action == LIVE_RESYNC_SEND) {
+                c.resyncs++;
+                c.queued++;
+                c.bytes += 2;
+            }
+            c.queued++;
+            c.bytes += n;
+            c.seen.insert(c.seen.end(), seqs.begin(), seqs.end());
+        }
+    };
+
+    for (int t = 0; t < ticks; t++) {
+        // Bursty producers: mostly quiet ticks, with the odd crowd walking past
+        int burst = arrivals(rng) * (unif(rng) < 0.1 ? 4 : 1);
+        for (int k = 0; k < burst; k++, seq++) {
+            if (head - tail >= RING) {
+                overflow = true;
+                res.ringDrops++;
+                continue;
+            }
+            ring[head++ % RING] = (seq % 16 == 15) ? alertEvent(seq, "BLE_SPAM", "burst from 12:34:56:78:9A:BC")
+                                                  : hitEvent(seq, names[seq % 5]);
+        }
+
+        auto t0 = std::chrono::steady_clock::now();
+        if (overflow) {
+            overflow = false;
+            for (SimClient &c : cl) {
+                c.everLagged = true;    // lost events; only a refetch recovers them
+                c.queued++;
+            }
+        }
+        for (int round = 0; round < ROUNDS; round++) {
+            batch.begin();
+            bool more = false;
+            while (tail != head) {
+                if (!batch.add(ring[tail % RING])) {
+                    more = true;
+                    break;
+                }
+                flushed.push_back(seq - (head - tail));
+                tail++;
+            }
+            const char *hits = batch.hitsJson();
+            const char *alerts = batch.alertsJson();
+            if (hits) {
+                res.allValid &= JsonCheck::valid(hits);
+                broadcast(hits);
+            }
+            if (alerts) {
+                res.allValid &= JsonCheck::valid(alerts);
+                broadcast(alerts);
+            }
+            if (!more) break;
+        }
+        flushUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+
+        for (SimClient &c : cl) {
+            bool stalled = t >= c.stallFrom && t < c.stallTo;
+            if (!stalled) c.queued -= std::min(c.queued, (size_t)c.drainPerTick);
+        }
+    }
+
+    // Ring drops are not flushed, so they can't be in "flushed"
+    std::sort(flushed.begin(), flushed.end());
+    res.fastExact = true;
+    size_t totalBytes = 0;
+    for (SimClient &c : cl) {
+        totalBytes += c.bytes;
+        res.skips += c.skips;
+        res.resyncs += c.resyncs;
+        if (c.everLagged) continue;
+        res.fastClients++;
+        std::vector<uint32_t> seen = c.seen;
+        std::sort(seen.begin(), seen.end());
+        res.fastExact &= seen == flushed;
+    }
+    res.flushedEvents = (long)flushed.size();
+    res.usPerFlush = flushUs / ticks;
+    res.bytesPerClientS = (double)totalBytes / clients / (ticks * 0.2);
+    return res;
+}
+
+static void test_load_many_clients()
+{
+    for (int clients : {1, 4, 16, 64}) {
+        LoadResult r = runLoad(clients, 1500, 6);
+        printf("%2d clients: %5.1f us/flush, %6.0f B/s per client, %ld events flushed, %ld ring drops, "
+               "%d skips, %d resyncs\n",
+               clients, r.usPerFlush, r.bytesPerClientS, r.flushedEvents, r.ringDrops, r.skips, r.resyncs);
+        TEST_ASSERT_TRUE(r.allValid);
+        TEST_ASSERT_GREATER_THAN(0, r.fastClients);
+        TEST_ASSERT_TRUE(r.fastExact);
+        // Serialization and fan-out must stay far below the 200 ms tick
+        TEST_ASSERT_LESS_THAN(2000.0, r.usPerFlush);
+        if (clients >= 4) {
+            // The slow and stalled clients fall behind and are brought back by a resync
+            TEST_ASSERT_GREATER_THAN(0, r.skips);
+            TEST_ASSERT_GREATER_THAN(0, r.resyncs);
+        }
+    }
+}
+
+// A crowd large enough to overrun the ring: every batch stays valid and
+// the per-client rate is capped by the three rounds per tick
+static void test_load_overrun()
+{
+    LoadResult r = runLoad(16, 500, 60);
+    printf("overrun: %5.1f us/flush, %6.0f B/s per client, %ld events flushed, %ld ring drops\n", r.usPerFlush,
+           r.bytesPerClientS, r.flushedEvents, r.ringDrops);
+    TEST_ASSERT_TRUE(r.allValid);
+    TEST_ASSERT_GREATER_THAN(0, r.ringDrops);
+    TEST_ASSERT_LESS_OR_EQUAL(6.0 * LIVE_MSG_MAX * 5, r.bytesPerClientS);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_escapes_names);
+    RUN_TEST(test_rolls_back_when_full);
+    RUN_TEST(test_batch_splits_and_closes);
+    RUN_TEST(test_send_policy);
+    RUN_TEST(test_load_many_clients);
+    RUN_TEST(test_load_overrun);
+    return UNITY_END();
+}
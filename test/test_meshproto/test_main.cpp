@@ -0,0 +1,266 @@
+#include <unity.h>
+#include <random>
+#include <string.h>
+#include <vector>
+#include "meshproto.h"
+
+void setUp() {}
+void tearDown() {}
+
+static void test_varint_round_trip()
+{
+    const uint32_t u[] = {0, 1, 127, 128, 300, 16383, 16384, 2097151, 2097152, 0x7FFFFFFF, 0xFFFFFFFF};
+    const int32_t s[] = {0, 1, -1, 63, -64, 64, -65, 1000000, -1000000, INT32_MAX, INT32_MIN};
+    uint8_t buf[128];
+    MpWriter w(buf, sizeof(buf));
+    for (uint32_t v : u) w.varint(v);
+    for (int32_t v : s) w.svarint(v);
+    TEST_ASSERT_FALSE(w.overflow);
+
+    MpReader r(buf, w.len);
+    for (uint32_t v : u) TEST_ASSERT_EQUAL_UINT32(v, r.varint());
+    for (int32_t v : s) TEST_ASSERT_EQUAL_INT32(v, r.svarint());
+    TEST_ASSERT_FALSE(r.err);
+    TEST_ASSERT_EQUAL(w.len, r.pos);
+}
+
+static void test_varint_sizes()
+{
+    uint8_t buf[8];
+    MpWriter w(buf, sizeof(buf));
+    w.varint(127);
+    TEST_ASSERT_EQUAL(1, w.len);
+    w.varint(128);
+    TEST_ASSERT_EQUAL(3, w.len);
+    w.svarint(-64);     // zigzag 127
+    TEST_ASSERT_EQUAL(4, w.len);
+}
+
+static void test_varint_truncated_and_overlong()
+{
+    const uint8_t cut[] = {0x80, 0x80};
+    MpReader r(cut, sizeof(cut));
+    r.varint();
+    TEST_ASSERT_TRUE(r.err);
+
+    const uint8_t longer[] = {0x80, 0x80, 0x80, 0x80, 0x80, 0x01};
+    MpReader r2(longer, sizeof(longer));
+    r2.varint();
+    TEST_ASSERT_TRUE(r2.err);
+
+    uint8_t small[2];
+    MpWriter w(small, sizeof(small));
+    w.varint(0xFFFFFFFF);
+    TEST_ASSERT_TRUE(w.overflow);
+}
+
+static void test_crc16_check_value()
+{
+    // CRC-16/CCITT-FALSE check value
+    TEST_ASSERT_EQUAL_HEX16(0x29B1, mpCrc16((const uint8_t *)"123456789", 9));
+    // Chained over two calls matches one pass
+    TEST_ASSERT_EQUAL_HEX16(0x29B1, mpCrc16((const uint8_t *)"6789", 4, mpCrc16((const uint8_t *)"12345", 5)));
+}
+
+static void test_cobs_round_trip()
+{
+    std::mt19937 rng(3);
+    for (int t = 0; t < 5000; t++) {
+        uint8_t in[600], enc[610], dec[610];
+        size_t n = 1 + rng() % 600;
+        for (size_t i = 0; i < n; i++) in[i] = rng() % 4 == 0 ? 0 : (uint8_t)rng();
+        size_t k = mpCobsEncode(in, n, enc);
+        TEST_ASSERT_LESS_OR_EQUAL(n + n / 254 + 1, k);
+        TEST_ASSERT_NULL(memchr(enc, 0, k));
+        TEST_ASSERT_EQUAL(n, mpCobsDecode(enc, k, dec));
+        TEST_ASSERT_EQUAL_MEMORY(in, dec, n);
+    }
+    // Runs of 254+ non-zero bytes need the extra code byte
+    uint8_t in[600], enc[610], dec[610];
+    memset(in, 0x55, sizeof(in));
+    size_t k = mpCobsEncode(in, sizeof(in), enc);
+    TEST_ASSERT_EQUAL(sizeof(in), mpCobsDecode(enc, k, dec));
+    TEST_ASSERT_EQUAL_MEMORY(in, dec, sizeof(in));
+}
+
+static void test_cobs_rejects_malformed()
+{
+    uint8_t dec[16];
+    const uint8_t zero[] = {0x03, 0x11, 0x00, 0x22};
+    TEST_ASSERT_EQUAL(0, mpCobsDecode(zero, sizeof(zero), dec));
+    const uint8_t past[] = {0x05, 0x11, 0x22};
+    TEST_ASSERT_EQUAL(0, mpCobsDecode(past, sizeof(past), dec));
+}
+
+static MpBatch testBatch()
+{
+    MpBatch b = {};
+    strcpy(b.node, "NODE_AB12CD");
+    b.seq = 4242;
+    b.hasGps = true;
+    b.lat1e6 = 59912345;
+    b.lon1e6 = -10754321;
+    b.t0 = 1760000000;
+    return b;
+}
+
+static std::vector<MpHit> randomHits(size_t n, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<MpHit> hs(n);
+    for (auto &h : hs) {
+        memset(&h, 0, sizeof(h));
+        for (auto &m : h.mac) m = (uint8_t)rng();
+        h.rssi = (int8_t)(-40 - (int)(rng() % 50));
+        h.ch = (uint8_t)((rng() % 3) * 5 + 1);
+        h.ble = rng() % 2;
+        h.ageS = (uint16_t)(rng() % 5);
+        h.count = (uint16_t)(rng() % 3 == 0 ? 2 + rng() % 20 : 1);
+        h.rssiMax = (int8_t)(h.rssi + rng() % 5);
+        h.rssiMean = (int8_t)(h.rssi + rng() % 3);
+        if (rng() % 4 == 0) strcpy(h.name, "iPhone");
+    }
+    return hs;
+}
+
+// Batches split across frames decode back to the same records, deltas and all
+static void test_hits_round_trip()
+{
+    MpBatch b = testBatch();
+    std::vector<MpHit> hs = randomHits(500, 7);
+    size_t off = 0, frames = 0;
+    while (off < hs.size()) {
+        uint8_t fr[MP_MTU];
+        size_t used;
+        size_t len = mpEncodeHits(b, &hs[off], hs.size() - off, fr, MP_MTU, used);
+        TEST_ASSERT_TRUE(len > 0 && len <= MP_MTU && used > 0);
+        TEST_ASSERT_EQUAL(0, fr[0]);
+        TEST_ASSERT_EQUAL(0, fr[len - 1]);
+
+        MpFrame f;
+        TEST_ASSERT_TRUE(mpDecodeFrame(fr + 1, len - 2, f));
+        TEST_ASSERT_EQUAL(MP_HITS, f.type);
+        TEST_ASSERT_EQUAL_STRING(b.node, f.node);
+        TEST_ASSERT_EQUAL_UINT32(b.seq, f.seq);
+
+        MpHitReader hr;
+        TEST_ASSERT_TRUE(mpBeginHits(f, hr));
+        TEST_ASSERT_TRUE(hr.batch.hasGps);
+        TEST_ASSERT_EQUAL_INT32(b.lat1e6, hr.batch.lat1e6);
+        TEST_ASSERT_EQUAL_INT32(b.lon1e6, hr.batch.lon1e6);
+        TEST_ASSERT_EQUAL_UINT32(b.t0, hr.batch.t0);
+        MpHit h;
+        size_t i = 0;
+        while (mpNextHit(hr, h)) {
+            const MpHit &e = hs[off + i++];
+            TEST_ASSERT_EQUAL_MEMORY(e.mac, h.mac, 6);
+            TEST_ASSERT_EQUAL_INT(e.rssi, h.rssi);
+            TEST_ASSERT_EQUAL_UINT(e.ch, h.ch);
+            TEST_ASSERT_EQUAL(e.ble, h.ble);
+            TEST_ASSERT_EQUAL_UINT(e.ageS, h.ageS);
+            TEST_ASSERT_EQUAL_STRING(e.name, h.name);
+            if (e.count > 1) {
+                TEST_ASSERT_EQUAL_UINT(e.count, h.count);
+                TEST_ASSERT_EQUAL_INT(e.rssiMax, h.rssiMax);
+                TEST_ASSERT_EQUAL_INT(e.rssiMean, h.rssiMean);
+            }
+        }
+        TEST_ASSERT_FALSE(hr.r.err);
+        TEST_ASSERT_EQUAL(used, i);
+        off += used;
+        frames++;
+    }
+    TEST_ASSERT_GREATER_THAN(1, frames);
+}
+
+static void test_text_round_trip()
+{
+    uint8_t fr[MP_MTU];
+    size_t len = mpEncodeText("NODE_1", 17, "STOP_ACK:OK", fr, MP_MTU);
+    TEST_ASSERT_GREATER_THAN(0, len);
+    MpFrame f;
+    TEST_ASSERT_TRUE(mpDecodeFrame(fr + 1, len - 2, f));
+    TEST_ASSERT_EQUAL(MP_TEXT, f.type);
+    TEST_ASSERT_EQUAL_UINT32(17, f.seq);
+    char out[64];
+    TEST_ASSERT_TRUE(mpReadText(f, out, sizeof(out)));
+    TEST_ASSERT_EQUAL_STRING("STOP_ACK:OK", out);
+    MpHitReader hr;
+    TEST_ASSERT_FALSE(mpBeginHits(f, hr));
+}
+
+// Every single-bit error anywhere in the frame body, and every truncation,
+// is rejected by COBS or the CRC rather than decoded as something else
+static void test_corrupt_frames_rejected()
+{
+    MpBatch b = testBatch();
+    std::vector<MpHit> hs = randomHits(8, 11);
+    uint8_t fr[MP_MTU];
+    size_t used;
+    size_t len = mpEncodeHits(b, hs.data(), hs.size(), fr, MP_MTU, used);
+    TEST_ASSERT_EQUAL(hs.size(), used);
+
+    MpFrame f;
+    for (size_t i = 1; i < len - 1; i++) {
+        for (int bit = 0; bit < 8; bit++) {
+            uint8_t bad[MP_MTU];
+            memcpy(bad, fr, len);
+            bad[i] ^= (uint8_t)(1 << bit);
+            TEST_ASSERT_FALSE(mpDecodeFrame(bad + 1, len - 2, f));
+        }
+    }
+    for (size_t n = 0; n < len - 2; n++) TEST_ASSERT_FALSE(mpDecodeFrame(fr + 1, n, f));
+
+    // Random multi-byte damage: the CRC leaves about 1 in 65536 through, so
+    // over this many trials none should get past it
+    std::mt19937 rng(5);
+    int accepted = 0;
+    for (int t = 0; t < 20000; t++) {
+        uint8_t bad[MP_MTU];
+        memcpy(bad, fr, len);
+        for (int k = 0; k < 3; k++) bad[1 + rng() % (len - 2)] = (uint8_t)(1 + rng() % 255);
+        if (memcmp(bad, fr, len) != 0 && mpDecodeFrame(bad + 1, len - 2, f)) accepted++;
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(2, accepted);
+}
+
+static void test_wrong_version_rejected()
+{
+    // Hand-built payload with a valid CRC but a future version nibble
+    uint8_t payload[16];
+    MpWriter w(payload, sizeof(payload));
+    w.u8((uint8_t)((MP_VERSION + 1) << 4 | MP_TEXT));
+    w.u8(1);
+    w.u8('N');
+    w.varint(1);
+    uint16_t crc = mpCrc16(payload, w.len);
+    w.u8((uint8_t)crc);
+    w.u8((uint8_t)(crc >> 8));
+    uint8_t enc[32];
+    size_t k = mpCobsEncode(payload, w.len, enc);
+    MpFrame f;
+    TEST_ASSERT_FALSE(mpDecodeFrame(enc, k, f));
+
+    payload[0] = (uint8_t)(MP_VERSION << 4 | MP_TEXT);
+    crc = mpCrc16(payload, w.len - 2);
+    payload[w.len - 2] = (uint8_t)crc;
+    payload[w.len - 1] = (uint8_t)(crc >> 8);
+    k = mpCobsEncode(payload, w.len, enc);
+    TEST_ASSERT_TRUE(mpDecodeFrame(enc, k, f));
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_varint_round_trip);
+    RUN_TEST(test_varint_sizes);
+    RUN_TEST(test_varint_truncated_and_overlong);
+    RUN_TEST(test_crc16_check_value);
+    RUN_TEST(test_cobs_round_trip);
+    RUN_TEST(test_cobs_rejects_malformed);
+    RUN_TEST(test_hits_round_trip);
+    RUN_TEST(test_text_round_trip);
+    RUN_TEST(test_corrupt_frames_rejected);
+    RUN_TEST(test_wrong_version_rejected);
+    return UNITY_END();
+}
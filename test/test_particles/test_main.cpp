@@ -0,0 +1,227 @@
+#include <unity.h>
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <vector>
+#include "particles.h"
+
+// A target walks between random waypoints at 1.4 m/s, pausing now and
+// then, inside a ring of six nodes 100 m out. Each node hears the target's
+// adverts through correlated shadowing, fading and the odd multipath
+// outlier, and reports the mean RSSI of its window. The particle filter
+// takes every report; least squares re-solves from each node's filtered
+// RSSI once three have reported, as the firmware does.
+
+static const LocalFrame ORIGIN = makeFrame(59.91, 10.75);
+static const int NODES = 6;
+
+struct SimConfig {
+    uint16_t particles;
+    uint32_t windowS;       // each node reports once per window
+    int runs;
+    int seconds;
+};
+
+struct SimResult {
+    std::vector<double> pfErr, wlsErr;
+    double pfUs = 0;
+    long updates = 0;
+};
+
+static double percentile(std::vector<double> v, double p)
+{
+    std::sort(v.begin(), v.end());
+    return v[(size_t)(p * (v.size() - 1))];
+}
+
+static SimResult simulate(const SimConfig &sc)
+{
+    const double SHADOW_DB = 6, SHADOW_CORR_M = 10, SPEED = 1.4;
+    std::mt19937 rng(5);
+    std::normal_distribution<double> gauss(0, 1);
+    std::uniform_real_distribution<double> unif(0, 1);
+    std::exponential_distribution<double> fade(1.0);
+    auto between = [&](double a, double b) { return a + (b - a) * unif(rng); };
+
+    SimResult res;
+    for (int run = 0; run < sc.runs; run++) {
+        double nx[NODES], ny[NODES], shadow[NODES], sum[NODES] = {};
+        int cnt[NODES] = {};
+        uint32_t phase[NODES];
+        PathLoss model[NODES];
+        for (int i = 0; i < NODES; i++) {
+            double a = 2 * M_PI * i / NODES;
+            nx[i] = 100 * cos(a) + 10 * gauss(rng);
+            ny[i] = 100 * sin(a) + 10 * gauss(rng);
+            model[i] = {(float)between(-62, -50), (float)between(2.2, 3.2), (float)SHADOW_DB};
+            shadow[i] = SHADOW_DB * gauss(rng);
+            phase[i] = rng() % sc.windowS;
+        }
+        ParticleLocator *pf = new ParticleLocator();
+        PfConfig cfg;
+        cfg.particles = sc.particles;
+        pf->configure(cfg, 1234 + run);
+        RssiFilter filt[NODES];
+        bool heard[NODES] = {};
+        LocFix prev;
+        bool havePrev = false;
+
+        double tx = between(-60, 60), ty = between(-60, 60), wx = between(-80, 80), wy = between(-80, 80);
+        double pauseUntil = 0;
+        for (int t = 0; t < sc.seconds; t++) {
+            if (t >= pauseUntil) {
+                double dx = wx - tx, dy = wy - ty, d = hypot(dx, dy);
+                if (d < SPEED) {
+                    tx = wx;
+                    ty = wy;
+                    wx = between(-80, 80);
+                    wy = between(-80, 80);
+                    if (unif(rng) < 0.3) pauseUntil = t + between(10, 60);
+                } else {
+                    tx += SPEED * dx / d;
+                    ty += SPEED * dy / d;
+                }
+            }
+            double tLat, tLon;
+            ORIGIN.fromEnu(tx, ty, tLat, tLon);
+
+            for (int i = 0; i < NODES; i++) {
+                double d = std::max(1.0, hypot(tx - nx[i], ty - ny[i]));
+                double rho = exp(-SPEED / SHADOW_CORR_M);
+                shadow[i] = rho * shadow[i] + sqrt(1 - rho * rho) * SHADOW_DB * gauss(rng);
+                if (unif(rng) < 0.5) {
+                    double v = model[i].p0 - 10 * model[i].n * log10(d) + shadow[i] + 10 * log10(fade(rng));
+                    if (unif(rng) < 0.05) v += unif(rng) < 0.5 ? 15 : -15;
+                    if (v >= -95) {
+                        sum[i] += v;
+                        cnt[i]++;
+                    }
+                }
+                if ((t + phase[i]) % sc.windowS || !cnt[i]) continue;
+
+                float level = (float)(int)(sum[i] / cnt[i]);
+                sum[i] = 0;
+                cnt[i] = 0;
+                double lat, lon;
+                ORIGIN.fromEnu(nx[i], ny[i], lat, lon);
+                auto t0 = std::chrono::steady_clock::now();
+                pf->update(lat, lon, level, model[i], t * 1000);
+                res.pfUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+                res.updates++;
+                LocFix f;
+                if (t >= 60 && pf->estimate(f)) res.pfErr.push_back(locDistance(f.lat, f.lon, tLat, tLon));
+
+                filt[i].update(level);
+                heard[i] = true;
+                LocObs obs[NODES];
+                size_t m = 0;
+                for (int k = 0; k < NODES; k++) {
+                    if (!heard[k]) continue;
+                    ORIGIN.fromEnu(nx[k], ny[k], obs[m].lat, obs[m].lon);
+                    obs[m].range = pathLossDistance(model[k], filt[k].value());
+                    obs[m].sigma = pathLossRangeSigma(model[k], obs[m].range);
+                    m++;
+                }
+                if (m < 3) continue;
+                LocStatus st = locateWls(obs, m, f, havePrev ? &prev : nullptr);
+                if (st == LOC_NO_CONVERGE && havePrev) st = locateWls(obs, m, f);
+                if (st == LOC_OK) {
+                    prev = f;
+                    havePrev = true;
+                }
+                if (t >= 60 && havePrev) res.wlsErr.push_back(locDistance(prev.lat, prev.lon, tLat, tLon));
+            }
+        }
+        delete pf;
+    }
+    return res;
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_estimate_before_first_report()
+{
+    ParticleLocator *pf = new ParticleLocator();
+    pf->configure(PfConfig(), 1);
+    LocFix f;
+    TEST_ASSERT_FALSE(pf->estimate(f));
+    TEST_ASSERT_FALSE(pf->started());
+    double lat, lon;
+    ORIGIN.fromEnu(0, 0, lat, lon);
+    pf->update(lat, lon, -70, PATHLOSS_DEFAULT, 1000);
+    TEST_ASSERT_TRUE(pf->estimate(f));
+    TEST_ASSERT_EQUAL_UINT32(1, pf->updates());
+    delete pf;
+}
+
+// Parked target, exact model readings from four nodes
+static void test_parked_target_converges()
+{
+    ParticleLocator *pf = new ParticleLocator();
+    pf->configure(PfConfig(), 7);
+    const double nodes[4][2] = {{-50, -50}, {50, -50}, {50, 50}, {-50, 50}};
+    const double tx = 15, ty = -20;
+    for (int k = 0; k < 80; k++) {
+        const double *n = nodes[k % 4];
+        double lat, lon;
+        ORIGIN.fromEnu(n[0], n[1], lat, lon);
+        float rssi = PATHLOSS_DEFAULT.p0 - 10 * PATHLOSS_DEFAULT.n * log10f((float)hypot(tx - n[0], ty - n[1]));
+        pf->update(lat, lon, rssi, PATHLOSS_DEFAULT, 1000 + k * 2500);
+    }
+    LocFix f;
+    TEST_ASSERT_TRUE(pf->estimate(f));
+    double lat, lon;
+    ORIGIN.fromEnu(tx, ty, lat, lon);
+    double err = locDistance(f.lat, f.lon, lat, lon);
+    printf("parked target: error %.1f m, 95%% spread %.1f x %.1f m\n", err, f.major, f.minor);
+    TEST_ASSERT_LESS_THAN(10.0, err);
+    float ve, vn;
+    pf->velocity(ve, vn);
+    TEST_ASSERT_LESS_THAN(1.0f, sqrtf(ve * ve + vn * vn));
+    delete pf;
+}
+
+// Accuracy and cost against particle count, one report per node per 10 s
+static void test_benchmark_particle_count()
+{
+    double median256 = 0, wlsMedian = 0;
+    for (uint16_t particles : {64, 128, 256, 512}) {
+        SimResult r = simulate({particles, 10, 20, 600});
+        double median = percentile(r.pfErr, 0.5), us = r.pfUs / r.updates;
+        wlsMedian = percentile(r.wlsErr, 0.5);
+        printf("PF %3u particles: median %.1f m, p90 %.1f m, %.1f us/update (WLS median %.1f m, p90 %.1f m)\n",
+               (unsigned)particles, median, percentile(r.pfErr, 0.9), us, wlsMedian, percentile(r.wlsErr, 0.9));
+        if (particles == PF_DEFAULT_PARTICLES) median256 = median;
+        TEST_ASSERT_LESS_THAN(1000.0, us);
+    }
+    // RSSI alone puts both near 50 m here; the filter must not do worse
+    TEST_ASSERT_LESS_THAN(wlsMedian * 1.1, median256);
+}
+
+// Accuracy against how often each node reports, default particle count
+static void test_benchmark_report_rate()
+{
+    double last = 0;
+    for (uint32_t windowS : {5, 10, 20, 40}) {
+        SimResult r = simulate({PF_DEFAULT_PARTICLES, windowS, 20, 600});
+        double median = percentile(r.pfErr, 0.5);
+        printf("one report per node per %2us: PF median %.1f m, p90 %.1f m; WLS median %.1f m\n", (unsigned)windowS,
+               median, percentile(r.pfErr, 0.9), percentile(r.wlsErr, 0.5));
+        last = median;
+    }
+    // Even at one report per node every 40 s it stays inside the node ring
+    TEST_ASSERT_LESS_THAN(100.0, last);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_estimate_before_first_report);
+    RUN_TEST(test_parked_target_converges);
+    RUN_TEST(test_benchmark_particle_count);
+    RUN_TEST(test_benchmark_report_rate);
+    return UNITY_END();
+}
@@ -0,0 +1,138 @@
+#include <unity.h>
+#include <algorithm>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <vector>
+#include "radio.h"
+
+void setUp() {}
+void tearDown() {}
+
+static void test_scan_params()
+{
+    const uint8_t modes[] = {RADIO_BLE, RADIO_AP | RADIO_BLE, RADIO_PROMISC_BLE, RADIO_AP_PROMISC | RADIO_BLE};
+    for (uint8_t mode : modes) {
+        for (bool tracking : {false, true}) {
+            BleScanParams p = bleScanParamsFor(mode, tracking);
+            TEST_ASSERT_TRUE(p.windowMs > 0 && p.windowMs <= p.intervalMs);
+            // The controller counts in 0.625 ms units, up to 10.24 s
+            TEST_ASSERT_EQUAL_UINT(0, (p.intervalMs * 8) % 5);
+            TEST_ASSERT_EQUAL_UINT(0, (p.windowMs * 8) % 5);
+            TEST_ASSERT_LESS_OR_EQUAL(10240, p.intervalMs);
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT(100, bleScanParamsFor(RADIO_BLE).windowMs);
+    TEST_ASSERT_EQUAL_UINT(100, bleScanParamsFor(RADIO_BLE, true).windowMs);
+    TEST_ASSERT_EQUAL_INT(RADIO_COEX_BT, bleScanParamsFor(RADIO_BLE).coex);
+    TEST_ASSERT_EQUAL_UINT(30, bleScanParamsFor(RADIO_PROMISC_BLE).windowMs);
+    // Tracking holds a whole 1 s advertising period in one window
+    TEST_ASSERT_GREATER_THAN(1010, bleScanParamsFor(RADIO_PROMISC_BLE, true).windowMs);
+}
+
+static void test_duty_meter()
+{
+    BleDutyMeter m;
+    m.start(bleScanParamsFor(RADIO_PROMISC_BLE), 0, 0);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.30f, m.duty(10000));
+    m.change(bleScanParamsFor(RADIO_BLE), 10000);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.65f, m.duty(20000));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 200.0f, m.advertRate(20000, 4000));
+    // Not recomputed until another window has passed
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 200.0f, m.advertRate(21000, 9000));
+    m.stop(20000);
+    TEST_ASSERT_FALSE(m.running());
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.65f, m.duty(60000));
+    TEST_ASSERT_EQUAL_UINT32(20000, m.elapsedMs(60000));
+}
+
+// Advertisers at Apple's recommended intervals (and 100 ms and 2 s), each
+// advert 0-10 ms late by its advDelay, against a listening schedule. A
+// scan of scanMs every periodMs (the old start(1) loops) reports a device
+// once per scan; a continuous one reports every advert in a window.
+struct Schedule {
+    const char *name;
+    BleScanParams p;
+    uint32_t scanMs, periodMs;
+};
+
+struct DutyResult {
+    double reported;        // share of adverts reported
+    double worstGapS;       // longest silence, any advertiser
+    double worstGap1sS;     // longest silence, ~1 s advertisers
+};
+
+static DutyResult simulate(const Schedule &s)
+{
+    const double periods[] = {100, 152.5, 211.25, 318.75, 417.5, 546.25, 760, 852.5, 1000, 1022.5, 1285, 2000};
+    const double T = 600000;
+    std::mt19937 rng(5);
+    DutyResult r = {0, 0, 0};
+    size_t caught = 0, total = 0;
+    for (double period : periods) {
+        for (int d = 0; d < 20; d++) {
+            double t = (rng() % 20000) / 10.0, last = 0, gap = 0;
+            long lastScan = -1;
+            for (; t < T; t += period + (rng() % 1001) / 100.0) {
+                total++;
+                bool listening = fmod(t, s.p.intervalMs) < s.p.windowMs;
+                long scan = -1;
+                if (s.periodMs) {
+                    double ph = fmod(t, s.periodMs);
+                    scan = (long)(t / s.periodMs);
+                    listening = listening && ph < s.scanMs;
+                }
+                if (!listening || (scan >= 0 && scan == lastScan)) continue;
+                lastScan = scan;
+                caught++;
+                gap = std::max(gap, t - last);
+                last = t;
+            }
+            gap = std::max(gap, T - last);
+            r.worstGapS = std::max(r.worstGapS, gap / 1000);
+            if (period >= 1000 && period < 1100) r.worstGap1sS = std::max(r.worstGap1sS, gap / 1000);
+        }
+    }
+    r.reported = (double)caught / total;
+    return r;
+}
+
+static void test_duty_simulation()
+{
+    const Schedule schedules[] = {
+        {"old list scan, 1 s every 3 s", {100, 99, RADIO_COEX_BALANCE}, 1000, 3000},
+        {"old tracker, 1 s back to back", {100, 99, RADIO_COEX_BALANCE}, 1000, 1050},
+        {"old sniffer, 1 s every 8 s", {100, 99, RADIO_COEX_BALANCE}, 1000, 8000},
+        {"promiscuous on", bleScanParamsFor(RADIO_PROMISC_BLE), 0, 0},
+        {"AP only", bleScanParamsFor(RADIO_AP | RADIO_BLE), 0, 0},
+        {"BLE alone", bleScanParamsFor(RADIO_BLE), 0, 0},
+        {"tracker, promiscuous on", bleScanParamsFor(RADIO_PROMISC_BLE, true), 0, 0},
+    };
+    DutyResult res[7];
+    for (int i = 0; i < 7; i++) {
+        res[i] = simulate(schedules[i]);
+        printf("%-32s %4u/%-4u ms: %5.1f%% of adverts, worst gap %5.1f s (1 s adverts %4.1f s)\n",
+               schedules[i].name, schedules[i].p.windowMs, schedules[i].p.intervalMs, 100 * res[i].reported,
+               res[i].worstGapS, res[i].worstGap1sS);
+    }
+    // Continuous scans report their listening share of every advert
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 0.30, res[3].reported);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 0.50, res[4].reported);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 1.0, res[5].reported);
+    TEST_ASSERT_LESS_THAN(2.1, res[5].worstGapS);
+    // A short window leaves ~1 s advertisers unheard for long stretches;
+    // the tracker's long window hears them every interval
+    TEST_ASSERT_GREATER_THAN(5.0, res[3].worstGap1sS);
+    TEST_ASSERT_LESS_THAN(4.0, res[6].worstGap1sS);
+    TEST_ASSERT_LESS_THAN(res[3].worstGapS, res[6].worstGapS);
+    TEST_ASSERT_GREATER_THAN(0.30, res[6].reported);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_scan_params);
+    RUN_TEST(test_duty_meter);
+    RUN_TEST(test_duty_simulation);
+    return UNITY_END();
+}
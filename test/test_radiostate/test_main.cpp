@@ -0,0 +1,157 @@
+#include <unity.h>
+#include <string.h>
+#include "radio.h"
+
+// A driver stub that keeps the state the real ESP-IDF calls would leave
+// behind, and refuses what the IDF refuses: promiscuous RX with Wi-Fi off.
+class FakeDriver : public RadioDriver {
+  public:
+    RadioWifiMode wifi = RADIO_WIFI_OFF;
+    bool promisc = false, ble = false;
+    int calls = 0;
+    int failWifi = -1;          // fail the setWifiMode call to this mode
+    bool failBle = false;
+
+    bool setWifiMode(RadioWifiMode mode) override
+    {
+        calls++;
+        if (mode == failWifi) return false;
+        // The IDF drops promiscuous RX on a mode change
+        if (mode != wifi) promisc = false;
+        wifi = mode;
+        return true;
+    }
+    bool setPromiscuous(bool on) override
+    {
+        calls++;
+        if (on && wifi == RADIO_WIFI_OFF) return false;
+        promisc = on;
+        return true;
+    }
+    bool setBLE(bool on) override
+    {
+        calls++;
+        if (on && failBle) return false;
+        ble = on;
+        return true;
+    }
+    int64_t nowUs() override { return calls * 1000; }
+
+    // The mode bits this driver state amounts to
+    uint8_t mode() const
+    {
+        return (wifi == RADIO_WIFI_AP ? RADIO_AP : 0) | (promisc ? RADIO_PROMISC : 0) | (ble ? RADIO_BLE : 0);
+    }
+};
+
+static const uint8_t MODES[] = {RADIO_OFF,          RADIO_AP,
+                                RADIO_PROMISC,      RADIO_BLE,
+                                RADIO_PROMISC_BLE,  RADIO_AP_PROMISC,
+                                RADIO_AP | RADIO_BLE, RADIO_AP_PROMISC | RADIO_BLE};
+
+void setUp() {}
+void tearDown() {}
+
+static void test_names()
+{
+    TEST_ASSERT_EQUAL_STRING("OFF", RadioStateMachine::modeName(RADIO_OFF));
+    TEST_ASSERT_EQUAL_STRING("PROMISC+BLE", RadioStateMachine::modeName(RADIO_PROMISC_BLE));
+    TEST_ASSERT_EQUAL_STRING("AP+PROMISC+BLE", RadioStateMachine::modeName(RADIO_AP_PROMISC | RADIO_BLE));
+    TEST_ASSERT_EQUAL_INT(RADIO_WIFI_AP, RadioStateMachine::wifiModeFor(RADIO_AP_PROMISC));
+    TEST_ASSERT_EQUAL_INT(RADIO_WIFI_STA, RadioStateMachine::wifiModeFor(RADIO_PROMISC_BLE));
+    TEST_ASSERT_EQUAL_INT(RADIO_WIFI_OFF, RadioStateMachine::wifiModeFor(RADIO_BLE));
+}
+
+// Every mode to every other: the target is reached, the driver ends up in
+// the same state the machine reports, and repeating it is free
+static void test_all_pairs()
+{
+    for (uint8_t from : MODES) {
+        for (uint8_t to : MODES) {
+            FakeDriver drv;
+            RadioStateMachine sm(drv);
+            RadioTransition t;
+            TEST_ASSERT_TRUE(sm.transition(from, t));
+            TEST_ASSERT_EQUAL_HEX8(from, drv.mode());
+            TEST_ASSERT_TRUE(sm.transition(to, t));
+            TEST_ASSERT_EQUAL_HEX8(from, t.from);
+            TEST_ASSERT_EQUAL_HEX8(to, t.reached);
+            TEST_ASSERT_EQUAL_HEX8(to, sm.mode());
+            TEST_ASSERT_EQUAL_HEX8(to, drv.mode());
+            TEST_ASSERT_EQUAL_INT64((int64_t)t.driverCalls * 1000, t.us);
+            TEST_ASSERT_TRUE(sm.transition(to, t));
+            TEST_ASSERT_EQUAL_UINT(0, t.driverCalls);
+        }
+    }
+}
+
+static void test_fewest_calls()
+{
+    FakeDriver drv;
+    RadioStateMachine sm(drv);
+    RadioTransition t;
+    TEST_ASSERT_TRUE(sm.transition(RADIO_AP, t));
+    TEST_ASSERT_EQUAL_UINT(1, t.driverCalls);
+    // AP <-> AP+PROMISC only toggles promiscuous RX
+    TEST_ASSERT_TRUE(sm.transition(RADIO_AP_PROMISC, t));
+    TEST_ASSERT_EQUAL_UINT(1, t.driverCalls);
+    TEST_ASSERT_TRUE(sm.transition(RADIO_AP, t));
+    TEST_ASSERT_EQUAL_UINT(1, t.driverCalls);
+    // Adding BLE leaves Wi-Fi alone
+    TEST_ASSERT_TRUE(sm.transition(RADIO_AP | RADIO_BLE, t));
+    TEST_ASSERT_EQUAL_UINT(1, t.driverCalls);
+    // AP+BLE -> PROMISC+BLE: restart Wi-Fi as STA, then promiscuous; BLE stays up
+    TEST_ASSERT_TRUE(sm.transition(RADIO_PROMISC_BLE, t));
+    TEST_ASSERT_EQUAL_UINT(2, t.driverCalls);
+    TEST_ASSERT_TRUE(drv.ble);
+    // PROMISC+BLE -> AP+PROMISC: BLE off, promiscuous off, AP, promiscuous on
+    TEST_ASSERT_TRUE(sm.transition(RADIO_AP_PROMISC, t));
+    TEST_ASSERT_EQUAL_UINT(4, t.driverCalls);
+}
+
+// A failed Wi-Fi switch leaves the driver off rather than half-configured,
+// and the machine says so
+static void test_wifi_failure()
+{
+    FakeDriver drv;
+    RadioStateMachine sm(drv);
+    RadioTransition t;
+    TEST_ASSERT_TRUE(sm.transition(RADIO_AP_PROMISC, t));
+    drv.failWifi = RADIO_WIFI_STA;
+    TEST_ASSERT_FALSE(sm.transition(RADIO_PROMISC_BLE, t));
+    TEST_ASSERT_EQUAL_HEX8(RADIO_PROMISC_BLE, t.to);
+    TEST_ASSERT_EQUAL_HEX8(RADIO_BLE, t.reached);
+    TEST_ASSERT_EQUAL_INT(RADIO_WIFI_OFF, drv.wifi);
+    TEST_ASSERT_FALSE(drv.promisc);
+    TEST_ASSERT_EQUAL_HEX8(drv.mode(), sm.mode());
+
+    // Once the driver recovers the same request goes through
+    drv.failWifi = -1;
+    TEST_ASSERT_TRUE(sm.transition(RADIO_PROMISC_BLE, t));
+    TEST_ASSERT_EQUAL_UINT(2, t.driverCalls);
+}
+
+static void test_ble_failure()
+{
+    FakeDriver drv;
+    RadioStateMachine sm(drv);
+    RadioTransition t;
+    drv.failBle = true;
+    TEST_ASSERT_FALSE(sm.transition(RADIO_AP | RADIO_BLE, t));
+    TEST_ASSERT_EQUAL_HEX8(RADIO_AP, t.reached);
+    TEST_ASSERT_EQUAL_HEX8(drv.mode(), sm.mode());
+    drv.failBle = false;
+    TEST_ASSERT_TRUE(sm.transition(RADIO_AP | RADIO_BLE, t));
+    TEST_ASSERT_EQUAL_UINT(1, t.driverCalls);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_names);
+    RUN_TEST(test_all_pairs);
+    RUN_TEST(test_fewest_calls);
+    RUN_TEST(test_wifi_failure);
+    RUN_TEST(test_ble_failure);
+    return UNITY_END();
+}
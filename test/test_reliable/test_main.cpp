@@ -0,0 +1,235 @@
+#include <unity.h>
+#include <algorithm>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "dedupe.h"
+#include "reliable.h"
+
+// Loss to simulate, percent per message per hop; build with
+// -D RELIABLE_SIM_LOSS=35 to try one value
+#ifdef RELIABLE_SIM_LOSS
+static const int LOSSES[] = {RELIABLE_SIM_LOSS};
+#else
+static const int LOSSES[] = {0, 10, 20, 30, 50};
+#endif
+
+void setUp() {}
+void tearDown() {}
+
+static void nodeName(int i, NodeName &out) { snprintf(out, sizeof(NodeName), "NODE_%d", i); }
+
+static void test_ack_tracking()
+{
+    ReliableSender s;
+    NodeName dests[2];
+    nodeName(1, dests[0]);
+    nodeName(2, dests[1]);
+    const char *line = "@ALL STOP ~CC.5";
+    TEST_ASSERT_TRUE(s.add(5, line, strlen(line), dests, 2, 0));
+    TEST_ASSERT_EQUAL(ACK_UNKNOWN, s.ack(6, "NODE_1", 6));
+    TEST_ASSERT_EQUAL(ACK_UNKNOWN, s.ack(5, "NODE_9", 6));
+    TEST_ASSERT_EQUAL(ACK_RECORDED, s.ack(5, "NODE_1", 6));
+    TEST_ASSERT_EQUAL(ACK_RECORDED, s.ack(5, "NODE_1", 6));
+    TEST_ASSERT_EQUAL(ACK_COMPLETE, s.ack(5, "NODE_2", 6));
+    TEST_ASSERT_EQUAL(0, s.pending());
+}
+
+// Resends back off up to RELIABLE_ATTEMPTS sends, then give up naming who
+// never answered
+static void test_backoff_and_expiry()
+{
+    ReliableSender s;
+    NodeName dests[2];
+    nodeName(1, dests[0]);
+    nodeName(2, dests[1]);
+    const char *line = "@ALL STOP ~CC.9";
+    TEST_ASSERT_TRUE(s.add(9, line, strlen(line), dests, 2, 0));
+    s.ack(9, "NODE_1", 6);
+
+    ReliableEvent ev[2];
+    uint32_t last = 0;
+    int resends = 0;
+    bool expired = false;
+    for (uint32_t now = 0; now < 600000 && !expired; now += 100) {
+        size_t n = s.poll(now, ev, 2);
+        for (size_t i = 0; i < n; i++) {
+            if (ev[i].expired) {
+                expired = true;
+                TEST_ASSERT_EQUAL_STRING("NODE_2", ev[i].missing);
+                TEST_ASSERT_EQUAL(1, ev[i].acked);
+                continue;
+            }
+            TEST_ASSERT_EQUAL(strlen(line), ev[i].len);
+            TEST_ASSERT_EQUAL_MEMORY(line, ev[i].line, ev[i].len);
+            // Doubling from RELIABLE_RETRY_MS to the cap, plus up to 25% jitter
+            uint32_t base = RELIABLE_RETRY_MS << resends;
+            if (base > RELIABLE_RETRY_MAX_MS) base = RELIABLE_RETRY_MAX_MS;
+            TEST_ASSERT_GREATER_OR_EQUAL(base, now - last);
+            TEST_ASSERT_LESS_OR_EQUAL(base + base / 4 + 100, now - last);
+            last = now;
+            resends++;
+        }
+    }
+    TEST_ASSERT_TRUE(expired);
+    TEST_ASSERT_EQUAL(RELIABLE_ATTEMPTS - 1, resends);
+    TEST_ASSERT_EQUAL(0, s.pending());
+}
+
+static void test_peer_table()
+{
+    PeerTable t;
+    for (int i = 0; i < 20; i++) {
+        NodeName n;
+        nodeName(i, n);
+        t.note(n, strlen(n), (uint32_t)i * 1000);
+    }
+    NodeName out[RELIABLE_DESTS];
+    // Full table: the four heard longest ago made room
+    TEST_ASSERT_EQUAL(RELIABLE_DESTS, t.collect(out, RELIABLE_DESTS, 20000, 60000));
+    for (size_t i = 0; i < RELIABLE_DESTS; i++) TEST_ASSERT_TRUE(strcmp(out[i], "NODE_0") != 0);
+    // Window: only nodes heard in the last 5 s
+    TEST_ASSERT_EQUAL(5, t.collect(out, RELIABLE_DESTS, 20000, 5000));
+    t.note("NODE_4", 6, 30000);
+    TEST_ASSERT_EQUAL(1, t.collect(out, RELIABLE_DESTS, 30000, 1000));
+    TEST_ASSERT_EQUAL_STRING("NODE_4", out[0]);
+}
+
+// One commander, RECEIVERS nodes. Every message (status, command, ack) is
+// lost independently with the given probability and otherwise delivered
+// after 1-8 s. The commander learns its peers from their status lines
+// through a PeerTable and waits for them with a ReliableSender; receivers
+// run the firmware's rule that a command id they already acked is re-acked,
+// never re-run.
+struct SimMsg {
+    uint32_t at;
+    int node;       // receiver for a command, sender for an ack
+    bool ack;
+    uint32_t seq;
+};
+
+struct SimResult {
+    double allRan, perNode, fireAndForget, sendsPerCmd, acksPerCmd, p50s, p95s;
+    long duplicateRuns, gaveUp;
+};
+
+static SimResult simulate(int lossPct)
+{
+    const int RECEIVERS = 10, CMDS = 2000;
+    std::mt19937 rng(7 + lossPct);
+    auto lost = [&] { return (int)(rng() % 100) < lossPct; };
+    auto latency = [&] { return (uint32_t)(1000 + rng() % 7000); };
+
+    PeerTable peers;
+    SimResult r = {};
+    long cmdTx = 0, ackTx = 0, runs = 0, allRan = 0;
+    std::vector<uint32_t> doneMs;
+    uint32_t clock = 0;
+    const char *line = "@ALL TRIANGULATE_START:AA:BB:CC:DD:EE:FF:60";
+
+    for (int c = 0; c < CMDS; c++) {
+        // Status lines every minute since the last command
+        for (int k = 0; k < 5; k++) {
+            clock += 60000;
+            for (int i = 0; i < RECEIVERS; i++) {
+                if (lost()) continue;
+                NodeName n;
+                nodeName(i, n);
+                peers.note(n, strlen(n), clock);
+            }
+        }
+        NodeName dests[RELIABLE_DESTS];
+        size_t destCount = peers.collect(dests, RELIABLE_DESTS, clock, 1800000);
+
+        ReliableSender s;
+        DedupeCache acked[RECEIVERS];
+        std::vector<int> ran(RECEIVERS, 0);
+        std::vector<SimMsg> q;
+        uint32_t seq = 1000 + c, now = 0;
+        auto sendCmd = [&] {
+            cmdTx++;
+            for (int i = 0; i < RECEIVERS; i++)
+                if (!lost()) q.push_back({now + latency(), i, false, seq});
+        };
+        sendCmd();
+        TEST_ASSERT_TRUE(s.add(seq, line, strlen(line), dests, destCount, now));
+
+        for (now = 0; now < 400000; now += 100) {
+            for (size_t i = 0; i < q.size();) {
+                if (q[i].at > now) {
+                    i++;
+                    continue;
+                }
+                SimMsg m = q[i];
+                q.erase(q.begin() + i);
+                if (!m.ack) {
+                    uint32_t key = dedupeKey("CMDR", 4, m.seq);
+                    if (!acked[m.node].contains(key, now, 600000)) {
+                        ran[m.node]++;
+                        acked[m.node].seen(key, now, 600000);
+                    }
+                    ackTx++;
+                    if (!lost()) q.push_back({now + latency(), m.node, true, m.seq});
+                } else {
+                    NodeName n;
+                    nodeName(m.node, n);
+                    if (s.ack(m.seq, n, strlen(n)) == ACK_COMPLETE) doneMs.push_back(now);
+                }
+            }
+            ReliableEvent ev[2];
+            size_t n = s.poll(now, ev, 2);
+            for (size_t i = 0; i < n; i++) {
+                if (ev[i].expired) r.gaveUp++;
+                else sendCmd();
+            }
+            if (!s.pending() && q.empty()) break;
+        }
+        int got = 0;
+        for (int i = 0; i < RECEIVERS; i++) {
+            if (ran[i]) got++;
+            if (ran[i] > 1) r.duplicateRuns += ran[i] - 1;
+            runs += ran[i] ? 1 : 0;
+        }
+        if (got == RECEIVERS) allRan++;
+        clock += now;
+    }
+
+    r.allRan = 100.0 * allRan / CMDS;
+    r.perNode = 100.0 * runs / (CMDS * RECEIVERS);
+    r.fireAndForget = 100.0;
+    for (int i = 0; i < RECEIVERS; i++) r.fireAndForget *= (100 - lossPct) / 100.0;
+    r.sendsPerCmd = (double)cmdTx / CMDS;
+    r.acksPerCmd = (double)ackTx / CMDS;
+    std::sort(doneMs.begin(), doneMs.end());
+    if (!doneMs.empty()) {
+        r.p50s = doneMs[(doneMs.size() - 1) / 2] / 1000.0;
+        r.p95s = doneMs[(size_t)(0.95 * (doneMs.size() - 1))] / 1000.0;
+    }
+    printf("loss %2d%%: all %d ran %.1f%% (fire-and-forget %.1f%%), per node %.2f%%, duplicate runs %ld, "
+           "sends/cmd %.2f, acks/cmd %.1f, gave up %ld, all acked p50 %.1fs p95 %.1fs\n",
+           lossPct, RECEIVERS, r.allRan, r.fireAndForget, r.perNode, r.duplicateRuns, r.sendsPerCmd, r.acksPerCmd,
+           r.gaveUp, r.p50s, r.p95s);
+    return r;
+}
+
+static void test_lossy_link()
+{
+    for (int loss : LOSSES) {
+        SimResult r = simulate(loss);
+        TEST_ASSERT_EQUAL(0, r.duplicateRuns);
+        TEST_ASSERT_GREATER_OR_EQUAL(r.fireAndForget, r.allRan);
+        if (loss == 0) TEST_ASSERT_FLOAT_WITHIN(0.001, 1.0, r.sendsPerCmd);
+        if (loss <= 20) TEST_ASSERT_GREATER_OR_EQUAL(99.0, r.allRan);
+    }
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_ack_tracking);
+    RUN_TEST(test_backoff_and_expiry);
+    RUN_TEST(test_peer_table);
+    RUN_TEST(test_lossy_link);
+    return UNITY_END();
+}
@@ -0,0 +1,199 @@
+#include <unity.h>
+#include <algorithm>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <vector>
+#include "rssimodel.h"
+
+void setUp() {}
+void tearDown() {}
+
+static double percentile(std::vector<double> v, double p)
+{
+    std::sort(v.begin(), v.end());
+    return v[(size_t)(p * (v.size() - 1))];
+}
+
+static float modelRssi(const PathLoss &m, double dist)
+{
+    return (float)(m.p0 - 10.0 * m.n * log10(dist));
+}
+
+static void test_distance_roundtrip()
+{
+    PathLoss m = {-52.0f, 2.7f, 5.0f};
+    for (float d : {1.0f, 3.0f, 10.0f, 45.0f}) TEST_ASSERT_FLOAT_WITHIN(d * 1e-4f, d, pathLossDistance(m, modelRssi(m, d)));
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 10.0f, pathLossDistance(PATHLOSS_DEFAULT, -79.0f));
+    // The range sigma grows with distance and never drops under 1 m
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 1.0f, pathLossRangeSigma(m, 0.5f));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 20 * 0.230259f * 5 / 2.7f, pathLossRangeSigma(m, 20));
+}
+
+static void test_filter_rejects_spikes()
+{
+    RssiFilter f;
+    for (int i = 0; i < 10; i++) f.update(-70);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, -70, f.value());
+
+    // Single multipath spikes and deep fades don't reach the output
+    f.update(-35);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, -70, f.value());
+    f.update(-70);
+    f.update(-98);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, -70, f.value());
+    // Nor do two in one window
+    f.update(-30);
+    f.update(-70);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, -70, f.value());
+    TEST_ASSERT_EQUAL_UINT32(15, f.count());
+
+    // A real move is followed: within 1 dB after a dozen readings
+    int n = 0;
+    while (fabsf(f.update(-55) + 55) > 1.0f) n++;
+    TEST_ASSERT_LESS_OR_EQUAL(12, n);
+}
+
+// A still device with 4 dB Gaussian noise and 5% outliers 15-30 dB off
+static void test_filter_noisy_trace()
+{
+    std::mt19937 rng(17);
+    std::normal_distribution<double> noise(0, 4);
+    std::uniform_real_distribution<double> unif(0, 1);
+    RssiFilter f;
+    std::vector<double> rawErr, filtErr;
+    for (int i = 0; i < 5000; i++) {
+        double r = -68 + noise(rng);
+        if (unif(rng) < 0.05) r += (unif(rng) < 0.5 ? 1 : -1) * (15 + 15 * unif(rng));
+        float v = f.update((float)r);
+        if (i < 20) continue;
+        rawErr.push_back(fabs(r + 68));
+        filtErr.push_back(fabs(v + 68));
+    }
+    double raw90 = percentile(rawErr, 0.9), filt90 = percentile(filtErr, 0.9);
+    double rawWorst = percentile(rawErr, 1.0), worst = percentile(filtErr, 1.0);
+    printf("noisy trace: |error| p90 raw %.1f dB, filtered %.1f dB; worst raw %.1f dB, filtered %.1f dB\n", raw90,
+           filt90, rawWorst, worst);
+    TEST_ASSERT_LESS_THAN(raw90 * 0.5, filt90);
+    // Outliers don't get through: the worst reading is only noise tails
+    TEST_ASSERT_LESS_THAN(rawWorst * 0.5, worst);
+}
+
+// A walk between 3 and 40 m from a beacon, log-uniform in distance
+static PathLossFit walk(const PathLoss &truth, int samples, double noiseDb, std::mt19937 &rng)
+{
+    std::normal_distribution<double> noise(0, noiseDb);
+    std::uniform_real_distribution<double> logd(log10(3.0), log10(40.0));
+    PathLossFit fit;
+    for (int i = 0; i < samples; i++) {
+        double d = pow(10, logd(rng));
+        fit.add((float)d, (float)(modelRssi(truth, d) + noise(rng)));
+    }
+    return fit;
+}
+
+static void test_fit_recovers_model()
+{
+    std::mt19937 rng(3);
+    const PathLoss truths[] = {{-52.0f, 2.7f, 4.0f}, {-61.0f, 2.0f, 4.0f}, {-45.0f, 3.4f, 4.0f}};
+    for (const PathLoss &t : truths) {
+        PathLoss m;
+        TEST_ASSERT_TRUE(walk(t, 400, 4.0, rng).solve(m));
+        TEST_ASSERT_FLOAT_WITHIN(1.5f, t.p0, m.p0);
+        TEST_ASSERT_FLOAT_WITHIN(0.15f, t.n, m.n);
+        TEST_ASSERT_FLOAT_WITHIN(0.6f, 4.0f, m.sigmaDb);
+    }
+
+    // Noise-free: exact, and sigma held at its 2 dB floor
+    PathLoss m;
+    TEST_ASSERT_TRUE(walk(truths[0], 20, 0, rng).solve(m));
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, -52.0f, m.p0);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 2.7f, m.n);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, 2.0f, m.sigmaDb);
+}
+
+static void test_fit_refuses()
+{
+    std::mt19937 rng(4);
+    PathLoss t = {-52.0f, 2.7f, 4.0f}, m;
+    TEST_ASSERT_FALSE(walk(t, PATHLOSS_FIT_MIN_SAMPLES - 1, 4.0, rng).solve(m));
+
+    // Distances within a factor of 2
+    PathLossFit narrow;
+    for (int i = 0; i < 50; i++) narrow.add(10.0f + i % 9, modelRssi(t, 10 + i % 9));
+    TEST_ASSERT_FALSE(narrow.solve(m));
+
+    // Closer than PATHLOSS_FIT_MIN_DIST isn't counted
+    PathLossFit close;
+    for (int i = 0; i < 50; i++) close.add(0.5f + (i % 5) * 0.5f, -40);
+    TEST_ASSERT_EQUAL_size_t(0, close.count());
+
+    // RSSI that doesn't fall with distance gives an implausible exponent
+    PathLossFit flat;
+    for (int i = 0; i < 50; i++) flat.add(3.0f + i, -70.0f + (i % 3));
+    TEST_ASSERT_FALSE(flat.solve(m));
+
+    PathLossFit fit = walk(t, 50, 4.0, rng);
+    TEST_ASSERT_TRUE(fit.solve(m));
+    fit.clear();
+    TEST_ASSERT_EQUAL_size_t(0, fit.count());
+    TEST_ASSERT_FALSE(fit.solve(m));
+}
+
+// Accuracy harness: exponent and reference power error against the number
+// of calibration samples, and what the fitted model buys in ranging over
+// the -59 dBm / 2.0 default on a node whose truth is different
+static void test_benchmark_fit_accuracy()
+{
+    const PathLoss truth = {-50.0f, 2.9f, 5.0f};
+    std::mt19937 rng(9);
+    double lastN = 1e9;
+    for (int samples : {20, 50, 200, 1000}) {
+        std::vector<double> p0Err, nErr;
+        int fails = 0;
+        for (int run = 0; run < 300; run++) {
+            PathLoss m;
+            if (!walk(truth, samples, truth.sigmaDb, rng).solve(m)) {
+                fails++;
+                continue;
+            }
+            p0Err.push_back(fabs(m.p0 - truth.p0));
+            nErr.push_back(fabs(m.n - truth.n));
+        }
+        double n90 = percentile(nErr, 0.9);
+        printf("%4d samples: |p0 error| median %.2f dB p90 %.2f dB, |n error| median %.3f p90 %.3f, %d/300 refused\n",
+               samples, percentile(p0Err, 0.5), percentile(p0Err, 0.9), percentile(nErr, 0.5), n90, fails);
+        TEST_ASSERT_LESS_THAN(lastN, n90);
+        lastN = n90;
+    }
+    TEST_ASSERT_LESS_THAN(0.1, lastN);
+
+    // Ranging from a filtered RSSI stream at known distances
+    PathLoss fitted;
+    TEST_ASSERT_TRUE(walk(truth, 200, truth.sigmaDb, rng).solve(fitted));
+    std::normal_distribution<double> noise(0, truth.sigmaDb);
+    std::vector<double> fitErr, defErr;
+    for (double d : {5.0, 10.0, 20.0, 35.0}) {
+        for (int run = 0; run < 100; run++) {
+            RssiFilter f;
+            for (int i = 0; i < 20; i++) f.update((float)(modelRssi(truth, d) + noise(rng)));
+            fitErr.push_back(fabs(pathLossDistance(fitted, f.value()) - d) / d);
+            defErr.push_back(fabs(pathLossDistance(PATHLOSS_DEFAULT, f.value()) - d) / d);
+        }
+    }
+    double fitMed = percentile(fitErr, 0.5), defMed = percentile(defErr, 0.5);
+    printf("range error, median: fitted model %.0f%%, default model %.0f%%\n", fitMed * 100, defMed * 100);
+    TEST_ASSERT_LESS_THAN(defMed * 0.5, fitMed);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_distance_roundtrip);
+    RUN_TEST(test_filter_rejects_spikes);
+    RUN_TEST(test_filter_noisy_trace);
+    RUN_TEST(test_fit_recovers_model);
+    RUN_TEST(test_fit_refuses);
+    RUN_TEST(test_benchmark_fit_accuracy);
+    return UNITY_END();
+}